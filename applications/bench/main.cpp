@@ -0,0 +1,722 @@
+// kangaroo_bench: host (CPU) benchmarks of the reconstruction and I/O hot
+// paths on reproducible synthetic inputs. All kernels run on the host and
+// none of them needs a GPU: the grid benchmarks keep their volumes in
+// TargetHost memory, which is pinned with a CUDA device and pageable
+// without. Results are written as JSON so they can be compared between
+// commits.
+//
+// usage: kangaroo_bench [--json file|-] [--repeat n] [--threads n]
+//                       [--filter substring] [--tmp dir] [--revision id]
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <kangaroo/kangaroo.h>
+#include <kangaroo/host_launch_utils.h>
+
+#ifdef HAVE_GRID_SDF
+#include <kangaroo/RollingGridSDF/BoundedVolumeGrid.h>
+#include <kangaroo/RollingGridSDF/GridSDFArchive.h>
+#ifdef HAVE_ASSIMP
+#include <kangaroo/RollingGridSDF/ParallelMarchingCubesGrid.h>
+#include <kangaroo/RollingGridSDF/SavePPMGrid.h>
+#include <kangaroo/RollingGridSDF/LoadPPMGrid.h>
+#ifdef HAVE_GLM
+#include <kangaroo/RollingGridSDF/PLYIO.h>
+#endif
+#endif
+#endif
+
+#ifndef KANGAROO_BENCH_REVISION
+#define KANGAROO_BENCH_REVISION "unknown"
+#endif
+
+using namespace std;
+
+//////////////////////////////////////////////////////
+// Timing and reporting
+//////////////////////////////////////////////////////
+
+struct BenchResult
+{
+    string name;
+    string params;
+    string error;
+    double items;
+    vector<double> ms;
+};
+
+class BenchRunner
+{
+public:
+    BenchRunner(int repeats, const string& filter)
+        : repeats(max(repeats,1)), filter(filter)
+    {
+    }
+
+    bool Enabled(const string& name) const
+    {
+        return filter.empty() || name.find(filter) != string::npos;
+    }
+
+    //! Time fn() repeats times after one warm up call. items is the amount of
+    //! work (pixels, voxels, bytes...) done by a single call.
+    template<typename F>
+    void Run(const string& name, const string& params, double items, F fn)
+    {
+        if(!Enabled(name)) return;
+
+        BenchResult r;
+        r.name = name;
+        r.params = params;
+        r.items = items;
+
+        try {
+            fn();
+            for(int i=0; i < repeats; ++i) {
+                const chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+                fn();
+                const chrono::steady_clock::time_point t1 = chrono::steady_clock::now();
+                r.ms.push_back( chrono::duration<double,milli>(t1-t0).count() );
+            }
+        }catch(const exception& e) {
+            r.error = e.what();
+        }
+
+        Report(r);
+        results.push_back(r);
+    }
+
+    //! Record a benchmark that could not be set up
+    void Fail(const string& name, const string& params, const string& error)
+    {
+        if(!Enabled(name)) return;
+
+        BenchResult r;
+        r.name = name;
+        r.params = params;
+        r.error = error;
+        r.items = 0;
+        Report(r);
+        results.push_back(r);
+    }
+
+    void WriteJson(ostream& os, const string& revision) const
+    {
+        os << "{\n";
+        os << "  \"revision\": \"" << Escape(revision) << "\",\n";
+        os << "  \"threads\": " << roo::HostThreadPool::Instance().NumThreads() << ",\n";
+        os << "  \"repeats\": " << repeats << ",\n";
+        os << "  \"pinned_host_memory\": " << (roo::HostMemoryPinned() ? "true" : "false") << ",\n";
+        os << "  \"benchmarks\": [";
+        for(size_t i=0; i < results.size(); ++i) {
+            const BenchResult& r = results[i];
+            os << (i ? ",\n" : "\n") << "    {\"name\": \"" << Escape(r.name)
+               << "\", \"params\": \"" << Escape(r.params) << "\"";
+            if(r.error.empty()) {
+                vector<double> s = r.ms;
+                sort(s.begin(), s.end());
+                double mean = 0;
+                for(size_t k=0; k < s.size(); ++k) mean += s[k];
+                mean /= s.size();
+                const double median = s[s.size()/2];
+                os << ", \"min_ms\": " << s.front() << ", \"median_ms\": " << median
+                   << ", \"mean_ms\": " << mean << ", \"max_ms\": " << s.back()
+                   << ", \"items\": " << r.items
+                   << ", \"items_per_s\": " << (median > 0 ? 1000.0 * r.items / median : 0);
+            }else{
+                os << ", \"error\": \"" << Escape(r.error) << "\"";
+            }
+            os << "}";
+        }
+        os << "\n  ]\n}\n";
+    }
+
+    bool HasErrors() const
+    {
+        for(size_t i=0; i < results.size(); ++i) {
+            if(!results[i].error.empty()) return true;
+        }
+        return false;
+    }
+
+protected:
+    static string Escape(const string& s)
+    {
+        string out;
+        for(size_t i=0; i < s.size(); ++i) {
+            if(s[i] == '"' || s[i] == '\\') out += '\\';
+            out += (s[i] == '\n') ? ' ' : s[i];
+        }
+        return out;
+    }
+
+    static void Report(const BenchResult& r)
+    {
+        if(r.error.empty()) {
+            vector<double> s = r.ms;
+            sort(s.begin(), s.end());
+            cerr << r.name << " [" << r.params << "] median " << s[s.size()/2]
+                 << " ms, min " << s.front() << " ms" << endl;
+        }else{
+            cerr << r.name << " [" << r.params << "] failed: " << r.error << endl;
+        }
+    }
+
+    int repeats;
+    string filter;
+    vector<BenchResult> results;
+};
+
+// Discard std::cout while in scope, for library calls that log per call
+struct SilenceCout
+{
+    SilenceCout() : buf(cout.rdbuf(0)) {}
+    ~SilenceCout() { cout.rdbuf(buf); }
+    streambuf* buf;
+};
+
+static string Dims(int w, int h)
+{
+    ostringstream ss;
+    ss << w << "x" << h;
+    return ss.str();
+}
+
+//////////////////////////////////////////////////////
+// Synthetic inputs
+//////////////////////////////////////////////////////
+
+// Depth of a tilted plane seen by camera K at the origin, as RaycastPlane
+// renders it, with a small ripple so that normals are not constant.
+static void MakePlaneDepth(roo::Image<float,roo::TargetHost> depth, const roo::ImageIntrinsics& K)
+{
+    const float3 n = make_float3(0.0f, -0.3f, -1.0f);
+    const float3 p0 = make_float3(0.0f, 0.0f, 3.0f);
+    const float d = n.x*p0.x + n.y*p0.y + n.z*p0.z;
+
+    for(unsigned int v=0; v < depth.h; ++v) {
+        for(unsigned int u=0; u < depth.w; ++u) {
+            const float3 r = K.Unproject((float)u, (float)v);
+            const float t = d / (n.x*r.x + n.y*r.y + n.z*r.z);
+            depth(u,v) = t + 0.02f * sinf(0.05f*u) * cosf(0.05f*v);
+        }
+    }
+}
+
+static void BenchImages(BenchRunner& bench)
+{
+    const int w = 640;
+    const int h = 480;
+    const string params = Dims(w,h);
+    const double pixels = w*h;
+
+    roo::Image<float,roo::TargetHostAligned,roo::Manage> depth(w,h);
+    roo::Image<float,roo::TargetHostAligned,roo::Manage> filtered(w,h);
+    roo::Image<float4,roo::TargetHostAligned,roo::Manage> vbo(w,h);
+    roo::Image<float4,roo::TargetHostAligned,roo::Manage> nrm(w,h);
+    roo::Pyramid<float,5,roo::TargetHostAligned,roo::Manage> pyr(w,h);
+
+    const roo::ImageIntrinsics K(570.0f, 570.0f, w/2.0f - 0.5f, h/2.0f - 0.5f);
+    MakePlaneDepth(depth, K);
+
+    bench.Run("host/bilateral_filter", params + " size 7", pixels, [&]() {
+        roo::BilateralFilter<float,float>(filtered, depth, 2.0f, 0.05f, 7);
+    });
+
+    // 16-bit depth in mm with a large window, direct against the grid
+    roo::Image<unsigned short,roo::TargetHostAligned,roo::Manage> depth_mm(w,h);
+    for(int v=0; v < h; ++v) {
+        for(int u=0; u < w; ++u) {
+            depth_mm(u,v) = (unsigned short)(1000 * depth(u,v));
+        }
+    }
+
+    bench.Run("host/bilateral_filter_mm", params + " gs 10 size 20", pixels, [&]() {
+        roo::BilateralFilter<float,unsigned short>(filtered, depth_mm, 10.0f, 20.0f, 20, 1);
+    });
+
+    bench.Run("host/bilateral_grid_mm", params + " gs 10", pixels, [&]() {
+        roo::BilateralGridFilter<float,unsigned short>(filtered, depth_mm, 10.0f, 20.0f, 1);
+    });
+
+    bench.Run("host/gaussian_blur", params + " sigma 2", pixels, [&]() {
+        roo::GaussianBlur<float,float>(filtered, depth, filtered, 2.0f);
+    });
+
+    bench.Run("host/gaussian_blur", params + " sigma 20", pixels, [&]() {
+        roo::GaussianBlur<float,float>(filtered, depth, filtered, 20.0f);
+    });
+
+    roo::Image<unsigned char,roo::TargetHostAligned,roo::Manage> scratch(w*sizeof(float), h);
+    bench.Run("host/box_filter", params + " rad 15", pixels, [&]() {
+        roo::BoxFilter<float,float,float>(filtered, depth, scratch, 15);
+    });
+
+    bench.Run("host/guided_filter", params + " rad 8", pixels, [&]() {
+        roo::GuidedFilter(filtered, depth, depth, 8, 1E-4f);
+    });
+
+    bench.Run("host/median_3x3", params, pixels, [&]() {
+        roo::MedianFilter3x3(filtered, depth);
+    });
+
+    bench.Run("host/median_reject_negative_9x9", params, pixels, [&]() {
+        roo::MedianFilterRejectNegative9x9(filtered, depth, 40);
+    });
+
+    // 31x31 disc: direct (spectrum set up per call) against a precomputed spectrum
+    roo::Image<float,roo::TargetHostAligned,roo::Manage> disc(31,31);
+    for(int v=0; v < 31; ++v) {
+        for(int u=0; u < 31; ++u) {
+            disc(u,v) = (u-15)*(u-15) + (v-15)*(v-15) <= 15*15 ? 1.0f : 0.0f;
+        }
+    }
+
+    bench.Run("host/convolution", params + " kernel 31x31", pixels, [&]() {
+        roo::Convolution<float,float,float,float>(filtered, depth, disc, 15, 15);
+    });
+
+    roo::ConvolutionSpectrum disc_spectrum;
+    roo::ConvolutionSpectrumInit(disc_spectrum, w, h, disc, 15, 15);
+    bench.Run("host/convolution_spectrum", params + " kernel 31x31", pixels, [&]() {
+        roo::Convolution(filtered, depth, disc_spectrum);
+    });
+
+    bench.Run("host/depth_to_vbo", params, pixels, [&]() {
+        roo::DepthToVbo<float>(vbo, depth, K);
+    });
+
+    bench.Run("host/normals_from_vbo", params, pixels, [&]() {
+        roo::NormalsFromVbo(nrm, vbo);
+    });
+
+    roo::Pyramid<float,5,roo::TargetHost> hpyr(pyr);
+    MakePlaneDepth(hpyr.imgs[0], K);
+    bench.Run("host/pyramid_box_reduce", params + " 5 levels", pixels, [&]() {
+        roo::BoxReduce<float,5,float>(hpyr);
+    });
+
+    // Point to plane normal equations of vbo against itself, summed per row
+    // then serially so the result does not depend on the thread count.
+    roo::DepthToVbo<float>(vbo, depth, K);
+    roo::NormalsFromVbo(nrm, vbo);
+    vector<roo::LeastSquaresSystem<float,6> > rows(h);
+    roo::LeastSquaresSystem<float,6> sum;
+
+    bench.Run("host/lss_reduce", params + " 6dof", pixels, [&]() {
+        roo::ParallelForRows(h, [&](size_t r0, size_t r1) {
+            for(size_t v=r0; v < r1; ++v) {
+                roo::LeastSquaresSystem<float,6>& lss = rows[v];
+                lss.SetZero();
+                for(int u=0; u < w; ++u) {
+                    const float4 P = vbo(u,v);
+                    const float4 N = nrm(u,v);
+                    if(!std::isfinite(P.z) || !std::isfinite(N.z)) continue;
+                    const float3 p = make_float3(P.x,P.y,P.z);
+                    const float3 n = make_float3(N.x,N.y,N.z);
+                    const float3 pxn = cross(p,n);
+                    const float y = 0.01f * n.z;
+                    const roo::Mat<float,1,6> J = {{n.x, n.y, n.z, pxn.x, pxn.y, pxn.z}};
+                    lss.JTJ += roo::OuterProduct(J, 1.0f);
+                    lss.JTy += roo::mul_aTb(J, y);
+                    lss.sqErr += y*y;
+                    lss.obs += 1;
+                }
+            }
+        });
+        sum.SetZero();
+        for(int v=0; v < h; ++v) sum += rows[v];
+    });
+}
+
+// Census stereo at camera rate: descriptors of both views and the full
+// Hamming cost volume, right view shifted by a constant disparity.
+// Point kf at a view of img. Image declares a copy constructor but no
+// assignment, so copy the view's fields rather than assigning the Image.
+static void SetKeyframeImage(roo::ImageKeyframe<float,roo::TargetHost>& kf, const roo::Image<float,roo::TargetHost>& img)
+{
+    kf.img.ptr = img.ptr;
+    kf.img.pitch = img.pitch;
+    kf.img.w = img.w;
+    kf.img.h = img.h;
+}
+
+static void BenchStereo(BenchRunner& bench)
+{
+    const int w = 640;
+    const int h = 480;
+    const int maxdisp = 128;
+    ostringstream ps;
+    ps << Dims(w,h) << " " << maxdisp << " disparities";
+    const double pixels = w*h;
+
+    roo::Image<unsigned char,roo::TargetHostAligned,roo::Manage> left(w,h);
+    roo::Image<unsigned char,roo::TargetHostAligned,roo::Manage> right(w,h);
+    roo::Image<ulong4,roo::TargetHostAligned,roo::Manage> cl(w,h);
+    roo::Image<ulong4,roo::TargetHostAligned,roo::Manage> cr(w,h);
+    roo::Volume<float,roo::TargetHostAligned,roo::Manage> vol(w,h,maxdisp);
+
+    unsigned int seed = 1;
+    for(int v=0; v < h; ++v) {
+        for(int u=0; u < w; ++u) {
+            seed = seed*1103515245 + 12345;
+            left(u,v) = (unsigned char)(seed >> 16);
+        }
+    }
+    for(int v=0; v < h; ++v) {
+        for(int u=0; u < w; ++u) {
+            right(u,v) = left(min(u+16,w-1),v);
+        }
+    }
+
+    bench.Run("host/census_16x16", Dims(w,h), pixels, [&]() {
+        roo::Census(cl, left);
+    });
+
+    bench.Run("host/census_stereo_volume", ps.str(), pixels*maxdisp, [&]() {
+        roo::Census(cl, left);
+        roo::Census(cr, right);
+        roo::CensusStereoVolume<float,ulong4>(vol, cl, cr, maxdisp, -1);
+    });
+
+    // Box sum patch costs, same work for any patch size
+    bench.Run("host/patch_sad_15x15_volume", ps.str(), pixels*maxdisp, [&]() {
+        roo::CostVolumeFromStereoPatch<roo::SADPatchScore<float,7,roo::ImgAccessClamped>,unsigned char>(vol, left, right, -1);
+    });
+
+    bench.Run("host/patch_ssnd_7x7_volume", ps.str(), pixels*maxdisp, [&]() {
+        roo::CostVolumeFromStereoPatch<roo::SSNDPatchScore<float,3,roo::ImgAccessClamped>,unsigned char>(vol, left, right, -1);
+    });
+
+    // Left and right disparities, confidence and left right check in one pass
+    roo::Image<float,roo::TargetHostAligned,roo::Manage> displ(w,h);
+    roo::Image<float,roo::TargetHostAligned,roo::Manage> dispr(w,h);
+    roo::Image<float,roo::TargetHostAligned,roo::Manage> conf(w,h);
+    roo::Image<unsigned char,roo::TargetHostAligned,roo::Manage> lrcheck(w,h);
+    bench.Run("host/cost_vol_disparities", ps.str(), pixels*maxdisp, [&]() {
+        roo::CostVolDisparities(displ, dispr, conf, lrcheck, vol, maxdisp, -1);
+    });
+
+    // Whole pipeline streamed in bands, working memory of a few bands only
+    roo::Image<float,roo::TargetHostAligned,roo::Manage> disp(w,h);
+    roo::StereoStreamParams params;
+    params.maxDisp = 64;
+    ostringstream ss;
+    ss << Dims(w,h) << " " << params.maxDisp << " disparities, band " << params.bandRows
+       << " overlap " << params.overlapRows;
+    bench.Run("host/stereo_streamed", ss.str(), pixels, [&]() {
+        roo::DenseStereoStreamed<unsigned char>(disp, left, right, params);
+    });
+
+    // Same frame again and again, as from a static rig: narrow search only
+    roo::StereoTemporalParams tparams;
+    roo::StereoTemporal temporal(w, h, tparams);
+    ostringstream ts;
+    ts << Dims(w,h) << " " << tparams.maxDisp << " disparities, static";
+    bench.Run("host/stereo_temporal", ts.str(), pixels, [&]() {
+        temporal.Process<unsigned char>(disp, left, right);
+    });
+
+    // Coarse to fine: full search on the 1/8 level, narrow bands below
+    roo::Pyramid<unsigned char,4,roo::TargetHostAligned,roo::Manage> pl(w,h);
+    roo::Pyramid<unsigned char,4,roo::TargetHostAligned,roo::Manage> pr(w,h);
+    pl.imgs[0].CopyFrom(left);
+    pr.imgs[0].CopyFrom(right);
+    ostringstream pps;
+    pps << ps.str() << ", 4 levels";
+    bench.Run("host/stereo_pyramid", pps.str(), pixels, [&]() {
+        roo::BoxReduce<unsigned char,4,unsigned int>(roo::Pyramid<unsigned char,4,roo::TargetHost>(pl));
+        roo::BoxReduce<unsigned char,4,unsigned int>(roo::Pyramid<unsigned char,4,roo::TargetHost>(pr));
+        roo::DenseStereoPyramid<unsigned char,4>(disp, pl, pr, maxdisp);
+    });
+
+    // PatchMatch over a disparity range as wide as the image, on a quarter
+    roo::Image<float,roo::TargetHostAligned,roo::Manage> lf(w/2,h/2);
+    roo::Image<float,roo::TargetHostAligned,roo::Manage> rf(w/2,h/2);
+    roo::Image<float,roo::TargetHostAligned,roo::Manage> dispf(w/2,h/2);
+    for(int v=0; v < h/2; ++v) {
+        for(int u=0; u < w/2; ++u) {
+            lf(u,v) = left(u,v);
+            rf(u,v) = right(u,v);
+        }
+    }
+    roo::PatchMatchParams pm;
+    pm.maxDisp = w/2;
+    pm.iterations = 2;
+    ostringstream pms;
+    pms << Dims(w/2,h/2) << " " << pm.maxDisp << " disparities, " << pm.iterations << " iterations";
+    bench.Run("host/patch_match", pms.str(), pixels/4, [&]() {
+        roo::PatchMatchStereo(dispf, lf, rf, pm);
+    });
+
+    // Plane sweep of four views around a reference, poses one baseline apart
+    const int views = 4;
+    const int planes = 32;
+    roo::Volume<roo::CostVolElem,roo::TargetHostAligned,roo::Manage> psvol(w/4,h/4,planes);
+    roo::ImageKeyframe<float,roo::TargetHost> ref;
+    roo::ImageKeyframe<float,roo::TargetHost> kfs[views];
+    SetKeyframeImage(ref, lf.SubImage(w/4,h/4));
+    ref.K = roo::ImageIntrinsics(w/4, w/4, w/8, h/8);
+    ref.T_iw = roo::MatZero<float,3,4>();
+    ref.T_iw(0,0) = ref.T_iw(1,1) = ref.T_iw(2,2) = 1;
+    for(int c=0; c < views; ++c) {
+        SetKeyframeImage(kfs[c], rf.SubImage(w/4,h/4));
+        kfs[c].K = ref.K;
+        kfs[c].T_iw = ref.T_iw;
+        kfs[c].T_iw(c/2,3) = (c%2) ? 0.1f : -0.1f;
+    }
+    ostringstream pss;
+    pss << Dims(w/4,h/4) << " " << planes << " planes, " << views << " views";
+    bench.Run("host/plane_sweep", pss.str(), pixels/16*planes*views, [&]() {
+        roo::PlaneSweep<float>(psvol, ref, kfs, views, 0.1f);
+    });
+}
+
+#ifdef HAVE_GRID_SDF
+
+typedef roo::BoundedVolumeGrid<roo::SDF_t_Smart,roo::TargetHost,roo::Manage> HostGridVolume;
+
+// Signed distance to a sphere in the middle of the volume, as SdfSphere
+// writes it, in the grids close enough to the surface to hold it.
+static void MakeSphereGrid(HostGridVolume& vol, int n, int res)
+{
+    const roo::BoundingBox bbox(make_float3(-1,-1,-1), make_float3(1,1,1));
+    vol.Init(n, n, n, res, bbox);
+
+    const float r = 0.7f;
+    const float3 s = vol.VoxelSizeUnits();
+    const float grid_radius = 0.5f * res * sqrtf(s.x*s.x + s.y*s.y + s.z*s.z);
+
+    for(unsigned int k=0; k < vol.m_nGridNum_d; ++k) {
+        for(unsigned int j=0; j < vol.m_nGridNum_h; ++j) {
+            for(unsigned int i=0; i < vol.m_nGridNum_w; ++i) {
+                const float3 c = vol.VoxelPositionInUnits(i*res + res/2, j*res + res/2, k*res + res/2);
+                if(fabs(length(c) - r) > 2*grid_radius) continue;
+
+                vol.InitSingleBasicSDFWithGridIndex(i*res, j*res, k*res);
+                for(int z=0; z < res; ++z) {
+                    for(int y=0; y < res; ++y) {
+                        for(int x=0; x < res; ++x) {
+                            const float3 p = vol.VoxelPositionInUnits(i*res+x, j*res+y, k*res+z);
+                            vol.Get(i*res+x, j*res+y, k*res+z) = roo::SDF_t_Smart(length(p) - r, 1.0f);
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+static int NumActiveGrids(const HostGridVolume& vol)
+{
+    int num = 0;
+    for(unsigned int i=0; i < vol.m_nTotalGridRes; ++i) {
+        if(vol.CheckIfBasicSDFActive(i)) ++num;
+    }
+    return num;
+}
+
+static void BenchGrids(BenchRunner& bench, const string& tmp)
+{
+    const int n = 256;
+    const int res = 16;
+    ostringstream ps;
+    ps << n << "^3 grid " << res;
+    const string params = ps.str();
+
+    HostGridVolume* vol = new HostGridVolume();
+    HostGridVolume* loaded = new HostGridVolume();
+
+    try {
+        MakeSphereGrid(*vol, n, res);
+    }catch(const exception& e) {
+        bench.Fail("grid/setup", params, e.what());
+        delete vol;
+        delete loaded;
+        return;
+    }
+
+    const int grids = NumActiveGrids(*vol);
+    const double grid_bytes = (double)res*res*res*sizeof(roo::SDF_t_Smart);
+    const double bytes = grids * grid_bytes;
+    const int3 g0 = make_int3(0,0,0);
+
+#ifdef HAVE_ASSIMP
+    roo::BoundedVolumeGrid<float,roo::TargetHost,roo::Manage>* color =
+        new roo::BoundedVolumeGrid<float,roo::TargetHost,roo::Manage>();
+    color->Init(1,1,1, res, vol->m_bbox);
+
+    roo::MarchingCUBERst mesh;
+    bench.Run("grid/marching_cubes", params, (double)grids*res*res*res, [&]() {
+        mesh = roo::MarchingCUBERst();
+        roo::GenMeshGridParallel(*vol, *color, mesh);
+    });
+    delete color;
+
+    // One PXM file per grid, named as SavePXMGridDesire names them
+    vector<string> files;
+    vector<unsigned int> indices;
+    for(unsigned int i=0; i < vol->m_nTotalGridRes; ++i) {
+        if(!vol->CheckIfBasicSDFActive(i)) continue;
+        const int3 l = make_int3(i % vol->m_nGridNum_w, (i / vol->m_nGridNum_w) % vol->m_nGridNum_h,
+                                 i / (vol->m_nGridNum_w * vol->m_nGridNum_h));
+        ostringstream name;
+        name << tmp << "/kangaroo_bench#0#0#0#" << l.x << "#" << l.y << "#" << l.z;
+        files.push_back(name.str());
+        indices.push_back(i);
+    }
+
+    bench.Run("io/pxm_save", params, bytes, [&]() {
+        for(size_t i=0; i < files.size(); ++i) {
+            SavePXM(files[i], vol->m_GridVolumes[indices[i]], "P5");
+        }
+    });
+
+    loaded->Init(n, n, n, res, vol->m_bbox);
+    bench.Run("io/pxm_load", params, bytes, [&]() {
+        for(size_t i=0; i < files.size(); ++i) {
+            LoadPXMSingleGrid(files[i], loaded->m_GridVolumes[indices[i]]);
+        }
+        loaded->FreeMemory();
+    });
+
+    for(size_t i=0; i < files.size(); ++i) {
+        remove(files[i].c_str());
+    }
+
+#ifdef HAVE_GLM
+    const string ply = tmp + "/kangaroo_bench.ply";
+    mesh.colors.assign(mesh.verts.size(), aiColor4D(128,128,128,255));
+    ostringstream ms;
+    ms << mesh.verts.size() << " verts " << mesh.faces.size() << " faces";
+    const double ply_bytes = mesh.verts.size()*(2*sizeof(aiVector3D)+4) + mesh.faces.size()*13.0;
+
+    bench.Run("io/ply_save", ms.str(), ply_bytes, [&]() {
+        SilenceCout quiet;
+        PLYModel model;
+        model.PLYWrite(mesh.verts, mesh.norms, mesh.faces, mesh.colors, ply.c_str(), true, true);
+    });
+
+    bench.Run("io/ply_load", ms.str(), ply_bytes, [&]() {
+        SilenceCout quiet;
+        PLYModel model;
+        model.ReadStarnardPLY(ply.c_str(), true, true);
+        model.FreeMemory();
+    });
+    remove(ply.c_str());
+#endif
+#endif // HAVE_ASSIMP
+
+    // Grid archive, written from scratch and read back through a mapping
+    const string archive = tmp + "/kangaroo_bench.kgrid";
+    bench.Run("io/grid_archive_write", params, bytes, [&]() {
+        roo::GridSDFArchiveWriter writer;
+        if(!writer.Open(archive, res, make_int3(n,n,n), false)) {
+            throw runtime_error("cannot open " + archive);
+        }
+        writer.AppendBoundingBox(g0, vol->m_bbox);
+        for(unsigned int i=0; i < vol->m_nTotalGridRes; ++i) {
+            if(!vol->CheckIfBasicSDFActive(i)) continue;
+            const int3 l = make_int3(i % vol->m_nGridNum_w, (i / vol->m_nGridNum_w) % vol->m_nGridNum_h,
+                                     i / (vol->m_nGridNum_w * vol->m_nGridNum_h));
+            writer.AppendGrid(g0, l, vol->m_GridVolumes[i]);
+        }
+        writer.Close();
+    });
+
+    float checksum = 0;
+    bench.Run("io/grid_archive_map", params, bytes, [&]() {
+        roo::GridSDFArchiveMap map;
+        if(!map.Open(archive)) {
+            throw runtime_error("cannot map " + archive);
+        }
+        loaded->Init(n, n, n, res, vol->m_bbox);
+        map.GetGlobalVolume(g0, *loaded);
+
+        // touch every voxel so the pages are actually read
+        float s = 0;
+        for(unsigned int i=0; i < loaded->m_nTotalGridRes; ++i) {
+            if(!loaded->CheckIfBasicSDFActive(i)) continue;
+            const roo::VolumeGrid<roo::SDF_t_Smart,roo::TargetHost,roo::Manage>& g = loaded->m_GridVolumes[i];
+            for(unsigned int k=0; k < g.w*g.h*g.d; ++k) s += g.ptr[k].val;
+        }
+        checksum = s;
+        loaded->FreeMemory();
+    });
+    remove(archive.c_str());
+    (void)checksum;
+
+    vol->FreeMemory();
+    delete vol;
+    delete loaded;
+}
+
+#endif // HAVE_GRID_SDF
+
+//////////////////////////////////////////////////////
+// Entry point
+//////////////////////////////////////////////////////
+
+int main( int argc, char* argv[] )
+{
+    string json = "kangaroo_bench.json";
+    string filter;
+    string revision = KANGAROO_BENCH_REVISION;
+    string tmp = getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp";
+    int repeats = 10;
+    int threads = 0;
+
+    for(int i=1; i < argc; ++i) {
+        const string arg = argv[i];
+        const bool has_value = i+1 < argc;
+        if(arg == "--json" && has_value) {
+            json = argv[++i];
+        }else if(arg == "--repeat" && has_value) {
+            repeats = atoi(argv[++i]);
+        }else if(arg == "--threads" && has_value) {
+            threads = atoi(argv[++i]);
+        }else if(arg == "--filter" && has_value) {
+            filter = argv[++i];
+        }else if(arg == "--tmp" && has_value) {
+            tmp = argv[++i];
+        }else if(arg == "--revision" && has_value) {
+            revision = argv[++i];
+        }else{
+            cerr << "usage: " << argv[0] << " [--json file|-] [--repeat n] [--threads n]"
+                 << " [--filter substring] [--tmp dir] [--revision id]" << endl;
+            return -1;
+        }
+    }
+
+    if(threads > 0) {
+        roo::HostThreadPool::Instance().SetNumThreads(threads);
+    }
+
+    BenchRunner bench(repeats, filter);
+
+    BenchImages(bench);
+    BenchStereo(bench);
+#ifdef HAVE_GRID_SDF
+    BenchGrids(bench, tmp);
+#endif
+
+    if(json == "-") {
+        bench.WriteJson(cout, revision);
+    }else{
+        ofstream f(json.c_str());
+        bench.WriteJson(f, revision);
+        cerr << "Results written to " << json << endl;
+    }
+
+    return bench.HasErrors() ? 1 : 0;
+}
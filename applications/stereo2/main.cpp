@@ -172,6 +172,21 @@ int main( int argc, char* argv[] )
     roo::Image<unsigned char, TargetHost, Manage> hImg[] = {{lw,lh},{lw,lh}};
     roo::Image<float, TargetHost, Manage> hDisp(lw,lh);
 
+    // Host copies of the cost volume for the CPU SGM backend, allocated the
+    // first time it is switched on (2 x lw*lh*MAXD floats)
+    typedef Volume<float, TargetHostAligned, Manage> HostCostVolume;
+    std::unique_ptr<HostCostVolume> hVol[2];
+    roo::Image<float, TargetHost, Manage> hImgf(lw,lh);
+
+    // Host images for band streaming stereo
+    roo::Image<float, TargetHost, Manage> hImgs[] = {{lw,lh},{lw,lh}};
+
+    // Census / SGM of consecutive frames reusing the previous disparities
+    StereoTemporalParams temporal_params;
+    temporal_params.maxDisp = MAXD;
+    temporal_params.maxChange = 8.0f / 255.0f;
+    StereoTemporal temporal(lw, lh, temporal_params);
+
 #ifdef COSTVOL_TIME
     Sophus::SE3d T_wv;
     Volume<CostVolElem, TargetDevice, Manage>  dCostVol(lw,lh,MAXD);
@@ -243,6 +258,13 @@ int main( int argc, char* argv[] )
     Var<bool> do_sgm_h("ui.SGM horiz", false, true);
     Var<bool> do_sgm_v("ui.SGM vert", false, true);
     Var<bool> do_sgm_reverse("ui.SGM reverse", false, true);
+    Var<bool> do_sgm_diag("ui.SGM diagonal (host)", false, true);
+    Var<bool> do_sgm_host("ui.SGM on host", false, true);
+    Var<bool> stream_host("ui.stream census on host", false, true);
+    Var<int> stream_band("ui.stream band rows", 32, 8, 128);
+    Var<int> stream_overlap("ui.stream overlap rows", 32, 0, 128);
+    Var<bool> temporal_host("ui.temporal census on host", false, true);
+    Var<int> temporal_radius("ui.temporal radius", 2, 0, 16);
     Var<float> sgm_p1("ui.sgm p1",0.01, 0, 0.1);
     Var<float> sgm_p2("ui.sgm p2",0.02, 0, 1, false);
 
@@ -380,59 +402,114 @@ int main( int argc, char* argv[] )
                 Census(census[i], img[i]);
             }
 
-            if(use_census) {
-                CensusStereoVolume<float, census_t>(vol[0], census[0], census[1], maxdisp, -1);
-                if(leftrightcheck) CensusStereoVolume<float, census_t>(vol[1], census[1], census[0], maxdisp, +1);
+            if(use_census && temporal_host) {
+                // Narrow search where the last frame was confident and unchanged
+                StereoTemporalParams& params = temporal.Params();
+                params.maxDisp = maxdisp;
+                params.P1 = sgm_p1;
+                params.P2 = sgm_p2;
+                params.dohoriz = do_sgm_h;
+                params.dovert = do_sgm_v;
+                params.doreverse = do_sgm_reverse;
+                params.dodiag = do_sgm_diag;
+                params.radius = temporal_radius;
+
+                hImgs[0].CopyFrom(img[0]);
+                hImgs[1].CopyFrom(img[1]);
+                temporal.Process<float>(hDisp, hImgs[0], hImgs[1]);
+                disp[0].CopyFrom(hDisp);
+            }else if(use_census && stream_host) {
+                // Census, SGM and minimum on the host a band of rows at a time
+                StereoStreamParams params;
+                params.maxDisp = maxdisp;
+                params.bandRows = stream_band;
+                params.overlapRows = stream_overlap;
+                params.P1 = sgm_p1;
+                params.P2 = sgm_p2;
+                params.dohoriz = do_sgm_h;
+                params.dovert = do_sgm_v;
+                params.doreverse = do_sgm_reverse;
+                params.dodiag = do_sgm_diag;
+                params.subpix = subpix;
+
+                for(int i=0; i<(leftrightcheck?2:1); ++i) {
+                    hImgs[0].CopyFrom(img[i]);
+                    hImgs[1].CopyFrom(img[1-i]);
+                    params.sd = i == 0 ? -1 : +1;
+                    DenseStereoStreamed<float>(hDisp, hImgs[0], hImgs[1], params);
+                    disp[i].CopyFrom(hDisp);
+                }
             }else{
-                CostVolumeFromStereoTruncatedAbsAndGrad(vol[0], img[0], img[1], -1, alpha, r1, r2);
-                if(leftrightcheck) CostVolumeFromStereoTruncatedAbsAndGrad(vol[1], img[1], img[0], +1, alpha, r1, r2);
-            }
-
+                if(use_census) {
+                    CensusStereoVolume<float, census_t>(vol[0], census[0], census[1], maxdisp, -1);
+                    if(leftrightcheck) CensusStereoVolume<float, census_t>(vol[1], census[1], census[0], maxdisp, +1);
+                }else{
+                    CostVolumeFromStereoTruncatedAbsAndGrad(vol[0], img[0], img[1], -1, alpha, r1, r2);
+                    if(leftrightcheck) CostVolumeFromStereoTruncatedAbsAndGrad(vol[1], img[1], img[0], +1, alpha, r1, r2);
+                }
 
-            if(filter) {
-                // Filter Cost volume
-                for(int v=0; v<(leftrightcheck?2:1); ++v)
-                {
-                    roo::Image<float, TargetDevice, Manage>& I = img[v];
-                    ComputeMeanVarience<float,float,float>(varI, temp[0], meanI, I, Scratch, rad);
 
-                    for(int d=0; d<maxdisp; ++d)
+                if(filter) {
+                    // Filter Cost volume
+                    for(int v=0; v<(leftrightcheck?2:1); ++v)
                     {
-                        roo::Image<float> P = vol[v].ImageXY(d);
-                        ComputeCovariance(temp[0],temp[2],temp[1],P,meanI,I,Scratch,rad);
-                        GuidedFilter(P,temp[0],varI,temp[1],meanI,I,Scratch,temp[2],temp[3],temp[4],rad,eps);
+                        roo::Image<float, TargetDevice, Manage>& I = img[v];
+                        ComputeMeanVarience<float,float,float>(varI, temp[0], meanI, I, Scratch, rad);
+
+                        for(int d=0; d<maxdisp; ++d)
+                        {
+                            roo::Image<float> P = vol[v].ImageXY(d);
+                            ComputeCovariance(temp[0],temp[2],temp[1],P,meanI,I,Scratch,rad);
+                            GuidedFilter(P,temp[0],varI,temp[1],meanI,I,Scratch,temp[2],temp[3],temp[4],rad,eps);
+                        }
                     }
                 }
-            }
-
-            if(applyBilateralFilter) {
-                // Filter Cost volume
-                for(int v=0; v<(leftrightcheck?2:1); ++v)
-                {
-                    roo::Image<float, TargetDevice, Manage>& I = img[v];
 
-                    for(int d=0; d<maxdisp; ++d)
+                if(applyBilateralFilter) {
+                    // Filter Cost volume
+                    for(int v=0; v<(leftrightcheck?2:1); ++v)
                     {
-                        roo::Image<float> P = vol[v].ImageXY(d);
-                        temp[0].CopyFrom(P);
-                        BilateralFilter<float,float,float>(P,temp[0],I,gs,gr,gc,bilateralWinSize);
+                        roo::Image<float, TargetDevice, Manage>& I = img[v];
+
+                        for(int d=0; d<maxdisp; ++d)
+                        {
+                            roo::Image<float> P = vol[v].ImageXY(d);
+                            temp[0].CopyFrom(P);
+                            BilateralFilter<float,float,float>(P,temp[0],I,gs,gr,gc,bilateralWinSize);
+                        }
                     }
                 }
-            }
 
-            if(do_sgm_h || do_sgm_v) {
-                for(int i=0; i<1; ++i) {
-                    SemiGlobalMatching<float,float,float>(vol[2],vol[i],img[i], maxdisp, sgm_p1, sgm_p2, do_sgm_h, do_sgm_v, do_sgm_reverse);
-                    vol[i].CopyFrom(vol[2]);
+                if(do_sgm_h || do_sgm_v) {
+                    for(int i=0; i<1; ++i) {
+                        if(do_sgm_host) {
+                            if(!hVol[0]) {
+                                hVol[0].reset(new HostCostVolume(lw,lh,MAXD));
+                                hVol[1].reset(new HostCostVolume(lw,lh,MAXD));
+                            }
+                            // Volumes are pitched differently on host and device, copy per slice
+                            for(int d=0; d<maxdisp; ++d) {
+                                hVol[0]->ImageXY(d).CopyFrom(vol[i].ImageXY(d));
+                            }
+                            hImgf.CopyFrom(img[i]);
+                            SemiGlobalMatching<float,float,float>(*hVol[1],*hVol[0],hImgf, maxdisp, sgm_p1, sgm_p2, do_sgm_h, do_sgm_v, do_sgm_reverse, do_sgm_diag);
+                            for(int d=0; d<maxdisp; ++d) {
+                                vol[i].ImageXY(d).CopyFrom(hVol[1]->ImageXY(d));
+                            }
+                        }else{
+                            SemiGlobalMatching<float,float,float>(vol[2],vol[i],img[i], maxdisp, sgm_p1, sgm_p2, do_sgm_h, do_sgm_v, do_sgm_reverse);
+                            vol[i].CopyFrom(vol[2]);
+                        }
+                    }
                 }
-            }
 
-            if(subpix) {
-                CostVolMinimumSubpix(disp[0],vol[0], maxdisp,-1);
-                if(leftrightcheck) CostVolMinimumSubpix(disp[1],vol[1], maxdisp,+1);
-            }else{
-                CostVolMinimum<float,float>(disp[0],vol[0], maxdisp);
-                if(leftrightcheck) CostVolMinimum<float,float>(disp[1],vol[1], maxdisp);
+                if(subpix) {
+                    CostVolMinimumSubpix(disp[0],vol[0], maxdisp,-1);
+                    if(leftrightcheck) CostVolMinimumSubpix(disp[1],vol[1], maxdisp,+1);
+                }else{
+                    CostVolMinimum<float,float>(disp[0],vol[0], maxdisp);
+                    if(leftrightcheck) CostVolMinimum<float,float>(disp[1],vol[1], maxdisp);
+                }
             }
 
             for(int di=0; di<(leftrightcheck?2:1); ++di) {
@@ -448,7 +525,8 @@ int main( int argc, char* argv[] )
 //                BilateralFilter<float,float,float>(disp[0],temp[0],img[0],gs,gr,gc,bilateralWinSize);
 //            }
 
-            if(leftrightcheck ) {
+            // temporal stereo is left right checked already
+            if(leftrightcheck && !(use_census && temporal_host)) {
                 LeftRightCheck(disp[1], disp[0], +1, maxdispdiff);
                 LeftRightCheck(disp[0], disp[1], -1, maxdispdiff);
             }
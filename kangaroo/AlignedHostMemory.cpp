@@ -0,0 +1,105 @@
+#include "AlignedHostMemory.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _WIN_
+#include <malloc.h>
+#else
+#include <sys/mman.h>
+#endif
+
+#include "host_launch_utils.h"
+
+namespace roo
+{
+
+static const size_t HugePageSize = 2 * 1024 * 1024;
+
+// Below this prefetching pages isn't worth waking the workers for
+static const size_t FirstTouchMinBytes = 1024 * 1024;
+
+static std::atomic<bool> g_huge_pages(false);
+static std::atomic<bool> g_first_touch(true);
+
+void SetAlignedHostHugePages(bool enable)
+{
+    g_huge_pages = enable;
+}
+
+bool AlignedHostHugePages()
+{
+    return g_huge_pages;
+}
+
+void SetAlignedHostFirstTouch(bool enable)
+{
+    g_first_touch = enable;
+}
+
+bool AlignedHostFirstTouch()
+{
+    return g_first_touch;
+}
+
+// Touch one byte per page, contiguous slices spread over the workers. This
+// only prefetches the page faults: slices go to whichever worker is free, so
+// pages are not placed on the node of the thread that later uses them.
+inline void FirstTouch(unsigned char* ptr, size_t bytes)
+{
+    const size_t page = 4096;
+    const size_t pages = (bytes + page - 1) / page;
+    HostThreadPool& pool = HostThreadPool::Instance();
+    const size_t slices = std::min<size_t>(pages, pool.NumThreads());
+
+    pool.Run(slices, [&](size_t s) {
+        const size_t p0 = (pages * s) / slices;
+        const size_t p1 = (pages * (s+1)) / slices;
+        for(size_t p = p0; p < p1; ++p) {
+            ptr[p*page] = 0;
+        }
+    });
+}
+
+void* AlignedHostAllocate(size_t bytes)
+{
+    const bool huge = g_huge_pages && bytes >= HugePageSize;
+    const size_t align = huge ? HugePageSize : HostAlignment;
+
+    void* ptr = 0;
+#ifdef _WIN_
+    ptr = _aligned_malloc(bytes, align);
+#else
+    if( posix_memalign(&ptr, align, bytes) != 0 ) {
+        ptr = 0;
+    }
+#endif
+    if(!ptr) {
+        return 0;
+    }
+
+#if defined(MADV_HUGEPAGE)
+    if(huge) {
+        madvise(ptr, bytes, MADV_HUGEPAGE);
+    }
+#endif
+
+    if(g_first_touch && bytes >= FirstTouchMinBytes) {
+        FirstTouch((unsigned char*)ptr, bytes);
+    }
+
+    return ptr;
+}
+
+void AlignedHostFree(void* ptr)
+{
+#ifdef _WIN_
+    _aligned_free(ptr);
+#else
+    free(ptr);
+#endif
+}
+
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+
+#include <kangaroo/platform.h>
+
+namespace roo
+{
+
+// Pageable host memory used by TargetHostAligned. Blocks start on a
+// HostAlignment boundary (larger for huge page backed blocks).
+static const size_t HostAlignment = 64;
+
+// Returns 0 on failure.
+KANGAROO_EXPORT void* AlignedHostAllocate(size_t bytes);
+KANGAROO_EXPORT void AlignedHostFree(void* ptr);
+
+// Back allocations of at least 2MB with transparent huge pages where the
+// OS supports it (madvise MADV_HUGEPAGE). Off by default.
+KANGAROO_EXPORT void SetAlignedHostHugePages(bool enable);
+KANGAROO_EXPORT bool AlignedHostHugePages();
+
+// Fault in the pages of new allocations from the host worker threads
+// (host_launch_utils.h) in parallel, so kernels don't pay for the page faults
+// on first use. Workers take tasks dynamically, so there is no guarantee of
+// NUMA locality. On by default.
+KANGAROO_EXPORT void SetAlignedHostFirstTouch(bool enable);
+KANGAROO_EXPORT bool AlignedHostFirstTouch();
+
+}
@@ -19,7 +19,8 @@ public:
     //////////////////////////////////////////////////////
 
     template<typename TargetFrom, typename ManagementFrom> inline __host__ __device__
-    BoundedVolume( const BoundedVolume<T,TargetFrom,ManagementFrom>& vol )
+    BoundedVolume( const BoundedVolume<T,TargetFrom,ManagementFrom>& vol,
+                   typename EnableIf<TargetCompatible<Target,TargetFrom>::value>::type* = 0 )
         : Volume<T,Target,Management>(vol), bbox(vol.bbox)
     {
     }
@@ -3,6 +3,7 @@
 #include "MatUtils.h"
 #include <kangaroo/ImageIntrinsics.h>
 #include <iostream>
+#include <limits>
 
 namespace roo
 {
@@ -0,0 +1,327 @@
+#include "CachingAllocator.h"
+#include "AlignedHostMemory.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <cuda_runtime.h>
+
+namespace roo
+{
+
+//////////////////////////////////////////////////////
+// Caching allocator
+//////////////////////////////////////////////////////
+
+struct CachingAllocator::Impl
+{
+    Impl(RawAllocFn raw_alloc, RawFreeFn raw_free, size_t max_retained_bytes)
+        : raw_alloc(raw_alloc), raw_free(raw_free), max_retained_bytes(max_retained_bytes)
+    {
+    }
+
+    // Caller must hold lock
+    void ReleaseCachedLocked()
+    {
+        for(auto& bucket : free_blocks) {
+            for(void* ptr : bucket.second) {
+                raw_free(ptr);
+                stats.released++;
+            }
+            bucket.second.clear();
+        }
+        stats.retained_bytes = 0;
+        stats.retained_blocks = 0;
+    }
+
+    RawAllocFn raw_alloc;
+    RawFreeFn raw_free;
+    size_t max_retained_bytes;
+
+    mutable std::mutex lock;
+
+    // bucket size -> unused blocks of that size
+    std::unordered_map<size_t, std::vector<void*> > free_blocks;
+
+    // block -> bucket size, for every block handed out
+    std::unordered_map<void*, size_t> live_blocks;
+
+    CachingAllocatorStats stats;
+};
+
+CachingAllocator::CachingAllocator(RawAllocFn raw_alloc, RawFreeFn raw_free, size_t max_retained_bytes)
+    : impl(new Impl(raw_alloc, raw_free, max_retained_bytes))
+{
+}
+
+CachingAllocator::~CachingAllocator()
+{
+    ReleaseCached();
+    delete impl;
+}
+
+size_t CachingAllocator::BucketSize(size_t bytes)
+{
+    const size_t min_bucket = 512;
+    if(bytes <= min_bucket) {
+        return min_bucket;
+    }
+
+    // Largest power of two not greater than bytes
+    size_t p = min_bucket;
+    while(p <= bytes / 2) {
+        p *= 2;
+    }
+
+    const size_t step = p / 4;
+    return ((bytes + step - 1) / step) * step;
+}
+
+void* CachingAllocator::Allocate(size_t bytes)
+{
+    const size_t size = BucketSize(bytes);
+
+    {
+        std::lock_guard<std::mutex> l(impl->lock);
+        impl->stats.requests++;
+
+        std::vector<void*>& bucket = impl->free_blocks[size];
+        if(!bucket.empty()) {
+            void* ptr = bucket.back();
+            bucket.pop_back();
+            impl->live_blocks[ptr] = size;
+            impl->stats.hits++;
+            impl->stats.retained_bytes -= size;
+            impl->stats.retained_blocks--;
+            impl->stats.in_use_bytes += size;
+            return ptr;
+        }
+        impl->stats.misses++;
+    }
+
+    // Don't hold the lock over (potentially slow) raw allocations
+    void* ptr = impl->raw_alloc(size);
+
+    std::lock_guard<std::mutex> l(impl->lock);
+    if(!ptr) {
+        // Out of memory. Give cached blocks back and try once more.
+        impl->ReleaseCachedLocked();
+        ptr = impl->raw_alloc(size);
+        if(!ptr) {
+            return 0;
+        }
+    }
+
+    impl->live_blocks[ptr] = size;
+    impl->stats.in_use_bytes += size;
+    impl->stats.peak_bytes = std::max(impl->stats.peak_bytes, impl->stats.in_use_bytes + impl->stats.retained_bytes);
+    return ptr;
+}
+
+bool CachingAllocator::Deallocate(void* ptr)
+{
+    if(!ptr) {
+        return true;
+    }
+
+    std::lock_guard<std::mutex> l(impl->lock);
+
+    std::unordered_map<void*,size_t>::iterator it = impl->live_blocks.find(ptr);
+    if(it == impl->live_blocks.end()) {
+        return false;
+    }
+
+    const size_t size = it->second;
+    impl->live_blocks.erase(it);
+    impl->stats.returned++;
+    impl->stats.in_use_bytes -= size;
+
+    if(impl->stats.retained_bytes + size <= impl->max_retained_bytes) {
+        impl->free_blocks[size].push_back(ptr);
+        impl->stats.retained_bytes += size;
+        impl->stats.retained_blocks++;
+    }else{
+        impl->raw_free(ptr);
+        impl->stats.released++;
+    }
+    return true;
+}
+
+void CachingAllocator::ReleaseCached()
+{
+    std::lock_guard<std::mutex> l(impl->lock);
+    impl->ReleaseCachedLocked();
+}
+
+void CachingAllocator::SetMaxRetainedBytes(size_t max_retained_bytes)
+{
+    std::lock_guard<std::mutex> l(impl->lock);
+    impl->max_retained_bytes = max_retained_bytes;
+    if(impl->stats.retained_bytes > max_retained_bytes) {
+        impl->ReleaseCachedLocked();
+    }
+}
+
+size_t CachingAllocator::MaxRetainedBytes() const
+{
+    std::lock_guard<std::mutex> l(impl->lock);
+    return impl->max_retained_bytes;
+}
+
+CachingAllocatorStats CachingAllocator::Stats() const
+{
+    std::lock_guard<std::mutex> l(impl->lock);
+    return impl->stats;
+}
+
+void CachingAllocator::ResetStats()
+{
+    std::lock_guard<std::mutex> l(impl->lock);
+    CachingAllocatorStats s;
+    s.in_use_bytes = impl->stats.in_use_bytes;
+    s.retained_bytes = impl->stats.retained_bytes;
+    s.retained_blocks = impl->stats.retained_blocks;
+    s.peak_bytes = s.in_use_bytes + s.retained_bytes;
+    impl->stats = s;
+}
+
+//////////////////////////////////////////////////////
+// Raw allocators
+//////////////////////////////////////////////////////
+
+void* MallocRawAlloc(size_t bytes)
+{
+    return malloc(bytes);
+}
+
+void MallocRawFree(void* ptr)
+{
+    free(ptr);
+}
+
+//////////////////////////////////////////////////////
+// Process wide pools
+//////////////////////////////////////////////////////
+
+// Pools are intentionally never destroyed: Manage-d images with static
+// storage may be freed after any pool object would have been.
+
+static const size_t DefaultMaxRetainedBytes = 256 * 1024 * 1024;
+
+bool HostMemoryPinned()
+{
+    // Decided once, so every block is freed the way it was allocated.
+    static const bool pinned = [](){
+        int devices = 0;
+        const bool present = cudaGetDeviceCount(&devices) == cudaSuccess && devices > 0;
+        cudaGetLastError();
+        return present;
+    }();
+    return pinned;
+}
+
+void* HostRawAlloc(size_t bytes)
+{
+    if(!HostMemoryPinned()) {
+        return MallocRawAlloc(bytes);
+    }
+    void* ptr = 0;
+    return cudaMallocHost(&ptr, bytes) == cudaSuccess ? ptr : 0;
+}
+
+void HostRawFree(void* ptr)
+{
+    if(!HostMemoryPinned()) {
+        MallocRawFree(ptr);
+        return;
+    }
+    cudaFreeHost(ptr);
+}
+
+inline void* DeviceRawAlloc(size_t bytes)
+{
+    void* ptr = 0;
+    return cudaMalloc(&ptr, bytes) == cudaSuccess ? ptr : 0;
+}
+
+inline void DeviceRawFree(void* ptr)
+{
+    cudaFree(ptr);
+}
+
+CachingAllocator& HostCachingAllocator()
+{
+    static CachingAllocator* pool = new CachingAllocator(HostRawAlloc, HostRawFree, DefaultMaxRetainedBytes);
+    return *pool;
+}
+
+CachingAllocator& AlignedHostCachingAllocator()
+{
+    static CachingAllocator* pool = new CachingAllocator(AlignedHostAllocate, AlignedHostFree, DefaultMaxRetainedBytes);
+    return *pool;
+}
+
+CachingAllocator& DeviceCachingAllocator()
+{
+    // One pool per device, blocks can't be shared between contexts.
+    static const int max_devices = 16;
+    static CachingAllocator* pools[max_devices] = {0};
+    static std::mutex lock;
+
+    int dev = 0;
+    cudaGetDevice(&dev);
+    if(dev < 0 || dev >= max_devices) dev = 0;
+
+    std::lock_guard<std::mutex> l(lock);
+    if(!pools[dev]) {
+        pools[dev] = new CachingAllocator(DeviceRawAlloc, DeviceRawFree, DefaultMaxRetainedBytes);
+    }
+    return *pools[dev];
+}
+
+#if CUDA_VERSION_MAJOR >= 6
+inline void* ManagedRawAlloc(size_t bytes)
+{
+    void* ptr = 0;
+    return cudaMallocManaged(&ptr, bytes) == cudaSuccess ? ptr : 0;
+}
+
+CachingAllocator& ManagedCachingAllocator()
+{
+    static CachingAllocator* pool = new CachingAllocator(ManagedRawAlloc, DeviceRawFree, DefaultMaxRetainedBytes);
+    return *pool;
+}
+#endif // CUDA_VERSION_MAJOR >= 6
+
+size_t DevicePitchAlignment()
+{
+    static size_t align = 0;
+    static std::once_flag once;
+    std::call_once(once, [](){
+        // cudaMallocPitch pads a one byte row out to exactly the alignment.
+        void* ptr = 0;
+        size_t pitch = 0;
+        if(cudaMallocPitch(&ptr, &pitch, 1, 1) == cudaSuccess) {
+            cudaFree(ptr);
+            align = pitch;
+        }else{
+            align = 512;
+        }
+    });
+    return align;
+}
+
+void ReleaseCachedMemory()
+{
+    HostCachingAllocator().ReleaseCached();
+    AlignedHostCachingAllocator().ReleaseCached();
+    DeviceCachingAllocator().ReleaseCached();
+#if CUDA_VERSION_MAJOR >= 6
+    ManagedCachingAllocator().ReleaseCached();
+#endif
+}
+
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <cstddef>
+
+#include <kangaroo/platform.h>
+
+namespace roo
+{
+
+////////////////////////////////////////
+// Definition
+////////////////////////////////////////
+
+struct CachingAllocatorStats
+{
+    CachingAllocatorStats()
+        : requests(0), hits(0), misses(0), returned(0), released(0),
+          in_use_bytes(0), retained_bytes(0), retained_blocks(0), peak_bytes(0)
+    {
+    }
+
+    // Fraction of requests served from the cache
+    inline double HitRate() const {
+        return requests ? (double)hits / (double)requests : 0.0;
+    }
+
+    size_t requests;        // Allocate() calls
+    size_t hits;            // served from cached blocks
+    size_t misses;          // served by the raw allocator
+    size_t returned;        // Deallocate() calls for pool owned blocks
+    size_t released;        // blocks handed back to the raw allocator
+
+    size_t in_use_bytes;    // bytes currently handed out
+    size_t retained_bytes;  // bytes cached for reuse
+    size_t retained_blocks; // blocks cached for reuse
+    size_t peak_bytes;      // high water mark of in_use + retained
+};
+
+//! Size bucketed caching allocator sitting in front of a raw allocator
+//! (cudaMallocHost, cudaMalloc, malloc ...). Freed blocks are kept in per
+//! bucket free lists and handed out again for any request of the same bucket,
+//! up to a configurable number of retained bytes. Thread safe.
+class KANGAROO_EXPORT CachingAllocator
+{
+public:
+    // Raw allocator should return 0 on failure.
+    typedef void* (*RawAllocFn)(size_t bytes);
+    typedef void (*RawFreeFn)(void* ptr);
+
+    CachingAllocator(RawAllocFn raw_alloc, RawFreeFn raw_free, size_t max_retained_bytes);
+    ~CachingAllocator();
+
+    // Returns block of at least bytes, or 0 if the raw allocator fails even
+    // after the cache has been released.
+    void* Allocate(size_t bytes);
+
+    // Returns false if ptr was not allocated by this pool (in which case it
+    // is left untouched).
+    bool Deallocate(void* ptr);
+
+    // Hand all cached (unused) blocks back to the raw allocator
+    void ReleaseCached();
+
+    void SetMaxRetainedBytes(size_t max_retained_bytes);
+    size_t MaxRetainedBytes() const;
+
+    CachingAllocatorStats Stats() const;
+    void ResetStats();
+
+    // Bucket size a request of bytes is rounded up to. Buckets are spaced a
+    // quarter power of two apart, so at most 25% of a block is wasted.
+    static size_t BucketSize(size_t bytes);
+
+protected:
+    struct Impl;
+    Impl* impl;
+
+private:
+    CachingAllocator(const CachingAllocator&);
+    CachingAllocator& operator=(const CachingAllocator&);
+};
+
+// Plain malloc / free raw allocator, for pools that must not depend on a
+// CUDA device being present.
+KANGAROO_EXPORT void* MallocRawAlloc(size_t bytes);
+KANGAROO_EXPORT void MallocRawFree(void* ptr);
+
+// Raw allocator of TargetHost. Pinned memory (cudaMallocHost), or plain
+// malloc when there is no CUDA device, so host only code and tools still
+// run. HostMemoryPinned() tells which, it does not change while running.
+KANGAROO_EXPORT void* HostRawAlloc(size_t bytes);
+KANGAROO_EXPORT void HostRawFree(void* ptr);
+KANGAROO_EXPORT bool HostMemoryPinned();
+
+// Process wide pools used by roo::Manage. Blocks are pinned host memory
+// (HostRawAlloc), pageable aligned host memory (AlignedHostAllocate),
+// device memory of the current device (cudaMalloc) and, for CUDA >= 6,
+// managed memory (cudaMallocManaged) respectively.
+KANGAROO_EXPORT CachingAllocator& HostCachingAllocator();
+KANGAROO_EXPORT CachingAllocator& AlignedHostCachingAllocator();
+KANGAROO_EXPORT CachingAllocator& DeviceCachingAllocator();
+#if CUDA_VERSION_MAJOR >= 6
+KANGAROO_EXPORT CachingAllocator& ManagedCachingAllocator();
+#endif
+
+// Pitch alignment used for pooled device allocations. Matches the pitch
+// cudaMallocPitch would choose on the current device.
+KANGAROO_EXPORT size_t DevicePitchAlignment();
+
+// Release cached blocks of all pools.
+KANGAROO_EXPORT void ReleaseCachedMemory();
+
+}
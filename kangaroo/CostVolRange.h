@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cuda_runtime.h>
+
+#include <kangaroo/platform.h>
+#include <kangaroo/Image.h>
+#include <kangaroo/Volume.h>
+
+namespace roo
+{
+
+//////////////////////////////////////////////////////
+// Cost volume holding a window of disparities per pixel
+//
+// Instead of w*h*maxDisp costs, pixel (x,y) only stores the costs of
+// disparities [range.x, range.x + range.y), where range.y <= vol.d. Windows
+// are usually seeded from the disparity of a coarser pyramid level or of
+// the previous frame (see CostVolRangeFromDisparity), so vol.d can be a
+// small fraction of the full disparity range.
+//////////////////////////////////////////////////////
+
+template<typename T, typename Target = TargetDevice, typename Management = DontManage>
+struct CostVolRange
+{
+    inline __host__
+    CostVolRange()
+    {
+    }
+
+    inline __host__
+    CostVolRange(unsigned int w, unsigned int h, unsigned int window)
+        : vol(w,h,window), range(w,h)
+    {
+    }
+
+    template<typename TargetFrom, typename ManagementFrom> inline __host__ __device__
+    CostVolRange( const CostVolRange<T,TargetFrom,ManagementFrom>& cv )
+        : vol(cv.vol), range(cv.range)
+    {
+    }
+
+    //! Largest number of disparities a pixel can hold
+    inline __host__ __device__
+    unsigned int Window() const
+    {
+        return vol.d;
+    }
+
+    inline __host__ __device__
+    int MinDisp(unsigned int x, unsigned int y) const
+    {
+        return range(x,y).x;
+    }
+
+    inline __host__ __device__
+    int NumDisp(unsigned int x, unsigned int y) const
+    {
+        return range(x,y).y;
+    }
+
+    inline __host__ __device__
+    bool Contains(unsigned int x, unsigned int y, int d) const
+    {
+        const short2 r = range(x,y);
+        return r.x <= d && d < r.x + r.y;
+    }
+
+    //! Cost of disparity d, which must be within the window of (x,y)
+    inline __host__ __device__
+    T& Get(unsigned int x, unsigned int y, int d)
+    {
+        return vol(x,y,d - range(x,y).x);
+    }
+
+    inline __host__ __device__
+    const T& Get(unsigned int x, unsigned int y, int d) const
+    {
+        return vol(x,y,d - range(x,y).x);
+    }
+
+    // vol(x,y,i) is the cost of disparity range(x,y).x + i
+    Volume<T,Target,Management> vol;
+
+    // x: first disparity, y: number of disparities held
+    Image<short2,Target,Management> range;
+};
+
+}
@@ -62,7 +62,8 @@ struct Image {
 
     template<typename TargetFrom, typename ManagementFrom>
     inline __host__ __device__
-    Image( const Image<T,TargetFrom,ManagementFrom>& img )
+    Image( const Image<T,TargetFrom,ManagementFrom>& img,
+           typename EnableIf<TargetCompatible<Target,TargetFrom>::value>::type* = 0 )
         : pitch(img.pitch), ptr(img.ptr), w(img.w), h(img.h)
     {
         AssignmentCheck<Management,Target, TargetFrom>();
@@ -78,8 +79,7 @@ struct Image {
     Image(unsigned int w, unsigned int h)
         :w(w), h(h)
     {
-        Management::AllocateCheck();
-        Target::template AllocatePitchedMem<T>(&ptr,&pitch,w,h);
+        Management::template AllocatePitchedMem<T,Target>(&ptr,&pitch,w,h);
     }
 
     inline __device__ __host__
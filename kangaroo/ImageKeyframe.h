@@ -10,7 +10,7 @@ namespace roo
 template<typename T, typename Target = TargetDevice, typename Management = DontManage>
 struct ImageKeyframe : public ImageTransformProject
 {
-    Image<T, roo::TargetDevice> img;
+    Image<T, Target, Management> img;
 };
 
 } // namespace roo
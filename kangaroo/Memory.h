@@ -4,6 +4,8 @@
 #include <cuda_runtime.h>
 
 #include <kangaroo/config.h>
+#include <kangaroo/CachingAllocator.h>
+#include <kangaroo/AlignedHostMemory.h>
 
 #ifdef HAVE_THRUST
 #include <thrust/device_vector.h>
@@ -31,28 +33,102 @@ struct CudaException : public std::exception
 
 struct TargetHost
 {
+    // Pinned, or pageable without a CUDA device (see HostRawAlloc)
     template<typename T> inline static
     void AllocatePitchedMem(T** hostPtr, size_t *pitch, size_t w, size_t h){
         *pitch = w*sizeof(T);
-        const cudaError err = cudaMallocHost(hostPtr, *pitch * h);
-        if( err != cudaSuccess ) {
-            throw CudaException("Unable to cudaMallocHost", err);
+        *hostPtr = (T*)HostRawAlloc(*pitch * h);
+        if( !*hostPtr ) {
+            throw CudaException("Unable to allocate host memory", cudaGetLastError());
         }
     }
 
     template<typename T> inline static
     void AllocatePitchedMem(T** hostPtr, size_t *pitch, size_t *img_pitch, size_t w, size_t h, size_t d){
+        AllocatePitchedMem(hostPtr, pitch, w, h*d);
+        *img_pitch = *pitch*h;
+    }
+
+    template<typename T> inline static
+    void DeallocatePitchedMem(T* hostPtr){
+        HostRawFree(hostPtr);
+    }
+
+    // Pooled variants, see CachingAllocator.h
+    template<typename T> inline static
+    void AllocatePooledPitchedMem(T** hostPtr, size_t *pitch, size_t w, size_t h){
         *pitch = w*sizeof(T);
+        *hostPtr = (T*)HostCachingAllocator().Allocate(*pitch * h);
+        if( !*hostPtr ) {
+            throw CudaException("Unable to allocate pooled host memory");
+        }
+    }
+
+    template<typename T> inline static
+    void AllocatePooledPitchedMem(T** hostPtr, size_t *pitch, size_t *img_pitch, size_t w, size_t h, size_t d){
+        AllocatePooledPitchedMem(hostPtr, pitch, w, h*d);
         *img_pitch = *pitch*h;
-        const cudaError err = cudaMallocHost(hostPtr, *pitch * h * d);
-        if( err != cudaSuccess ) {
-            throw CudaException("Unable to cudaMallocHost", err);
+    }
+
+    template<typename T> inline static
+    void DeallocatePooledPitchedMem(T* hostPtr){
+        if( !HostCachingAllocator().Deallocate(hostPtr) ) {
+            DeallocatePitchedMem(hostPtr);
+        }
+    }
+};
+
+// Pageable host memory with every row starting on a HostAlignment (64 byte)
+// boundary, for SIMD host kernels and for volumes too large to pin. Images
+// and volumes of this target can be passed wherever TargetHost is accepted.
+struct TargetHostAligned
+{
+    template<typename T> inline static
+    size_t Pitch(size_t w) {
+        return ((w*sizeof(T) + HostAlignment - 1) / HostAlignment) * HostAlignment;
+    }
+
+    template<typename T> inline static
+    void AllocatePitchedMem(T** hostPtr, size_t *pitch, size_t w, size_t h){
+        *pitch = Pitch<T>(w);
+        *hostPtr = (T*)AlignedHostAllocate(*pitch * h);
+        if( !*hostPtr ) {
+            throw CudaException("Unable to allocate aligned host memory");
         }
     }
 
+    template<typename T> inline static
+    void AllocatePitchedMem(T** hostPtr, size_t *pitch, size_t *img_pitch, size_t w, size_t h, size_t d){
+        AllocatePitchedMem(hostPtr, pitch, w, h*d);
+        *img_pitch = *pitch*h;
+    }
+
     template<typename T> inline static
     void DeallocatePitchedMem(T* hostPtr){
-        cudaFreeHost(hostPtr);
+        AlignedHostFree(hostPtr);
+    }
+
+    // Pooled variants, see CachingAllocator.h
+    template<typename T> inline static
+    void AllocatePooledPitchedMem(T** hostPtr, size_t *pitch, size_t w, size_t h){
+        *pitch = Pitch<T>(w);
+        *hostPtr = (T*)AlignedHostCachingAllocator().Allocate(*pitch * h);
+        if( !*hostPtr ) {
+            throw CudaException("Unable to allocate pooled aligned host memory");
+        }
+    }
+
+    template<typename T> inline static
+    void AllocatePooledPitchedMem(T** hostPtr, size_t *pitch, size_t *img_pitch, size_t w, size_t h, size_t d){
+        AllocatePooledPitchedMem(hostPtr, pitch, w, h*d);
+        *img_pitch = *pitch*h;
+    }
+
+    template<typename T> inline static
+    void DeallocatePooledPitchedMem(T* hostPtr){
+        if( !AlignedHostCachingAllocator().Deallocate(hostPtr) ) {
+            DeallocatePitchedMem(hostPtr);
+        }
     }
 };
 
@@ -81,6 +157,33 @@ struct TargetDevice
     void DeallocatePitchedMem(T* devPtr){
         cudaFree(devPtr);
     }
+
+    // Pooled variants, see CachingAllocator.h. Pitch is padded to the same
+    // alignment cudaMallocPitch would use.
+    template<typename T> inline static
+    void AllocatePooledPitchedMem(T** devPtr, size_t *pitch, size_t w, size_t h)
+    {
+        const size_t align = DevicePitchAlignment();
+        *pitch = ((w*sizeof(T) + align - 1) / align) * align;
+        *devPtr = (T*)DeviceCachingAllocator().Allocate(*pitch * h);
+        if( !*devPtr ) {
+            throw CudaException("Unable to allocate pooled device memory");
+        }
+    }
+
+    template<typename T> inline static
+    void AllocatePooledPitchedMem(T** devPtr, size_t *pitch, size_t *img_pitch, size_t w, size_t h, size_t d)
+    {
+        AllocatePooledPitchedMem(devPtr, pitch, w, h*d);
+        *img_pitch = *pitch * h;
+    }
+
+    template<typename T> inline static
+    void DeallocatePooledPitchedMem(T* devPtr){
+        if( !DeviceCachingAllocator().Deallocate(devPtr) ) {
+            DeallocatePitchedMem(devPtr);
+        }
+    }
 };
 
 #if CUDA_VERSION_MAJOR >= 6
@@ -109,6 +212,29 @@ struct TargetManaged
     void DeallocatePitchedMem(T* mgdPtr){
         cudaFree(mgdPtr);
     }
+
+    // Pooled variants, see CachingAllocator.h
+    template<typename T> inline static
+    void AllocatePooledPitchedMem(T** mgdPtr, size_t *pitch, size_t w, size_t h){
+        *pitch = w*sizeof(T);
+        *mgdPtr = (T*)ManagedCachingAllocator().Allocate(*pitch * h);
+        if( !*mgdPtr ) {
+            throw CudaException("Unable to allocate pooled managed memory");
+        }
+    }
+
+    template<typename T> inline static
+    void AllocatePooledPitchedMem(T** mgdPtr, size_t *pitch, size_t *img_pitch, size_t w, size_t h, size_t d){
+        AllocatePooledPitchedMem(mgdPtr, pitch, w, h*d);
+        *img_pitch = *pitch*h;
+    }
+
+    template<typename T> inline static
+    void DeallocatePooledPitchedMem(T* mgdPtr){
+        if( !ManagedCachingAllocator().Deallocate(mgdPtr) ) {
+            DeallocatePitchedMem(mgdPtr);
+        }
+    }
 };
 #endif // CUDA_VERSION_MAJOR >= 6
 
@@ -119,10 +245,16 @@ template<> inline cudaMemcpyKind TargetCopyKind<TargetHost,TargetHost>() { retur
 template<> inline cudaMemcpyKind TargetCopyKind<TargetDevice,TargetHost>() { return cudaMemcpyHostToDevice;}
 template<> inline cudaMemcpyKind TargetCopyKind<TargetHost,TargetDevice>() { return cudaMemcpyDeviceToHost;}
 template<> inline cudaMemcpyKind TargetCopyKind<TargetDevice,TargetDevice>() { return cudaMemcpyDeviceToDevice;}
+template<> inline cudaMemcpyKind TargetCopyKind<TargetHostAligned,TargetHostAligned>() { return cudaMemcpyHostToHost;}
+template<> inline cudaMemcpyKind TargetCopyKind<TargetHostAligned,TargetHost>() { return cudaMemcpyHostToHost;}
+template<> inline cudaMemcpyKind TargetCopyKind<TargetHost,TargetHostAligned>() { return cudaMemcpyHostToHost;}
+template<> inline cudaMemcpyKind TargetCopyKind<TargetDevice,TargetHostAligned>() { return cudaMemcpyHostToDevice;}
+template<> inline cudaMemcpyKind TargetCopyKind<TargetHostAligned,TargetDevice>() { return cudaMemcpyDeviceToHost;}
 
 #ifdef HAVE_THRUST
 template<typename T, typename Target> struct ThrustType;
 template<typename T> struct ThrustType<T,TargetHost> { typedef T* Ptr; };
+template<typename T> struct ThrustType<T,TargetHostAligned> { typedef T* Ptr; };
 template<typename T> struct ThrustType<T,TargetDevice> { typedef thrust::device_ptr<T> Ptr; };
 
 #if CUDA_VERSION_MAJOR >= 6
@@ -132,6 +264,9 @@ template<typename T> struct ThrustType<T,TargetManaged> { typedef thrust::device
 
 #endif // HAVE_THRUST
 
+// Managed memory is drawn from and returned to the Target's caching pool.
+// Memory allocated directly through Target::AllocatePitchedMem may still be
+// handed to Cleanup, it is passed straight on to the Target.
 struct Manage
 {
     inline static __host__
@@ -139,11 +274,23 @@ struct Manage
     {
     }
 
+    template<typename T, typename Target> inline static __host__
+    void AllocatePitchedMem(T** ptr, size_t *pitch, size_t w, size_t h)
+    {
+        Target::template AllocatePooledPitchedMem<T>(ptr,pitch,w,h);
+    }
+
+    template<typename T, typename Target> inline static __host__
+    void AllocatePitchedMem(T** ptr, size_t *pitch, size_t *img_pitch, size_t w, size_t h, size_t d)
+    {
+        Target::template AllocatePooledPitchedMem<T>(ptr,pitch,img_pitch,w,h,d);
+    }
+
     template<typename T, typename Target> inline static __host__
     void Cleanup(T* ptr)
     {
         if(ptr) {
-            Target::template DeallocatePitchedMem<T>(ptr);
+            Target::template DeallocatePooledPitchedMem<T>(ptr);
             ptr = 0;
         }
     }
@@ -157,6 +304,18 @@ struct DontManage
         throw CudaException("Image that doesn't own data should not call this constructor");
     }
 
+    template<typename T, typename Target> inline static __host__
+    void AllocatePitchedMem(T** /*ptr*/, size_t* /*pitch*/, size_t /*w*/, size_t /*h*/)
+    {
+        AllocateCheck();
+    }
+
+    template<typename T, typename Target> inline static __host__
+    void AllocatePitchedMem(T** /*ptr*/, size_t* /*pitch*/, size_t* /*img_pitch*/, size_t /*w*/, size_t /*h*/, size_t /*d*/)
+    {
+        AllocateCheck();
+    }
+
     template<typename T, typename Target> inline static __device__ __host__
     void Cleanup(T* /*ptr*/)
     {
@@ -171,6 +330,8 @@ void AssignmentCheck();
 // Define valid assignments
 template<> inline void AssignmentCheck<DontManage, TargetDevice, TargetDevice>() { }
 template<> inline void AssignmentCheck<DontManage, TargetHost,   TargetHost>() { }
+template<> inline void AssignmentCheck<DontManage, TargetHostAligned, TargetHostAligned>() { }
+template<> inline void AssignmentCheck<DontManage, TargetHost,   TargetHostAligned>() { }
 
 #if CUDA_VERSION_MAJOR >= 6
 template<> inline void AssignmentCheck<DontManage, TargetManaged,TargetManaged>() { }
@@ -178,6 +339,28 @@ template<> inline void AssignmentCheck<DontManage, TargetDevice, TargetManaged>(
 template<> inline void AssignmentCheck<DontManage, TargetHost,   TargetManaged>() { }
 #endif
 
+// Compile time counterpart of AssignmentCheck for the target alone. Used to keep
+// conversions between incompatible targets out of overload resolution, so that
+// TargetHost and TargetDevice overloads of the same function never clash.
+template<typename TargetTo, typename TargetFrom>
+struct TargetCompatible { enum { value = 0 }; };
+
+template<typename Target>
+struct TargetCompatible<Target,Target> { enum { value = 1 }; };
+
+template<> struct TargetCompatible<TargetHost, TargetHostAligned> { enum { value = 1 }; };
+
+#if CUDA_VERSION_MAJOR >= 6
+template<> struct TargetCompatible<TargetDevice, TargetManaged> { enum { value = 1 }; };
+template<> struct TargetCompatible<TargetHost,   TargetManaged> { enum { value = 1 }; };
+#endif
+
+template<bool Cond, typename T = void>
+struct EnableIf { };
+
+template<typename T>
+struct EnableIf<true,T> { typedef T type; };
+
 }
 
 #endif // CUDAMEMORY_H
@@ -35,7 +35,8 @@ struct Pyramid {
 
     template<typename TargetFrom, typename ManagementFrom>
     inline __host__ __device__
-    Pyramid(const Pyramid<T,Levels,TargetFrom,ManagementFrom>& pyramid)
+    Pyramid(const Pyramid<T,Levels,TargetFrom,ManagementFrom>& pyramid,
+            typename EnableIf<TargetCompatible<Target,TargetFrom>::value>::type* = 0)
     {
         AssignmentCheck<Management,Target,TargetFrom>();
         for(unsigned int l=0; l<Levels; ++l) {
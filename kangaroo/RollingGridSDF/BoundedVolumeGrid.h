@@ -19,6 +19,15 @@ namespace roo
 
 const int MAX_SUPPORT_GRID_NUM = 13824;
 
+// One counter for every BoundedVolumeGrid instantiation, so grids of
+// different types or management never share a stamp.
+inline __host__
+unsigned long long NextGridVolumeStamp()
+{
+  static unsigned long long nStamp = 0;
+  return ++nStamp;
+}
+
 template<typename T, typename Target = TargetDevice, typename Management = DontManage>
 class BoundedVolumeGrid
 {
@@ -85,6 +94,7 @@ public:
       //        GpuCheckErrors();
       //      }
     }
+    MarkGridVolumesChanged();
   }
 
   inline __host__
@@ -118,6 +128,7 @@ public:
        m_GridVolumes[nIndex].d !=m_nVolumeGridRes )
     {
       m_GridVolumes[nIndex].InitVolume(m_nVolumeGridRes, m_nVolumeGridRes, m_nVolumeGridRes);
+      MarkGridVolumesChanged();
       GpuCheckErrors();
     }
   }
@@ -130,6 +141,7 @@ public:
        m_GridVolumes[nIndex].d !=m_nVolumeGridRes )
     {
       m_GridVolumes[nIndex].InitVolume(m_nVolumeGridRes, m_nVolumeGridRes, m_nVolumeGridRes);
+      MarkGridVolumesChanged();
       GpuCheckErrors();
       return true;
     }
@@ -469,9 +481,10 @@ public:
         m_GridVolumes[i].d=0;
         m_GridVolumes[i].w=0;
         m_GridVolumes[i].h=0;
-        cudaFree( m_GridVolumes[i].ptr );
+        m_GridVolumes[i].CleanUp();
       }
     }
+    MarkGridVolumesChanged();
   }
 
   inline __host__
@@ -483,7 +496,17 @@ public:
       exit(-1);
     }
 
-    cudaFree( m_GridVolumes[nIndex].ptr );
+    m_GridVolumes[nIndex].CleanUp();
+    MarkGridVolumesChanged();
+  }
+
+  // Init / free of grid volumes give the grid a new stamp, so users of the
+  // set of grid volumes (GridBlockTableCache) can tell it changed without
+  // scanning all of them. Call this after editing m_GridVolumes directly.
+  inline __host__
+  void MarkGridVolumesChanged()
+  {
+    m_nGridStamp = NextGridVolumeStamp();
   }
 
   //////////////////////////////////////////////////////
@@ -851,6 +874,9 @@ public:
   // Volume that save all data; Maximum size of grid vol is MAX_SUPPORT_GRID_NUM.
   // larger size will lead to a slow profermance.
   VolumeGrid<T, Target, Manage>  m_GridVolumes[MAX_SUPPORT_GRID_NUM];
+
+  // changes whenever a grid volume is allocated or freed
+  unsigned long long m_nGridStamp;
 };
 
 }
@@ -0,0 +1,417 @@
+// by lu.ma@colorado.edu
+
+#pragma once
+
+#include <vector>
+#include <cstring>
+
+#include "BoundedVolumeGrid.h"
+
+namespace roo
+{
+
+// =============================================================================
+// A GridBlockTable is a compact, read only descriptor of a BoundedVolumeGrid
+// for use in kernels: the grid geometry plus a table from real grid index to
+// block pointer (0 for inactive grids). It provides the same accessors as
+// BoundedVolumeGrid, but is a few hundred bytes instead of a struct of
+// MAX_SUPPORT_GRID_NUM volumes, and the pointer table lives in Target memory.
+//
+// Build it with a GridBlockTableCache, which keeps the pointer table in
+// Target memory between calls and only uploads it when the set of active
+// grids changes.
+// =============================================================================
+
+template<typename T, typename Target = TargetDevice>
+struct GridBlockTable
+{
+  inline __device__ __host__
+  float3 SizeUnits() const
+  {
+    return m_bbox.Size();
+  }
+
+  inline __device__ __host__
+  float3 VoxelSizeUnits() const
+  {
+    return m_bbox.Size() / make_float3( m_w-1, m_h-1, m_d-1 );
+  }
+
+  inline __device__ __host__
+  uint3 Voxels() const
+  {
+    return make_uint3(m_w,m_h,m_d);
+  }
+
+  inline __device__ __host__
+  unsigned int GetTotalGridNum() const
+  {
+    return m_nTotalGridRes;
+  }
+
+  // same mapping as BoundedVolumeGrid::ConvertLocalIndexToRealIndex: a local
+  // shift rotates the grid indices of each axis
+  inline __device__ __host__
+  unsigned int ConvertLocalIndexToRealIndex(int x, int y, int z) const
+  {
+    const int nw = static_cast<int>(m_nGridNum_w);
+    const int nh = static_cast<int>(m_nGridNum_h);
+    const int nd = static_cast<int>(m_nGridNum_d);
+
+    x = ((x + m_local_shift.x) % nw + nw) % nw;
+    y = ((y + m_local_shift.y) % nh + nh) % nh;
+    z = ((z + m_local_shift.z) % nd + nd) % nd;
+
+    return x + m_nGridNum_w* (y+ m_nGridNum_h* z);
+  }
+
+  inline __host__ __device__
+  bool CheckIfBasicSDFActive(const int nIndex) const
+  {
+    return m_ppBlocks[nIndex] != 0;
+  }
+
+  inline __host__ __device__
+  bool CheckIfVoxelExist(int x, int y, int z) const
+  {
+    return CheckIfBasicSDFActive( ConvertLocalIndexToRealIndex(
+                                    x/m_nVolumeGridRes, y/m_nVolumeGridRes, z/m_nVolumeGridRes) );
+  }
+
+  // view of the grid volume with real index nIndex
+  inline __device__ __host__
+  VolumeGrid<T,Target,DontManage> GetGridVolume(int nIndex) const
+  {
+    VolumeGrid<T,Target,DontManage> vol;
+    vol.ptr       = m_ppBlocks[nIndex];
+    vol.w         = m_nVolumeGridRes;
+    vol.h         = m_nVolumeGridRes;
+    vol.d         = m_nVolumeGridRes;
+    vol.pitch     = m_nBlockPitch;
+    vol.img_pitch = m_nBlockImgPitch;
+    return vol;
+  }
+
+  //////////////////////////////////////////////////////
+  // Access Elements
+  //////////////////////////////////////////////////////
+
+  inline  __device__  __host__
+  T& Get(unsigned int x,unsigned int y, unsigned int z) const
+  {
+    const int nIndex = ConvertLocalIndexToRealIndex(
+          x/m_nVolumeGridRes, y/m_nVolumeGridRes, z/m_nVolumeGridRes );
+
+    T* ptr = (T*)( (unsigned char*)m_ppBlocks[nIndex] +
+                   (z%m_nVolumeGridRes)*m_nBlockImgPitch +
+                   (y%m_nVolumeGridRes)*m_nBlockPitch );
+    return ptr[x%m_nVolumeGridRes];
+  }
+
+  inline  __device__
+  T& operator()(unsigned int x,unsigned int y, unsigned int z) const
+  {
+    return Get(x,y,z);
+  }
+
+  // input pos_w in meter
+  inline  __device__
+  float GetUnitsTrilinearClamped(float3 pos_w) const
+  {
+    float3 pos_v_grid;
+    const int nIndex = GetIndexAndFraction(pos_w, pos_v_grid);
+
+    if(CheckIfBasicSDFActive(nIndex) == false)
+    {
+      return 0.0/0.0;
+    }
+
+    return GetGridVolume(nIndex).GetFractionalTrilinearClamped(pos_v_grid);
+  }
+
+  inline __device__
+  float3 GetUnitsBackwardDiffDxDyDz(float3 pos_w) const
+  {
+    float3 pos_v_grid;
+    const int nIndex = GetIndexAndFraction(pos_w, pos_v_grid);
+
+    if(CheckIfBasicSDFActive(nIndex)==false)
+    {
+      return make_float3(0.0/0.0,0.0/0.0,0.0/0.0);
+    }
+
+    const float3 deriv = GetGridVolume(nIndex).GetFractionalBackwardDiffDxDyDz(pos_v_grid);
+
+    return deriv / VoxelSizeUnits();
+  }
+
+  inline __device__
+  float3 GetUnitsOutwardNormal(float3 pos_w) const
+  {
+    const float3 deriv = GetUnitsBackwardDiffDxDyDz(pos_w);
+    return deriv / length(deriv);
+  }
+
+  inline __device__ __host__
+  float3 VoxelPositionInUnits(int x, int y, int z) const
+  {
+    return make_float3(
+          m_bbox.Min().x + m_bbox.Size().x * static_cast<float>(x)/static_cast<float>(m_w-1),
+          m_bbox.Min().y + m_bbox.Size().y * static_cast<float>(y)/static_cast<float>(m_h-1),
+          m_bbox.Min().z + m_bbox.Size().z * static_cast<float>(z)/static_cast<float>(m_d-1)
+          );
+  }
+
+  inline __device__ __host__
+  float3 VoxelPositionInUnits(int3 p_v) const
+  {
+    return VoxelPositionInUnits(p_v.x,p_v.y,p_v.z);
+  }
+
+  inline __device__
+  float3 GetPrecentagePosInBB(float3 pos_w, float3 cam_translate) const
+  {
+    float3 final_pose;
+    final_pose.x = pos_w.x + cam_translate.x - (pos_w.x>=0 ? m_bbox.Min().x : m_bbox.Max().x);
+    final_pose.y = pos_w.y + cam_translate.y - (pos_w.y>=0 ? m_bbox.Min().y : m_bbox.Max().y);
+    final_pose.z = pos_w.z + cam_translate.z - (pos_w.z>=0 ? m_bbox.Min().z : m_bbox.Max().z);
+    return final_pose / m_bbox.Size();
+  }
+
+  inline __device__ __host__
+  int GetIndexAndFraction(float3 pos_w, float3& pos_v_grid) const
+  {
+    /// get pose of voxel in whole sdf, in %
+    float3 pos_v = (pos_w - m_bbox.Min()) / (m_bbox.Size());
+
+    if(pos_v.x>=1) { pos_v.x =0.99999f; }
+    else if(pos_v.x<0) { pos_v.x =0.f; }
+
+    if(pos_v.y>=1) { pos_v.y =0.99999f; }
+    else if(pos_v.y<0) { pos_v.y =0.f; }
+
+    if(pos_v.z>=1) { pos_v.z =0.99999f; }
+    else if(pos_v.z<0) { pos_v.z =0.f; }
+
+    const float fFactor = static_cast<float>(m_nVolumeGridRes)/static_cast<float>(m_w);
+
+    // Get the index of voxel in basic sdf
+    const uint3 Index =make_uint3( floorf(pos_v.x/fFactor),
+                                   floorf(pos_v.y/fFactor),
+                                   floorf(pos_v.z/fFactor) );
+
+    /// get axis.
+    pos_v_grid = make_float3( fmod(pos_v.x, fFactor) /fFactor,
+                              fmod(pos_v.y, fFactor) /fFactor,
+                              fmod(pos_v.z, fFactor) /fFactor );
+
+    return ConvertLocalIndexToRealIndex( Index.x, Index.y, Index.z);
+  }
+
+  size_t        m_w;
+  size_t        m_h;
+  size_t        m_d;
+  int3          m_local_shift;
+  BoundingBox   m_bbox;
+
+  unsigned int  m_nVolumeGridRes;
+  unsigned int  m_nGridNum_w;
+  unsigned int  m_nGridNum_h;
+  unsigned int  m_nGridNum_d;
+  unsigned int  m_nTotalGridRes;
+
+  size_t        m_nBlockPitch;     // row pitch, same for every grid volume
+  size_t        m_nBlockImgPitch;  // slice pitch, same for every grid volume
+
+  T**           m_ppBlocks;        // m_nTotalGridRes block pointers in Target memory
+};
+
+// =============================================================================
+// Host side owner of the pointer table of a GridBlockTable. Keep one cache
+// per kernel symbol / call site; Update() is cheap when nothing changed.
+//
+// Caches usually have static storage, and at static destruction the CUDA
+// context may already be gone, so the destructor deliberately leaks the
+// pointer table. Call Release() while the context is alive to free it.
+// =============================================================================
+template<typename T, typename Target = TargetDevice>
+class GridBlockTableCache
+{
+public:
+  GridBlockTableCache()
+    : m_pTargetBlocks(0), m_nCapacity(0), m_nBlockPitch(0), m_nBlockImgPitch(0),
+      m_nGridStamp(0), m_nTableUploads(0)
+  {
+    memset((void*)&m_Table, 0, sizeof(m_Table));
+  }
+
+  // free the pointer table, the next Update() builds it again
+  inline __host__
+  void Release()
+  {
+    Target::template DeallocatePitchedMem<T*>(m_pTargetBlocks);
+    m_pTargetBlocks  = 0;
+    m_nCapacity      = 0;
+    m_nBlockPitch    = 0;
+    m_nBlockImgPitch = 0;
+    m_nGridStamp     = 0;
+    m_vBlocks.clear();
+    memset((void*)&m_Table, 0, sizeof(m_Table));
+  }
+
+  // Refresh the descriptor from vol. The grid volumes are only scanned if
+  // some were allocated or freed since the last call (see
+  // BoundedVolumeGrid::MarkGridVolumesChanged), and the pointer table is
+  // uploaded only if the set of active grid volumes changed. Returns true if
+  // the descriptor itself changed (so copies of it, e.g. in a __device__
+  // symbol, are stale).
+  template<typename Management>
+  inline __host__
+  bool Update(const BoundedVolumeGrid<T,Target,Management>& vol)
+  {
+    const unsigned int nTotal = vol.m_nTotalGridRes;
+
+    if(vol.m_nGridStamp != m_nGridStamp || nTotal != m_vBlocks.size())
+    {
+      UpdateBlocks(vol);
+      m_nGridStamp = vol.m_nGridStamp;
+    }
+
+    GridBlockTable<T,Target> table;
+    memset((void*)&table, 0, sizeof(table));
+    table.m_w              = vol.m_w;
+    table.m_h              = vol.m_h;
+    table.m_d              = vol.m_d;
+    table.m_local_shift    = vol.m_local_shift;
+    table.m_bbox           = vol.m_bbox;
+    table.m_nVolumeGridRes = vol.m_nVolumeGridRes;
+    table.m_nGridNum_w     = vol.m_nGridNum_w;
+    table.m_nGridNum_h     = vol.m_nGridNum_h;
+    table.m_nGridNum_d     = vol.m_nGridNum_d;
+    table.m_nTotalGridRes  = nTotal;
+    table.m_nBlockPitch    = m_nBlockPitch;
+    table.m_nBlockImgPitch = m_nBlockImgPitch;
+    table.m_ppBlocks       = m_pTargetBlocks;
+
+    if(memcmp((const void*)&table, (const void*)&m_Table, sizeof(table)) != 0)
+    {
+      m_Table = table;
+      return true;
+    }
+    return false;
+  }
+
+  inline __host__
+  const GridBlockTable<T,Target>& Table() const
+  {
+    return m_Table;
+  }
+
+  // number of times the pointer table was uploaded
+  inline __host__
+  size_t NumTableUploads() const
+  {
+    return m_nTableUploads;
+  }
+
+protected:
+  // scan the grid volumes of vol, upload the pointer table if it changed
+  template<typename Management>
+  inline __host__
+  void UpdateBlocks(const BoundedVolumeGrid<T,Target,Management>& vol)
+  {
+    const unsigned int nTotal = vol.m_nTotalGridRes;
+
+    std::vector<T*> vBlocks(nTotal, (T*)0);
+    size_t nPitch = 0;
+    size_t nImgPitch = 0;
+
+    for(unsigned int i = 0; i != nTotal; i++)
+    {
+      if(vol.CheckIfBasicSDFActive(i))
+      {
+        vBlocks[i] = vol.m_GridVolumes[i].ptr;
+
+        if(nPitch == 0)
+        {
+          nPitch    = vol.m_GridVolumes[i].pitch;
+          nImgPitch = vol.m_GridVolumes[i].img_pitch;
+        }
+        else if(nPitch != vol.m_GridVolumes[i].pitch ||
+                nImgPitch != vol.m_GridVolumes[i].img_pitch)
+        {
+          printf("[GridBlockTableCache] Fatal error! Grid volumes with different pitch!\n");
+          exit(-1);
+        }
+      }
+    }
+
+    // upload pointer table only if active set changed
+    if(vBlocks != m_vBlocks)
+    {
+      if(nTotal > m_nCapacity)
+      {
+        size_t pitch;
+        Target::template DeallocatePitchedMem<T*>(m_pTargetBlocks);
+        Target::template AllocatePitchedMem<T*>(&m_pTargetBlocks, &pitch, nTotal, 1);
+        m_nCapacity = nTotal;
+      }
+
+      if(nTotal > 0)
+      {
+        if(TargetCopyKind<Target,TargetHost>() == cudaMemcpyHostToHost)
+        {
+          memcpy(m_pTargetBlocks, &vBlocks[0], nTotal * sizeof(T*));
+        }
+        else
+        {
+          cudaMemcpy(m_pTargetBlocks, &vBlocks[0], nTotal * sizeof(T*),
+                     TargetCopyKind<Target,TargetHost>());
+          GpuCheckErrors();
+        }
+      }
+
+      m_vBlocks.swap(vBlocks);
+      m_nTableUploads++;
+    }
+
+    // keep pitch of the previous descriptor if no grid is active
+    if(nPitch != 0)
+    {
+      m_nBlockPitch    = nPitch;
+      m_nBlockImgPitch = nImgPitch;
+    }
+  }
+
+  GridBlockTable<T,Target> m_Table;
+  std::vector<T*>          m_vBlocks;        // host copy of the uploaded table
+  T**                      m_pTargetBlocks;  // table in Target memory
+  unsigned int             m_nCapacity;
+  size_t                   m_nBlockPitch;
+  size_t                   m_nBlockImgPitch;
+  unsigned long long       m_nGridStamp;     // stamp of the grid last scanned
+  size_t                   m_nTableUploads;
+
+private:
+  GridBlockTableCache(const GridBlockTableCache&);
+  GridBlockTableCache& operator=(const GridBlockTableCache&);
+};
+
+// Refresh cache from vol and copy the descriptor to a __device__ symbol if it
+// changed since the last call.
+template<typename T, typename Management>
+inline __host__
+void UploadGridBlockTable(
+    GridBlockTable<T,TargetDevice>&                 symbol,
+    GridBlockTableCache<T,TargetDevice>&            cache,
+    const BoundedVolumeGrid<T,TargetDevice,Management>& vol)
+{
+  if(cache.Update(vol))
+  {
+    cudaMemcpyToSymbol(symbol, &cache.Table(), sizeof(GridBlockTable<T,TargetDevice>),
+                       size_t(0), cudaMemcpyHostToDevice);
+    GpuCheckErrors();
+  }
+}
+
+}
@@ -0,0 +1,770 @@
+// by lu.ma@colorado.edu
+
+#include "GridSDFArchive.h"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef _WIN_
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace roo {
+
+static const char         GridArchiveMagic[8]    = {'K','G','R','I','D','S','D','F'};
+static const char         GridArchiveEndMagic[8] = {'K','G','R','I','D','E','N','D'};
+static const unsigned int GridArchiveChunkMagic  = 0x4b4c4247; // "GBLK"
+
+static_assert(sizeof(GridArchiveHeader)  == GridArchiveAlignment, "GridArchiveHeader size");
+static_assert(sizeof(GridArchiveChunk)   == GridArchiveAlignment, "GridArchiveChunk size");
+static_assert(sizeof(GridArchiveTrailer) == GridArchiveAlignment, "GridArchiveTrailer size");
+
+// large sequential writes, one grid of SDF_t at res 32 is 256KB
+static const size_t GridArchiveBufferSize = 4 * 1024 * 1024;
+
+inline unsigned long long AlignArchiveOffset(unsigned long long nOffset)
+{
+  return (nOffset + GridArchiveAlignment - 1) / GridArchiveAlignment * GridArchiveAlignment;
+}
+
+inline std::vector<int> ArchiveKey(int3 GlobalIndex)
+{
+  std::vector<int> vKey(3);
+  vKey[0] = GlobalIndex.x; vKey[1] = GlobalIndex.y; vKey[2] = GlobalIndex.z;
+  return vKey;
+}
+
+inline std::vector<int> ArchiveKey(const GridArchiveEntry& entry)
+{
+  std::vector<int> vKey(7);
+  vKey[0] = entry.GlobalIndex.x; vKey[1] = entry.GlobalIndex.y; vKey[2] = entry.GlobalIndex.z;
+  vKey[3] = entry.LocalIndex.x;  vKey[4] = entry.LocalIndex.y;  vKey[5] = entry.LocalIndex.z;
+  vKey[6] = entry.nChannel;
+  return vKey;
+}
+
+inline GridArchiveEntry EntryFromChunk(const GridArchiveChunk& chunk,
+                                       unsigned long long nOffset)
+{
+  GridArchiveEntry entry;
+  memset(&entry, 0, sizeof(entry));
+  entry.nOffset     = nOffset;
+  entry.nKind       = chunk.nKind;
+  entry.nChannel    = chunk.nChannel;
+  entry.nElemSize   = chunk.nElemSize;
+  entry.GlobalIndex = make_int3(chunk.GlobalIndex[0], chunk.GlobalIndex[1], chunk.GlobalIndex[2]);
+  entry.LocalIndex  = make_int3(chunk.LocalIndex[0], chunk.LocalIndex[1], chunk.LocalIndex[2]);
+  entry.nDim[0]     = chunk.nDim[0];
+  entry.nDim[1]     = chunk.nDim[1];
+  entry.nDim[2]     = chunk.nDim[2];
+  entry.nBytes      = chunk.nBytes;
+  return entry;
+}
+
+inline bool EntryLess(const GridArchiveEntry& lhs, const GridArchiveEntry& rhs)
+{
+  return ArchiveKey(lhs) < ArchiveKey(rhs);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//                                 Writer                                    //
+///////////////////////////////////////////////////////////////////////////////
+
+GridSDFArchiveWriter::GridSDFArchiveWriter()
+  : m_nEnd(0)
+{
+}
+
+GridSDFArchiveWriter::~GridSDFArchiveWriter()
+{
+  Close();
+}
+
+bool GridSDFArchiveWriter::Open(
+    const std::string&         sFileName,
+    unsigned int               nGridRes,
+    int3                       nVolRes,
+    bool                       bAppend)
+{
+  Close();
+
+  m_vEntries.clear();
+  m_BBoxes.clear();
+  m_sFileName = sFileName;
+
+  // ---------------------------------------------------------------------------
+  // continue an existing archive, new chunks go over its index
+  if(bAppend)
+  {
+    GridSDFArchiveReader reader;
+    std::ifstream bTest(sFileName.c_str(), std::ios::in | std::ios::binary);
+    const bool bExist = !bTest.fail();
+    bTest.close();
+
+    if(bExist)
+    {
+      if(reader.Open(sFileName) == false)
+      {
+        std::cerr<<"[GridSDFArchiveWriter] Error! cannot append to "<<sFileName<<std::endl;
+        return false;
+      }
+
+      const GridArchiveHeader& header = reader.Header();
+      if(header.nGridRes != nGridRes || header.nVolRes[0] != nVolRes.x ||
+         header.nVolRes[1] != nVolRes.y || header.nVolRes[2] != nVolRes.z)
+      {
+        std::cerr<<"[GridSDFArchiveWriter] Error! "<<sFileName<<
+                   " was written with a different grid setting."<<std::endl;
+        return false;
+      }
+
+      // resume after the last chunk
+      m_nEnd = 0;
+      for(unsigned int i=0; i!=reader.m_vAll.size(); i++)
+      {
+        const GridArchiveEntry& entry = reader.m_vAll[i];
+        m_vEntries.push_back(entry);
+        m_nEnd = std::max(m_nEnd, AlignArchiveOffset(entry.nOffset + entry.nBytes));
+
+        if(entry.nKind == GRID_ARCHIVE_BBOX)
+        {
+          m_BBoxes[ArchiveKey(entry.GlobalIndex)] = m_vEntries.size()-1;
+        }
+      }
+      m_nEnd = std::max(m_nEnd, (unsigned long long)sizeof(GridArchiveHeader));
+      reader.Close();
+
+      m_vBuffer.resize(GridArchiveBufferSize);
+      m_File.rdbuf()->pubsetbuf(&m_vBuffer[0], m_vBuffer.size());
+      m_File.open(sFileName.c_str(), std::ios::in | std::ios::out | std::ios::binary);
+      m_File.seekp(m_nEnd);
+      return !m_File.fail();
+    }
+  }
+
+  // ---------------------------------------------------------------------------
+  // new archive
+  m_vBuffer.resize(GridArchiveBufferSize);
+  m_File.rdbuf()->pubsetbuf(&m_vBuffer[0], m_vBuffer.size());
+  m_File.open(sFileName.c_str(), std::ios::out | std::ios::trunc | std::ios::binary);
+  if(m_File.fail())
+  {
+    std::cerr<<"[GridSDFArchiveWriter] Error! cannot create "<<sFileName<<std::endl;
+    return false;
+  }
+
+  GridArchiveHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.sMagic, GridArchiveMagic, sizeof(header.sMagic));
+  header.nVersion   = GridArchiveVersion;
+  header.nGridRes   = nGridRes;
+  header.nVolRes[0] = nVolRes.x;
+  header.nVolRes[1] = nVolRes.y;
+  header.nVolRes[2] = nVolRes.z;
+
+  m_File.write((const char*)&header, sizeof(header));
+  m_nEnd = sizeof(header);
+  return !m_File.fail();
+}
+
+bool GridSDFArchiveWriter::IsOpen() const
+{
+  return m_File.is_open();
+}
+
+size_t GridSDFArchiveWriter::NumEntries() const
+{
+  return m_vEntries.size();
+}
+
+bool GridSDFArchiveWriter::Close()
+{
+  if(!m_File.is_open())
+  {
+    return true;
+  }
+
+  // index
+  GridArchiveChunk chunk;
+  memset(&chunk, 0, sizeof(chunk));
+  chunk.nMagic = GridArchiveChunkMagic;
+  chunk.nKind  = GRID_ARCHIVE_INDEX;
+  chunk.nBytes = m_vEntries.size() * sizeof(GridArchiveEntry);
+
+  const unsigned long long nIndexOffset = m_nEnd;
+  m_File.seekp(m_nEnd);
+  m_File.write((const char*)&chunk, sizeof(chunk));
+  if(!m_vEntries.empty())
+  {
+    m_File.write((const char*)&m_vEntries[0], chunk.nBytes);
+  }
+
+  // trailer, aligned so the scan of an interrupted file stops at it
+  const unsigned long long nTrailer =
+      AlignArchiveOffset(nIndexOffset + sizeof(chunk) + chunk.nBytes);
+  const std::vector<char> vPad(nTrailer - (nIndexOffset + sizeof(chunk) + chunk.nBytes), 0);
+  if(!vPad.empty())
+  {
+    m_File.write(&vPad[0], vPad.size());
+  }
+
+  GridArchiveTrailer trailer;
+  memset(&trailer, 0, sizeof(trailer));
+  memcpy(trailer.sMagic, GridArchiveEndMagic, sizeof(trailer.sMagic));
+  trailer.nIndexOffset = nIndexOffset;
+  trailer.nNumEntries  = m_vEntries.size();
+  m_File.write((const char*)&trailer, sizeof(trailer));
+
+  const bool bSuccess = !m_File.fail();
+  m_File.close();
+
+  if(!bSuccess)
+  {
+    std::cerr<<"[GridSDFArchiveWriter] Error! fail writing index of "<<m_sFileName<<std::endl;
+  }
+  return bSuccess;
+}
+
+bool GridSDFArchiveWriter::AppendChunk(
+    const GridArchiveChunk&    chunk,
+    GridArchiveEntry&          entry,
+    const void*                pData,
+    size_t                     nBytes)
+{
+  if(!m_File.is_open())
+  {
+    std::cerr<<"[GridSDFArchiveWriter] Error! archive is not open."<<std::endl;
+    return false;
+  }
+
+  m_File.write((const char*)&chunk, sizeof(chunk));
+  m_File.write((const char*)pData, nBytes);
+
+  const unsigned long long nPayload = m_nEnd + sizeof(chunk);
+  const unsigned long long nEnd = AlignArchiveOffset(nPayload + nBytes);
+  static const char aPad[GridArchiveAlignment] = {0};
+  m_File.write(aPad, nEnd - (nPayload + nBytes));
+
+  if(m_File.fail())
+  {
+    std::cerr<<"[GridSDFArchiveWriter] Error! fail writing "<<m_sFileName<<std::endl;
+    return false;
+  }
+
+  entry = EntryFromChunk(chunk, nPayload);
+  m_nEnd = nEnd;
+  return true;
+}
+
+bool GridSDFArchiveWriter::AppendGridBytes(
+    int3                       GlobalIndex,
+    int3                       LocalIndex,
+    unsigned int               nChannel,
+    unsigned int               nElemSize,
+    const unsigned int         nDim[3],
+    const void*                pData,
+    size_t                     nBytes)
+{
+  GridArchiveChunk chunk;
+  memset(&chunk, 0, sizeof(chunk));
+  chunk.nMagic         = GridArchiveChunkMagic;
+  chunk.nKind          = GRID_ARCHIVE_GRID;
+  chunk.nChannel       = nChannel;
+  chunk.nElemSize      = nElemSize;
+  chunk.GlobalIndex[0] = GlobalIndex.x;
+  chunk.GlobalIndex[1] = GlobalIndex.y;
+  chunk.GlobalIndex[2] = GlobalIndex.z;
+  chunk.LocalIndex[0]  = LocalIndex.x;
+  chunk.LocalIndex[1]  = LocalIndex.y;
+  chunk.LocalIndex[2]  = LocalIndex.z;
+  chunk.nDim[0]        = nDim[0];
+  chunk.nDim[1]        = nDim[1];
+  chunk.nDim[2]        = nDim[2];
+  chunk.nBytes         = nBytes;
+
+  GridArchiveEntry entry;
+  if(AppendChunk(chunk, entry, pData, nBytes) == false)
+  {
+    return false;
+  }
+
+  m_vEntries.push_back(entry);
+  return true;
+}
+
+bool GridSDFArchiveWriter::AppendBoundingBox(
+    int3                       GlobalIndex,
+    const BoundingBox&         BBox)
+{
+  const float aBBox[6] = {BBox.boxmin.x, BBox.boxmin.y, BBox.boxmin.z,
+                          BBox.boxmax.x, BBox.boxmax.y, BBox.boxmax.z};
+
+  GridArchiveChunk chunk;
+  memset(&chunk, 0, sizeof(chunk));
+  chunk.nMagic         = GridArchiveChunkMagic;
+  chunk.nKind          = GRID_ARCHIVE_BBOX;
+  chunk.nElemSize      = sizeof(float);
+  chunk.GlobalIndex[0] = GlobalIndex.x;
+  chunk.GlobalIndex[1] = GlobalIndex.y;
+  chunk.GlobalIndex[2] = GlobalIndex.z;
+  chunk.nBytes         = sizeof(aBBox);
+
+  GridArchiveEntry entry;
+  if(AppendChunk(chunk, entry, aBBox, sizeof(aBBox)) == false)
+  {
+    return false;
+  }
+
+  // keep the box in the index as well so readers don't need to seek for it
+  memcpy(entry.BBox, aBBox, sizeof(aBBox));
+  m_vEntries.push_back(entry);
+  m_BBoxes[ArchiveKey(GlobalIndex)] = m_vEntries.size()-1;
+  return true;
+}
+
+bool GridSDFArchiveWriter::HasBoundingBox(int3 GlobalIndex) const
+{
+  return m_BBoxes.find(ArchiveKey(GlobalIndex)) != m_BBoxes.end();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//                                 Reader                                    //
+///////////////////////////////////////////////////////////////////////////////
+
+GridSDFArchiveReader::GridSDFArchiveReader()
+{
+  memset(&m_Header, 0, sizeof(m_Header));
+}
+
+GridSDFArchiveReader::~GridSDFArchiveReader()
+{
+  Close();
+}
+
+void GridSDFArchiveReader::Close()
+{
+  if(m_File.is_open())
+  {
+    m_File.close();
+  }
+  m_vAll.clear();
+  m_vGrids.clear();
+  m_GridMap.clear();
+  m_BBoxes.clear();
+}
+
+bool GridSDFArchiveReader::Open(const std::string& sFileName)
+{
+  Close();
+
+  m_File.open(sFileName.c_str(), std::ios::in | std::ios::binary);
+  if(m_File.fail())
+  {
+    std::cerr<<"[GridSDFArchiveReader] Error! cannot open "<<sFileName<<std::endl;
+    return false;
+  }
+
+  m_File.seekg(0, std::ios::end);
+  const unsigned long long nFileSize = m_File.tellg();
+  m_File.seekg(0, std::ios::beg);
+
+  m_File.read((char*)&m_Header, sizeof(m_Header));
+  if(m_File.fail() || memcmp(m_Header.sMagic, GridArchiveMagic, sizeof(GridArchiveMagic)) != 0)
+  {
+    std::cerr<<"[GridSDFArchiveReader] Error! "<<sFileName<<" is not a grid sdf archive."<<std::endl;
+    m_File.close();
+    return false;
+  }
+
+  if(m_Header.nVersion > GridArchiveVersion)
+  {
+    std::cerr<<"[GridSDFArchiveReader] Error! "<<sFileName<<" has version "<<
+               m_Header.nVersion<<", support up to "<<GridArchiveVersion<<std::endl;
+    m_File.close();
+    return false;
+  }
+
+  // use the index if the file was closed properly, scan otherwise
+  if(LoadIndex(nFileSize) == false)
+  {
+    std::cerr<<"[GridSDFArchiveReader] Warning! "<<sFileName<<
+               " has no valid index, scanning chunks."<<std::endl;
+    m_vAll.clear();
+    m_GridMap.clear();
+    m_BBoxes.clear();
+
+    if(ScanChunks(nFileSize) == false)
+    {
+      m_File.close();
+      return false;
+    }
+  }
+
+  // latest copy of every grid, in key order
+  m_vGrids.clear();
+  for(std::map<std::vector<int>, size_t>::const_iterator it = m_GridMap.begin();
+      it != m_GridMap.end(); ++it)
+  {
+    m_vGrids.push_back(m_vAll[it->second]);
+  }
+
+  m_File.clear();
+  return true;
+}
+
+void GridSDFArchiveReader::AddEntry(const GridArchiveEntry& entry)
+{
+  m_vAll.push_back(entry);
+
+  if(entry.nKind == GRID_ARCHIVE_GRID)
+  {
+    m_GridMap[ArchiveKey(entry)] = m_vAll.size()-1;
+  }
+  else if(entry.nKind == GRID_ARCHIVE_BBOX)
+  {
+    m_BBoxes[ArchiveKey(entry.GlobalIndex)] = BoundingBox(
+          make_float3(entry.BBox[0], entry.BBox[1], entry.BBox[2]),
+          make_float3(entry.BBox[3], entry.BBox[4], entry.BBox[5]) );
+  }
+}
+
+bool GridSDFArchiveReader::LoadIndex(unsigned long long nFileSize)
+{
+  if(nFileSize < sizeof(GridArchiveHeader) + sizeof(GridArchiveTrailer))
+  {
+    return false;
+  }
+
+  GridArchiveTrailer trailer;
+  m_File.seekg(nFileSize - sizeof(trailer));
+  m_File.read((char*)&trailer, sizeof(trailer));
+  if(m_File.fail() ||
+     memcmp(trailer.sMagic, GridArchiveEndMagic, sizeof(GridArchiveEndMagic)) != 0)
+  {
+    m_File.clear();
+    return false;
+  }
+
+  GridArchiveChunk chunk;
+  m_File.seekg(trailer.nIndexOffset);
+  m_File.read((char*)&chunk, sizeof(chunk));
+  if(m_File.fail() || chunk.nMagic != GridArchiveChunkMagic ||
+     chunk.nKind != GRID_ARCHIVE_INDEX ||
+     chunk.nBytes != trailer.nNumEntries * sizeof(GridArchiveEntry))
+  {
+    m_File.clear();
+    return false;
+  }
+
+  std::vector<GridArchiveEntry> vEntries(trailer.nNumEntries);
+  if(!vEntries.empty())
+  {
+    m_File.read((char*)&vEntries[0], chunk.nBytes);
+    if(m_File.fail())
+    {
+      m_File.clear();
+      return false;
+    }
+  }
+
+  for(unsigned int i=0; i!=vEntries.size(); i++)
+  {
+    AddEntry(vEntries[i]);
+  }
+  return true;
+}
+
+bool GridSDFArchiveReader::ScanChunks(unsigned long long nFileSize)
+{
+  unsigned long long nOffset = sizeof(GridArchiveHeader);
+
+  while(nOffset + sizeof(GridArchiveChunk) <= nFileSize)
+  {
+    GridArchiveChunk chunk;
+    m_File.seekg(nOffset);
+    m_File.read((char*)&chunk, sizeof(chunk));
+
+    const unsigned long long nPayload = nOffset + sizeof(chunk);
+    if(m_File.fail() || chunk.nMagic != GridArchiveChunkMagic ||
+       nPayload + chunk.nBytes > nFileSize)
+    {
+      break;
+    }
+
+    if(chunk.nKind == GRID_ARCHIVE_INDEX)
+    {
+      // stale index of an earlier session, chunks may follow it
+      nOffset = AlignArchiveOffset(nPayload + chunk.nBytes);
+      continue;
+    }
+
+    GridArchiveEntry entry = EntryFromChunk(chunk, nPayload);
+    if(chunk.nKind == GRID_ARCHIVE_BBOX)
+    {
+      m_File.read((char*)entry.BBox, sizeof(entry.BBox));
+      if(m_File.fail())
+      {
+        break;
+      }
+    }
+    AddEntry(entry);
+
+    nOffset = AlignArchiveOffset(nPayload + chunk.nBytes);
+  }
+
+  m_File.clear();
+  return true;
+}
+
+const GridArchiveHeader& GridSDFArchiveReader::Header() const
+{
+  return m_Header;
+}
+
+const std::vector<GridArchiveEntry>& GridSDFArchiveReader::Grids() const
+{
+  return m_vGrids;
+}
+
+std::vector<int3> GridSDFArchiveReader::GetGlobalIndices() const
+{
+  std::vector<int3> vIndices;
+  for(unsigned int i=0; i!=m_vGrids.size(); i++)
+  {
+    const int3 g = m_vGrids[i].GlobalIndex;
+    if(vIndices.empty() || vIndices.back().x != g.x ||
+       vIndices.back().y != g.y || vIndices.back().z != g.z)
+    {
+      vIndices.push_back(g);
+    }
+  }
+  return vIndices;
+}
+
+std::vector<GridArchiveEntry> GridSDFArchiveReader::GetGrids(
+    int3                       GlobalIndex,
+    GridArchiveChannel         eChannel) const
+{
+  // grids are sorted by global index first
+  GridArchiveEntry key;
+  memset(&key, 0, sizeof(key));
+  key.GlobalIndex = GlobalIndex;
+  key.LocalIndex  = make_int3(INT_MIN, INT_MIN, INT_MIN);
+
+  std::vector<GridArchiveEntry> vGrids;
+  for(std::vector<GridArchiveEntry>::const_iterator it =
+      std::lower_bound(m_vGrids.begin(), m_vGrids.end(), key, EntryLess);
+      it != m_vGrids.end() && it->GlobalIndex.x == GlobalIndex.x &&
+      it->GlobalIndex.y == GlobalIndex.y && it->GlobalIndex.z == GlobalIndex.z; ++it)
+  {
+    if(it->nChannel == static_cast<unsigned int>(eChannel))
+    {
+      vGrids.push_back(*it);
+    }
+  }
+  return vGrids;
+}
+
+bool GridSDFArchiveReader::GetBoundingBox(int3 GlobalIndex, BoundingBox& rBBox) const
+{
+  std::map<std::vector<int>, BoundingBox>::const_iterator it =
+      m_BBoxes.find(ArchiveKey(GlobalIndex));
+
+  if(it == m_BBoxes.end())
+  {
+    return false;
+  }
+
+  rBBox = it->second;
+  return true;
+}
+
+bool GridSDFArchiveReader::ReadBytes(const GridArchiveEntry& entry, void* pData)
+{
+  m_File.seekg(entry.nOffset);
+  m_File.read((char*)pData, entry.nBytes);
+
+  if(m_File.fail())
+  {
+    std::cerr<<"[GridSDFArchiveReader] Error! fail reading grid at "<<entry.nOffset<<std::endl;
+    m_File.clear();
+    return false;
+  }
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//                               Memory map                                  //
+///////////////////////////////////////////////////////////////////////////////
+
+GridSDFArchiveMap::GridSDFArchiveMap()
+  : m_pData(NULL), m_nSize(0)
+{
+}
+
+GridSDFArchiveMap::~GridSDFArchiveMap()
+{
+  Close();
+}
+
+bool GridSDFArchiveMap::Open(const std::string& sFileName)
+{
+  Close();
+
+  // the index is small, read it the usual way
+  if(m_Index.Open(sFileName) == false)
+  {
+    return false;
+  }
+
+#ifdef _WIN_
+  HANDLE hFile = CreateFileA(sFileName.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+                             OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, NULL);
+  if(hFile == INVALID_HANDLE_VALUE)
+  {
+    std::cerr<<"[GridSDFArchiveMap] Error! cannot open "<<sFileName<<std::endl;
+    m_Index.Close();
+    return false;
+  }
+
+  LARGE_INTEGER nFileSize;
+  if(GetFileSizeEx(hFile, &nFileSize) == 0 || nFileSize.QuadPart == 0)
+  {
+    CloseHandle(hFile);
+    m_Index.Close();
+    return false;
+  }
+
+  // copy on write, see GridSDFArchive.h. The view keeps the mapping alive,
+  // the handles can go
+  HANDLE hMap = CreateFileMappingA(hFile, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+  void* pData = hMap != NULL ? MapViewOfFile(hMap, FILE_MAP_COPY, 0, 0, 0) : NULL;
+  if(hMap != NULL)
+  {
+    CloseHandle(hMap);
+  }
+  CloseHandle(hFile);
+
+  if(pData == NULL)
+  {
+    std::cerr<<"[GridSDFArchiveMap] Error! cannot map "<<sFileName<<std::endl;
+    m_Index.Close();
+    return false;
+  }
+
+  const unsigned long long nSize = nFileSize.QuadPart;
+#else
+  const int fd = open(sFileName.c_str(), O_RDONLY);
+  if(fd < 0)
+  {
+    std::cerr<<"[GridSDFArchiveMap] Error! cannot open "<<sFileName<<std::endl;
+    m_Index.Close();
+    return false;
+  }
+
+  struct stat st;
+  if(fstat(fd, &st) != 0 || st.st_size == 0)
+  {
+    close(fd);
+    m_Index.Close();
+    return false;
+  }
+
+  // copy on write, see GridSDFArchive.h
+  void* pData = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+
+  if(pData == MAP_FAILED)
+  {
+    std::cerr<<"[GridSDFArchiveMap] Error! cannot map "<<sFileName<<std::endl;
+    m_Index.Close();
+    return false;
+  }
+
+  // grids are visited in arbitrary order, don't read far ahead
+  madvise(pData, st.st_size, MADV_RANDOM);
+
+  const unsigned long long nSize = st.st_size;
+#endif
+
+  m_pData     = (unsigned char*)pData;
+  m_nSize     = nSize;
+  m_sFileName = sFileName;
+  return true;
+}
+
+void GridSDFArchiveMap::Close()
+{
+  if(m_pData != NULL)
+  {
+#ifdef _WIN_
+    UnmapViewOfFile(m_pData);
+#else
+    munmap(m_pData, m_nSize);
+#endif
+    m_pData = NULL;
+    m_nSize = 0;
+  }
+  m_Index.Close();
+}
+
+bool GridSDFArchiveMap::IsOpen() const
+{
+  return m_pData != NULL;
+}
+
+const GridSDFArchiveReader& GridSDFArchiveMap::Index() const
+{
+  return m_Index;
+}
+
+void GridSDFArchiveMap::WillNeed(const std::vector<GridArchiveEntry>& vEntries) const
+{
+#ifdef _WIN_
+  // no portable read ahead hint for views, pages are read on first touch
+  (void)vEntries;
+#else
+  const unsigned long long nPage = sysconf(_SC_PAGESIZE);
+
+  for(unsigned int i=0; i!=vEntries.size(); i++)
+  {
+    const unsigned long long nBegin = vEntries[i].nOffset / nPage * nPage;
+    const unsigned long long nEnd   = vEntries[i].nOffset + vEntries[i].nBytes;
+    if(m_pData != NULL && nEnd <= m_nSize)
+    {
+      madvise(m_pData + nBegin, nEnd - nBegin, MADV_WILLNEED);
+    }
+  }
+#endif
+}
+
+unsigned char* GridSDFArchiveMap::GetPayload(
+    const GridArchiveEntry&    entry,
+    unsigned int               nElemSize) const
+{
+  if(m_pData == NULL)
+  {
+    std::cerr<<"[GridSDFArchiveMap] Error! archive is not mapped."<<std::endl;
+    return NULL;
+  }
+
+  if(entry.nKind != GRID_ARCHIVE_GRID || entry.nElemSize != nElemSize ||
+     entry.nOffset + entry.nBytes > m_nSize ||
+     entry.nBytes != (unsigned long long)entry.nDim[0] * entry.nDim[1] *
+                     entry.nDim[2] * nElemSize)
+  {
+    std::cerr<<"[GridSDFArchiveMap] Error! entry at "<<entry.nOffset<<
+               " is not a grid of elem size "<<nElemSize<<std::endl;
+    return NULL;
+  }
+
+  // payloads are GridArchiveAlignment aligned
+  return m_pData + entry.nOffset;
+}
+
+}
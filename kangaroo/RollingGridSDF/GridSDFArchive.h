@@ -0,0 +1,371 @@
+// by lu.ma@colorado.edu
+
+#ifndef GRIDSDFARCHIVE_H
+#define GRIDSDFARCHIVE_H
+
+#include <climits>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <kangaroo/platform.h>
+#include <kangaroo/BoundingBox.h>
+#include "BoundedVolumeGrid.h"
+
+namespace roo {
+
+// =============================================================================
+// Single file container for rolling grid SDF dumps, replacing one PXM file
+// per grid plus one "-BB#x#y#z" file per global volume.
+//
+// Layout, all records start on a GridArchiveAlignment boundary:
+//   GridArchiveHeader
+//   GridArchiveChunk + payload      (grid voxels, or a volume bounding box)
+//   ...
+//   GridArchiveChunk + index        (one GridArchiveEntry per chunk above)
+//   GridArchiveTrailer              (locates the index)
+//
+// Chunks are only ever appended. Reopening a file for append writes the new
+// chunks over the old index and then a new index, so an interrupted write
+// loses at most the index, which the reader rebuilds by scanning the chunks.
+// If a grid is written more than once (e.g. when the rolling window returns
+// to it) the last copy wins.
+// =============================================================================
+
+static const unsigned int GridArchiveAlignment = 64;
+static const unsigned int GridArchiveVersion   = 1;
+
+enum GridArchiveChunkKind
+{
+  GRID_ARCHIVE_GRID  = 1,  // voxels of one VolumeGrid
+  GRID_ARCHIVE_BBOX  = 2,  // bounding box of one global volume
+  GRID_ARCHIVE_INDEX = 3   // table of GridArchiveEntry
+};
+
+// what a grid holds, e.g. the sdf or the gray/color sdf of the same grid
+enum GridArchiveChannel
+{
+  GRID_ARCHIVE_SDF   = 0,
+  GRID_ARCHIVE_COLOR = 1
+};
+
+struct GridArchiveHeader
+{
+  char          sMagic[8];          // "KGRIDSDF"
+  unsigned int  nVersion;
+  unsigned int  nGridRes;           // voxels per side of a single grid
+  int           nVolRes[3];         // voxels of a BoundedVolumeGrid
+  unsigned char reserved[36];
+};
+
+struct GridArchiveChunk
+{
+  unsigned int  nMagic;             // GridArchiveChunkMagic
+  unsigned int  nKind;              // GridArchiveChunkKind
+  unsigned int  nChannel;           // GridArchiveChannel
+  unsigned int  nElemSize;          // sizeof(T) of grid voxels
+  int           GlobalIndex[3];
+  int           LocalIndex[3];
+  unsigned int  nDim[3];            // w,h,d of a grid
+  unsigned int  reserved;
+  unsigned long long nBytes;        // payload bytes following this chunk
+};
+
+// one entry of the index, also what the reader hands out
+struct GridArchiveEntry
+{
+  unsigned long long nOffset;       // file offset of the payload
+  unsigned int  nKind;
+  unsigned int  nChannel;
+  unsigned int  nElemSize;
+  int3          GlobalIndex;
+  int3          LocalIndex;
+  unsigned int  nDim[3];
+  float         BBox[6];            // GRID_ARCHIVE_BBOX only, min then max
+  unsigned long long nBytes;
+};
+
+struct GridArchiveTrailer
+{
+  char          sMagic[8];          // "KGRIDEND"
+  unsigned long long nIndexOffset;  // file offset of the index chunk
+  unsigned long long nNumEntries;
+  unsigned char reserved[40];
+};
+
+// -----------------------------------------------------------------------------
+class KANGAROO_EXPORT GridSDFArchiveWriter
+{
+public:
+  GridSDFArchiveWriter();
+  ~GridSDFArchiveWriter();
+
+  // create a new archive (bAppend false) or continue an existing one. nGridRes
+  // and nVolRes must match when appending.
+  bool Open(const std::string& sFileName, unsigned int nGridRes,
+            int3 nVolRes, bool bAppend = true);
+
+  // write the index and trailer. Called by the destructor as well.
+  bool Close();
+
+  bool IsOpen() const;
+
+  template<typename T, typename Manage>
+  bool AppendGrid(
+      int3                                             GlobalIndex,
+      int3                                             LocalIndex,
+      const VolumeGrid<T,TargetHost,Manage>&           vol,
+      GridArchiveChannel                               eChannel = GRID_ARCHIVE_SDF)
+  {
+    const size_t nRowBytes = vol.w * sizeof(T);
+    const size_t nBytes = nRowBytes * vol.h * vol.d;
+    const unsigned int nDim[3] = {static_cast<unsigned int>(vol.w),
+                                  static_cast<unsigned int>(vol.h),
+                                  static_cast<unsigned int>(vol.d)};
+
+    // host volumes are usually dense, write them without staging
+    if(vol.pitch == nRowBytes && vol.img_pitch == nRowBytes * vol.h)
+    {
+      return AppendGridBytes(GlobalIndex, LocalIndex, eChannel, sizeof(T),
+                             nDim, vol.ptr, nBytes);
+    }
+
+    m_vStaging.resize(nBytes);
+    for(unsigned int d=0; d<vol.d; ++d) {
+      for(unsigned int r=0; r<vol.h; ++r) {
+        memcpy(&m_vStaging[(d*vol.h + r)*nRowBytes], vol.RowPtr(r,d), nRowBytes);
+      }
+    }
+    return AppendGridBytes(GlobalIndex, LocalIndex, eChannel, sizeof(T),
+                           nDim, &m_vStaging[0], nBytes);
+  }
+
+  bool AppendBoundingBox(int3 GlobalIndex, const BoundingBox& BBox);
+
+  // if the bounding box of a global volume was written already
+  bool HasBoundingBox(int3 GlobalIndex) const;
+
+  size_t NumEntries() const;
+
+protected:
+  bool AppendGridBytes(
+      int3 GlobalIndex, int3 LocalIndex, unsigned int nChannel,
+      unsigned int nElemSize, const unsigned int nDim[3],
+      const void* pData, size_t nBytes);
+
+  bool AppendChunk(const GridArchiveChunk& chunk, GridArchiveEntry& entry,
+                   const void* pData, size_t nBytes);
+
+  std::fstream                                   m_File;
+  std::string                                    m_sFileName;
+  unsigned long long                             m_nEnd;
+  std::vector<GridArchiveEntry>                  m_vEntries;
+  std::map<std::vector<int>, size_t>             m_BBoxes;
+  std::vector<char>                              m_vStaging;
+  std::vector<char>                              m_vBuffer;
+
+private:
+  GridSDFArchiveWriter(const GridSDFArchiveWriter&);
+  GridSDFArchiveWriter& operator=(const GridSDFArchiveWriter&);
+};
+
+// -----------------------------------------------------------------------------
+class KANGAROO_EXPORT GridSDFArchiveReader
+{
+public:
+  GridSDFArchiveReader();
+  ~GridSDFArchiveReader();
+
+  bool Open(const std::string& sFileName);
+  void Close();
+
+  const GridArchiveHeader& Header() const;
+
+  // latest copy of every grid, ordered by global index, local index, channel
+  const std::vector<GridArchiveEntry>& Grids() const;
+
+  // global indices of all volumes that have grids, ordered
+  std::vector<int3> GetGlobalIndices() const;
+
+  // grids of one global volume and channel
+  std::vector<GridArchiveEntry> GetGrids(
+      int3 GlobalIndex, GridArchiveChannel eChannel = GRID_ARCHIVE_SDF) const;
+
+  bool GetBoundingBox(int3 GlobalIndex, BoundingBox& rBBox) const;
+
+  // read raw payload of an entry into pData (entry.nBytes bytes)
+  bool ReadBytes(const GridArchiveEntry& entry, void* pData);
+
+  template<typename T>
+  bool ReadGrid(
+      const GridArchiveEntry&                          entry,
+      VolumeGrid<T,TargetHost,Manage>&                 vol)
+  {
+    if(entry.nKind != GRID_ARCHIVE_GRID || entry.nElemSize != sizeof(T))
+    {
+      std::cerr<<"[GridSDFArchiveReader] Error! entry is not a grid of elem size "<<
+                 sizeof(T)<<std::endl;
+      return false;
+    }
+
+    // vol is reallocated unless it has the size of the grid already. As with
+    // the grids of a BoundedVolumeGrid, w == 0 marks an unallocated grid.
+    if(vol.w != entry.nDim[0] || vol.h != entry.nDim[1] || vol.d != entry.nDim[2])
+    {
+      if(vol.w != 0)
+      {
+        vol.CleanUp();
+      }
+      vol.InitVolume(entry.nDim[0], entry.nDim[1], entry.nDim[2]);
+    }
+
+    const size_t nRowBytes = vol.w * sizeof(T);
+    if(vol.pitch == nRowBytes && vol.img_pitch == nRowBytes * vol.h)
+    {
+      return ReadBytes(entry, vol.ptr);
+    }
+
+    m_vStaging.resize(entry.nBytes);
+    if(ReadBytes(entry, &m_vStaging[0]) == false)
+    {
+      return false;
+    }
+    for(unsigned int d=0; d<vol.d; ++d) {
+      for(unsigned int r=0; r<vol.h; ++r) {
+        memcpy(vol.RowPtr(r,d), &m_vStaging[(d*vol.h + r)*nRowBytes], nRowBytes);
+      }
+    }
+    return true;
+  }
+
+protected:
+  bool LoadIndex(unsigned long long nFileSize);
+  bool ScanChunks(unsigned long long nFileSize);
+  void AddEntry(const GridArchiveEntry& entry);
+
+  std::ifstream                                  m_File;
+  GridArchiveHeader                              m_Header;
+  std::vector<GridArchiveEntry>                  m_vAll;      // file order
+  std::vector<GridArchiveEntry>                  m_vGrids;
+  std::map<std::vector<int>, size_t>             m_GridMap;
+  std::map<std::vector<int>, BoundingBox>        m_BBoxes;
+  std::vector<char>                              m_vStaging;
+
+  friend class GridSDFArchiveWriter;
+
+private:
+  GridSDFArchiveReader(const GridSDFArchiveReader&);
+  GridSDFArchiveReader& operator=(const GridSDFArchiveReader&);
+};
+
+// -----------------------------------------------------------------------------
+// Copy on write memory map of an archive. GetGrid() hands out grids as
+// DontManage VolumeGrid views straight into the mapping, so opening an
+// archive costs only reading its index and the OS pages in the grids actually
+// touched. Writes through a view go to private copies of the touched pages,
+// never to the file, and are lost when the map is closed. Views stay valid
+// until then.
+//
+// GetGlobalVolume() is not zero copy: it copies grids into pooled volumes of
+// a BoundedVolumeGrid, which then outlive the map (e.g. for meshing).
+class KANGAROO_EXPORT GridSDFArchiveMap
+{
+public:
+  GridSDFArchiveMap();
+  ~GridSDFArchiveMap();
+
+  bool Open(const std::string& sFileName);
+  void Close();
+
+  bool IsOpen() const;
+
+  // index, see GridSDFArchiveReader
+  const GridSDFArchiveReader& Index() const;
+
+  // hint the OS to read the grids ahead, e.g. the next global volume
+  void WillNeed(const std::vector<GridArchiveEntry>& vEntries) const;
+
+  template<typename T>
+  bool GetGrid(
+      const GridArchiveEntry&                          entry,
+      VolumeGrid<T,TargetHost,DontManage>&             vol) const
+  {
+    unsigned char* pData = GetPayload(entry, sizeof(T));
+    if(pData == NULL)
+    {
+      return false;
+    }
+
+    vol.ptr       = (T*)pData;
+    vol.w         = entry.nDim[0];
+    vol.h         = entry.nDim[1];
+    vol.d         = entry.nDim[2];
+    vol.pitch     = vol.w * sizeof(T);
+    vol.img_pitch = vol.pitch * vol.h;
+    return true;
+  }
+
+  // copy all grids of a global volume into rVol, which must be Init() with
+  // the setting the archive was written with. Grids are allocated from the
+  // pool as needed, so rVol owns them and can FreeMemory() as usual; use
+  // GetGrid() for views into the mapping instead. Returns number of grids.
+  template<typename T, typename Management>
+  int GetGlobalVolume(
+      int3                                             GlobalIndex,
+      BoundedVolumeGrid<T,TargetHost,Management>&      rVol,
+      GridArchiveChannel                               eChannel = GRID_ARCHIVE_SDF) const
+  {
+    const std::vector<GridArchiveEntry> vGrids = m_Index.GetGrids(GlobalIndex, eChannel);
+
+    int nNum = 0;
+    for(unsigned int i=0; i!=vGrids.size(); i++)
+    {
+      const int3 l = vGrids[i].LocalIndex;
+
+      // grids are saved without any local shift applied
+      const int nIndex = l.x + rVol.m_nGridNum_w * (l.y + rVol.m_nGridNum_h * l.z);
+
+      VolumeGrid<T,TargetHost,DontManage> view;
+      if(nIndex < 0 || nIndex >= static_cast<int>(rVol.m_nTotalGridRes) ||
+         GetGrid(vGrids[i], view) == false ||
+         view.w != rVol.m_nVolumeGridRes || view.h != rVol.m_nVolumeGridRes ||
+         view.d != rVol.m_nVolumeGridRes)
+      {
+        std::cerr<<"[GridSDFArchiveMap] Error! cannot map grid ("<<l.x<<","<<l.y<<
+                   ","<<l.z<<")"<<std::endl;
+        continue;
+      }
+
+      rVol.InitSingleBasicSDFWithIndex(nIndex);
+
+      VolumeGrid<T,TargetHost,Manage>& grid = rVol.m_GridVolumes[nIndex];
+      for(unsigned int d=0; d<view.d; ++d) {
+        for(unsigned int r=0; r<view.h; ++r) {
+          memcpy(grid.RowPtr(r,d), view.RowPtr(r,d), view.w * sizeof(T));
+        }
+      }
+      nNum++;
+    }
+    return nNum;
+  }
+
+protected:
+  unsigned char* GetPayload(const GridArchiveEntry& entry,
+                            unsigned int nElemSize) const;
+
+  GridSDFArchiveReader                           m_Index;
+  std::string                                    m_sFileName;
+  unsigned char*                                 m_pData;
+  unsigned long long                             m_nSize;
+
+private:
+  GridSDFArchiveMap(const GridSDFArchiveMap&);
+  GridSDFArchiveMap& operator=(const GridSDFArchiveMap&);
+};
+
+}
+
+#endif // GRIDSDFARCHIVE_H
@@ -2,6 +2,7 @@
 
 #include "MarchingCubesGrid.h"
 
+namespace roo {
 
 // fGetOffset finds the approximate point of intersection of the surface
 // between two points with the values fValue1 and fValue2
@@ -17,3 +18,5 @@ float fGetOffset(
   }
   return (fValueDesired - fValue1)/fDelta;
 }
+
+}
@@ -0,0 +1,384 @@
+// by lu.ma@colorado.edu
+
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include "MarchingCubesGrid.h"
+#include <kangaroo/host_launch_utils.h>
+
+namespace roo {
+
+// =============================================================================
+// Multithreaded marching cubes over all active grids of a host
+// BoundedVolumeGrid. Each grid is one task and runs in two passes:
+//
+// 1, every surface crossing on an edge owned by the grid (an edge is owned by
+//    the grid of its lower end voxel) is computed once, together with its
+//    normal and color, into the grid's own vertex buffer.
+// 2, every cube of the grid is classified and its triangles look the crossings
+//    up by edge, in this grid or in the neighbour grid that owns the edge.
+//
+// Vertices are therefore shared between all triangles that touch them, also
+// across grid seams, and the per grid buffers are merged at the end in grid
+// order so the output does not depend on the number of threads.
+// =============================================================================
+
+// crossing of the surface on one edge, keyed by the owning voxel and axis
+struct MarchingCubesGridEdge
+{
+  unsigned int nKey;     // (local voxel index)*3 + axis
+  unsigned int nVertex;  // index into the grid vertex buffer
+};
+
+template<typename TColor>
+struct MarchingCubesGridChunk
+{
+  int3                                nLocalIndex;
+  unsigned int                        nRealIndex;
+  unsigned int                        nBaseVertex;  // offset in merged output
+
+  std::vector<MarchingCubesGridEdge>  vEdges;       // sorted by nKey
+  std::vector<aiVector3D>             verts;
+  std::vector<aiVector3D>             norms;
+  std::vector<aiColor4D>              colors;
+  std::vector<unsigned int>           faces;        // 3 global indices each
+};
+
+// read voxel (x,y,z) of vol directly from its grid, false if outside the
+// volume, inside an inactive grid or not finite
+template<typename T, typename Management>
+inline bool GetGridVoxelValue(
+    const BoundedVolumeGrid<T,TargetHost,Management>& vol,
+    int x, int y, int z, float& fValue)
+{
+  if(x<0 || y<0 || z<0 ||
+     x>=static_cast<int>(vol.m_w) || y>=static_cast<int>(vol.m_h) ||
+     z>=static_cast<int>(vol.m_d))
+  {
+    return false;
+  }
+
+  const int nRes = static_cast<int>(vol.m_nVolumeGridRes);
+  const int nIndex = vol.ConvertLocalIndexToRealIndex(x/nRes, y/nRes, z/nRes);
+
+  if(vol.CheckIfBasicSDFActive(nIndex) == false)
+  {
+    return false;
+  }
+
+  fValue = vol.m_GridVolumes[nIndex].Get(x%nRes, y%nRes, z%nRes);
+  return std::isfinite(fValue);
+}
+
+// pass 1, compute crossings on the edges owned by a single grid
+template<typename T, typename TColor, typename Management>
+inline void MarchingCubesGridEdges(
+    const BoundedVolumeGrid<T,TargetHost,Management>&       vol,
+    const BoundedVolumeGrid<TColor,TargetHost,Management>&  volColor,
+    bool                                                    bColor,
+    float                                                   fTargetValue,
+    MarchingCubesGridChunk<TColor>&                         chunk)
+{
+  const int nRes = static_cast<int>(vol.m_nVolumeGridRes);
+  const int3 o = chunk.nLocalIndex * nRes;
+  const float3 fScale = vol.VoxelSizeUnits();
+  const VolumeGrid<T,TargetHost,Manage>& grid =
+      vol.m_GridVolumes[chunk.nRealIndex];
+
+  for(int z=0; z!=nRes; z++)
+  {
+    for(int y=0; y!=nRes; y++)
+    {
+      for(int x=0; x!=nRes; x++)
+      {
+        const float fValue = grid.Get(x,y,z);
+        if(!std::isfinite(fValue)) continue;
+
+        const bool bInside = fValue <= fTargetValue;
+
+        for(int a=0; a!=3; a++)
+        {
+          const int3 n = make_int3(o.x + x + (a==0), o.y + y + (a==1), o.z + z + (a==2));
+
+          float fNext;
+          if(GetGridVoxelValue(vol, n.x, n.y, n.z, fNext) == false ||
+             (fNext <= fTargetValue) == bInside)
+          {
+            continue;
+          }
+
+          const float fOffset = fGetOffset(fValue, fNext, fTargetValue);
+          const float3 p = vol.VoxelPositionInUnits(o.x + x, o.y + y, o.z + z);
+          const float3 v = make_float3(
+                p.x + (a==0 ? fOffset * fScale.x : 0.f),
+                p.y + (a==1 ? fOffset * fScale.y : 0.f),
+                p.z + (a==2 ? fOffset * fScale.z : 0.f) );
+
+          const float3 deriv = vol.GetUnitsBackwardDiffDxDyDz(v);
+          float3 norm = deriv / length(deriv);
+          if( !std::isfinite(norm.x) || !std::isfinite(norm.y) ||
+              !std::isfinite(norm.z) )
+          {
+            norm = make_float3(0,0,0);
+          }
+
+          MarchingCubesGridEdge edge;
+          edge.nKey    = 3*(x + nRes*(y + nRes*z)) + a;
+          edge.nVertex = chunk.verts.size();
+          chunk.vEdges.push_back(edge);
+
+          chunk.verts.push_back(aiVector3D(v.x, v.y, v.z));
+          chunk.norms.push_back(aiVector3D(norm.x, norm.y, norm.z));
+
+          if(bColor)
+          {
+            const TColor c = volColor.GetUnitsTrilinearClamped(v);
+            const float3 sColor = roo::ConvertPixel<float3,TColor>(c);
+            chunk.colors.push_back(aiColor4D(sColor.x, sColor.y, sColor.z, 1.0f));
+          }
+        }
+      }
+    }
+  }
+}
+
+inline bool MarchingCubesGridEdgeLess(
+    const MarchingCubesGridEdge& lhs, const MarchingCubesGridEdge& rhs)
+{
+  return lhs.nKey < rhs.nKey;
+}
+
+// pass 2, emit triangles of a single grid using the crossings of pass 1.
+// pChunkOfGrid maps a real grid index to its chunk (0 if inactive).
+template<typename T, typename TColor, typename Management>
+inline void MarchingCubesGridFaces(
+    const BoundedVolumeGrid<T,TargetHost,Management>&       vol,
+    const std::vector<MarchingCubesGridChunk<TColor>*>&     pChunkOfGrid,
+    float                                                   fTargetValue,
+    MarchingCubesGridChunk<TColor>&                         chunk)
+{
+  const int nRes = static_cast<int>(vol.m_nVolumeGridRes);
+  const int3 o = chunk.nLocalIndex * nRes;
+  const VolumeGrid<T,TargetHost,Manage>& grid =
+      vol.m_GridVolumes[chunk.nRealIndex];
+
+  for(int z=0; z!=nRes; z++)
+  {
+    for(int y=0; y!=nRes; y++)
+    {
+      for(int x=0; x!=nRes; x++)
+      {
+        // corners inside this grid are read directly, the others (last
+        // layer of the grid) through the neighbour grids
+        const bool bInterior = x<nRes-1 && y<nRes-1 && z<nRes-1;
+
+        float afCubeValue[8];
+        bool bValid = true;
+        for(int iVertex = 0; iVertex < 8 && bValid; iVertex++)
+        {
+          const int dx = static_cast<int>(a2fVertexOffset[iVertex][0]);
+          const int dy = static_cast<int>(a2fVertexOffset[iVertex][1]);
+          const int dz = static_cast<int>(a2fVertexOffset[iVertex][2]);
+
+          if(bInterior)
+          {
+            afCubeValue[iVertex] = grid.Get(x+dx, y+dy, z+dz);
+            bValid = std::isfinite(afCubeValue[iVertex]);
+          }
+          else
+          {
+            bValid = GetGridVoxelValue(vol, o.x+x+dx, o.y+y+dy, o.z+z+dz,
+                                       afCubeValue[iVertex]);
+          }
+        }
+        if(!bValid) continue;
+
+        int iFlagIndex = 0;
+        for(int iVertexTest = 0; iVertexTest < 8; iVertexTest++)
+        {
+          if(afCubeValue[iVertexTest] <= fTargetValue)
+            iFlagIndex |= 1<<iVertexTest;
+        }
+
+        const int iEdgeFlags = aiCubeEdgeFlags[iFlagIndex];
+        if(iEdgeFlags == 0) continue;
+
+        // global vertex index of the crossing on each intersected edge
+        unsigned int anEdgeVertex[12];
+        for(int iEdge = 0; iEdge < 12; iEdge++)
+        {
+          if(!(iEdgeFlags & (1<<iEdge))) continue;
+
+          // the edge is owned by its lower end voxel
+          const int c0 = a2iEdgeConnection[iEdge][0];
+          const int c1 = a2iEdgeConnection[iEdge][1];
+          int3 v = make_int3(
+                o.x + x + static_cast<int>(std::min(a2fVertexOffset[c0][0], a2fVertexOffset[c1][0])),
+                o.y + y + static_cast<int>(std::min(a2fVertexOffset[c0][1], a2fVertexOffset[c1][1])),
+                o.z + z + static_cast<int>(std::min(a2fVertexOffset[c0][2], a2fVertexOffset[c1][2])) );
+          const int a = a2fEdgeDirection[iEdge][0] != 0 ? 0 :
+                        a2fEdgeDirection[iEdge][1] != 0 ? 1 : 2;
+
+          const int3 g = make_int3(v.x/nRes, v.y/nRes, v.z/nRes);
+          const MarchingCubesGridChunk<TColor>* pOwner =
+              pChunkOfGrid[vol.ConvertLocalIndexToRealIndex(g.x, g.y, g.z)];
+          v = v - g * nRes;
+
+          MarchingCubesGridEdge key;
+          key.nKey = 3*(v.x + nRes*(v.y + nRes*v.z)) + a;
+          const std::vector<MarchingCubesGridEdge>::const_iterator it =
+              std::lower_bound(pOwner->vEdges.begin(), pOwner->vEdges.end(),
+                               key, MarchingCubesGridEdgeLess);
+
+          anEdgeVertex[iEdge] = pOwner->nBaseVertex + it->nVertex;
+        }
+
+        for(int iTriangle = 0; iTriangle < 5; iTriangle++)
+        {
+          if(a2iTriangleConnectionTable[iFlagIndex][3*iTriangle] < 0)
+            break;
+
+          for(int iCorner = 0; iCorner < 3; iCorner++)
+          {
+            chunk.faces.push_back(anEdgeVertex[
+                a2iTriangleConnectionTable[iFlagIndex][3*iTriangle+iCorner] ]);
+          }
+        }
+      }
+    }
+  }
+}
+
+// extract the mesh of every active grid of vol into rst (appending to it).
+// If pVertexEdges is given it receives, for every vertex of rst, the edge the
+// vertex lies on as (voxel x, voxel y, voxel z, axis) in volume coordinates,
+// which lets callers weld vertices shared with neighbouring volumes.
+KANGAROO_EXPORT
+template<typename T, typename TColor, typename Management>
+void GenMeshGridParallel(
+    const BoundedVolumeGrid<T,TargetHost,Management>&       vol,
+    const BoundedVolumeGrid<TColor,TargetHost,Management>&  volColor,
+    MarchingCUBERst&                                        rst,
+    float                                                   fTargetValue = 0.0f,
+    std::vector<int4>*                                      pVertexEdges = NULL)
+{
+  // one chunk per active grid
+  std::vector<MarchingCubesGridChunk<TColor> > vChunks;
+  std::vector<MarchingCubesGridChunk<TColor>*> pChunkOfGrid(vol.m_nTotalGridRes, 0);
+
+  for(unsigned int k=0; k!=vol.m_nGridNum_d; k++)
+  {
+    for(unsigned int j=0; j!=vol.m_nGridNum_h; j++)
+    {
+      for(unsigned int i=0; i!=vol.m_nGridNum_w; i++)
+      {
+        const unsigned int nIndex = vol.ConvertLocalIndexToRealIndex(i,j,k);
+        if(vol.CheckIfBasicSDFActive(nIndex))
+        {
+          MarchingCubesGridChunk<TColor> chunk;
+          chunk.nLocalIndex = make_int3(i,j,k);
+          chunk.nRealIndex  = nIndex;
+          chunk.nBaseVertex = 0;
+          vChunks.push_back(chunk);
+        }
+      }
+    }
+  }
+
+  for(size_t c=0; c!=vChunks.size(); c++)
+  {
+    pChunkOfGrid[vChunks[c].nRealIndex] = &vChunks[c];
+  }
+
+  const bool bColor = volColor.IsValid();
+
+  // pass 1, crossings
+  ParallelFor(0, vChunks.size(), [&](size_t c) {
+    MarchingCubesGridEdges(vol, volColor, bColor, fTargetValue, vChunks[c]);
+  });
+
+  // place the vertices of each grid in the merged output
+  unsigned int nBase = rst.verts.size();
+  for(size_t c=0; c!=vChunks.size(); c++)
+  {
+    vChunks[c].nBaseVertex = nBase;
+    nBase += vChunks[c].verts.size();
+  }
+
+  // pass 2, triangles
+  ParallelFor(0, vChunks.size(), [&](size_t c) {
+    MarchingCubesGridFaces(vol, pChunkOfGrid, fTargetValue, vChunks[c]);
+  });
+
+  // merge
+  size_t nFaceBase = rst.faces.size();
+  std::vector<size_t> vFaceBase(vChunks.size());
+  for(size_t c=0; c!=vChunks.size(); c++)
+  {
+    vFaceBase[c] = nFaceBase;
+    nFaceBase += vChunks[c].faces.size()/3;
+  }
+
+  rst.verts.resize(nBase);
+  rst.norms.resize(nBase);
+  if(bColor)
+  {
+    rst.colors.resize(nBase);
+  }
+  rst.faces.resize(nFaceBase);
+  if(pVertexEdges)
+  {
+    pVertexEdges->resize(nBase);
+  }
+
+  const int nRes = static_cast<int>(vol.m_nVolumeGridRes);
+
+  ParallelFor(0, vChunks.size(), [&](size_t c) {
+    MarchingCubesGridChunk<TColor>& chunk = vChunks[c];
+
+    std::copy(chunk.verts.begin(), chunk.verts.end(),
+              rst.verts.begin() + chunk.nBaseVertex);
+    std::copy(chunk.norms.begin(), chunk.norms.end(),
+              rst.norms.begin() + chunk.nBaseVertex);
+    if(bColor)
+    {
+      std::copy(chunk.colors.begin(), chunk.colors.end(),
+                rst.colors.begin() + chunk.nBaseVertex);
+    }
+
+    for(size_t f=0; f!=chunk.faces.size()/3; f++)
+    {
+      aiFace& face = rst.faces[vFaceBase[c] + f];
+      face.mNumIndices = 3;
+      face.mIndices = new unsigned int[3];
+      face.mIndices[0] = chunk.faces[3*f+0];
+      face.mIndices[1] = chunk.faces[3*f+1];
+      face.mIndices[2] = chunk.faces[3*f+2];
+    }
+
+    if(pVertexEdges)
+    {
+      const int3 o = chunk.nLocalIndex * nRes;
+      for(size_t e=0; e!=chunk.vEdges.size(); e++)
+      {
+        const int nVoxel = chunk.vEdges[e].nKey / 3;
+        (*pVertexEdges)[chunk.nBaseVertex + chunk.vEdges[e].nVertex] = make_int4(
+              o.x + nVoxel % nRes,
+              o.y + (nVoxel / nRes) % nRes,
+              o.z + nVoxel / (nRes*nRes),
+              chunk.vEdges[e].nKey % 3 );
+      }
+    }
+
+    // release the grid buffers early, they can be large
+    std::vector<aiVector3D>().swap(chunk.verts);
+    std::vector<aiVector3D>().swap(chunk.norms);
+    std::vector<aiColor4D>().swap(chunk.colors);
+    std::vector<unsigned int>().swap(chunk.faces);
+    std::vector<MarchingCubesGridEdge>().swap(chunk.vEdges);
+  });
+}
+
+}
@@ -4,6 +4,7 @@
 #define SAVEMESHGRID_H
 
 #include "MarchingCubesGrid.h"
+#include "ParallelMarchingCubesGrid.h"
 #include "PLYIO.h"
 #include <kangaroo/MarchingCubes.h>
 
@@ -39,35 +40,11 @@ aiMesh* GetMeshGrid(
     BoundedVolumeGrid<T, TargetHost, Manage>          vol,
     BoundedVolumeGrid<TColor, TargetHost, Manage>     volColor )
 {
-  std::vector<aiVector3D>   verts;
-  std::vector<aiVector3D>   norms;
-  std::vector<aiFace>       faces;
-  std::vector<aiColor4D>    colors;
-
-  // scan each grid..
-  int nNumSkip =0;
-  int nNumSave =0;
-
-  for(int i=0;i!=vol.m_nGridNum_w;i++)
-  {
-    for(int j=0;j!=vol.m_nGridNum_h;j++)
-    {
-      for(int k=0;k!=vol.m_nGridNum_d;k++)
-      {
-        if(vol.CheckIfBasicSDFActive(vol.ConvertLocalIndexToRealIndex(i,j,k)) == true)
-        {
-          GenMeshSingleGrid(vol,volColor,make_int3(i,j,k),verts, norms, faces, colors);
-          nNumSave++;
-        }
-        else
-        {
-          nNumSkip++;
-        }
-      }
-    }
-  }
+  MarchingCUBERst ObjMesh;
+  GenMeshGridParallel(vol, volColor, ObjMesh);
 
-  return MeshFromListsVector(verts,norms,faces,colors);
+  return MeshFromListsVector(ObjMesh.verts, ObjMesh.norms,
+                             ObjMesh.faces, ObjMesh.colors);
 }
 
 KANGAROO_EXPORT
@@ -138,35 +115,14 @@ void SaveMeshGrid(
     BoundedVolumeGrid<TColor, TargetHost, Manage>     hVolColor )
 {
   MarchingCUBERst ObjMesh;
-  int nNumSkip =0; int nNumSave =0;
-
-  // for each grid in the whole volume
-  for(unsigned int i=0;i!=hVol.m_nGridNum_w;i++)
-  {
-    for(unsigned int j=0;j!=hVol.m_nGridNum_h;j++)
-    {
-      for(unsigned int k=0;k!=hVol.m_nGridNum_d;k++)
-      {
-        if(hVol.CheckIfBasicSDFActive(hVol.ConvertLocalIndexToRealIndex(i,j,k)))
-        {
-          int3 CurLocalIndex = make_int3(i,j,k);
 
-          GenMeshSingleGrid(hVol, hVolColor, CurLocalIndex, ObjMesh.verts,
-                            ObjMesh.norms, ObjMesh.faces, ObjMesh.colors);
+  // all active grids at once, see ParallelMarchingCubesGrid.h
+  GenMeshGridParallel(hVol, hVolColor, ObjMesh);
 
-          std::cout<<"Finish save grid "<<hVol.ConvertLocalIndexToRealIndex(i,j,k)<<
-                     "("<<i<<","<<j<<","<<k<<")"<<"; vertes num: "<<ObjMesh.verts.size()<<
-                     "; norms num: "<<ObjMesh.norms.size()<<"; faces num: "<<ObjMesh.faces.size()<<
-                     "; colors num: "<<ObjMesh.colors.size()<<std::endl;
-          nNumSave++;
-        }
-        else
-        {
-          nNumSkip++;
-        }
-      }
-    }
-  }
+  std::cout<<"Finish save "<<hVol.GetActiveGridVolNum()<<" grids; vertes num: "<<
+             ObjMesh.verts.size()<<"; norms num: "<<ObjMesh.norms.size()<<
+             "; faces num: "<<ObjMesh.faces.size()<<"; colors num: "<<
+             ObjMesh.colors.size()<<std::endl;
 
   aiMesh* mesh = MeshFromListsVector(ObjMesh.verts,ObjMesh.norms,
                                      ObjMesh.faces,ObjMesh.colors);
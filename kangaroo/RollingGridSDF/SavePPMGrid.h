@@ -6,6 +6,7 @@
 #include "kangaroo/extra/SavePPM.h"
 #include "BoundedVolumeGrid.h"
 #include "RollingGridSDF.h"
+#include "GridSDFArchive.h"
 
 // P1	Portable bitmap	ASCII
 // P2	Portable graymap	ASCII
@@ -306,4 +307,102 @@ void SavePXMGridDesire(
 }
 
 
+///========================= Save Grid SDFs to Archive =========================
+// same as SavePXMGridDesire, but append the grids (and bounding boxes) to a
+// single archive file instead of writing one file per grid. See GridSDFArchive.h
+// Returns false if the archive is not open or a write failed, in which case
+// the archive holds the grids appended before the failure.
+KANGAROO_EXPORT
+template<typename T, typename Manage>
+bool SavePXMGridDesire(
+    roo::GridSDFArchiveWriter&                               rArchive,
+    int                                                      pGridNeedSave[],
+    int                                                      pGlobalIndex_x[],
+    int                                                      pGlobalIndex_y[],
+    int                                                      pGlobalIndex_z[],
+    roo::BoundedVolumeGrid<T,roo::TargetDevice, Manage>&     rDVol,
+    roo::BoundedVolumeGrid<float,roo::TargetDevice, Manage>* pDColorVol,
+    bool                                                     bSaveBBox)
+{
+  if(rDVol.GetActiveGridVolNum() == 0)
+  {
+    std::cerr<<"[Kangaroo/SavePXMGridDesire] Cannot save PXM for void volume."<<std::endl;
+    exit(-1);
+  }
+
+  if(rArchive.IsOpen() == false)
+  {
+    std::cerr<<"[Kangaroo/SavePXMGridDesire] Archive is not open."<<std::endl;
+    return false;
+  }
+
+  // ------------------------------------------------------------------------
+  // only copy the grids we need to the host
+  int nSavedGridNum =0;
+
+  for(int i=0; i!=static_cast<int>(rDVol.m_nGridNum_w); i++)
+  {
+    for(int j=0; j!=static_cast<int>(rDVol.m_nGridNum_h); j++)
+    {
+      for(int k=0; k!=static_cast<int>(rDVol.m_nGridNum_d); k++)
+      {
+        // here we don't consider any shift as the grid for saving does not
+        // had any shift applied
+        int nGridIndex = i + rDVol.m_nGridNum_w* (j+ rDVol.m_nGridNum_h* k);
+
+        if( pGridNeedSave[nGridIndex]==1 &&
+            rDVol.CheckIfBasicSDFActive(nGridIndex) )
+        {
+          int3 GlobalIndex = make_int3(pGlobalIndex_x[nGridIndex],
+                                       pGlobalIndex_y[nGridIndex],
+                                       pGlobalIndex_z[nGridIndex]);
+
+          int3 LocalIndex  = make_int3(i,j,k);
+
+          roo::VolumeGrid<T,roo::TargetHost,roo::Manage> HGrid;
+          HGrid.InitVolume(rDVol.m_nVolumeGridRes, rDVol.m_nVolumeGridRes,
+                           rDVol.m_nVolumeGridRes);
+          HGrid.CopyFrom(rDVol.m_GridVolumes[nGridIndex]);
+          bool bSuccess = rArchive.AppendGrid(GlobalIndex, LocalIndex, HGrid,
+                                              roo::GRID_ARCHIVE_SDF);
+
+          if(bSuccess && pDColorVol != NULL &&
+             pDColorVol->CheckIfBasicSDFActive(nGridIndex))
+          {
+            roo::VolumeGrid<float,roo::TargetHost,roo::Manage> HColorGrid;
+            HColorGrid.InitVolume(pDColorVol->m_nVolumeGridRes,
+                                  pDColorVol->m_nVolumeGridRes,
+                                  pDColorVol->m_nVolumeGridRes);
+            HColorGrid.CopyFrom(pDColorVol->m_GridVolumes[nGridIndex]);
+            bSuccess = rArchive.AppendGrid(GlobalIndex, LocalIndex, HColorGrid,
+                                           roo::GRID_ARCHIVE_COLOR);
+            HColorGrid.CleanUp();
+          }
+
+          HGrid.CleanUp();
+
+          // bb in global pose, once per global volume
+          if(bSuccess && bSaveBBox && rArchive.HasBoundingBox(GlobalIndex) == false)
+          {
+            bSuccess = rArchive.AppendBoundingBox(GlobalIndex, rDVol.GetDesireBB(GlobalIndex));
+          }
+
+          if(bSuccess == false)
+          {
+            std::cerr<<"[Kangaroo/SavePXMGridDesire] Fail appending grid ("<<i<<","<<j<<
+                       ","<<k<<") to archive after "<<nSavedGridNum<<" grids."<<std::endl;
+            return false;
+          }
+          nSavedGridNum++;
+        }
+      }
+    }
+  }
+
+  printf("\n[Kangaroo/SavePXMGridDesire] Append %d grid sdf in Global Pose to archive.\n",
+         nSavedGridNum);
+  return true;
+}
+
+
 #endif // SAVEPPMGRID_H
@@ -2,6 +2,11 @@
 
 #include "SaveRollingGridSDF.h"
 
+#include <cstdio>
+#include <map>
+#include <tuple>
+#include <unordered_map>
+
 namespace roo {
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -44,11 +49,13 @@ bool GetIndexFromFileName(
   }
 }
 
-// get files need saving into mesh
+// get files need saving into mesh. Volumes are returned in the order their
+// global index first appears in vfilename.
 std::vector<SingleVolume> GetFilesNeedSaving(
     std::vector<std::string>&  vfilename)
 {
   std::vector<SingleVolume>  vVolumes;
+  std::map<std::tuple<int,int,int>, size_t> mVolumeOfGlobalIndex;
 
   for(unsigned int i=0; i!=vfilename.size(); i++)
   {
@@ -59,28 +66,20 @@ std::vector<SingleVolume> GetFilesNeedSaving(
 
     if( GetIndexFromFileName(sFileName, GlobalIndex, LocalIndex) )
     {
-      bool bFlag = false;
-      for(unsigned int i=0;i!=vVolumes.size();i++)
-      {
-        if(vVolumes[i].GlobalIndex.x == GlobalIndex.x &&
-           vVolumes[i].GlobalIndex.y == GlobalIndex.y &&
-           vVolumes[i].GlobalIndex.z == GlobalIndex.z)
-        {
-          vVolumes[i].vLocalIndex.push_back(LocalIndex);
-          vVolumes[i].vFileName.push_back(sFileName);
-          bFlag=true;
-        }
-      }
+      const std::tuple<int,int,int> Key(GlobalIndex.x, GlobalIndex.y, GlobalIndex.z);
+      std::map<std::tuple<int,int,int>, size_t>::iterator it =
+          mVolumeOfGlobalIndex.find(Key);
 
-      if(bFlag==false)
+      if(it == mVolumeOfGlobalIndex.end())
       {
         SingleVolume mSingVolume;
         mSingVolume.GlobalIndex = GlobalIndex;
-        mSingVolume.vLocalIndex.push_back(LocalIndex);
-        mSingVolume.vFileName.push_back(sFileName);
+        it = mVolumeOfGlobalIndex.insert(std::make_pair(Key, vVolumes.size())).first;
         vVolumes.push_back(mSingVolume);
       }
 
+      vVolumes[it->second].vLocalIndex.push_back(LocalIndex);
+      vVolumes[it->second].vFileName.push_back(sFileName);
     }
     else
     {
@@ -92,130 +91,568 @@ std::vector<SingleVolume> GetFilesNeedSaving(
   return vVolumes;
 }
 
-// Generate one single mesh from several ppm files.
-bool SaveMeshFromPXMs(
-    std::string                sDirName,
-    std::string                sBBFileHead,
-    int3                       nVolRes,
-    int                        nGridRes,
-    std::vector<std::string>   vfilename,
-    std::string                sMeshFileName)
+///////////////////////////////////////////////////////////////////////////////
+///                     Streaming mesh of global volumes                    ///
+///////////////////////////////////////////////////////////////////////////////
+// The global volumes are meshed in batches that fit in the memory budget. The
+// volumes of a batch are loaded and meshed in parallel, then written to the
+// output file in order and released, so only one batch of grids and meshes is
+// ever held in memory.
+//
+// Neighbouring global volumes share their boundary voxel layer, so a crossing
+// on a boundary edge is produced by both volumes. The writer welds those by
+// keying each boundary vertex on its edge in the global voxel lattice.
+
+namespace {
+
+// the mesh of a single global volume, ready to be streamed out
+struct GlobalVolumeMesh
 {
-  printf("\n---- [Kangaroo/SaveMeshFromPXMs] Start.\n");
+  MarchingCUBERst                 Mesh;
+  std::vector<int4>               vVertexEdges;
+  int                             nGridNum;
+  bool                            bSuccess;
+};
+
+// approximate host memory needed to mesh a global volume: its grids plus
+// roughly the same again for the marching cubes output
+size_t GetVolumeMemoryBytes(
+    const SingleVolume&            rVolume,
+    const SingleVolume*            pColorVolume,
+    int                            nGridRes)
+{
+  const size_t nGridVoxels = static_cast<size_t>(nGridRes) * nGridRes * nGridRes;
+  size_t nBytes = rVolume.vFileName.size() * nGridVoxels * sizeof(SDF_t_Smart);
+  if(pColorVolume)
+  {
+    nBytes += pColorVolume->vFileName.size() * nGridVoxels * sizeof(float);
+  }
+  return 2 * nBytes;
+}
 
-  // 1 ---------------------------------------------------------------------------
-  // read all grid sdf and sort them into volumes. vVolume index is global index
-  std::vector<SingleVolume>  vVolumes = GetFilesNeedSaving(vfilename);
+bool MeshGlobalVolume(
+    const std::string&             sDirName,
+    const std::string&             sBBFileHead,
+    int3                           nVolRes,
+    int                            nGridRes,
+    const SingleVolume&            rVolume,
+    const SingleVolume*            pColorVolume,
+    GlobalVolumeMesh&              rVolumeMesh)
+{
+  rVolumeMesh.nGridNum = 0;
 
-  if(vVolumes.size()<=0)
+  // load the corresponding bounding box
+  std::string sBBFileName =
+      sDirName + sBBFileHead +
+      std::to_string(rVolume.GlobalIndex.x) + "#" +
+      std::to_string(rVolume.GlobalIndex.y) + "#" +
+      std::to_string(rVolume.GlobalIndex.z);
+
+  if( CheckIfBBfileExist(sBBFileName) == false )
   {
-    printf("[Kangaroo/SaveMeshFromPXMs] Cannot find any files for generating the mesh!\n");
+    std::cerr<<"[Kangaroo/SaveMeshFromPXMs] Error! Fail loading bbox "<<
+               sBBFileName<<std::endl;
     return false;
   }
 
-  // prepare data structure for the single mesh
-  MarchingCUBERst ObjMesh;
+  // NOTICE that this is the GLOBAL bounding box, not the local one.
+  roo::BoundingBox BBox = LoadPXMBoundingBox(sBBFileName);
 
-  // 2 ---------------------------------------------------------------------------
-  // For each global volume we have, gen mesh with it
-  int nTotalSaveGridNum = 0;
+  roo::BoundedVolumeGrid<roo::SDF_t_Smart,roo::TargetHost,roo::Manage> hVol;
+  hVol.Init(nVolRes.x, nVolRes.y, nVolRes.z, nGridRes, BBox);
+
+  // a 1x1x1 color volume has no grid and disables color
+  roo::BoundedVolumeGrid<float, roo::TargetHost, roo::Manage> hColorVol;
+  if(pColorVolume)
+  {
+    hColorVol.Init(nVolRes.x, nVolRes.y, nVolRes.z, nGridRes, BBox);
+  }
+  else
+  {
+    hColorVol.Init(1,1,1, nGridRes, BBox);
+  }
+
+  bool bSuccess = true;
+
+  // for each single grid volume live in the global bounding box
+  for(unsigned int j=0; j!=rVolume.vLocalIndex.size() && bSuccess; j++)
+  {
+    int3 LocalIndex = rVolume.vLocalIndex[j];
+    int nRealIndex = hVol.ConvertLocalIndexToRealIndex(
+          LocalIndex.x, LocalIndex.y,LocalIndex.z);
+
+    std::string sPXMFile = sDirName + rVolume.vFileName[j];
+    if(LoadPXMSingleGrid(sPXMFile, hVol.m_GridVolumes[nRealIndex]) == false )
+    {
+      std::cerr<<"[Kangaroo/SaveMeshFromPXMs] Error! load "<<sPXMFile<<" fail."<<std::endl;
+      bSuccess = false;
+    }
+  }
+
+  for(unsigned int j=0; pColorVolume && j!=pColorVolume->vLocalIndex.size() && bSuccess; j++)
+  {
+    int3 LocalIndex = pColorVolume->vLocalIndex[j];
+    int nRealIndex = hColorVol.ConvertLocalIndexToRealIndex(
+          LocalIndex.x, LocalIndex.y,LocalIndex.z);
+
+    std::string sPXMGrayFile = sDirName + pColorVolume->vFileName[j];
+    if(LoadPXMSingleGrid(sPXMGrayFile, hColorVol.m_GridVolumes[nRealIndex]) == false )
+    {
+      std::cerr<<"[Kangaroo/SaveMeshFromPXMs] Error! load "<<sPXMGrayFile<<" fail."<<std::endl;
+      bSuccess = false;
+    }
+  }
+
+  if(bSuccess)
+  {
+    for(unsigned int i=0; i!=hVol.m_nTotalGridRes; i++)
+    {
+      if(hVol.CheckIfBasicSDFActive(i))
+      {
+        rVolumeMesh.nGridNum++;
+      }
+    }
+
+    GenMeshGridParallel(hVol, hColorVol, rVolumeMesh.Mesh, 0.0f,
+                        &rVolumeMesh.vVertexEdges);
+  }
+
+  hVol.FreeMemory();
+  hColorVol.FreeMemory();
+
+  return bSuccess;
+}
+
+// writes vertices and triangles as they come. Obj is written in place; for
+// binary ply the triangles go to a side file that is appended on Close() and
+// the element counts are patched into the fixed width header. A writer that is
+// not closed successfully removes its output, so a failed export never leaves
+// a mesh behind that looks complete.
+class MeshStreamWriter
+{
+public:
+  MeshStreamWriter()
+    : m_pFile(NULL), m_pFaceFile(NULL), m_bColor(false), m_nVertexNum(0),
+      m_nFaceNum(0), m_nVertexCountPos(0), m_nFaceCountPos(0) {}
+
+  ~MeshStreamWriter()
+  {
+    Abort();
+  }
 
-  for(unsigned int i=0; i!=vVolumes.size(); i++)
+  // vVolumes are all volumes that will be appended, their neighbourhood
+  // decides when the seam vertices of a volume can be forgotten
+  bool Open(const std::string& sFileName, const std::string& sFormat,
+            int3 nVolRes, bool bColor, const std::vector<SingleVolume>& vVolumes)
   {
-      std::cout<<"[Kangaroo/SaveMeshFromPXMs] Merging grids in global bb area ("<<
-                 std::to_string(vVolumes[i].GlobalIndex.x)<<","<<
-                 std::to_string(vVolumes[i].GlobalIndex.y)<<","<<
-                 std::to_string(vVolumes[i].GlobalIndex.z)<<")"<< std::endl;
+    m_sFileName = sFileName + "." + sFormat;
+    m_sFormat   = sFormat;
+    m_nVolRes   = nVolRes;
+    m_bColor    = bColor;
 
-      int nSingleLoopSaveGridNum = 0;
+    for(unsigned int i=0; i!=vVolumes.size(); i++)
+    {
+      m_mSeamVolume[GetVolumeKey(vVolumes[i].GlobalIndex)] = SeamVolume();
+    }
+
+    if(m_sFormat != "obj" && m_sFormat != "ply")
+    {
+      std::cerr<<"[MeshStreamWriter] Error! Unsupport format "<<m_sFormat<<std::endl;
+      return false;
+    }
 
-      // load the corresponding bounding box
-      std::string sBBFileName =
-          sDirName + sBBFileHead +
-          std::to_string(vVolumes[i].GlobalIndex.x) + "#" +
-          std::to_string(vVolumes[i].GlobalIndex.y) + "#" +
-          std::to_string(vVolumes[i].GlobalIndex.z);
+    m_pFile = fopen(m_sFileName.c_str(), "wb");
+    if(m_pFile == NULL)
+    {
+      std::cerr<<"[MeshStreamWriter] Error! Cannot open "<<m_sFileName<<std::endl;
+      return false;
+    }
 
-      if( CheckIfBBfileExist(sBBFileName) )
+    if(m_sFormat == "ply")
+    {
+      m_sFaceFileName = m_sFileName + ".faces";
+      m_pFaceFile = fopen(m_sFaceFileName.c_str(), "w+b");
+      if(m_pFaceFile == NULL)
       {
-        // 1, --------------------------------------------------------------------
-        // load the bounxing box of the sdf.
-        // NOTICE that this is the GLOBAL bounding box, not the local one.
-        // To load it from disk, we need to use host volume
-        roo::BoundingBox BBox = LoadPXMBoundingBox(sBBFileName);
+        std::cerr<<"[MeshStreamWriter] Error! Cannot open "<<m_sFaceFileName<<std::endl;
+        Abort();
+        return false;
+      }
 
-        roo::BoundedVolumeGrid<roo::SDF_t_Smart,roo::TargetHost,roo::Manage> hVol;
-        hVol.Init(nVolRes.x, nVolRes.y, nVolRes.z, nGridRes, BBox);
+      fprintf(m_pFile,"ply\n");
+      fprintf(m_pFile,"format binary_little_endian 1.0\n");
+      fprintf(m_pFile,"comment Kangaroo SaveMeshFromPXMs\n");
+      fprintf(m_pFile,"element vertex ");
+      m_nVertexCountPos = ftell(m_pFile);
+      fprintf(m_pFile,"%010u\n", 0u);
+      fprintf(m_pFile,"property float x\n");
+      fprintf(m_pFile,"property float y\n");
+      fprintf(m_pFile,"property float z\n");
+      fprintf(m_pFile,"property float nx\n");
+      fprintf(m_pFile,"property float ny\n");
+      fprintf(m_pFile,"property float nz\n");
+      if(m_bColor)
+      {
+        fprintf(m_pFile,"property uchar red\n");
+        fprintf(m_pFile,"property uchar green\n");
+        fprintf(m_pFile,"property uchar blue\n");
+        fprintf(m_pFile,"property uchar alpha\n");
+      }
+      fprintf(m_pFile,"element face ");
+      m_nFaceCountPos = ftell(m_pFile);
+      fprintf(m_pFile,"%010u\n", 0u);
+      fprintf(m_pFile,"property list uchar int vertex_indices\n");
+      fprintf(m_pFile,"end_header\n");
+    }
 
-        roo::BoundedVolumeGrid<float, roo::TargetHost, roo::Manage> hVolColor;
-        hVolColor.Init(1,1,1, nGridRes, BBox);
+    return true;
+  }
 
-        // 2, --------------------------------------------------------------------
-        // for each single grid volume live in the global bounding box
-        for(unsigned int j=0; j!=vVolumes[i].vLocalIndex.size(); j++)
+  // append the mesh of the global volume GlobalIndex
+  void Append(const GlobalVolumeMesh& rVolumeMesh, int3 GlobalIndex)
+  {
+    const MarchingCUBERst& rMesh = rVolumeMesh.Mesh;
+    const int3 nLast = make_int3(m_nVolRes.x-1, m_nVolRes.y-1, m_nVolRes.z-1);
+    SeamVolume& rSeam = m_mSeamVolume[GetVolumeKey(GlobalIndex)];
+
+    std::vector<unsigned int> vRemap(rMesh.verts.size());
+
+    for(size_t i=0; i!=rMesh.verts.size(); i++)
+    {
+      const int4 e = rVolumeMesh.vVertexEdges[i];
+
+      // vertices on the boundary layer are shared with the neighbour volume
+      if(e.x == 0 || e.y == 0 || e.z == 0 ||
+         e.x == nLast.x || e.y == nLast.y || e.z == nLast.z)
+      {
+        const uint64_t nKey = GetLatticeKey(
+              GlobalIndex.x * nLast.x + e.x,
+              GlobalIndex.y * nLast.y + e.y,
+              GlobalIndex.z * nLast.z + e.z, e.w);
+
+        std::pair<std::unordered_map<uint64_t, unsigned int>::iterator, bool> it =
+            m_mSeamVertex.insert(std::make_pair(nKey, m_nVertexNum));
+
+        if(it.second == false)
         {
-          int3 LocalIndex = vVolumes[i].vLocalIndex[j];
+          vRemap[i] = it.first->second;
+          continue;
+        }
+        rSeam.vKey.push_back(nKey);
+      }
 
-          int nRealIndex = hVol.ConvertLocalIndexToRealIndex(
-                LocalIndex.x, LocalIndex.y,LocalIndex.z);
+      vRemap[i] = m_nVertexNum++;
+      WriteVertex(rMesh, i);
+    }
 
-          std::string sPXMFile = sDirName + vVolumes[i].vFileName[j];
+    for(size_t f=0; f!=rMesh.faces.size(); f++)
+    {
+      const aiFace& face = rMesh.faces[f];
+      WriteFace(vRemap[face.mIndices[0]], vRemap[face.mIndices[1]],
+                vRemap[face.mIndices[2]]);
+    }
 
-          // load the grid volume
-          if(LoadPXMSingleGrid(sPXMFile, hVol.m_GridVolumes[nRealIndex]) == false )
+    // a seam vertex is only looked up by the volumes around its owner, once
+    // all of them are written it is dropped
+    rSeam.bAppended = true;
+    for(int dz=-1; dz<=1; dz++)
+      for(int dy=-1; dy<=1; dy++)
+        for(int dx=-1; dx<=1; dx++)
+        {
+          const int3 n = make_int3(GlobalIndex.x+dx, GlobalIndex.y+dy, GlobalIndex.z+dz);
+          std::map<std::tuple<int,int,int>, SeamVolume>::iterator it =
+              m_mSeamVolume.find(GetVolumeKey(n));
+          if(it != m_mSeamVolume.end() && it->second.bAppended &&
+             !it->second.vKey.empty() && CheckIfNeighboursAppended(n))
           {
-            std::cerr<<"[Kangaroo/SaveMeshFromPXMs] Error! load file fail.. exit."<<std::endl;
-            return false;
+            for(size_t k=0; k!=it->second.vKey.size(); k++)
+            {
+              m_mSeamVertex.erase(it->second.vKey[k]);
+            }
+            std::vector<uint64_t>().swap(it->second.vKey);
           }
         }
+  }
+
+  // close and remove everything written so far
+  void Abort()
+  {
+    if(m_pFaceFile)
+    {
+      fclose(m_pFaceFile);
+      m_pFaceFile = NULL;
+      remove(m_sFaceFileName.c_str());
+    }
+    if(m_pFile)
+    {
+      fclose(m_pFile);
+      m_pFile = NULL;
+      remove(m_sFileName.c_str());
+      std::cerr<<"[MeshStreamWriter] Mesh export abort, removed "<<m_sFileName<<std::endl;
+    }
+  }
+
+  bool Close()
+  {
+    bool bSuccess = true;
+
+    if(m_sFormat == "ply")
+    {
+      // append the triangles after the vertices
+      rewind(m_pFaceFile);
+      std::vector<char> vBuffer(1<<20);
+      size_t nRead;
+      while( (nRead = fread(&vBuffer[0], 1, vBuffer.size(), m_pFaceFile)) > 0 )
+      {
+        bSuccess &= fwrite(&vBuffer[0], 1, nRead, m_pFile) == nRead;
+      }
+      fclose(m_pFaceFile);
+      m_pFaceFile = NULL;
+      remove(m_sFaceFileName.c_str());
+
+      fseek(m_pFile, m_nVertexCountPos, SEEK_SET);
+      fprintf(m_pFile,"%010u", m_nVertexNum);
+      fseek(m_pFile, m_nFaceCountPos, SEEK_SET);
+      fprintf(m_pFile,"%010u", m_nFaceNum);
+    }
+
+    bSuccess &= ferror(m_pFile) == 0;
+    bSuccess &= fclose(m_pFile) == 0;
+    m_pFile = NULL;
 
-        // 3, --------------------------------------------------------------------
-        // for each grid in the whole volume
-        for(unsigned int i=0;i!=hVol.m_nGridNum_w;i++)
+    if(bSuccess)
+    {
+      std::cout<<"[MeshStreamWriter] Mesh export success. File Name "<<m_sFileName<<
+                 ", "<<m_nVertexNum<<" vertices, "<<m_nFaceNum<<" faces."<<std::endl;
+    }
+    else
+    {
+      remove(m_sFileName.c_str());
+      std::cerr<<"[MeshStreamWriter] Mesh export fail, removed "<<m_sFileName<<std::endl;
+    }
+    return bSuccess;
+  }
+
+private:
+  struct SeamVolume
+  {
+    SeamVolume() : bAppended(false) {}
+    bool                  bAppended;
+    std::vector<uint64_t> vKey;       // seam vertices this volume wrote first
+  };
+
+  static std::tuple<int,int,int> GetVolumeKey(int3 g)
+  {
+    return std::make_tuple(g.x, g.y, g.z);
+  }
+
+  bool CheckIfNeighboursAppended(int3 g) const
+  {
+    for(int dz=-1; dz<=1; dz++)
+      for(int dy=-1; dy<=1; dy++)
+        for(int dx=-1; dx<=1; dx++)
         {
-          for(unsigned int j=0;j!=hVol.m_nGridNum_h;j++)
+          std::map<std::tuple<int,int,int>, SeamVolume>::const_iterator it =
+              m_mSeamVolume.find(std::make_tuple(g.x+dx, g.y+dy, g.z+dz));
+          if(it != m_mSeamVolume.end() && it->second.bAppended == false)
           {
-            for(unsigned int k=0;k!=hVol.m_nGridNum_d;k++)
-            {
-              if(hVol.CheckIfBasicSDFActive(hVol.ConvertLocalIndexToRealIndex(i,j,k)))
-              {
-                int3 CurLocalIndex = make_int3(i,j,k);
+            return false;
+          }
+        }
+    return true;
+  }
+
+  // 20 bits per axis (offset to be positive) and 2 bits for the edge axis
+  static uint64_t GetLatticeKey(int x, int y, int z, int a)
+  {
+    const int nOffset = 1<<19;
+    return (static_cast<uint64_t>(x + nOffset) << 42) |
+           (static_cast<uint64_t>(y + nOffset) << 22) |
+           (static_cast<uint64_t>(z + nOffset) << 2 ) |
+            static_cast<uint64_t>(a);
+  }
 
-                GenMeshSingleGrid(hVol, hVolColor, CurLocalIndex, ObjMesh.verts,
-                                  ObjMesh.norms, ObjMesh.faces, ObjMesh.colors);
+  void WriteVertex(const MarchingCUBERst& rMesh, size_t i)
+  {
+    const aiVector3D& v = rMesh.verts[i];
+    const aiVector3D& n = rMesh.norms[i];
 
-                nTotalSaveGridNum++;
-                nSingleLoopSaveGridNum ++;
-              }
-            }
-          }
+    if(m_sFormat == "obj")
+    {
+      fprintf(m_pFile, "v %f %f %f\n", v.x, v.y, v.z);
+      fprintf(m_pFile, "vn %f %f %f\n", n.x, n.y, n.z);
+    }
+    else
+    {
+      fwrite(&v, sizeof(aiVector3D), 1, m_pFile);
+      fwrite(&n, sizeof(aiVector3D), 1, m_pFile);
+      if(m_bColor)
+      {
+        // same conversion as PLYModel::PLYWrite, black if the volume has no
+        // color
+        unsigned char c[4] = {0, 0, 0, 255};
+        if(i < rMesh.colors.size())
+        {
+          c[0] = static_cast<unsigned char>(rMesh.colors[i][0]);
+          c[1] = static_cast<unsigned char>(rMesh.colors[i][1]);
+          c[2] = static_cast<unsigned char>(rMesh.colors[i][2]);
         }
+        fwrite(c, sizeof(c), 1, m_pFile);
+      }
+    }
+  }
+
+  void WriteFace(unsigned int a, unsigned int b, unsigned int c)
+  {
+    if(m_sFormat == "obj")
+    {
+      fprintf(m_pFile, "f %u//%u %u//%u %u//%u\n", a+1, a+1, b+1, b+1, c+1, c+1);
+    }
+    else
+    {
+      const unsigned char nSides = 3;
+      const int anIndex[3] = {static_cast<int>(a), static_cast<int>(b),
+                              static_cast<int>(c)};
+      fwrite(&nSides, sizeof(unsigned char), 1, m_pFaceFile);
+      fwrite(anIndex, sizeof(anIndex), 1, m_pFaceFile);
+    }
+    m_nFaceNum++;
+  }
+
+  std::string                                   m_sFileName;
+  std::string                                   m_sFaceFileName;
+  std::string                                   m_sFormat;
+  FILE*                                         m_pFile;
+  FILE*                                         m_pFaceFile;
+  int3                                          m_nVolRes;
+  bool                                          m_bColor;
+  unsigned int                                  m_nVertexNum;
+  unsigned int                                  m_nFaceNum;
+  long                                          m_nVertexCountPos;
+  long                                          m_nFaceCountPos;
+  std::unordered_map<uint64_t, unsigned int>    m_mSeamVertex;
+  std::map<std::tuple<int,int,int>, SeamVolume> m_mSeamVolume;
+};
+
+bool SaveMeshFromVolumes(
+    const std::string&                  sDirName,
+    const std::string&                  sBBFileHead,
+    int3                                nVolRes,
+    int                                 nGridRes,
+    const std::vector<SingleVolume>&    vVolumes,
+    const std::vector<const SingleVolume*>& vColorVolumes,
+    const std::string&                  sMeshFileName,
+    const std::string&                  sFormat,
+    size_t                              nMemoryBudget)
+{
+  const bool bColor = !vColorVolumes.empty();
 
-        // 4, --------------------------------------------------------------------
-        // reset grid
-        roo::SdfReset(hVol);
-        hVol.ResetAllGridVol();
+  MeshStreamWriter Writer;
+  if(Writer.Open(sMeshFileName, sFormat, nVolRes, bColor, vVolumes) == false)
+  {
+    return false;
+  }
+
+  int nTotalSaveGridNum = 0;
+  size_t nBegin = 0;
+
+  while(nBegin != vVolumes.size())
+  {
+    // 1, ------------------------------------------------------------------------
+    // take as many volumes as fit in the budget, at least one
+    size_t nEnd = nBegin;
+    size_t nBatchBytes = 0;
+    while(nEnd != vVolumes.size())
+    {
+      const size_t nBytes = GetVolumeMemoryBytes(
+            vVolumes[nEnd], bColor ? vColorVolumes[nEnd] : NULL, nGridRes);
+      if(nEnd != nBegin && nBatchBytes + nBytes > nMemoryBudget)
+      {
+        break;
       }
-      else
+      nBatchBytes += nBytes;
+      nEnd++;
+    }
+
+    std::cout<<"[Kangaroo/SaveMeshFromPXMs] Meshing global volumes "<<nBegin<<
+               " to "<<nEnd-1<<" of "<<vVolumes.size()<<" (~"<<
+               (nBatchBytes>>20)<<" MB)."<<std::endl;
+
+    // 2, ------------------------------------------------------------------------
+    // load and mesh the batch, one volume per task. A single volume is meshed
+    // directly so that its grids are processed in parallel instead.
+    std::vector<GlobalVolumeMesh> vMeshes(nEnd - nBegin);
+
+    auto MeshVolume = [&](size_t i) {
+      vMeshes[i].bSuccess = MeshGlobalVolume(
+            sDirName, sBBFileHead, nVolRes, nGridRes, vVolumes[nBegin+i],
+            bColor ? vColorVolumes[nBegin+i] : NULL, vMeshes[i]);
+    };
+
+    if(vMeshes.size() == 1)
+    {
+      MeshVolume(0);
+    }
+    else
+    {
+      ParallelFor(0, vMeshes.size(), MeshVolume);
+    }
+
+    // 3, ------------------------------------------------------------------------
+    // stream the batch to disk in volume order and release it
+    for(size_t i=0; i!=vMeshes.size(); i++)
+    {
+      if(vMeshes[i].bSuccess == false)
       {
-        std::cerr<<"[Kangaroo/SaveMeshFromPXMs] Error! Fail loading bbox "<<
-                   sBBFileName<<std::endl;
+        Writer.Abort();
         return false;
       }
 
-      std::cout<<"[Kangaroo/SaveMeshFromPXMs] Finish merge "<<nSingleLoopSaveGridNum<<
-                 " grids."<<std::endl;
+      Writer.Append(vMeshes[i], vVolumes[nBegin+i].GlobalIndex);
+      nTotalSaveGridNum += vMeshes[i].nGridNum;
+
+      std::cout<<"[Kangaroo/SaveMeshFromPXMs] Finish merge "<<vMeshes[i].nGridNum<<
+                 " grids in global bb area ("<<
+                 vVolumes[nBegin+i].GlobalIndex.x<<","<<
+                 vVolumes[nBegin+i].GlobalIndex.y<<","<<
+                 vVolumes[nBegin+i].GlobalIndex.z<<")"<<std::endl;
+    }
+
+    nBegin = nEnd;
   }
 
   std::cout<<"[Kangaroo/SaveMeshFromPXMs] Finish marching cube for " <<
              nTotalSaveGridNum<< " Grids.\n";
 
-  // 3 ---------------------------------------------------------------------------
-  // Save mesh from memory to hard disk
-  aiMesh* mesh = MeshFromListsVector(ObjMesh.verts, ObjMesh.norms,
-                                     ObjMesh.faces, ObjMesh.colors);
+  return Writer.Close();
+}
+
+}
+
+// Generate one single mesh from several ppm files.
+bool SaveMeshFromPXMs(
+    std::string                sDirName,
+    std::string                sBBFileHead,
+    int3                       nVolRes,
+    int                        nGridRes,
+    std::vector<std::string>   vfilename,
+    std::string                sMeshFileName,
+    size_t                     nMemoryBudget)
+{
+  printf("\n---- [Kangaroo/SaveMeshFromPXMs] Start.\n");
+
+  // read all grid sdf and sort them into volumes. vVolume index is global index
+  std::vector<SingleVolume>  vVolumes = GetFilesNeedSaving(vfilename);
+
+  if(vVolumes.size()<=0)
+  {
+    printf("[Kangaroo/SaveMeshFromPXMs] Cannot find any files for generating the mesh!\n");
+    return false;
+  }
 
-  return SaveMeshGridToFileAssimp(sMeshFileName, mesh, "obj");
+  return SaveMeshFromVolumes(sDirName, sBBFileHead, nVolRes, nGridRes, vVolumes,
+                             std::vector<const SingleVolume*>(), sMeshFileName,
+                             "obj", nMemoryBudget);
 }
 
 
@@ -227,11 +664,11 @@ bool SaveMeshFromPXMs(
     int                        nGridRes,
     std::vector<std::string>   vGridsFilename,
     std::vector<std::string>   vGridsGrayFilename,
-    std::string                sMeshFileName)
+    std::string                sMeshFileName,
+    size_t                     nMemoryBudget)
 {
   printf("\n---- [Kangaroo/SaveMeshFromPXMs] Start Color Version.\n");
 
-  // 1 ---------------------------------------------------------------------------
   // read all grid sdf and sort them into volumes. vVolume index is global index
   std::vector<SingleVolume>  vGridVolumes = GetFilesNeedSaving(vGridsFilename);
   std::vector<SingleVolume>  vGridGrayVolumes = GetFilesNeedSaving(vGridsGrayFilename);
@@ -248,128 +685,32 @@ bool SaveMeshFromPXMs(
     return false;
   }
 
-  // prepare data structure for the single mesh
-  MarchingCUBERst ObjMesh;
-
-  // 2 ---------------------------------------------------------------------------
-  // For each global volume we have, gen mesh with it
-  int nTotalSaveGridNum = 0;
+  // pair every volume with the color volume of the same global index
+  std::map<std::tuple<int,int,int>, const SingleVolume*> mGrayVolume;
+  for(unsigned int i=0; i!=vGridGrayVolumes.size(); i++)
+  {
+    const int3& g = vGridGrayVolumes[i].GlobalIndex;
+    mGrayVolume[std::make_tuple(g.x, g.y, g.z)] = &vGridGrayVolumes[i];
+  }
 
+  std::vector<const SingleVolume*> vColorVolumes(vGridVolumes.size());
   for(unsigned int i=0; i!=vGridVolumes.size(); i++)
   {
-      std::cout<<"[Kangaroo/SaveMeshFromPXMs] Merging grids in global bb area ("<<
-                 std::to_string(vGridVolumes[i].GlobalIndex.x)<<","<<
-                 std::to_string(vGridVolumes[i].GlobalIndex.y)<<","<<
-                 std::to_string(vGridVolumes[i].GlobalIndex.z)<<")"<< std::endl;
-
-      int nSingleLoopSaveGridNum = 0;
-
-      // load the corresponding bounding box
-      std::string sBBFileName =
-          sDirName + sBBFileHead +
-          std::to_string(vGridVolumes[i].GlobalIndex.x) + "#" +
-          std::to_string(vGridVolumes[i].GlobalIndex.y) + "#" +
-          std::to_string(vGridVolumes[i].GlobalIndex.z);
-
-      if( CheckIfBBfileExist(sBBFileName) )
-      {
-        // 1, --------------------------------------------------------------------
-        // load the bounxing box of the sdf.
-        // NOTICE that this is the GLOBAL bounding box, not the local one.
-        // To load it from disk, we need to use host volume
-        roo::BoundingBox BBox = LoadPXMBoundingBox(sBBFileName);
-        GpuCheckErrors();
-        roo::BoundedVolumeGrid<roo::SDF_t_Smart,roo::TargetHost,roo::Manage> hVol;
-        hVol.Init(nVolRes.x, nVolRes.y, nVolRes.z, nGridRes, BBox);
-        GpuCheckErrors();
-        roo::BoundedVolumeGrid<float, roo::TargetHost, roo::Manage> hColorVol;
-        hColorVol.Init(nVolRes.x, nVolRes.y, nVolRes.z, nGridRes, BBox);
-        GpuCheckErrors();
-        // 2, --------------------------------------------------------------------
-        // for each single grid volume live in the global bounding box
-        for(unsigned int j=0; j!=vGridVolumes[i].vLocalIndex.size(); j++)
-        {
-          int3 LocalIndex = vGridVolumes[i].vLocalIndex[j];
-
-          int nRealIndex = hVol.ConvertLocalIndexToRealIndex(
-                LocalIndex.x, LocalIndex.y,LocalIndex.z);
-
-          std::string sPXMFile = sDirName + vGridVolumes[i].vFileName[j];
-
-          // load the grid volume
-          if(LoadPXMSingleGrid(sPXMFile, hVol.m_GridVolumes[nRealIndex]) == false )
-          {
-            std::cerr<<"[Kangaroo/SaveMeshFromPXMs] Error! load "<<sPXMFile<<" fail. exit."<<std::endl;
-            return false;
-          }
-
-          std::string sPXMGrayFile = sDirName + vGridGrayVolumes[i].vFileName[j];
-
-          if(LoadPXMSingleGrid(sPXMGrayFile, hColorVol.m_GridVolumes[nRealIndex]) == false )
-          {
-            std::cerr<<"[Kangaroo/SaveMeshFromPXMs] Error! load "<<sPXMGrayFile<<" fail. exit."<<std::endl;
-            return false;
-          }
-        }
-
-        // 3, --------------------------------------------------------------------
-        // for each grid in the whole volume
-        for(unsigned int i=0;i!=hVol.m_nGridNum_w;i++)
-        {
-          for(unsigned int j=0;j!=hVol.m_nGridNum_h;j++)
-          {
-            for(unsigned int k=0;k!=hVol.m_nGridNum_d;k++)
-            {
-              if(hVol.CheckIfBasicSDFActive(hVol.ConvertLocalIndexToRealIndex(i,j,k)))
-              {
-                int3 CurLocalIndex = make_int3(i,j,k);
-
-                GenMeshSingleGrid(hVol, hColorVol, CurLocalIndex, ObjMesh.verts,
-                                  ObjMesh.norms, ObjMesh.faces, ObjMesh.colors);
-
-                nTotalSaveGridNum++;
-                nSingleLoopSaveGridNum ++;
-              }
-            }
-          }
-        }
-
-        // 4, --------------------------------------------------------------------
-        // reset grid
-        GpuCheckErrors();
-        roo::SdfReset(hVol);
-        hVol.ResetAllGridVol();
-
-        roo::SdfReset(hColorVol);
-        hColorVol.ResetAllGridVol();
-
-        GpuCheckErrors();
-      }
-      else
-      {
-        std::cerr<<"[Kangaroo/SaveMeshFromPXMs] Error! Fail loading bbox "<<
-                   sBBFileName<<std::endl;
-        return false;
-      }
-
-      std::cout<<"[Kangaroo/SaveMeshFromPXMs] Finish merge "<<nSingleLoopSaveGridNum<<
-                 " grids."<<std::endl;
+    const int3& g = vGridVolumes[i].GlobalIndex;
+    std::map<std::tuple<int,int,int>, const SingleVolume*>::const_iterator it =
+        mGrayVolume.find(std::make_tuple(g.x, g.y, g.z));
+    if(it == mGrayVolume.end())
+    {
+      printf("[Kangaroo/SaveMeshFromPXMs] Grid and Color Grid Size MisMatch!\n");
+      return false;
+    }
+    vColorVolumes[i] = it->second;
   }
 
-  std::cout<<"[Kangaroo/SaveMeshFromPXMs] Finish marching cube for " <<
-             nTotalSaveGridNum<< " Grids.\n";
-
-  // 3 ---------------------------------------------------------------------------
-  // Save mesh from memory to hard disk
-  //  aiMesh* mesh = MeshFromListsVector(ObjMesh.verts, ObjMesh.norms,
-  //                                     ObjMesh.faces, ObjMesh.colors);
-
   // to keep color for the mesh, we have to save it as ply format
-  //  return SaveMeshGridToFileAssimp(sMeshFileName, mesh, "ply");
-  //  return SaveMeshGridToFile(sMeshFileName, mesh, "ply");
-  return SaveMeshGridToFile(sMeshFileName, ObjMesh.verts, ObjMesh.norms,
-                            ObjMesh.faces, ObjMesh.colors, "ply");
-
+  return SaveMeshFromVolumes(sDirName, sBBFileHead, nVolRes, nGridRes,
+                             vGridVolumes, vColorVolumes, sMeshFileName,
+                             "ply", nMemoryBudget);
 }
 
 
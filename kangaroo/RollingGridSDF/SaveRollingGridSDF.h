@@ -33,15 +33,21 @@ bool GetIndexFromFileName(
 std::vector<SingleVolume> GetFilesNeedSaving(
     std::vector<std::string>&     vfilename);
 
+// Mesh all grids in vGridsFilename into one mesh, streamed to
+// sMeshFileName.obj. Global volumes are loaded and meshed in parallel batches
+// of at most nMemoryBudget bytes (a single larger volume still runs alone) and
+// vertices on the seams between neighbouring volumes are welded. Returns false
+// and removes the output if any volume fails to load or the write fails.
 bool SaveMeshFromPXMs(
     std::string                   sDirName,
     std::string                   sBBFileHead,
     int3                          nVolRes,
     int                           nGridRes,
     std::vector<std::string>      vGridsFilename,
-    std::string                   sMeshFileName);
-
+    std::string                   sMeshFileName,
+    size_t                        nMemoryBudget = size_t(4)<<30);
 
+// as above with color, streamed to sMeshFileName.ply
 bool SaveMeshFromPXMs(
     std::string                   sDirName,
     std::string                   sBBFileHead,
@@ -49,7 +55,8 @@ bool SaveMeshFromPXMs(
     int                           nGridRes,
     std::vector<std::string>      vGridsFilename,
     std::vector<std::string>      vGridsGrayFilename,
-    std::string                   sMeshFileName);
+    std::string                   sMeshFileName,
+    size_t                        nMemoryBudget = size_t(4)<<30);
 
 }
 
@@ -0,0 +1,662 @@
+// by lu.ma@colorado.edu
+
+#pragma once
+
+#include <vector>
+#include <cstring>
+
+#include "VolumeGrid.h"
+#include "kangaroo/BoundingBox.h"
+#include "kangaroo/Sdf.h"
+#include "SdfSmart.h"
+#include "kangaroo/launch_utils.h"
+
+namespace roo
+{
+
+// =============================================================================
+// A SparseVolumeGrid is an alternative to BoundedVolumeGrid for large scenes.
+// Instead of a fixed array of MAX_SUPPORT_GRID_NUM grid volumes it keeps
+// - a pool of equally sized blocks (n_res^3 voxels each) in one allocation,
+//   which grows on demand, so memory is proportional to the observed surface;
+// - a spatial hash (open addressing, linear probing) from block coordinate to
+//   block slot in the pool.
+// Voxel access (Get, GetUnitsTrilinearClamped, ...) has the same semantics as
+// BoundedVolumeGrid: voxel / world coordinates are relative to m_bbox and a
+// missing block reads as NaN. Block coordinates are the local block index
+// plus m_block_offset, so rolling the volume is a change of offset and
+// doesn't move any data.
+//
+// The struct only holds pointers and sizes, so it is small enough to pass
+// to kernels by value. The hash table is edited on the host; call SyncTable()
+// after a batch of InitBlock / FreeBlock calls before launching kernels.
+// The grid owns its pool and table, so Init / FreeMemory need Manage (the
+// default); the blocks and table come from and go back to the Target's pool.
+// =============================================================================
+
+struct SparseBlockEntry
+{
+  int x;
+  int y;
+  int z;
+  int slot; // < 0 if the entry is empty
+};
+
+template<typename T, typename Target = TargetDevice, typename Management = Manage>
+class SparseVolumeGrid
+{
+public:
+
+  // ===========================================================================
+  // no constructor, for the same reason as BoundedVolumeGrid. Call Init first
+  // and FreeMemory when done.
+  // ===========================================================================
+  inline __host__
+  void Init(
+      unsigned int       n_w,   // num of voxels of the volume in width
+      unsigned int       n_h,   // num of voxels of the volume in height
+      unsigned int       n_d,   // num of voxels of the volume in depth
+      unsigned int       n_res, // resolution of a single block, e.g. 16, 32
+      const BoundingBox& r_bbox,
+      unsigned int       n_init_blocks = 64)
+  {
+    m_w = n_w; m_h = n_h; m_d = n_d;
+
+    m_bbox           = r_bbox;
+    m_nVolumeGridRes = n_res;
+
+    m_nGridNum_w     = m_w/m_nVolumeGridRes;
+    m_nGridNum_h     = m_h/m_nVolumeGridRes;
+    m_nGridNum_d     = m_d/m_nVolumeGridRes;
+
+    m_nBlockSize     = n_res * n_res * n_res;
+    m_block_offset   = make_int3(0,0,0);
+
+    m_pBlocks        = 0;
+    m_pTable         = 0;
+    m_pHostTable     = 0;
+    m_pFreeSlots     = 0;
+    m_nCapacity      = 0;
+    m_nTableMask     = 0;
+    m_nActiveBlocks  = 0;
+    m_nFreeSlots     = 0;
+    m_bTableDirty    = false;
+
+    Allocate(n_init_blocks > 0 ? n_init_blocks : 1);
+
+    if(n_w != n_h || n_h != n_d || n_w!=n_d)
+    {
+      std::cerr<<"[SparseVolumeGrid/init] suggest use cube size SDF!"<<std::endl;
+    }
+  }
+
+  // free all blocks and the hash table
+  inline __host__
+  void FreeMemory()
+  {
+    Management::template Cleanup<T,Target>(m_pBlocks);
+    if(m_pTable != m_pHostTable)
+    {
+      Management::template Cleanup<SparseBlockEntry,Target>(m_pTable);
+    }
+    delete[] m_pHostTable;
+    delete[] m_pFreeSlots;
+
+    m_pBlocks       = 0;
+    m_pTable        = 0;
+    m_pHostTable    = 0;
+    m_pFreeSlots    = 0;
+    m_nCapacity     = 0;
+    m_nTableMask    = 0;
+    m_nActiveBlocks = 0;
+    m_nFreeSlots    = 0;
+  }
+
+  //////////////////////////////////////////////////////
+  // Dimensions
+  //////////////////////////////////////////////////////
+
+  inline __device__ __host__
+  float3 SizeUnits() const
+  {
+    return m_bbox.Size();
+  }
+
+  inline __device__ __host__
+  float3 VoxelSizeUnits() const
+  {
+    return m_bbox.Size() / make_float3( m_w-1, m_h-1, m_d-1 );
+  }
+
+  inline __device__ __host__
+  uint3 Voxels() const
+  {
+    return make_uint3(m_w,m_h,m_d);
+  }
+
+  //////////////////////////////////////////////////////
+  // Block table
+  //////////////////////////////////////////////////////
+
+  inline __device__ __host__
+  static unsigned int HashBlock(int x, int y, int z)
+  {
+    return (static_cast<unsigned int>(x) * 73856093u) ^
+           (static_cast<unsigned int>(y) * 19349663u) ^
+           (static_cast<unsigned int>(z) * 83492791u);
+  }
+
+  // block coordinate of local block index (the index BoundedVolumeGrid uses)
+  inline __device__ __host__
+  int3 GetBlockCoord(int x, int y, int z) const
+  {
+    return make_int3(x,y,z) + m_block_offset;
+  }
+
+  // slot of block, or -1 if block is not active
+  inline __device__ __host__
+  int FindSlot(int3 block) const
+  {
+#ifdef __CUDA_ARCH__
+    const SparseBlockEntry* table = m_pTable;
+#else
+    const SparseBlockEntry* table = m_pHostTable;
+#endif
+    unsigned int i = HashBlock(block.x, block.y, block.z) & m_nTableMask;
+
+    for(unsigned int n = 0; n <= m_nTableMask; n++)
+    {
+      const SparseBlockEntry& e = table[i];
+      if(e.slot < 0)
+      {
+        return -1;
+      }
+      if(e.x == block.x && e.y == block.y && e.z == block.z)
+      {
+        return e.slot;
+      }
+      i = (i+1) & m_nTableMask;
+    }
+    return -1;
+  }
+
+  inline __device__ __host__
+  bool CheckIfBlockActive(int3 block) const
+  {
+    return FindSlot(block) >= 0;
+  }
+
+  inline __device__ __host__
+  bool CheckIfVoxelExist(int x, int y, int z) const
+  {
+    return FindSlot( GetBlockCoord(x/m_nVolumeGridRes,
+                                   y/m_nVolumeGridRes,
+                                   z/m_nVolumeGridRes) ) >= 0;
+  }
+
+  inline __host__
+  int GetActiveGridVolNum() const
+  {
+    return m_nActiveBlocks;
+  }
+
+  inline __host__
+  bool IsValid() const
+  {
+    return m_nActiveBlocks > 0 && m_w > 0 && m_h > 0 && m_d > 0;
+  }
+
+  // view of a single block, usable like a grid volume of BoundedVolumeGrid
+  inline __device__ __host__
+  VolumeGrid<T,Target,DontManage> GetBlockVolume(int slot) const
+  {
+    VolumeGrid<T,Target,DontManage> vol;
+    vol.ptr       = m_pBlocks + static_cast<size_t>(slot) * m_nBlockSize;
+    vol.w         = m_nVolumeGridRes;
+    vol.h         = m_nVolumeGridRes;
+    vol.d         = m_nVolumeGridRes;
+    vol.pitch     = m_nVolumeGridRes * sizeof(T);
+    vol.img_pitch = vol.pitch * m_nVolumeGridRes;
+    return vol;
+  }
+
+  // host list of all active block coordinates
+  inline __host__
+  void GetActiveBlocks(std::vector<int3>& vBlocks) const
+  {
+    vBlocks.clear();
+    for(unsigned int i = 0; i <= m_nTableMask; i++)
+    {
+      const SparseBlockEntry& e = m_pHostTable[i];
+      if(e.slot >= 0)
+      {
+        vBlocks.push_back(make_int3(e.x, e.y, e.z));
+      }
+    }
+  }
+
+  // ===========================================================================
+  // add block to the table, drawing a slot from the pool. Returns its slot.
+  // Block content is not initialized (same as VolumeGrid::InitVolume).
+  // ===========================================================================
+  inline __host__
+  int InitBlock(int3 block)
+  {
+    int slot = FindSlot(block);
+    if(slot >= 0)
+    {
+      return slot;
+    }
+
+    if(m_nFreeSlots == 0)
+    {
+      Reserve(2 * m_nCapacity);
+    }
+
+    slot = m_pFreeSlots[--m_nFreeSlots];
+    InsertEntry(m_pHostTable, m_nTableMask, block, slot);
+    m_nActiveBlocks++;
+    m_bTableDirty = true;
+    return slot;
+  }
+
+  inline __host__
+  int InitSingleBasicSDFWithGridIndex(unsigned int x, unsigned int y, unsigned int z)
+  {
+    return InitBlock( GetBlockCoord(x/m_nVolumeGridRes,
+                                    y/m_nVolumeGridRes,
+                                    z/m_nVolumeGridRes) );
+  }
+
+  // remove block from the table and return its slot to the pool
+  inline __host__
+  bool FreeBlock(int3 block)
+  {
+    unsigned int i = HashBlock(block.x, block.y, block.z) & m_nTableMask;
+
+    for(unsigned int n = 0; n <= m_nTableMask; n++)
+    {
+      SparseBlockEntry& e = m_pHostTable[i];
+      if(e.slot < 0)
+      {
+        return false;
+      }
+      if(e.x == block.x && e.y == block.y && e.z == block.z)
+      {
+        m_pFreeSlots[m_nFreeSlots++] = e.slot;
+        EraseEntry(i);
+        m_nActiveBlocks--;
+        m_bTableDirty = true;
+        return true;
+      }
+      i = (i+1) & m_nTableMask;
+    }
+    return false;
+  }
+
+  // upload host edits of the table to the Target (no-op for host grids)
+  inline __host__
+  void SyncTable()
+  {
+    if(m_bTableDirty && m_pTable != m_pHostTable)
+    {
+      cudaMemcpy(m_pTable, m_pHostTable, TableSize() * sizeof(SparseBlockEntry),
+                 TargetCopyKind<Target,TargetHost>());
+      GpuCheckErrors();
+    }
+    m_bTableDirty = false;
+  }
+
+  // make room for n_blocks blocks without further allocation
+  inline __host__
+  void Reserve(unsigned int n_blocks)
+  {
+    if(n_blocks <= m_nCapacity)
+    {
+      return;
+    }
+
+    SparseVolumeGrid<T,Target,Management> old = *this;
+    Allocate(n_blocks);
+
+    // move block data, slots stay the same
+    cudaMemcpy(m_pBlocks, old.m_pBlocks, old.m_nCapacity * m_nBlockSize * sizeof(T),
+               TargetCopyKind<Target,Target>());
+    GpuCheckErrors();
+
+    // re-insert entries into the larger table
+    for(unsigned int i = 0; i <= old.m_nTableMask; i++)
+    {
+      const SparseBlockEntry& e = old.m_pHostTable[i];
+      if(e.slot >= 0)
+      {
+        InsertEntry(m_pHostTable, m_nTableMask, make_int3(e.x,e.y,e.z), e.slot);
+      }
+    }
+
+    // slots beyond the old capacity are free, used slots are not
+    m_nFreeSlots = 0;
+    for(unsigned int s = m_nCapacity; s > old.m_nCapacity; s--)
+    {
+      m_pFreeSlots[m_nFreeSlots++] = s-1;
+    }
+    for(unsigned int s = old.m_nFreeSlots; s > 0; s--)
+    {
+      m_pFreeSlots[m_nFreeSlots++] = old.m_pFreeSlots[s-1];
+    }
+
+    m_nActiveBlocks = old.m_nActiveBlocks;
+    m_bTableDirty   = true;
+
+    old.FreeMemory();
+  }
+
+  //////////////////////////////////////////////////////
+  // Access Elements
+  //////////////////////////////////////////////////////
+
+  inline  __device__  __host__
+  T& Get(unsigned int x,unsigned int y, unsigned int z)
+  {
+    const int slot = FindSlot( GetBlockCoord(x/m_nVolumeGridRes,
+                                             y/m_nVolumeGridRes,
+                                             z/m_nVolumeGridRes) );
+
+    if(slot < 0)
+    {
+      printf("[SparseVolumeGrid] Fatal Error! Block doesn't exist. index (%d,%d,%d)\n",
+             x/m_nVolumeGridRes, y/m_nVolumeGridRes, z/m_nVolumeGridRes);
+      return m_pBlocks[0];
+    }
+
+    return m_pBlocks[ static_cast<size_t>(slot) * m_nBlockSize +
+        (x%m_nVolumeGridRes) + m_nVolumeGridRes *
+        ((y%m_nVolumeGridRes) + m_nVolumeGridRes * (z%m_nVolumeGridRes)) ];
+  }
+
+  inline  __device__
+  T& operator()(unsigned int x,unsigned int y, unsigned int z)
+  {
+    return Get(x,y,z);
+  }
+
+  // input pos_w in meter
+  inline  __device__ __host__
+  float GetUnitsTrilinearClamped(float3 pos_w) const
+  {
+    float3 pos_v_grid;
+    const int slot = GetSlotAndFraction(pos_w, pos_v_grid);
+
+    if(slot < 0)
+    {
+      return 0.0/0.0;
+    }
+
+    return GetBlockVolume(slot).GetFractionalTrilinearClamped(pos_v_grid);
+  }
+
+  inline __device__ __host__
+  float3 GetUnitsBackwardDiffDxDyDz(float3 pos_w) const
+  {
+    float3 pos_v_grid;
+    const int slot = GetSlotAndFraction(pos_w, pos_v_grid);
+
+    if(slot < 0)
+    {
+      return make_float3(0.0/0.0,0.0/0.0,0.0/0.0);
+    }
+
+    const float3 deriv = GetBlockVolume(slot).GetFractionalBackwardDiffDxDyDz(pos_v_grid);
+
+    return deriv / VoxelSizeUnits();
+  }
+
+  inline __device__ __host__
+  float3 GetUnitsOutwardNormal(float3 pos_w) const
+  {
+    const float3 deriv = GetUnitsBackwardDiffDxDyDz(pos_w);
+    return deriv / length(deriv);
+  }
+
+  inline __device__ __host__
+  float3 VoxelPositionInUnits(int x, int y, int z) const
+  {
+    return make_float3(
+          m_bbox.Min().x + m_bbox.Size().x * static_cast<float>(x)/static_cast<float>(m_w-1),
+          m_bbox.Min().y + m_bbox.Size().y * static_cast<float>(y)/static_cast<float>(m_h-1),
+          m_bbox.Min().z + m_bbox.Size().z * static_cast<float>(z)/static_cast<float>(m_d-1)
+          );
+  }
+
+  inline __device__ __host__
+  float3 VoxelPositionInUnits(int3 p_v) const
+  {
+    return VoxelPositionInUnits(p_v.x,p_v.y,p_v.z);
+  }
+
+  //////////////////////////////////////////////////////
+  // Rolling
+  //////////////////////////////////////////////////////
+
+  // move the window of the volume by cur_shift blocks. No data is moved;
+  // blocks that fall out of the window stay in the table until freed.
+  inline __host__
+  void ShiftBlockOffset(int3 cur_shift)
+  {
+    m_block_offset = m_block_offset + cur_shift;
+  }
+
+  // free all blocks that are outside of the current window
+  inline __host__
+  int FreeBlocksOutsideWindow()
+  {
+    std::vector<int3> vBlocks;
+    GetActiveBlocks(vBlocks);
+
+    int nNum = 0;
+    for(size_t i = 0; i != vBlocks.size(); i++)
+    {
+      const int3 local = vBlocks[i] - m_block_offset;
+      if(local.x < 0 || local.x >= static_cast<int>(m_nGridNum_w) ||
+         local.y < 0 || local.y >= static_cast<int>(m_nGridNum_h) ||
+         local.z < 0 || local.z >= static_cast<int>(m_nGridNum_d) )
+      {
+        FreeBlock(vBlocks[i]);
+        nNum++;
+      }
+    }
+    return nNum;
+  }
+
+  //////////////////////////////////////////////////////
+  // Copy
+  //////////////////////////////////////////////////////
+
+  // make this grid a copy of rVol (table, blocks and window). Memory is
+  // reallocated if the capacities differ.
+  template<typename TargetFrom, typename ManagementFrom>
+  inline __host__
+  void CopyFrom(const SparseVolumeGrid<T, TargetFrom, ManagementFrom>& rVol)
+  {
+    if(m_nVolumeGridRes != rVol.m_nVolumeGridRes)
+    {
+      printf("[SparseVolumeGrid] Error! Cannot copy from grid with different block resolution!\n");
+      exit(-1);
+    }
+
+    if(m_nCapacity != rVol.m_nCapacity)
+    {
+      FreeMemory();
+      Allocate(rVol.m_nCapacity);
+    }
+
+    m_w = rVol.m_w; m_h = rVol.m_h; m_d = rVol.m_d;
+    m_bbox           = rVol.m_bbox;
+    m_block_offset   = rVol.m_block_offset;
+    m_nActiveBlocks  = rVol.m_nActiveBlocks;
+    m_nFreeSlots     = rVol.m_nFreeSlots;
+
+    memcpy(m_pHostTable, rVol.m_pHostTable, TableSize() * sizeof(SparseBlockEntry));
+    memcpy(m_pFreeSlots, rVol.m_pFreeSlots, m_nCapacity * sizeof(int));
+
+    cudaMemcpy(m_pBlocks, rVol.m_pBlocks, m_nCapacity * m_nBlockSize * sizeof(T),
+               TargetCopyKind<Target,TargetFrom>());
+    GpuCheckErrors();
+
+    m_bTableDirty = true;
+    SyncTable();
+  }
+
+  inline __host__
+  unsigned int TableSize() const
+  {
+    return m_nTableMask + 1;
+  }
+
+protected:
+  inline __device__ __host__
+  int GetSlotAndFraction(float3 pos_w, float3& pos_v_grid) const
+  {
+    /// get pose of voxel in whole sdf, in %
+    float3 pos_v = (pos_w - m_bbox.Min()) / (m_bbox.Size());
+
+    if(pos_v.x>=1) { pos_v.x =0.99999f; }
+    else if(pos_v.x<0) { pos_v.x =0.f; }
+
+    if(pos_v.y>=1) { pos_v.y =0.99999f; }
+    else if(pos_v.y<0) { pos_v.y =0.f; }
+
+    if(pos_v.z>=1) { pos_v.z =0.99999f; }
+    else if(pos_v.z<0) { pos_v.z =0.f; }
+
+    const float fFactor = static_cast<float>(m_nVolumeGridRes)/static_cast<float>(m_w);
+
+    // Get the index of voxel in basic sdf
+    const int3 Index = make_int3( floorf(pos_v.x/fFactor),
+                                  floorf(pos_v.y/fFactor),
+                                  floorf(pos_v.z/fFactor) );
+
+    /// get axis.
+    pos_v_grid = make_float3( fmod(pos_v.x, fFactor) /fFactor,
+                              fmod(pos_v.y, fFactor) /fFactor,
+                              fmod(pos_v.z, fFactor) /fFactor );
+
+    return FindSlot( GetBlockCoord(Index.x, Index.y, Index.z) );
+  }
+
+  // allocate pool for n_blocks blocks and an empty table, load factor <= 0.5
+  inline __host__
+  void Allocate(unsigned int n_blocks)
+  {
+    size_t pitch = 0;
+    Management::template AllocatePitchedMem<T,Target>(
+          &m_pBlocks, &pitch, static_cast<size_t>(n_blocks) * m_nBlockSize, 1);
+
+    unsigned int nTableSize = 16;
+    while(nTableSize < 2*n_blocks)
+    {
+      nTableSize *= 2;
+    }
+
+    m_pHostTable = new SparseBlockEntry[nTableSize];
+    for(unsigned int i = 0; i != nTableSize; i++)
+    {
+      m_pHostTable[i].slot = -1;
+    }
+
+    if(TargetCopyKind<Target,TargetHost>() == cudaMemcpyHostToHost)
+    {
+      m_pTable = m_pHostTable;
+    }
+    else
+    {
+      Management::template AllocatePitchedMem<SparseBlockEntry,Target>(
+            &m_pTable, &pitch, nTableSize, 1);
+    }
+
+    m_pFreeSlots = new int[n_blocks];
+    m_nFreeSlots = 0;
+    for(unsigned int s = n_blocks; s > 0; s--)
+    {
+      m_pFreeSlots[m_nFreeSlots++] = s-1;
+    }
+
+    m_nCapacity     = n_blocks;
+    m_nTableMask    = nTableSize - 1;
+    m_nActiveBlocks = 0;
+    m_bTableDirty   = true;
+  }
+
+  inline __host__
+  static void InsertEntry(SparseBlockEntry* table, unsigned int mask, int3 block, int slot)
+  {
+    unsigned int i = HashBlock(block.x, block.y, block.z) & mask;
+    while(table[i].slot >= 0)
+    {
+      i = (i+1) & mask;
+    }
+    table[i].x = block.x;
+    table[i].y = block.y;
+    table[i].z = block.z;
+    table[i].slot = slot;
+  }
+
+  // backward shift deletion, keeps probe sequences intact without tombstones
+  inline __host__
+  void EraseEntry(unsigned int i)
+  {
+    unsigned int j = i;
+    while(true)
+    {
+      j = (j+1) & m_nTableMask;
+      if(m_pHostTable[j].slot < 0)
+      {
+        break;
+      }
+
+      const SparseBlockEntry& e = m_pHostTable[j];
+      const unsigned int k = HashBlock(e.x, e.y, e.z) & m_nTableMask;
+
+      // move entry j into the hole at i unless its home k lies cyclically in (i,j]
+      const bool bInRange = (i <= j) ? (i < k && k <= j) : (i < k || k <= j);
+      if(!bInRange)
+      {
+        m_pHostTable[i] = m_pHostTable[j];
+        i = j;
+      }
+    }
+    m_pHostTable[i].slot = -1;
+  }
+
+public:
+  size_t        m_w;               // value usually 128, 256
+  size_t        m_h;               // value usually 128, 256
+  size_t        m_d;               // value usually 128, 256
+
+  BoundingBox   m_bbox;            // bounding box of the volume window
+
+  // block coordinate of local block (0,0,0). Changed when rolling the volume
+  int3          m_block_offset;
+
+  unsigned int  m_nVolumeGridRes;  // resolution of a block e.g. 8, 16, 32
+  unsigned int  m_nGridNum_w;      // num of blocks of the window in x
+  unsigned int  m_nGridNum_h;      // num of blocks of the window in y
+  unsigned int  m_nGridNum_d;      // num of blocks of the window in z
+
+  size_t        m_nBlockSize;      // num of voxels in a block
+
+  T*            m_pBlocks;         // pool of m_nCapacity blocks in Target memory
+  unsigned int  m_nCapacity;       // num of blocks the pool can hold
+  unsigned int  m_nActiveBlocks;   // num of blocks in use
+
+  SparseBlockEntry* m_pTable;      // hash table in Target memory
+  SparseBlockEntry* m_pHostTable;  // host copy of hash table, edited by host
+  unsigned int  m_nTableMask;      // table size - 1, table size is a power of 2
+
+  int*          m_pFreeSlots;      // host stack of unused block slots
+  unsigned int  m_nFreeSlots;
+
+  bool          m_bTableDirty;     // host table differs from m_pTable
+};
+
+}
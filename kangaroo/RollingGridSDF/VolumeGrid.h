@@ -29,6 +29,29 @@ namespace roo
 // When access VolumeGrid(x,y,z), we will return the volume in that single volume.
 // The VolumeGrid itself works like a "volume manager".
 
+// Manage-d blocks come and go as the grid rolls, so they are drawn from the
+// Target's pool. DontManage grids allocate straight from the Target and the
+// caller frees them, as before pooling.
+template<typename Management>
+struct VolumeGridAllocator
+{
+  template<typename T, typename Target> inline static __host__
+  void AllocatePitchedMem(T** ptr, size_t* pitch, size_t* img_pitch, size_t w, size_t h, size_t d)
+  {
+    Target::template AllocatePitchedMem<T>(ptr,pitch,img_pitch,w,h,d);
+  }
+};
+
+template<>
+struct VolumeGridAllocator<Manage>
+{
+  template<typename T, typename Target> inline static __host__
+  void AllocatePitchedMem(T** ptr, size_t* pitch, size_t* img_pitch, size_t w, size_t h, size_t d)
+  {
+    Manage::template AllocatePitchedMem<T,Target>(ptr,pitch,img_pitch,w,h,d);
+  }
+};
+
 template<typename T, typename Target = TargetDevice, typename Management = DontManage>
 struct VolumeGrid
 {
@@ -36,12 +59,13 @@ struct VolumeGrid
   void CleanUp()
   {
     Management::template Cleanup<T,Target>(ptr);
+    ptr = 0;
   }
 
   inline __host__
   void InitVolume(unsigned int n_w, unsigned int n_h, unsigned int n_d)
   {
-    Target::template AllocatePitchedMem<T>(&ptr,&pitch,&img_pitch,n_w,n_h,n_d);
+    VolumeGridAllocator<Management>::template AllocatePitchedMem<T,Target>(&ptr,&pitch,&img_pitch,n_w,n_h,n_d);
 
     w = n_w;
     h = n_h;
@@ -1,6 +1,7 @@
 // by lu.ma@colorado.edu
 
 #include "cu_raycast_grid.h"
+#include "GridBlockTable.h"
 
 namespace roo
 {
@@ -28,9 +29,12 @@ float PhongShade(const float3 p_c, const float3 n_c)
 //////////////////////////////////////////////////////
 // Raycast grid gray SDF
 //////////////////////////////////////////////////////
-__device__ BoundedVolumeGrid<SDF_t, roo::TargetDevice, roo::Manage>        g_vol;
-__device__ BoundedVolumeGrid<SDF_t_Smart, roo::TargetDevice, roo::Manage>  g_vol_smart;
-__device__ BoundedVolumeGrid<float, roo::TargetDevice, roo::Manage>        g_grayVol;
+__device__ GridBlockTable<SDF_t>        g_vol;
+static GridBlockTableCache<SDF_t>        g_volTable;
+__device__ GridBlockTable<SDF_t_Smart>  g_vol_smart;
+static GridBlockTableCache<SDF_t_Smart>  g_vol_smartTable;
+__device__ GridBlockTable<float>        g_grayVol;
+static GridBlockTableCache<float>        g_grayVolTable;
 
 
 
@@ -123,7 +127,7 @@ void RaycastSdf(
     float trunc_dist, bool subpix )
 {
   // load vol val to golbal memory
-  cudaMemcpyToSymbol(g_vol, &vol, sizeof(vol), size_t(0), cudaMemcpyHostToDevice);
+  UploadGridBlockTable(g_vol, g_volTable, vol);
   GpuCheckErrors();
 
   dim3 blockDim, gridDim;
@@ -132,8 +136,6 @@ void RaycastSdf(
   KernRaycastSdfGrid<<<gridDim,blockDim>>>(depth, norm, img, T_wc, K, near, far,
                                            trunc_dist, subpix);
   GpuCheckErrors();
-
-  g_vol.FreeMemory();
 }
 
 
@@ -224,8 +226,8 @@ void RaycastSdf(
     float trunc_dist, bool subpix )
 {
   // load vol val to golbal memory
-  cudaMemcpyToSymbol(g_vol, &vol, sizeof(vol), size_t(0), cudaMemcpyHostToDevice);
-  cudaMemcpyToSymbol(g_grayVol, &grayVol, sizeof(grayVol), size_t(0), cudaMemcpyHostToDevice);
+  UploadGridBlockTable(g_vol, g_volTable, vol);
+  UploadGridBlockTable(g_grayVol, g_grayVolTable, grayVol);
   GpuCheckErrors();
 
   dim3 blockDim, gridDim;
@@ -233,9 +235,6 @@ void RaycastSdf(
   KernRaycastSdfGridGray<<<gridDim,blockDim>>>(depth, norm, img, T_wc, K, near,
                                                far, trunc_dist, subpix);
   GpuCheckErrors();
-
-  g_vol.FreeMemory();
-  g_grayVol.FreeMemory();
 }
 
 
@@ -328,7 +327,7 @@ void RaycastSdf(
     ImageIntrinsics K, float near, float far, float trunc_dist, bool subpix )
 {
   // load vol val to golbal memory
-  cudaMemcpyToSymbol(g_vol_smart, &vol, sizeof(vol), size_t(0), cudaMemcpyHostToDevice);
+  UploadGridBlockTable(g_vol_smart, g_vol_smartTable, vol);
   GpuCheckErrors();
 
   dim3 blockDim, gridDim;
@@ -337,8 +336,6 @@ void RaycastSdf(
   KernRaycastSdfGridSmart<<<gridDim,blockDim>>>(depth, norm, img, T_wc, K, near,
                                                 far, trunc_dist, subpix);
   GpuCheckErrors();
-
-  g_vol_smart.FreeMemory();
 }
 
 
@@ -430,8 +427,8 @@ void RaycastSdf(
 {
   GpuCheckErrors();
   // load vol val to golbal memory
-  cudaMemcpyToSymbol(g_vol_smart, &vol, sizeof(vol), size_t(0), cudaMemcpyHostToDevice);
-  cudaMemcpyToSymbol(g_grayVol, &grayVol, sizeof(grayVol), size_t(0), cudaMemcpyHostToDevice);
+  UploadGridBlockTable(g_vol_smart, g_vol_smartTable, vol);
+  UploadGridBlockTable(g_grayVol, g_grayVolTable, grayVol);
   GpuCheckErrors();
 
   dim3 blockDim, gridDim;
@@ -439,9 +436,6 @@ void RaycastSdf(
   KernRaycastSdfGridGraySmart<<<gridDim,blockDim>>>(depth, norm, img, T_wc, K,
                                                     near, far, trunc_dist, subpix);
   GpuCheckErrors();
-
-  g_vol_smart.FreeMemory();
-  g_grayVol.FreeMemory();
 }
 
 }
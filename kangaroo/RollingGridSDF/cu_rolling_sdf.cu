@@ -2,6 +2,7 @@
 
 #include "cu_rolling_sdf.h"
 #include "BoundedVolumeGrid.h"
+#include "GridBlockTable.h"
 #include "kangaroo/MatUtils.h"
 #include "kangaroo/launch_utils.h"
 
@@ -67,16 +68,24 @@ void SdfResetPartial(BoundedVolume<SDF_t> vol, float3 shift)
 //////////////////////////////////////////////////////
 /// Rolling GRID SDF
 //////////////////////////////////////////////////////
-__device__ BoundedVolumeGrid<SDF_t, roo::TargetDevice, roo::Manage>        g_vol;
-__device__ BoundedVolumeGrid<SDF_t_Smart, roo::TargetDevice, roo::Manage>  g_vol_smart;
+__device__ GridBlockTable<SDF_t>        g_vol;
+static GridBlockTableCache<SDF_t>        g_volTable;
+__device__ GridBlockTable<SDF_t_Smart>  g_vol_smart;
+static GridBlockTableCache<SDF_t_Smart>  g_vol_smartTable;
 __device__ int                                                             g_NextResetSDFs[MAX_SUPPORT_GRID_NUM];
 
+// descriptor of the grid the rolling kernels run on, by voxel type
+template<typename T> __device__ inline GridBlockTable<T>& RollingGridVol();
+template<> __device__ inline GridBlockTable<SDF_t>& RollingGridVol<SDF_t>() { return g_vol; }
+template<> __device__ inline GridBlockTable<SDF_t_Smart>& RollingGridVol<SDF_t_Smart>() { return g_vol_smart; }
+
 // =============================================================================
 // Boxmin & boxmax define the box that is to be kept intact, rest will be cleared.
 // This approach makes if conditions inside simpler.
 // When we clean a grid sdf, we also need to free its memory.. This maybe a little
 // bit expensive
 // =============================================================================
+template<typename T>
 __global__ void KernRollingGridSdf(
     float3                                boxmin,
     float3                                boxmax,
@@ -84,11 +93,12 @@ __global__ void KernRollingGridSdf(
 {
   const int x = blockIdx.x*blockDim.x + threadIdx.x;
   const int y = blockIdx.y*blockDim.y + threadIdx.y;
+  const GridBlockTable<T>& rVol = RollingGridVol<T>();
 
   // For each voxel (x,y,z) we have in a bounded volume
-  for(int z=0; z < g_vol.m_d; ++z)
+  for(int z=0; z < rVol.m_d; ++z)
   {
-    const float3 P_w = g_vol.VoxelPositionInUnits(x,y,z);
+    const float3 P_w = rVol.VoxelPositionInUnits(x,y,z);
 
     bool mincrit, maxcrit;//if mincrit and maxcrit are true, point is inside the box, i.e. valid.
     mincrit = P_w.x > boxmin.x && P_w.y > boxmin.y && P_w.z > boxmin.z;
@@ -96,12 +106,12 @@ __global__ void KernRollingGridSdf(
 
     if(!mincrit || !maxcrit)//i.e. the point is outside the box.
     {
-      g_vol(x,y,z) = SDF_t(0.0/0.0,0.0);
+      rVol(x,y,z) = T(0.0/0.0,0.0);
 
       // get the index of grid sdf that need to be reseted
-      int nIndex = static_cast<int>(floorf(x/g_vol.m_nVolumeGridRes)) +
-          g_vol.m_nGridNum_w * ( static_cast<int>(floorf(y/g_vol.m_nVolumeGridRes)) +
-                                 g_vol.m_nGridNum_h * static_cast<int>(floorf(z/g_vol.m_nVolumeGridRes)) );
+      int nIndex = static_cast<int>(floorf(x/rVol.m_nVolumeGridRes)) +
+          rVol.m_nGridNum_w * ( static_cast<int>(floorf(y/rVol.m_nVolumeGridRes)) +
+                                rVol.m_nGridNum_h * static_cast<int>(floorf(z/rVol.m_nVolumeGridRes)) );
 
       // save index of sdf that need to be reset later
       g_NextResetSDFs[nIndex] = 1;
@@ -122,7 +132,7 @@ void RollingGridSdfCuda(
     BoundedVolumeGrid<SDF_t>              vol,
     int3                                  shift)
 {
-  cudaMemcpyToSymbol(g_vol, &vol, sizeof(vol), size_t(0), cudaMemcpyHostToDevice);
+  UploadGridBlockTable(g_vol, g_volTable, vol);
   GpuCheckErrors();
 
   // 1, Compute the latest bounding box
@@ -152,7 +162,7 @@ void RollingGridSdfCuda(
   // 2, Kernel functin. Initialization for GPU parallelization
   //  dim3 blockDim(16,16);
   //  dim3 gridDim(vol.m_w / blockDim.x, vol.m_h / blockDim.y);
-  //  KernRollingGridSdf<<<gridDim,blockDim>>>(bb_min, bb_max, shift);
+  //  KernRollingGridSdf<SDF_t><<<gridDim,blockDim>>>(bb_min, bb_max, shift);
   //  GpuCheckErrors();
 
 
@@ -171,9 +181,6 @@ void RollingGridSdfCuda(
   // reset index
   cudaMemcpyToSymbol(g_NextResetSDFs,nNextResetSDFs,sizeof(nNextResetSDFs),0,cudaMemcpyHostToDevice);
 
-  // for each grid sdf that need to be reset, free it.
-  g_vol.FreeMemory();
-
   // reset
   for(int i=0;i!=vol.GetTotalGridNum();i++)
   {
@@ -189,7 +196,7 @@ void RollingGridSdfCuda(
     BoundedVolumeGrid<SDF_t_Smart>        vol,
     int3                                  shift)
 {
-  cudaMemcpyToSymbol(g_vol, &vol, sizeof(vol), size_t(0), cudaMemcpyHostToDevice);
+  UploadGridBlockTable(g_vol_smart, g_vol_smartTable, vol);
   GpuCheckErrors();
 
   // 1, Compute the latest bounding box
@@ -219,7 +226,7 @@ void RollingGridSdfCuda(
   // 2, Kernel functin. Initialization for GPU parallelization
   //  dim3 blockDim(16,16);
   //  dim3 gridDim(vol.m_w / blockDim.x, vol.m_h / blockDim.y);
-  //  KernRollingGridSdf<<<gridDim,blockDim>>>(bb_min, bb_max, shift);
+  //  KernRollingGridSdf<SDF_t_Smart><<<gridDim,blockDim>>>(bb_min, bb_max, shift);
   //  GpuCheckErrors();
 
   // 3, copy array back
@@ -237,9 +244,6 @@ void RollingGridSdfCuda(
   // reset index
   cudaMemcpyToSymbol(g_NextResetSDFs,nNextResetSDFs,sizeof(nNextResetSDFs),0,cudaMemcpyHostToDevice);
 
-  // for each grid sdf that need to be reset, free it.
-  g_vol.FreeMemory();
-
   // reset
   for(int i=0;i!=vol.GetTotalGridNum();i++)
   {
@@ -255,6 +259,7 @@ void RollingGridSdfCuda(
 // =============================================================================
 __device__ float3 g_positive_precentage_shift;
 __device__ float3 g_negative_precentage_shift;
+template<typename T>
 __global__ void KernDetectRollingSdfShift(
     Image<float>                                                  imgdepth,
     const Mat<float,3,4>                                          T_wc,
@@ -272,7 +277,7 @@ __global__ void KernDetectRollingSdfShift(
       const float3 T_wc_translate = SE3Translation(T_wc);
 
       // check if the pixel is out of BB. shift is the change of % of poses in BB
-      float3 cur_precentage_shift = g_vol.GetPrecentagePosInBB(ray_w, T_wc_translate);
+      float3 cur_precentage_shift = RollingGridVol<T>().GetPrecentagePosInBB(ray_w, T_wc_translate);
 
       // if shift > 1: (the current bounding box (BB) cannot hold the new pixel)
       if(abs(cur_precentage_shift.x) > 1.f)
@@ -325,7 +330,7 @@ void RollingDetShift(
     ImageIntrinsics                                               K)
 {
   // load vol val to golbal memory
-  cudaMemcpyToSymbol(g_vol, &vol, sizeof(vol), size_t(0), cudaMemcpyHostToDevice);
+  UploadGridBlockTable(g_vol, g_volTable, vol);
   GpuCheckErrors();
 
   // init the precentage shift value to 0
@@ -344,15 +349,13 @@ void RollingDetShift(
 
   dim3 blockDim, gridDim;
   InitDimFromOutputImageOver(blockDim, gridDim, depth);
-  KernDetectRollingSdfShift<<<gridDim,blockDim>>>(depth, T_wc, K);
+  KernDetectRollingSdfShift<SDF_t><<<gridDim,blockDim>>>(depth, T_wc, K);
   GpuCheckErrors();
 
   // copy the actual camera shift (in precentage) back to the host memory
   cudaMemcpyFromSymbol(&positive_shift,g_positive_precentage_shift,sizeof(positive_shift),0,cudaMemcpyDeviceToHost);
   cudaMemcpyFromSymbol(&negative_shift,g_negative_precentage_shift,sizeof(negative_shift),0,cudaMemcpyDeviceToHost);
   GpuCheckErrors();
-
-  g_vol.FreeMemory();
 }
 
 void RollingDetShift(
@@ -365,7 +368,7 @@ void RollingDetShift(
 {
 
   // load vol val to golbal memory
-  cudaMemcpyToSymbol(g_vol, &vol, sizeof(vol), size_t(0), cudaMemcpyHostToDevice);
+  UploadGridBlockTable(g_vol_smart, g_vol_smartTable, vol);
   GpuCheckErrors();
 
   // set the shift value to 0
@@ -384,14 +387,12 @@ void RollingDetShift(
 
   dim3 blockDim, gridDim;
   InitDimFromOutputImageOver(blockDim, gridDim, depth);
-  KernDetectRollingSdfShift<<<gridDim,blockDim>>>(depth, T_wc, K);
+  KernDetectRollingSdfShift<SDF_t_Smart><<<gridDim,blockDim>>>(depth, T_wc, K);
   GpuCheckErrors();
 
   cudaMemcpyFromSymbol(&positive_shift,g_positive_precentage_shift,sizeof(positive_shift),0,cudaMemcpyDeviceToHost);
   cudaMemcpyFromSymbol(&negative_shift,g_negative_precentage_shift,sizeof(negative_shift),0,cudaMemcpyDeviceToHost);
   GpuCheckErrors();
-
-  g_vol.FreeMemory();
 }
 
 }
@@ -1,6 +1,7 @@
 // by lu.ma@colorado.edu
 
 #include "cu_sdf_reset.h"
+#include "GridBlockTable.h"
 #include "kangaroo/MatUtils.h"
 #include "kangaroo/launch_utils.h"
 
@@ -10,8 +11,10 @@ namespace roo
 ///////////////////////////// For Grid SDF Fusion //////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
 
-__device__ BoundedVolumeGrid<SDF_t, roo::TargetDevice, roo::Manage>  g_vol;
-__device__ BoundedVolumeGrid<float, roo::TargetDevice, roo::Manage>  g_grayVol;
+__device__ GridBlockTable<SDF_t>  g_vol;
+static GridBlockTableCache<SDF_t>  g_volTable;
+__device__ GridBlockTable<float>  g_grayVol;
+static GridBlockTableCache<float>  g_grayVolTable;
 
 // have a large size of array to save index of grid sdf that need to init
 __device__ int                            g_NextInitSDFs[MAX_SUPPORT_GRID_NUM];
@@ -109,10 +112,10 @@ void SDFInitGrayGrid(
     exit(-1);
   }
 
-  // load grid sdf to global memory. We do this instead of pass it via function
-  // param because there is a size limit of the parameters that we can send the the kernel function.
-  cudaMemcpyToSymbol(g_vol, &vol, sizeof(vol), size_t(0), cudaMemcpyHostToDevice);
-  cudaMemcpyToSymbol(g_grayVol, &grayVol, sizeof(grayVol), size_t(0), cudaMemcpyHostToDevice);
+  // upload grid descriptors, the block tables are only sent if the set of
+  // active grids changed since the last call
+  UploadGridBlockTable(g_vol, g_volTable, vol);
+  UploadGridBlockTable(g_grayVol, g_grayVolTable, grayVol);
   GpuCheckErrors();
 
   // launch kernel for SDF fusion
@@ -141,11 +144,6 @@ void SDFInitGrayGrid(
   // reset index
   cudaMemcpyToSymbol(g_NextInitSDFs,nNextInitSDFs,sizeof(nNextInitSDFs),0,cudaMemcpyHostToDevice);
   GpuCheckErrors();
-
-  // cuda free memory
-  g_vol.FreeMemory();
-  g_grayVol.FreeMemory();
-  GpuCheckErrors();
 }
 
 // -----------------------------------------------------------------------------
@@ -239,10 +237,10 @@ void SdfFuseDirectGrayGrid(
     float trunc_dist, float max_w, float mincostheta, float min_depth
     )
 {
-  /// load grid sdf to golbal memory. We do this because there is a size limit of
-  // the parameters that we can send the the kernel function.
-  cudaMemcpyToSymbol(g_vol, &vol, sizeof(vol), size_t(0), cudaMemcpyHostToDevice);
-  cudaMemcpyToSymbol(g_grayVol, &colorVol, sizeof(colorVol), size_t(0), cudaMemcpyHostToDevice);
+  // upload grid descriptors, the block tables are only sent if the set of
+  // active grids changed since the last call
+  UploadGridBlockTable(g_vol, g_volTable, vol);
+  UploadGridBlockTable(g_grayVol, g_grayVolTable, colorVol);
   GpuCheckErrors();
 
   // launch kernel for SDF fusion
@@ -252,16 +250,6 @@ void SdfFuseDirectGrayGrid(
                                                   gray, T_iw, Krgb, trunc_dist,
                                                   max_w, mincostheta, min_depth);
   GpuCheckErrors();
-
-  // copy data back after launch the kernel
-  vol.CopyFrom(g_vol);
-  colorVol.CopyFrom(g_grayVol);
-  GpuCheckErrors();
-
-  // cuda free memory
-  g_vol.FreeMemory();
-  g_grayVol.FreeMemory();
-  GpuCheckErrors();
 }
 
 
@@ -373,10 +361,10 @@ void SdfFuseDirectGrayGridSafe(
     float trunc_dist, float max_w, float mincostheta, float min_depth
     )
 {
-  /// load grid sdf to golbal memory. We do this because there is a size limit of
-  // the parameters that we can send the the kernel function.
-  cudaMemcpyToSymbol(g_vol, &vol, sizeof(vol), size_t(0), cudaMemcpyHostToDevice);
-  cudaMemcpyToSymbol(g_grayVol, &colorVol, sizeof(colorVol), size_t(0), cudaMemcpyHostToDevice);
+  // upload grid descriptors, the block tables are only sent if the set of
+  // active grids changed since the last call
+  UploadGridBlockTable(g_vol, g_volTable, vol);
+  UploadGridBlockTable(g_grayVol, g_grayVolTable, colorVol);
   GpuCheckErrors();
 
   // launch kernel for SDF fusion
@@ -386,16 +374,6 @@ void SdfFuseDirectGrayGridSafe(
                                                       gray, T_iw, Krgb, trunc_dist,
                                                       max_w, mincostheta, min_depth);
   GpuCheckErrors();
-
-  // copy data back after launch the kernel
-  vol.CopyFrom(g_vol);
-  colorVol.CopyFrom(g_grayVol);
-  GpuCheckErrors();
-
-  // cuda free memory
-  g_vol.FreeMemory();
-  g_grayVol.FreeMemory();
-  GpuCheckErrors();
 }
 
 
@@ -524,10 +502,10 @@ void SdfFuseDirectGrayGridDesireIndex(
     exit(-1);
   }
 
-  /// load grid sdf to golbal memory. We do this because there is a size limit of
-  // the parameters that we can send the the kernel function.
-  cudaMemcpyToSymbol(g_vol, &vol, sizeof(vol), size_t(0), cudaMemcpyHostToDevice);
-  cudaMemcpyToSymbol(g_grayVol, &colorVol, sizeof(colorVol), size_t(0), cudaMemcpyHostToDevice);
+  // upload grid descriptors, the block tables are only sent if the set of
+  // active grids changed since the last call
+  UploadGridBlockTable(g_vol, g_volTable, vol);
+  UploadGridBlockTable(g_grayVol, g_grayVolTable, colorVol);
   GpuCheckErrors();
 
   // copy array back
@@ -551,16 +529,6 @@ void SdfFuseDirectGrayGridDesireIndex(
                                                              min_depth, bWeight);
   GpuCheckErrors();
 
-  // copy data back after launch the kernel
-  vol.CopyFrom(g_vol);
-  colorVol.CopyFrom(g_grayVol);
-  GpuCheckErrors();
-
-  // cuda free memory
-  g_vol.FreeMemory();
-  g_grayVol.FreeMemory();
-  GpuCheckErrors();
-
   printf("[SdfFuseDirectgrayGridDesireIndex/cu] Finished all.\n");
 }
 
@@ -689,10 +657,10 @@ void SdfFuseDirectGrayGridAutoInit(
     exit(-1);
   }
 
-  /// load grid sdf to golbal memory. We do this because there is a size limit of
-  // the parameters that we can send the the kernel function.
-  cudaMemcpyToSymbol(g_vol, &vol, sizeof(vol), size_t(0), cudaMemcpyHostToDevice);
-  cudaMemcpyToSymbol(g_grayVol, &colorVol, sizeof(colorVol), size_t(0), cudaMemcpyHostToDevice);
+  // upload grid descriptors, the block tables are only sent if the set of
+  // active grids changed since the last call
+  UploadGridBlockTable(g_vol, g_volTable, vol);
+  UploadGridBlockTable(g_grayVol, g_grayVolTable, colorVol);
   GpuCheckErrors();
 
   // launch kernel for SDF fusion
@@ -719,16 +687,6 @@ void SdfFuseDirectGrayGridAutoInit(
   // reset index
   cudaMemcpyToSymbol(g_NextInitSDFs,nNextInitSDFs,sizeof(nNextInitSDFs),0,cudaMemcpyHostToDevice);
   GpuCheckErrors();
-
-  // copy data back after launch the kernel
-  vol.CopyFrom(g_vol);
-  colorVol.CopyFrom(g_grayVol);
-  GpuCheckErrors();
-
-  // cuda free memory
-  g_vol.FreeMemory();
-  g_grayVol.FreeMemory();
-  GpuCheckErrors();
 }
 
 
@@ -859,7 +817,8 @@ void SdfFuseDirectGrayGridAutoInit(
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
 
-__device__ BoundedVolumeGrid<SDF_t_Smart, roo::TargetDevice, roo::Manage>  g_vol_smart;
+__device__ GridBlockTable<SDF_t_Smart>  g_vol_smart;
+static GridBlockTableCache<SDF_t_Smart>  g_vol_smartTable;
 
 // -----------------------------------------------------------------------------
 // do SDF fusion without consideing void (zero intensity) pixels
@@ -955,10 +914,10 @@ void SDFInitGrayGrid(
     exit(-1);
   }
 
-  // load grid sdf to global memory. We do this instead of pass it via function
-  // param because there is a size limit of the parameters that we can send the the kernel function.
-  cudaMemcpyToSymbol(g_vol_smart, &vol, sizeof(vol), size_t(0), cudaMemcpyHostToDevice);
-  cudaMemcpyToSymbol(g_grayVol, &grayVol, sizeof(grayVol), size_t(0), cudaMemcpyHostToDevice);
+  // upload grid descriptors, the block tables are only sent if the set of
+  // active grids changed since the last call
+  UploadGridBlockTable(g_vol_smart, g_vol_smartTable, vol);
+  UploadGridBlockTable(g_grayVol, g_grayVolTable, grayVol);
   GpuCheckErrors();
 
   // launch kernel for SDF fusion
@@ -983,10 +942,6 @@ void SDFInitGrayGrid(
   cudaMemcpyToSymbol(g_NextInitSDFs,nNextInitSDFs,sizeof(nNextInitSDFs),0,cudaMemcpyHostToDevice);
   GpuCheckErrors();
 
-  // cuda free global memory
-  g_vol_smart.FreeMemory();
-  g_grayVol.FreeMemory();
-  GpuCheckErrors();
 }
 
 // -----------------------------------------------------------------------------
@@ -1080,11 +1035,10 @@ void SdfFuseDirectGrayGrid(
     float trunc_dist, float max_w, float mincostheta, float min_depth
     )
 {
-  /// load grid sdf to golbal memory. We do this because there is a size limit of
-  // the parameters that we can send the the kernel function.
-  cudaMemcpyToSymbol(g_vol_smart, &vol, sizeof(vol), size_t(0), cudaMemcpyHostToDevice);
-  cudaMemcpyToSymbol(g_grayVol, &colorVol, sizeof(colorVol),
-                     size_t(0), cudaMemcpyHostToDevice);
+  // upload grid descriptors, the block tables are only sent if the set of
+  // active grids changed since the last call
+  UploadGridBlockTable(g_vol_smart, g_vol_smartTable, vol);
+  UploadGridBlockTable(g_grayVol, g_grayVolTable, colorVol);
   GpuCheckErrors();
 
   // launch kernel for SDF fusion
@@ -1094,16 +1048,6 @@ void SdfFuseDirectGrayGrid(
                                                        gray, T_iw, Krgb, trunc_dist,
                                                        max_w, mincostheta, min_depth);
   GpuCheckErrors();
-
-  // copy data back after launch the kernel
-  vol.CopyFrom(g_vol_smart);
-  colorVol.CopyFrom(g_grayVol);
-  GpuCheckErrors();
-
-  // cuda free memory
-  g_vol_smart.FreeMemory();
-  g_grayVol.FreeMemory();
-  GpuCheckErrors();
 }
 
 
@@ -1215,10 +1159,10 @@ void SdfFuseDirectGrayGridSafe(
     float trunc_dist, float max_w, float mincostheta, float min_depth
     )
 {
-  /// load grid sdf to golbal memory. We do this because there is a size limit of
-  // the parameters that we can send the the kernel function.
-  cudaMemcpyToSymbol(g_vol_smart, &vol, sizeof(vol), size_t(0), cudaMemcpyHostToDevice);
-  cudaMemcpyToSymbol(g_grayVol, &colorVol, sizeof(colorVol), size_t(0), cudaMemcpyHostToDevice);
+  // upload grid descriptors, the block tables are only sent if the set of
+  // active grids changed since the last call
+  UploadGridBlockTable(g_vol_smart, g_vol_smartTable, vol);
+  UploadGridBlockTable(g_grayVol, g_grayVolTable, colorVol);
   GpuCheckErrors();
 
   // launch kernel for SDF fusion
@@ -1230,16 +1174,6 @@ void SdfFuseDirectGrayGridSafe(
                                                            max_w, mincostheta,
                                                            min_depth);
   GpuCheckErrors();
-
-  // copy data back after launch the kernel
-  vol.CopyFrom(g_vol_smart);
-  colorVol.CopyFrom(g_grayVol);
-  GpuCheckErrors();
-
-  // cuda free memory
-  g_vol_smart.FreeMemory();
-  g_grayVol.FreeMemory();
-  GpuCheckErrors();
 }
 
 
@@ -1368,10 +1302,10 @@ void SdfFuseDirectGrayGridDesireIndex(
     exit(-1);
   }
 
-  /// load grid sdf to golbal memory. We do this because there is a size limit of
-  // the parameters that we can send the the kernel function.
-  cudaMemcpyToSymbol(g_vol_smart, &vol, sizeof(vol), size_t(0), cudaMemcpyHostToDevice);
-  cudaMemcpyToSymbol(g_grayVol, &colorVol, sizeof(colorVol), size_t(0), cudaMemcpyHostToDevice);
+  // upload grid descriptors, the block tables are only sent if the set of
+  // active grids changed since the last call
+  UploadGridBlockTable(g_vol_smart, g_vol_smartTable, vol);
+  UploadGridBlockTable(g_grayVol, g_grayVolTable, colorVol);
   GpuCheckErrors();
 
   // copy array back
@@ -1396,16 +1330,6 @@ void SdfFuseDirectGrayGridDesireIndex(
                                                                   min_depth, bWeight);
   GpuCheckErrors();
 
-  // copy data back after launch the kernel
-  vol.CopyFrom(g_vol_smart);
-  colorVol.CopyFrom(g_grayVol);
-  GpuCheckErrors();
-
-  // cuda free memory
-  g_vol_smart.FreeMemory();
-  g_grayVol.FreeMemory();
-  GpuCheckErrors();
-
   printf("[SdfFuseDirectgrayGridDesireIndex/cu] Finished all.\n");
 }
 
@@ -1533,10 +1457,10 @@ void SdfFuseDirectGrayGridAutoInit(
     exit(-1);
   }
 
-  /// load grid sdf to golbal memory. We do this because there is a size limit of
-  // the parameters that we can send the the kernel function.
-  cudaMemcpyToSymbol(g_vol_smart, &vol, sizeof(vol), size_t(0), cudaMemcpyHostToDevice);
-  cudaMemcpyToSymbol(g_grayVol, &colorVol, sizeof(colorVol), size_t(0), cudaMemcpyHostToDevice);
+  // upload grid descriptors, the block tables are only sent if the set of
+  // active grids changed since the last call
+  UploadGridBlockTable(g_vol_smart, g_vol_smartTable, vol);
+  UploadGridBlockTable(g_grayVol, g_grayVolTable, colorVol);
   GpuCheckErrors();
 
   // launch kernel for SDF fusion
@@ -1566,16 +1490,6 @@ void SdfFuseDirectGrayGridAutoInit(
   cudaMemcpyToSymbol(g_NextInitSDFs,nNextInitSDFs,sizeof(nNextInitSDFs),
                      0,cudaMemcpyHostToDevice);
   GpuCheckErrors();
-
-  // copy data back after launch the kernel
-  vol.CopyFrom(g_vol_smart);
-  colorVol.CopyFrom(g_grayVol);
-  GpuCheckErrors();
-
-  // cuda free memory
-  g_vol_smart.FreeMemory();
-  g_grayVol.FreeMemory();
-  GpuCheckErrors();
 }
 
 
@@ -1,11 +1,14 @@
 // by lu.ma@colorado.edu
 
 #include "cu_visualize_grid.h"
+#include "GridBlockTable.h"
 
 namespace roo
 {
-__device__ BoundedVolumeGrid<SDF_t_Smart, roo::TargetDevice, roo::Manage>  g_vol_grid_smart;
-__device__ BoundedVolumeGrid<float, roo::TargetDevice, roo::Manage>  g_vol_grid_gray;
+__device__ GridBlockTable<SDF_t_Smart>  g_vol_grid_smart;
+static GridBlockTableCache<SDF_t_Smart>  g_vol_grid_smartTable;
+__device__ GridBlockTable<float>  g_vol_grid_gray;
+static GridBlockTableCache<float>  g_vol_grid_grayTable;
 
 __global__ void KernVisualizeGrid()
 {
@@ -38,10 +41,10 @@ void VisualizeGrid(
     BoundedVolumeGrid<SDF_t_Smart,roo::TargetDevice, roo::Manage> vol,
     BoundedVolumeGrid<float, TargetDevice, Manage> colorVol)
 {
-  /// load grid sdf to golbal memory. We do this because there is a size limit of
-  // the parameters that we can send the the kernel function.
-  cudaMemcpyToSymbol(g_vol_grid_smart, &vol, sizeof(vol), size_t(0), cudaMemcpyHostToDevice);
-  cudaMemcpyToSymbol(g_vol_grid_gray, &colorVol, sizeof(colorVol), size_t(0), cudaMemcpyHostToDevice);
+  // upload grid descriptors, the block tables are only sent if the set of
+  // active grids changed since the last call
+  UploadGridBlockTable(g_vol_grid_smart, g_vol_grid_smartTable, vol);
+  UploadGridBlockTable(g_vol_grid_gray, g_vol_grid_grayTable, colorVol);
   GpuCheckErrors();
 
   // launch kernel for SDF fusion
@@ -49,11 +52,6 @@ void VisualizeGrid(
   dim3 gridDim(vol.m_w / blockDim.x, vol.m_h / blockDim.y);
   KernVisualizeGrid<<<gridDim,blockDim>>>();
   GpuCheckErrors();
-
-  // copy data back after launch the kernel
-  vol.CopyFrom(g_vol_grid_smart);
-  colorVol.CopyFrom(g_vol_grid_gray);
-  GpuCheckErrors();
 }
 
 }
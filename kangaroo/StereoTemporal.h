@@ -0,0 +1,87 @@
+#pragma once
+
+#include <kangaroo/platform.h>
+#include <kangaroo/Image.h>
+#include <kangaroo/CostVolRange.h>
+
+namespace roo
+{
+
+////////////////////////////////////////
+// Definition
+////////////////////////////////////////
+
+struct StereoTemporalParams
+{
+    StereoTemporalParams()
+        : maxDisp(64), sd(-1), P1(0.01f), P2(0.02f),
+          dohoriz(true), dovert(true), doreverse(true), dodiag(false),
+          radius(2), minConfidence(0.1f), maxChange(8), changeRad(2)
+    {
+    }
+
+    int maxDisp;
+    float sd;
+    float P1;
+    float P2;
+    bool dohoriz;
+    bool dovert;
+    bool doreverse;
+    bool dodiag;
+
+    // Search of reliable pixels, +-radius around the previous disparities
+    // of their 3x3 neighbourhood
+    int radius;
+
+    // Previous disparities are reliable if they passed the left right check
+    // with at least minConfidence (see CostVolDisparities) and the mean
+    // absolute change of the left image over (2*changeRad+1)^2 pixels is at
+    // most maxChange, in image units.
+    float minConfidence;
+    float maxChange;
+    int changeRad;
+};
+
+//! Census / SGM stereo for video from a static or slowly moving rig. The
+//! previous disparities are carried over to the current frame where they
+//! were confident and the image did not change, and only a narrow band
+//! around them is matched there; everywhere else gets the full search.
+//! Host (CPU) execution, see cpu_stereo_temporal.cpp
+class KANGAROO_EXPORT StereoTemporal
+{
+public:
+    StereoTemporal(int w, int h, const StereoTemporalParams& params);
+
+    // Disparities of the next frame, right view at x + sd*d, NaN where the
+    // left right check failed.
+    template<typename Timg>
+    void Process(Image<float,TargetHost> disp, const Image<Timg,TargetHost> left, const Image<Timg,TargetHost> right);
+
+    // Next frame is searched in full
+    void Reset();
+
+    // Fraction of the full disparity range matched in the last frame
+    float SearchedFraction() const;
+
+    // May change between frames, up to the maxDisp and with SGM on or off
+    // as at construction
+    StereoTemporalParams& Params();
+
+protected:
+    StereoTemporalParams params;
+    bool have_prev;
+    float searched;
+
+    Image<ulong4,TargetHostAligned,Manage> census_left;
+    Image<ulong4,TargetHostAligned,Manage> census_right;
+    CostVolRange<float,TargetHostAligned,Manage> volC;
+    CostVolRange<float,TargetHostAligned,Manage> volH;
+
+    Image<float,TargetHostAligned,Manage> prev_left;
+    Image<float,TargetHostAligned,Manage> prev_disp;
+    Image<float,TargetHostAligned,Manage> conf;
+    Image<float,TargetHostAligned,Manage> dispR;
+    Image<unsigned char,TargetHostAligned,Manage> lrcheck;
+};
+
+}
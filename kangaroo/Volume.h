@@ -32,7 +32,8 @@ struct Volume
     //////////////////////////////////////////////////////
 
     template<typename TargetFrom, typename ManagementFrom> inline __host__ __device__
-    Volume( const Volume<T,TargetFrom,ManagementFrom>& img )
+    Volume( const Volume<T,TargetFrom,ManagementFrom>& img,
+            typename EnableIf<TargetCompatible<Target,TargetFrom>::value>::type* = 0 )
         : pitch(img.pitch), ptr(img.ptr), w(img.w), h(img.h), img_pitch(img.img_pitch), d(img.d)
     {
         AssignmentCheck<Management,Target, TargetFrom>();
@@ -48,8 +49,7 @@ struct Volume
     Volume(unsigned int w, unsigned int h, unsigned int d)
         :w(w), h(h), d(d)
     {
-        Management::AllocateCheck();
-        Target::template AllocatePitchedMem<T>(&ptr,&pitch,&img_pitch,w,h,d);
+        Management::template AllocatePitchedMem<T,Target>(&ptr,&pitch,&img_pitch,w,h,d);
     }
 
     inline __device__ __host__
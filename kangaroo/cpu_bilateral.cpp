@@ -0,0 +1,367 @@
+#include "cu_bilateral.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "host_launch_utils.h"
+#include "InvalidValue.h"
+
+namespace roo
+{
+
+// Spatial weights only depend on the offset, so compute them once per call
+// instead of once per pixel and window element as the device kernel does.
+inline std::vector<float> BilateralSpatialWeights(float gs, int size)
+{
+    const int n = 2*size+1;
+    std::vector<float> sw(n*n);
+    for(int r = -size; r <= size; ++r ) {
+        for(int c = -size; c <= size; ++c ) {
+            const float sd2 = r*r + c*c;
+            sw[(r+size)*n + (c+size)] = expf(-(sd2) / (2 * gs * gs));
+        }
+    }
+    return sw;
+}
+
+/////////////////////////////////////////////////////
+// Bilateral Filter (Spatial and intensity weights)
+//////////////////////////////////////////////////////
+
+template<typename To, typename Ti>
+void BilateralFilter(
+    Image<To,TargetHost> dOut, const Image<Ti,TargetHost> dIn, float gs, float gr, uint size
+) {
+    const int s = size;
+    const int n = 2*s+1;
+    const std::vector<float> sw = BilateralSpatialWeights(gs, s);
+    const float ir = -1.0f / (2 * gr * gr);
+
+    ParallelForPixels(dOut.w, dOut.h, [&](size_t x, size_t y) {
+        const Ti p = dIn(x,y);
+        float sum = 0;
+        float sumw = 0;
+
+        for(int r = -s; r <= s; ++r ) {
+            const float* swr = &sw[(r+s)*n + s];
+            for(int c = -s; c <= s; ++c ) {
+                const Ti q = dIn.GetWithClampedRange(x+c, y+r);
+                const float id = p-q;
+                const float w = swr[c] * expf(id*id * ir);
+                sumw += w;
+                sum += w * q;
+            }
+        }
+
+        dOut(x,y) = (To)(sum / sumw);
+    });
+}
+
+template KANGAROO_EXPORT void BilateralFilter(Image<float,TargetHost>, const Image<float,TargetHost>, float, float, uint);
+template KANGAROO_EXPORT void BilateralFilter(Image<float,TargetHost>, const Image<unsigned char,TargetHost>, float, float, uint);
+
+/////////////////////////////////////////////////////
+// Bilateral Filter (Spatial and intensity weights) ignore vals below min
+//////////////////////////////////////////////////////
+
+template<typename To, typename Ti>
+void BilateralFilter(
+    Image<To,TargetHost> dOut, const Image<Ti,TargetHost> dIn, float gs, float gr, uint size, Ti minval
+) {
+    const int s = size;
+    const int n = 2*s+1;
+    const std::vector<float> sw = BilateralSpatialWeights(gs, s);
+    const float ir = -1.0f / (2 * gr * gr);
+
+    ParallelForPixels(dOut.w, dOut.h, [&](size_t x, size_t y) {
+        const Ti p = dIn(x,y);
+        float sum = 0;
+        float sumw = 0;
+
+        if( p >= minval) {
+            for(int r = -s; r <= s; ++r ) {
+                const float* swr = &sw[(r+s)*n + s];
+                for(int c = -s; c <= s; ++c ) {
+                    const Ti q = dIn.GetWithClampedRange(x+c, y+r);
+                    if(q >= minval) {
+                        const float id = p-q;
+                        const float w = swr[c] * expf(id*id * ir);
+                        sumw += w;
+                        sum += w * q;
+                    }
+                }
+            }
+        }
+
+        dOut(x,y) = (To)(sum / sumw);
+    });
+}
+
+template KANGAROO_EXPORT void BilateralFilter(Image<float,TargetHost>, const Image<float,TargetHost>, float, float, uint, float);
+template KANGAROO_EXPORT void BilateralFilter(Image<float,TargetHost>, const Image<unsigned short,TargetHost>, float, float, uint, unsigned short);
+
+/////////////////////////////////////////////////////
+// Bilateral Filter (Spatial, intensity and colour (external) weights)
+//////////////////////////////////////////////////////
+
+template<typename To, typename Ti, typename Ti2>
+void BilateralFilter(
+    Image<To,TargetHost> dOut, const Image<Ti,TargetHost> dIn, const Image<Ti2,TargetHost> dImg, float gs, float gr, float gc, uint size
+) {
+    const int s = size;
+    const int n = 2*s+1;
+    const std::vector<float> sw = BilateralSpatialWeights(gs, s);
+    const float ir = -1.0f / (2 * gr * gr);
+    const float ic = -1.0f / (2 * gc * gc);
+
+    ParallelForPixels(dOut.w, dOut.h, [&](size_t x, size_t y) {
+        const float p = dIn(x,y);
+        const float pc = dImg(x,y);
+        float sum = 0;
+        float sumw = 0;
+
+        for(int r = -s; r <= s; ++r ) {
+            const float* swr = &sw[(r+s)*n + s];
+            for(int c = -s; c <= s; ++c ) {
+                const float q = dIn.GetWithClampedRange(x+c, y+r);
+                const float qc = dImg.GetWithClampedRange(x+c, y+r);
+                const float rd = p-q;
+                const float cd = pc-qc;
+                const float w = swr[c] * expf(rd*rd*ir + cd*cd*ic);
+                sumw += w;
+                sum += w * q;
+            }
+        }
+
+        dOut(x,y) = sumw == 0 ? p : (To)(sum / sumw);
+    });
+}
+
+template KANGAROO_EXPORT void BilateralFilter(Image<float,TargetHost>, const Image<float,TargetHost>, const Image<unsigned char,TargetHost>, float, float, float, uint);
+template KANGAROO_EXPORT void BilateralFilter(Image<float,TargetHost>, const Image<float,TargetHost>, const Image<float,TargetHost>, float, float, float, uint);
+
+/////////////////////////////////////////////////////
+// Bilateral Grid (Spatial and intensity weights)
+//
+// Pixels are splatted trilinearly into a grid of (value*weight, weight)
+// sampled every gs pixels and every gr intensity units, the grid is blurred
+// by [1 4 6 4 1]/16 along each axis (a Gaussian of one cell, i.e. gs and
+// gr) and the result is sliced trilinearly at every pixel. The grid shrinks
+// with gs^2, so the cost does not grow with the spatial extent.
+//////////////////////////////////////////////////////
+
+// Empty cells around the data so blur and interpolation need no bound checks
+const int BILATERAL_GRID_PAD = 2;
+
+// Intensity cells at most, gr is coarsened for wider intensity ranges
+const int BILATERAL_GRID_MAX_DEPTH = 256;
+
+// Grids of more cells than this many times the pixels are filtered directly
+const int BILATERAL_GRID_MAX_CELLS_PER_PIXEL = 8;
+
+struct BilateralGridAll
+{
+    template<typename T>
+    inline bool operator()(T) const { return true; }
+
+    template<typename To, typename Ti>
+    void Direct(Image<To,TargetHost> dOut, const Image<Ti,TargetHost> dIn, float gs, float gr, uint size) const
+    {
+        BilateralFilter(dOut, dIn, gs, gr, size);
+    }
+};
+
+template<typename Ti>
+struct BilateralGridMin
+{
+    BilateralGridMin(Ti minval) : minval(minval) {}
+    inline bool operator()(Ti v) const { return v >= minval; }
+
+    template<typename To>
+    void Direct(Image<To,TargetHost> dOut, const Image<Ti,TargetHost> dIn, float gs, float gr, uint size) const
+    {
+        BilateralFilter(dOut, dIn, gs, gr, size, minval);
+    }
+
+    Ti minval;
+};
+
+// [1 4 6 4 1]/16 along a line of n cells, stride apart, (sum,weight) pairs
+inline void BilateralGridBlurLine(float* g, size_t stride, int n, std::vector<float>& tmp)
+{
+    tmp.resize(2*n);
+    for(int i=0; i < n; ++i) {
+        tmp[2*i] = g[i*stride];
+        tmp[2*i+1] = g[i*stride+1];
+    }
+    for(int i=0; i < n; ++i) {
+        float s = 6*tmp[2*i];
+        float w = 6*tmp[2*i+1];
+        if(i > 0)   { s += 4*tmp[2*(i-1)]; w += 4*tmp[2*(i-1)+1]; }
+        if(i < n-1) { s += 4*tmp[2*(i+1)]; w += 4*tmp[2*(i+1)+1]; }
+        if(i > 1)   { s += tmp[2*(i-2)];   w += tmp[2*(i-2)+1]; }
+        if(i < n-2) { s += tmp[2*(i+2)];   w += tmp[2*(i+2)+1]; }
+        g[i*stride] = s / 16;
+        g[i*stride+1] = w / 16;
+    }
+}
+
+template<typename To, typename Ti, typename Valid>
+void BilateralGridFilterHost(
+    Image<To,TargetHost> dOut, const Image<Ti,TargetHost> dIn, float gs, float gr, Valid valid
+) {
+    const int w = dIn.w;
+    const int h = dIn.h;
+    const int P = BILATERAL_GRID_PAD;
+
+    if(w == 0 || h == 0) return;
+
+    // Intensity range of the valid pixels
+    std::vector<float> rowmin(h, 1E30f);
+    std::vector<float> rowmax(h, -1E30f);
+    ParallelForRows(h, [&](size_t y0, size_t y1) {
+        for(size_t y=y0; y < y1; ++y) {
+            for(int x=0; x < w; ++x) {
+                const Ti v = dIn(x,y);
+                if(valid(v)) {
+                    rowmin[y] = std::min(rowmin[y], (float)v);
+                    rowmax[y] = std::max(rowmax[y], (float)v);
+                }
+            }
+        }
+    });
+    const float vmin = *std::min_element(rowmin.begin(), rowmin.end());
+    const float vmax = *std::max_element(rowmax.begin(), rowmax.end());
+
+    // No valid pixels, so no grid to splat into
+    if(vmax < vmin) {
+        ParallelForRows(h, [&](size_t y0, size_t y1) {
+            for(size_t y=y0; y < y1; ++y) {
+                for(int x=0; x < w; ++x) {
+                    dOut(x,y) = InvalidValue<To>::Value();
+                }
+            }
+        });
+        return;
+    }
+
+    const float ss = gs;
+    const float sr = vmax > vmin ? std::max(gr, (vmax - vmin) / (BILATERAL_GRID_MAX_DEPTH - 2*P - 2)) : 1.0f;
+    const int gw = (int)((w-1) / ss) + 1 + 2*P;
+    const int gh = (int)((h-1) / ss) + 1 + 2*P;
+    const int gd = (int)((vmax - vmin) / sr) + 1 + 2*P;
+
+    // A fine spatial sampling gives a grid larger than the image, where the
+    // direct filter over +-2gs is cheaper
+    if((size_t)gw * gh * gd > (size_t)BILATERAL_GRID_MAX_CELLS_PER_PIXEL * w * h) {
+        valid.Direct(dOut, dIn, gs, gr, (uint)std::ceil(2*gs));
+        return;
+    }
+
+    // (value*weight, weight), depth innermost. The buffer is kept per calling
+    // thread so that filtering every frame does not allocate.
+    static thread_local std::vector<float> grid;
+    grid.assign((size_t)gw * gh * gd * 2, 0.0f);
+    const size_t sz = 2;
+    const size_t sx = gd * sz;
+    const size_t sy = gw * sx;
+
+    // Splat, each grid row only written by its own task
+    ParallelFor(0, gh, [&](size_t gy) {
+        const int ylo = std::max(0, (int)std::ceil(((int)gy - P - 1) * ss));
+        const int yhi = std::min(h-1, (int)std::floor(((int)gy - P + 1) * ss));
+        float* g = &grid[gy * sy];
+        for(int y=ylo; y <= yhi; ++y) {
+            const float wy = 1 - std::fabs(y / ss + P - gy);
+            if(wy <= 0) continue;
+            for(int x=0; x < w; ++x) {
+                const Ti v = dIn(x,y);
+                if(!valid(v)) continue;
+                const float fx = x / ss + P;
+                const float fz = (v - vmin) / sr + P;
+                const int ix = (int)fx;
+                const int iz = (int)fz;
+                const float ax = fx - ix;
+                const float az = fz - iz;
+                float* c = g + ix*sx + iz*sz;
+                const float w00 = wy * (1-ax) * (1-az);
+                const float w01 = wy * (1-ax) * az;
+                const float w10 = wy * ax * (1-az);
+                const float w11 = wy * ax * az;
+                c[0] += w00 * v;           c[1] += w00;
+                c[sz] += w01 * v;          c[sz+1] += w01;
+                c[sx] += w10 * v;          c[sx+1] += w10;
+                c[sx+sz] += w11 * v;       c[sx+sz+1] += w11;
+            }
+        }
+    });
+
+    // Blur along depth, x and y
+    ParallelFor(0, (size_t)gw*gh, [&](size_t i) {
+        static thread_local std::vector<float> tmp;
+        BilateralGridBlurLine(&grid[i*sx], sz, gd, tmp);
+    }, 64);
+    ParallelFor(0, (size_t)gh*gd, [&](size_t i) {
+        static thread_local std::vector<float> tmp;
+        BilateralGridBlurLine(&grid[(i/gd)*sy + (i%gd)*sz], sx, gw, tmp);
+    }, 64);
+    ParallelFor(0, (size_t)gw*gd, [&](size_t i) {
+        static thread_local std::vector<float> tmp;
+        BilateralGridBlurLine(&grid[i*sz], sy, gh, tmp);
+    }, 64);
+
+    // Slice
+    ParallelForRows(h, [&](size_t y0, size_t y1) {
+        for(size_t y=y0; y < y1; ++y) {
+            const float fy = y / ss + P;
+            const int iy = (int)fy;
+            const float ay = fy - iy;
+            for(int x=0; x < w; ++x) {
+                const Ti v = dIn(x,y);
+                if(!valid(v)) {
+                    dOut(x,y) = InvalidValue<To>::Value();
+                    continue;
+                }
+                const float fx = x / ss + P;
+                const float fz = (v - vmin) / sr + P;
+                const int ix = (int)fx;
+                const int iz = (int)fz;
+                const float ax = fx - ix;
+                const float az = fz - iz;
+                const float* c = &grid[iy*sy + ix*sx + iz*sz];
+                float sum = 0;
+                float sumw = 0;
+                for(int k=0; k < 8; ++k) {
+                    const int dy = (k>>2)&1, dx = (k>>1)&1, dz = k&1;
+                    const float wk = (dy ? ay : 1-ay) * (dx ? ax : 1-ax) * (dz ? az : 1-az);
+                    const float* ck = c + dy*sy + dx*sx + dz*sz;
+                    sum += wk * ck[0];
+                    sumw += wk * ck[1];
+                }
+                dOut(x,y) = sumw > 0 ? (To)(sum / sumw) : (To)v;
+            }
+        }
+    });
+}
+
+template<typename To, typename Ti>
+void BilateralGridFilter(
+    Image<To,TargetHost> dOut, const Image<Ti,TargetHost> dIn, float gs, float gr
+) {
+    BilateralGridFilterHost(dOut, dIn, gs, gr, BilateralGridAll());
+}
+
+template<typename To, typename Ti>
+void BilateralGridFilter(
+    Image<To,TargetHost> dOut, const Image<Ti,TargetHost> dIn, float gs, float gr, Ti minval
+) {
+    BilateralGridFilterHost(dOut, dIn, gs, gr, BilateralGridMin<Ti>(minval));
+}
+
+template KANGAROO_EXPORT void BilateralGridFilter(Image<float,TargetHost>, const Image<float,TargetHost>, float, float);
+template KANGAROO_EXPORT void BilateralGridFilter(Image<float,TargetHost>, const Image<unsigned char,TargetHost>, float, float);
+template KANGAROO_EXPORT void BilateralGridFilter(Image<float,TargetHost>, const Image<float,TargetHost>, float, float, float);
+template KANGAROO_EXPORT void BilateralGridFilter(Image<float,TargetHost>, const Image<unsigned short,TargetHost>, float, float, unsigned short);
+
+}
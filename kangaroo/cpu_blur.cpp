@@ -0,0 +1,179 @@
+#include "cu_blur.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "cu_integral_image.h"
+#include "host_launch_utils.h"
+
+namespace roo {
+
+//////////////////////////////////////////////////////
+// Recursive Gaussian Blur on the host
+// I.T. Young, L.J. van Vliet, Recursive implementation of the Gaussian
+// filter, Signal Processing 1995. A causal and an anticausal third order
+// filter per axis, so the cost per pixel does not depend on sigma. Borders
+// are extended with the edge value: the causal filter starts in its steady
+// state, the anticausal one from its response to the extension (Triggs and
+// Sdika 2006), worked out numerically once per call.
+//////////////////////////////////////////////////////
+
+// Columns filtered together, each task runs its block down the whole image
+const int RECURSIVE_GAUSSIAN_COLS = 64;
+
+struct RecursiveGaussian
+{
+    RecursiveGaussian(float sigma)
+    {
+        const double s = std::max(sigma, 0.5f);
+        const double q = s >= 2.5 ? 0.98711*s - 0.96330 : 3.97156 - 4.14554*std::sqrt(1 - 0.26891*s);
+        const double b0 = 1.57825 + 2.44413*q + 1.4281*q*q + 0.422205*q*q*q;
+        const double b1 = 2.44413*q + 2.85619*q*q + 1.26661*q*q*q;
+        const double b2 = -(1.4281*q*q + 1.26661*q*q*q);
+        const double b3 = 0.422205*q*q*q;
+        const double c1 = b1/b0;
+        const double c2 = b2/b0;
+        const double c3 = b3/b0;
+        const double dB = 1 - (c1 + c2 + c3);
+
+        B = (float)dB;
+        c[0] = (float)c1;
+        c[1] = (float)c2;
+        c[2] = (float)c3;
+
+        // M(j,k): anticausal output at N+j for a unit causal output at N-1-k
+        // above the extension, which then decays with no further input
+        const int K = 64 + (int)(20*q);
+        std::vector<double> e(K+3);
+        std::vector<double> y(K+6);
+        for(int k=0; k < 3; ++k) {
+            std::fill(e.begin(), e.end(), 0.0);
+            std::fill(y.begin(), y.end(), 0.0);
+            e[2-k] = 1;
+            for(int i=3; i < K+3; ++i) {
+                e[i] = c1*e[i-1] + c2*e[i-2] + c3*e[i-3];
+            }
+            for(int i=K+2; i >= 3; --i) {
+                y[i] = dB*e[i] + c1*y[i+1] + c2*y[i+2] + c3*y[i+3];
+            }
+            for(int j=0; j < 3; ++j) {
+                M[j][k] = (float)y[3+j];
+            }
+        }
+    }
+
+    float B;
+    float c[3];
+    float M[3][3];
+};
+
+// Filters along y from in to out, which may be the same image
+template<typename Tin>
+void RecursiveGaussianColumns(Image<float,TargetHost> out, const Image<Tin,TargetHost> in, const RecursiveGaussian& g)
+{
+    const int w = in.w;
+    const int h = in.h;
+    const int CW = RECURSIVE_GAUSSIAN_COLS;
+    const float B = g.B;
+    const float c1 = g.c[0];
+    const float c2 = g.c[1];
+    const float c3 = g.c[2];
+
+    ParallelFor(0, (w + CW - 1) / CW, [&](size_t chunk) {
+        const int x0 = chunk * CW;
+        const int n = std::min(CW, w - x0);
+        float last[RECURSIVE_GAUSSIAN_COLS];
+        float ext[3][RECURSIVE_GAUSSIAN_COLS];
+
+        const Tin* rl = in.RowPtr(h-1) + x0;
+        for(int x=0; x < n; ++x) last[x] = rl[x];
+
+        // causal, rows before the first equal to it
+        for(int y=0; y < h; ++y) {
+            const Tin* ri = in.RowPtr(y) + x0;
+            float* r = out.RowPtr(y) + x0;
+            const float* p1 = out.RowPtr(std::max(y-1,0)) + x0;
+            const float* p2 = out.RowPtr(std::max(y-2,0)) + x0;
+            const float* p3 = out.RowPtr(std::max(y-3,0)) + x0;
+            if(y == 0) {
+                for(int x=0; x < n; ++x) r[x] = ri[x];
+            }else{
+                for(int x=0; x < n; ++x) {
+                    r[x] = B*ri[x] + c1*p1[x] + c2*p2[x] + c3*p3[x];
+                }
+            }
+        }
+
+        // anticausal, rows after the last from the extension
+        const float* w1 = out.RowPtr(h-1) + x0;
+        const float* w2 = out.RowPtr(std::max(h-2,0)) + x0;
+        const float* w3 = out.RowPtr(std::max(h-3,0)) + x0;
+        for(int j=0; j < 3; ++j) {
+            for(int x=0; x < n; ++x) {
+                const float u = last[x];
+                ext[j][x] = u + g.M[j][0]*(w1[x]-u) + g.M[j][1]*(w2[x]-u) + g.M[j][2]*(w3[x]-u);
+            }
+        }
+
+        for(int y=h-1; y >= 0; --y) {
+            float* r = out.RowPtr(y) + x0;
+            const float* p1 = y+1 < h ? out.RowPtr(y+1) + x0 : ext[y+1-h];
+            const float* p2 = y+2 < h ? out.RowPtr(y+2) + x0 : ext[y+2-h];
+            const float* p3 = y+3 < h ? out.RowPtr(y+3) + x0 : ext[y+3-h];
+            for(int x=0; x < n; ++x) {
+                r[x] = B*r[x] + c1*p1[x] + c2*p2[x] + c3*p3[x];
+            }
+        }
+    });
+}
+
+inline void RecursiveGaussianStore(unsigned char& o, float v)
+{
+    o = (unsigned char)std::max(0.0f, std::min(v + 0.5f, 255.0f));
+}
+
+inline void RecursiveGaussianStore(float& o, float v)
+{
+    o = v;
+}
+
+template<typename Tout, typename Tin>
+void GaussianBlur(Image<Tout,TargetHost> out, const Image<Tin,TargetHost> in, Image<Tout,TargetHost> temp, float sigma)
+{
+    if(sigma == 0) {
+        ParallelForRows(out.h, [&](size_t y0, size_t y1) {
+            for(size_t y=y0; y < y1; ++y) {
+                for(size_t x=0; x < out.w; ++x) {
+                    RecursiveGaussianStore(out(x,y), (float)in(x,y));
+                }
+            }
+        });
+        return;
+    }
+
+    // y, then x on the transposed image, where it also runs down columns
+    const RecursiveGaussian g(sigma);
+    Image<float,TargetHostAligned,Manage> F(in.w, in.h);
+    Image<float,TargetHostAligned,Manage> T(in.h, in.w);
+    RecursiveGaussianColumns<Tin>(F, in, g);
+    Transpose<float,float>(T, F);
+    RecursiveGaussianColumns<float>(T, T, g);
+    Transpose<float,float>(F, T);
+
+    ParallelForRows(out.h, [&](size_t y0, size_t y1) {
+        for(size_t y=y0; y < y1; ++y) {
+            const float* rf = F.RowPtr(y);
+            Tout* ro = out.RowPtr(y);
+            for(size_t x=0; x < out.w; ++x) {
+                RecursiveGaussianStore(ro[x], rf[x]);
+            }
+        }
+    });
+}
+
+template KANGAROO_EXPORT void GaussianBlur(Image<unsigned char,TargetHost>, const Image<unsigned char,TargetHost>, Image<unsigned char,TargetHost>, float);
+template KANGAROO_EXPORT void GaussianBlur(Image<float,TargetHost>, const Image<unsigned char,TargetHost>, Image<float,TargetHost>, float);
+template KANGAROO_EXPORT void GaussianBlur(Image<float,TargetHost>, const Image<float,TargetHost>, Image<float,TargetHost>, float);
+
+}
@@ -0,0 +1,428 @@
+#include "cu_census.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <stdint.h>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define KANGAROO_HOST_SSE2
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Without -mpopcnt gcc calls a library popcount, so the Hamming loops are
+// also built for popcnt and picked at runtime.
+#if !defined(__POPCNT__) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define KANGAROO_HOST_POPCNT_DISPATCH
+#endif
+
+#include "host_launch_utils.h"
+#include "InvalidValue.h"
+
+namespace roo
+{
+
+//////////////////////////////////////////////////////
+// Census transform on the host
+//
+// Descriptors are built one 64 bit word at a time. A word is described by
+// its taps, the (dx,dy) offsets compared against the centre pixel in bit
+// order, which reproduce the bit layout of the device kernels exactly.
+// Source rows are copied with replicated borders so that taps never need
+// bound checks (GetWithClampedRange on the device).
+//////////////////////////////////////////////////////
+
+// taps lie within [-CENSUS_PAD, CENSUS_PAD) of the centre
+const int CENSUS_PAD = 8;
+
+typedef std::vector<int2> CensusWordTaps;
+
+inline unsigned HostPopcount(uint64_t v)
+{
+#if defined(_MSC_VER) && defined(_M_X64)
+    return (unsigned)__popcnt64(v);
+#else
+    // popcnt instruction when the compiler targets it (-mpopcnt)
+    return (unsigned)__builtin_popcountll(v);
+#endif
+}
+
+inline void CensusAddRows(CensusWordTaps& taps, int y0, int y1, int x0, int x1)
+{
+    for(int r=y0; r <= y1; ++r) {
+        for(int c=x0; c <= x1; ++c) {
+            taps.push_back(make_int2(c,r));
+        }
+    }
+}
+
+// 9x7 window in a single word, see KernCensus9x7
+inline std::vector<CensusWordTaps> CensusPattern9x7()
+{
+    std::vector<CensusWordTaps> words(1);
+    CensusAddRows(words[0], -3, 3, -4, 4);
+    return words;
+}
+
+// 11x11 window split after the centre pixel, see KernCensus11x11
+inline std::vector<CensusWordTaps> CensusPattern11x11()
+{
+    std::vector<CensusWordTaps> words(2);
+    CensusAddRows(words[0], -5, -1, -5, 5);
+    CensusAddRows(words[0],  0,  0, -5, 0);
+    CensusAddRows(words[1],  0,  0,  1, 5);
+    CensusAddRows(words[1],  1,  5, -5, 5);
+    return words;
+}
+
+// 8x16 window, four rows per word, see KernCensus16x16
+inline std::vector<CensusWordTaps> CensusPattern16x16()
+{
+    std::vector<CensusWordTaps> words(4);
+    for(int i=0; i < 4; ++i) {
+        CensusAddRows(words[i], -8 + 4*i, -5 + 4*i, -4, 3);
+    }
+    return words;
+}
+
+// One word for pixels [0,w) of a row. rows[dy] point at x=0 of the padded
+// source row y+dy, out has a stride of W words per pixel.
+template<typename Tin>
+void CensusWordRow(uint64_t* out, int W, int w, const Tin* const* rows, const CensusWordTaps& taps)
+{
+    const Tin* centre = rows[0];
+    for(int x=0; x < w; ++x) {
+        const Tin p = centre[x];
+        uint64_t word = 0;
+        for(size_t k=0; k < taps.size(); ++k) {
+            const Tin q = rows[taps[k].y][x + taps[k].x];
+            if( q < p ) {
+                word |= (uint64_t)1 << k;
+            }
+        }
+        out[x*W] = word;
+    }
+}
+
+#ifdef KANGAROO_HOST_SSE2
+// 16 pixels at a time. Comparison k sets bit k%8 in byte plane k/8, and the
+// eight planes are transposed into one 64 bit word per pixel at the end.
+template<>
+void CensusWordRow<unsigned char>(uint64_t* out, int W, int w, const unsigned char* const* rows, const CensusWordTaps& taps)
+{
+    const __m128i sign = _mm_set1_epi8((char)0x80);
+    const unsigned char* centre = rows[0];
+
+    for(int x0=0; x0 < w; x0 += 16) {
+        // unsigned q < p as signed comparison of biased values
+        const __m128i p = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(centre + x0)), sign);
+
+        __m128i planes[8];
+        for(int b=0; b < 8; ++b) planes[b] = _mm_setzero_si128();
+
+        for(size_t k=0; k < taps.size(); ++k) {
+            const __m128i q = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(rows[taps[k].y] + x0 + taps[k].x)), sign);
+            const __m128i lt = _mm_cmpgt_epi8(p, q);
+            planes[k/8] = _mm_or_si128(planes[k/8], _mm_and_si128(lt, _mm_set1_epi8((char)(1 << (k%8)))));
+        }
+
+        // 8 planes of 16 bytes -> 16 words of 8 bytes
+        const __m128i t0 = _mm_unpacklo_epi8(planes[0], planes[1]);
+        const __m128i t1 = _mm_unpackhi_epi8(planes[0], planes[1]);
+        const __m128i t2 = _mm_unpacklo_epi8(planes[2], planes[3]);
+        const __m128i t3 = _mm_unpackhi_epi8(planes[2], planes[3]);
+        const __m128i t4 = _mm_unpacklo_epi8(planes[4], planes[5]);
+        const __m128i t5 = _mm_unpackhi_epi8(planes[4], planes[5]);
+        const __m128i t6 = _mm_unpacklo_epi8(planes[6], planes[7]);
+        const __m128i t7 = _mm_unpackhi_epi8(planes[6], planes[7]);
+
+        const __m128i u0 = _mm_unpacklo_epi16(t0, t2);
+        const __m128i u1 = _mm_unpackhi_epi16(t0, t2);
+        const __m128i u2 = _mm_unpacklo_epi16(t1, t3);
+        const __m128i u3 = _mm_unpackhi_epi16(t1, t3);
+        const __m128i v0 = _mm_unpacklo_epi16(t4, t6);
+        const __m128i v1 = _mm_unpackhi_epi16(t4, t6);
+        const __m128i v2 = _mm_unpacklo_epi16(t5, t7);
+        const __m128i v3 = _mm_unpackhi_epi16(t5, t7);
+
+        uint64_t words[16];
+        _mm_storeu_si128((__m128i*)(words +  0), _mm_unpacklo_epi32(u0, v0));
+        _mm_storeu_si128((__m128i*)(words +  2), _mm_unpackhi_epi32(u0, v0));
+        _mm_storeu_si128((__m128i*)(words +  4), _mm_unpacklo_epi32(u1, v1));
+        _mm_storeu_si128((__m128i*)(words +  6), _mm_unpackhi_epi32(u1, v1));
+        _mm_storeu_si128((__m128i*)(words +  8), _mm_unpacklo_epi32(u2, v2));
+        _mm_storeu_si128((__m128i*)(words + 10), _mm_unpackhi_epi32(u2, v2));
+        _mm_storeu_si128((__m128i*)(words + 12), _mm_unpacklo_epi32(u3, v3));
+        _mm_storeu_si128((__m128i*)(words + 14), _mm_unpackhi_epi32(u3, v3));
+
+        const int n = std::min(16, w - x0);
+        for(int i=0; i < n; ++i) {
+            out[(x0+i)*W] = words[i];
+        }
+    }
+}
+#endif
+
+template<typename Tout, typename Tin>
+void CensusHost(Image<Tout,TargetHost> census, const Image<Tin,TargetHost> img, const std::vector<CensusWordTaps>& words)
+{
+    const int W = (int)words.size();
+    const int w = img.w;
+    const int h = img.h;
+
+    // census rows are written as W consecutive 64 bit words per pixel
+    assert(sizeof(Tout) == W*sizeof(uint64_t));
+
+    if(w == 0 || h == 0) return;
+
+    // padded rows hold the vector tail as well
+    const int stride = w + 2*CENSUS_PAD + 16;
+
+    ParallelForRows(h, [&](size_t y0, size_t y1) {
+        // padded copies of the source rows this chunk of rows touches
+        const int r0 = (int)y0 - CENSUS_PAD;
+        const int nrows = (int)(y1 - y0) + 2*CENSUS_PAD;
+        std::vector<Tin> buf((size_t)nrows * stride);
+        for(int i=0; i < nrows; ++i) {
+            const Tin* src = img.RowPtr(std::min(std::max(r0 + i, 0), h-1));
+            Tin* dst = &buf[(size_t)i*stride];
+            std::fill(dst, dst + CENSUS_PAD, src[0]);
+            std::copy(src, src + w, dst + CENSUS_PAD);
+            std::fill(dst + CENSUS_PAD + w, dst + stride, src[w-1]);
+        }
+
+        const Tin* rowsBase[2*CENSUS_PAD+1];
+        const Tin** rows = rowsBase + CENSUS_PAD;
+
+        for(int y=(int)y0; y < (int)y1; ++y) {
+            for(int dy=-CENSUS_PAD; dy < CENSUS_PAD; ++dy) {
+                rows[dy] = &buf[(size_t)(y + dy - r0)*stride + CENSUS_PAD];
+            }
+
+            uint64_t* out = (uint64_t*)census.RowPtr(y);
+            for(int i=0; i < W; ++i) {
+                CensusWordRow<Tin>(out + i, W, w, rows, words[i]);
+            }
+        }
+    });
+}
+
+void Census(Image<unsigned long,TargetHost> census, const Image<unsigned char,TargetHost> img)
+{
+    CensusHost(census, img, CensusPattern9x7());
+}
+
+void Census(Image<ulong2,TargetHost> census, const Image<unsigned char,TargetHost> img)
+{
+    CensusHost(census, img, CensusPattern11x11());
+}
+
+void Census(Image<ulong4,TargetHost> census, const Image<unsigned char,TargetHost> img)
+{
+    CensusHost(census, img, CensusPattern16x16());
+}
+
+void Census(Image<unsigned long,TargetHost> census, const Image<float,TargetHost> img)
+{
+    CensusHost(census, img, CensusPattern9x7());
+}
+
+void Census(Image<ulong2,TargetHost> census, const Image<float,TargetHost> img)
+{
+    CensusHost(census, img, CensusPattern11x11());
+}
+
+void Census(Image<ulong4,TargetHost> census, const Image<float,TargetHost> img)
+{
+    CensusHost(census, img, CensusPattern16x16());
+}
+
+//////////////////////////////////////////////////////
+// Hamming distance of descriptors
+//////////////////////////////////////////////////////
+
+// Words are widened to 64 bits, unsigned long is only 32 on LLP64 targets
+inline unsigned HostHammingDistance(uint64_t p, uint64_t q)
+{
+    return HostPopcount(p^q);
+}
+
+inline unsigned HostHammingDistance(const ulong2 p, const ulong2 q)
+{
+    return HostHammingDistance(p.x,q.x) + HostHammingDistance(p.y,q.y);
+}
+
+inline unsigned HostHammingDistance(const ulong4 p, const ulong4 q)
+{
+    return HostHammingDistance(p.x,q.x) + HostHammingDistance(p.y,q.y) +
+           HostHammingDistance(p.z,q.z) + HostHammingDistance(p.w,q.w);
+}
+
+//////////////////////////////////////////////////////
+// Census Stereo
+//////////////////////////////////////////////////////
+
+void CensusStereo(Image<char,TargetHost> disp, const Image<unsigned long,TargetHost> left, const Image<unsigned long,TargetHost> right, int maxDispVal)
+{
+    ParallelForRows(disp.h, [&](size_t y0, size_t y1) {
+        for(size_t y=y0; y < y1; ++y) {
+            const unsigned long* l = left.RowPtr(y);
+            const unsigned long* r = right.RowPtr(y);
+            char* out = disp.RowPtr(y);
+
+            for(int x=0; x < (int)disp.w; ++x) {
+                const int minDisp = std::max(std::min(maxDispVal, 0), x - ((int)left.w-1));
+                const int maxDisp = std::min(std::max(0, maxDispVal), x);
+
+                unsigned bestScore = 0xFFFFF;
+                int bestDisp = InvalidValue<char>::Value();
+                for(int d=minDisp; d < maxDisp; ++d) {
+                    const unsigned score = HostHammingDistance(l[x], r[x-d]);
+                    if(score < bestScore) {
+                        bestScore = score;
+                        bestDisp = d;
+                    }
+                }
+                out[x] = bestDisp;
+            }
+        }
+    });
+}
+
+//////////////////////////////////////////////////////
+// Build Census Cost volume
+//////////////////////////////////////////////////////
+
+template<typename Tvol, typename T>
+inline void CensusVolumeRow(Tvol* out, const T* l, const T* r, int x0, int x1, int off, float bits)
+{
+    for(int x=x0; x < x1; ++x) {
+        out[x] = HostHammingDistance(l[x], r[x+off]) / bits;
+    }
+}
+
+#ifdef KANGAROO_HOST_POPCNT_DISPATCH
+template<typename Tvol, typename T>
+__attribute__((target("popcnt")))
+void CensusVolumeRowPopcnt(Tvol* out, const T* l, const T* r, int x0, int x1, int off, float bits)
+{
+    CensusVolumeRow(out, l, r, x0, x1, off, bits);
+}
+#endif
+
+template<typename Tvol, typename T>
+void CensusStereoVolume(Volume<Tvol,TargetHost> vol, const Image<T,TargetHost> left, const Image<T,TargetHost> right, int maxDisp, float sd)
+{
+    const float bits = (float)(sizeof(T)*8);
+    const int w = left.w;
+
+#ifdef KANGAROO_HOST_POPCNT_DISPATCH
+    const bool popcnt = __builtin_cpu_supports("popcnt");
+#endif
+
+    ParallelForRows(left.h, [&](size_t y0, size_t y1) {
+        for(size_t y=y0; y < y1; ++y) {
+            const T* l = left.RowPtr(y);
+            const T* r = right.RowPtr(y);
+
+            for(int d=0; d < maxDisp; ++d) {
+                // descriptors along a disparity slice are contiguous
+                Tvol* out = vol.ImageXY(d).RowPtr(y);
+
+                // the device reads column (int)(x + sd*d), truncated towards
+                // zero, so x + sd*d in (-1,0) still reads column 0
+                const float fo = sd*d;
+                const int off = (int)std::floor(fo);
+                const int x0 = std::min(w, std::max(0, (int)std::floor(-1.0f - fo) + 1));
+                const int xs = std::min(w, std::max(x0, -off));
+                const int x1 = std::max(xs, std::min(w, (int)right.w - off));
+
+                for(int x=0; x < x0; ++x) out[x] = 0.5;
+                for(int x=x0; x < xs; ++x) out[x] = HostHammingDistance(l[x], r[0]) / bits;
+#ifdef KANGAROO_HOST_POPCNT_DISPATCH
+                if(popcnt) {
+                    CensusVolumeRowPopcnt(out, l, r, xs, x1, off, bits);
+                }else
+#endif
+                {
+                    CensusVolumeRow(out, l, r, xs, x1, off, bits);
+                }
+                for(int x=x1; x < w; ++x) out[x] = 0.5;
+            }
+        }
+    });
+}
+
+template KANGAROO_EXPORT void CensusStereoVolume(Volume<unsigned short,TargetHost> vol, const Image<unsigned long,TargetHost> left, const Image<unsigned long,TargetHost> right, int maxDisp, float);
+template KANGAROO_EXPORT void CensusStereoVolume(Volume<unsigned short,TargetHost> vol, const Image<ulong2,TargetHost> left, const Image<ulong2,TargetHost> right, int maxDisp, float);
+template KANGAROO_EXPORT void CensusStereoVolume(Volume<unsigned short,TargetHost> vol, const Image<ulong4,TargetHost> left, const Image<ulong4,TargetHost> right, int maxDisp, float);
+template KANGAROO_EXPORT void CensusStereoVolume(Volume<float,TargetHost> vol, const Image<unsigned long,TargetHost> left, const Image<unsigned long,TargetHost> right, int maxDisp, float);
+template KANGAROO_EXPORT void CensusStereoVolume(Volume<float,TargetHost> vol, const Image<ulong2,TargetHost> left, const Image<ulong2,TargetHost> right, int maxDisp, float);
+template KANGAROO_EXPORT void CensusStereoVolume(Volume<float,TargetHost> vol, const Image<ulong4,TargetHost> left, const Image<ulong4,TargetHost> right, int maxDisp, float);
+
+template<typename Tvol, typename T>
+inline void CensusRangeRow(Tvol* out, const short2* range, const T* l, const T* r, int w, int wr, int i, float sd, float bits)
+{
+    for(int x=0; x < w; ++x) {
+        const int xr = x + (int)(sd*(range[x].x + i));
+        if(i < range[x].y && 0 <= xr && xr < wr) {
+            out[x] = HostHammingDistance(l[x], r[xr]) / bits;
+        }else{
+            out[x] = 0.5;
+        }
+    }
+}
+
+#ifdef KANGAROO_HOST_POPCNT_DISPATCH
+template<typename Tvol, typename T>
+__attribute__((target("popcnt")))
+void CensusRangeRowPopcnt(Tvol* out, const short2* range, const T* l, const T* r, int w, int wr, int i, float sd, float bits)
+{
+    CensusRangeRow(out, range, l, r, w, wr, i, sd, bits);
+}
+#endif
+
+template<typename Tvol, typename T>
+void CensusStereoVolume(CostVolRange<Tvol,TargetHost> vol, const Image<T,TargetHost> left, const Image<T,TargetHost> right, float sd)
+{
+    const float bits = (float)(sizeof(T)*8);
+
+#ifdef KANGAROO_HOST_POPCNT_DISPATCH
+    const bool popcnt = __builtin_cpu_supports("popcnt");
+#endif
+
+    ParallelForRows(left.h, [&](size_t y0, size_t y1) {
+        for(size_t y=y0; y < y1; ++y) {
+            const short2* range = vol.range.RowPtr(y);
+            const T* l = left.RowPtr(y);
+            const T* r = right.RowPtr(y);
+
+            // entries beyond the window of a pixel are set as out of view
+            for(unsigned int i=0; i < vol.Window(); ++i) {
+                Tvol* out = vol.vol.ImageXY(i).RowPtr(y);
+#ifdef KANGAROO_HOST_POPCNT_DISPATCH
+                if(popcnt) {
+                    CensusRangeRowPopcnt(out, range, l, r, left.w, right.w, i, sd, bits);
+                }else
+#endif
+                {
+                    CensusRangeRow(out, range, l, r, left.w, right.w, i, sd, bits);
+                }
+            }
+        }
+    });
+}
+
+template KANGAROO_EXPORT void CensusStereoVolume(CostVolRange<unsigned short,TargetHost> vol, const Image<unsigned long,TargetHost> left, const Image<unsigned long,TargetHost> right, float);
+template KANGAROO_EXPORT void CensusStereoVolume(CostVolRange<unsigned short,TargetHost> vol, const Image<ulong2,TargetHost> left, const Image<ulong2,TargetHost> right, float);
+template KANGAROO_EXPORT void CensusStereoVolume(CostVolRange<unsigned short,TargetHost> vol, const Image<ulong4,TargetHost> left, const Image<ulong4,TargetHost> right, float);
+template KANGAROO_EXPORT void CensusStereoVolume(CostVolRange<float,TargetHost> vol, const Image<unsigned long,TargetHost> left, const Image<unsigned long,TargetHost> right, float);
+template KANGAROO_EXPORT void CensusStereoVolume(CostVolRange<float,TargetHost> vol, const Image<ulong2,TargetHost> left, const Image<ulong2,TargetHost> right, float);
+template KANGAROO_EXPORT void CensusStereoVolume(CostVolRange<float,TargetHost> vol, const Image<ulong4,TargetHost> left, const Image<ulong4,TargetHost> right, float);
+
+}
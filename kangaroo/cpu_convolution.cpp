@@ -0,0 +1,618 @@
+#include "cu_convolution.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+#include "CUDA_SDK/cutil_math.h"
+#include "host_launch_utils.h"
+#include "host_simd.h"
+
+namespace roo
+{
+
+using namespace simd;
+
+//////////////////////////////////////////////////////
+// FFT on the host
+//
+// Stockham autosort: each stage reads one buffer and writes the other in
+// natural order, so there is no bit reversal pass. Element k of sequence q
+// is at re[q + s*k], im[q + s*k], and the sequences q0..q1-1 are
+// transformed together with the innermost loop running over q, i.e. along
+// image rows when transforming columns. Real and imaginary parts are kept
+// in separate planes so that loop vectorises. Forward transforms use
+// exp(-2 pi i/n), inverse ones exp(+2 pi i/n), neither is scaled.
+//////////////////////////////////////////////////////
+
+// MV complex values, one per sequence
+struct cvec
+{
+    mvec re;
+    mvec im;
+};
+
+inline cvec make_cvec(mvec re, mvec im)
+{
+    cvec r;
+    r.re = re;
+    r.im = im;
+    return r;
+}
+
+inline cvec operator+(const cvec& a, const cvec& b)
+{
+    return make_cvec(MvAdd(a.re, b.re), MvAdd(a.im, b.im));
+}
+
+inline cvec operator-(const cvec& a, const cvec& b)
+{
+    return make_cvec(MvSub(a.re, b.re), MvSub(a.im, b.im));
+}
+
+inline cvec operator*(float s, const cvec& a)
+{
+    const mvec v = MvSet(s);
+    return make_cvec(MvMul(v, a.re), MvMul(v, a.im));
+}
+
+inline float2 CMul(float2 a, float2 b)
+{
+    return make_float2(a.x*b.x - a.y*b.y, a.x*b.y + a.y*b.x);
+}
+
+inline cvec CMul(const cvec& a, float2 b)
+{
+    const mvec br = MvSet(b.x);
+    const mvec bi = MvSet(b.y);
+    return make_cvec(MvSub(MvMul(a.re, br), MvMul(a.im, bi)), MvAdd(MvMul(a.re, bi), MvMul(a.im, br)));
+}
+
+inline float2 Conj(float2 a)
+{
+    return make_float2(a.x, -a.y);
+}
+
+// -i*a forward, +i*a inverse
+template<bool INV>
+inline float2 JMul(float2 a)
+{
+    return INV ? make_float2(-a.y, a.x) : make_float2(a.y, -a.x);
+}
+
+template<bool INV>
+inline cvec JMul(const cvec& a)
+{
+    return INV ? make_cvec(MvSub(MvSet(0), a.im), a.re) : make_cvec(a.im, MvSub(MvSet(0), a.re));
+}
+
+inline void CLoad(float2& a, const float* re, const float* im)
+{
+    a = make_float2(*re, *im);
+}
+
+inline void CLoad(cvec& a, const float* re, const float* im)
+{
+    a = make_cvec(MvLoad(re), MvLoad(im));
+}
+
+inline void CStore(float* re, float* im, const float2& a)
+{
+    *re = a.x;
+    *im = a.y;
+}
+
+inline void CStore(float* re, float* im, const cvec& a)
+{
+    MvStore(re, a.re);
+    MvStore(im, a.im);
+}
+
+// Butterflies on float2 or on cvec
+template<int P, bool INV> struct FFTButterfly;
+
+template<bool INV> struct FFTButterfly<2,INV>
+{
+    template<typename CV>
+    static inline void Apply(CV* a)
+    {
+        const CV t = a[0] - a[1];
+        a[0] = a[0] + a[1];
+        a[1] = t;
+    }
+};
+
+template<bool INV> struct FFTButterfly<3,INV>
+{
+    template<typename CV>
+    static inline void Apply(CV* a)
+    {
+        const CV t = a[1] + a[2];
+        const CV m = a[0] - 0.5f*t;
+        const CV n = JMul<INV>(0.86602540378f*(a[1] - a[2]));
+        a[0] = a[0] + t;
+        a[1] = m + n;
+        a[2] = m - n;
+    }
+};
+
+template<bool INV> struct FFTButterfly<4,INV>
+{
+    template<typename CV>
+    static inline void Apply(CV* a)
+    {
+        const CV t0 = a[0] + a[2];
+        const CV t1 = a[0] - a[2];
+        const CV t2 = a[1] + a[3];
+        const CV t3 = JMul<INV>(a[1] - a[3]);
+        a[0] = t0 + t2;
+        a[1] = t1 + t3;
+        a[2] = t0 - t2;
+        a[3] = t1 - t3;
+    }
+};
+
+template<bool INV> struct FFTButterfly<5,INV>
+{
+    template<typename CV>
+    static inline void Apply(CV* a)
+    {
+        const float c1 = 0.30901699437f;
+        const float c2 = -0.80901699437f;
+        const float s1 = 0.95105651630f;
+        const float s2 = 0.58778525229f;
+        const CV t1 = a[1] + a[4];
+        const CV t2 = a[2] + a[3];
+        const CV t3 = a[1] - a[4];
+        const CV t4 = a[2] - a[3];
+        const CV m1 = a[0] + c1*t1 + c2*t2;
+        const CV m2 = a[0] + c2*t1 + c1*t2;
+        const CV n1 = JMul<INV>(s1*t3 + s2*t4);
+        const CV n2 = JMul<INV>(s2*t3 - s1*t4);
+        a[0] = a[0] + t1 + t2;
+        a[1] = m1 + n1;
+        a[4] = m1 - n1;
+        a[2] = m2 + n2;
+        a[3] = m2 - n2;
+    }
+};
+
+// Butterfly of sequences q.. (one or MV of them), legs r at xr[r]+q,
+// xi[r]+q, results t times the twiddle w[t] to yr[t]+q, yi[t]+q
+template<int P, bool INV, typename CV>
+inline void FFTButterflyAt(
+    const float* const* xr, const float* const* xi, float* const* yr, float* const* yi,
+    const float2* w, int q
+) {
+    CV a[P];
+    for(int r=0; r < P; ++r) {
+        CLoad(a[r], xr[r] + q, xi[r] + q);
+    }
+    FFTButterfly<P,INV>::Apply(a);
+    CStore(yr[0] + q, yi[0] + q, a[0]);
+    for(int t=1; t < P; ++t) {
+        CStore(yr[t] + q, yi[t] + q, CMul(a[t], w[t]));
+    }
+}
+
+// Radix P stage after stages whose radices multiply to l
+template<int P, bool INV>
+void FFTStage(
+    const float* xr, const float* xi, float* yr, float* yi,
+    const float2* tw, int n, int l, int s, int q0, int q1
+) {
+    const int m = n / (l*P);
+    const int ls = l*s;
+
+    for(int pp=0; pp < m; ++pp) {
+        float2 w[P];
+        for(int t=1; t < P; ++t) {
+            w[t] = INV ? Conj(tw[pp*(P-1) + t-1]) : tw[pp*(P-1) + t-1];
+        }
+        for(int j=0; j < l; ++j) {
+            const float* ar[P];
+            const float* ai[P];
+            float* br[P];
+            float* bi[P];
+            for(int r=0; r < P; ++r) {
+                ar[r] = xr + s*j + ls*(pp + m*r);
+                ai[r] = xi + s*j + ls*(pp + m*r);
+                br[r] = yr + s*j + ls*(P*pp + r);
+                bi[r] = yi + s*j + ls*(P*pp + r);
+            }
+            int q = q0;
+            for(; q + MV <= q1; q += MV) {
+                FFTButterflyAt<P,INV,cvec>(ar, ai, br, bi, w, q);
+            }
+            for(; q < q1; ++q) {
+                FFTButterflyAt<P,INV,float2>(ar, ai, br, bi, w, q);
+            }
+        }
+    }
+}
+
+// work planes are as large as data, the result is left in data
+template<bool INV>
+void FFT(const FFTPlan& plan, float* re, float* im, float* work_re, float* work_im, int s, int q0, int q1)
+{
+    float* xr = re;
+    float* xi = im;
+    float* yr = work_re;
+    float* yi = work_im;
+    const float2* tw = &plan.twiddle[0];
+    int l = 1;
+
+    for(size_t i=0; i < plan.radix.size(); ++i) {
+        const int p = plan.radix[i];
+        switch(p) {
+        case 2: FFTStage<2,INV>(xr, xi, yr, yi, tw, plan.n, l, s, q0, q1); break;
+        case 3: FFTStage<3,INV>(xr, xi, yr, yi, tw, plan.n, l, s, q0, q1); break;
+        case 4: FFTStage<4,INV>(xr, xi, yr, yi, tw, plan.n, l, s, q0, q1); break;
+        case 5: FFTStage<5,INV>(xr, xi, yr, yi, tw, plan.n, l, s, q0, q1); break;
+        }
+        tw += (plan.n / (l*p)) * (p-1);
+        l *= p;
+        std::swap(xr, yr);
+        std::swap(xi, yi);
+    }
+
+    if(xr != re) {
+        for(int k=0; k < plan.n; ++k) {
+            std::copy(xr + s*k + q0, xr + s*k + q1, re + s*k + q0);
+            std::copy(xi + s*k + q0, xi + s*k + q1, im + s*k + q0);
+        }
+    }
+}
+
+void FFTPlanInit(FFTPlan& plan, int n)
+{
+    plan.n = n;
+    plan.radix.clear();
+    plan.twiddle.clear();
+
+    const int radices[] = {4, 2, 3, 5};
+    for(int i=0; i < 4; ++i) {
+        while(n % radices[i] == 0) {
+            plan.radix.push_back(radices[i]);
+            n /= radices[i];
+        }
+    }
+
+    // exp(-2 pi i pp*t/nc) for each stage, nc the length it splits
+    int nc = plan.n;
+    for(size_t i=0; i < plan.radix.size(); ++i) {
+        const int p = plan.radix[i];
+        const int m = nc / p;
+        for(int pp=0; pp < m; ++pp) {
+            for(int t=1; t < p; ++t) {
+                const double a = -2.0 * M_PI * pp * t / nc;
+                plan.twiddle.push_back(make_float2((float)std::cos(a), (float)std::sin(a)));
+            }
+        }
+        nc = m;
+    }
+}
+
+// Smallest n' >= n of the form 2^a 3^b 5^c
+inline int FFTFastSize(int n)
+{
+    for(int m = std::max(n,1); ; ++m) {
+        int r = m;
+        while(r % 2 == 0) r /= 2;
+        while(r % 3 == 0) r /= 3;
+        while(r % 5 == 0) r /= 5;
+        if(r == 1) return m;
+    }
+}
+
+//////////////////////////////////////////////////////
+// Convolution by FFT on the host
+//
+// Rows are real, so each is transformed as a complex sequence of half the
+// length (even and odd samples as real and imaginary parts) and split into
+// nw/2+1 bins. Blocks of rows are interleaved so they are transformed
+// together as the columns are. Columns of bins are transformed in blocks,
+// multiplied by the kernel spectrum and transformed back while still in
+// cache. The padded image holds the Neumann extension of the input over the
+// kernel support, and the transform is large enough that nothing wraps
+// around into the w x h result.
+//////////////////////////////////////////////////////
+
+// Rows, and columns of bins, per task
+const int CONVOLUTION_FFT_ROWS = 16;
+const int CONVOLUTION_FFT_COLS = 16;
+
+inline int ConvolutionMirror(int i, int n)
+{
+    i = std::abs(i);
+    if(i >= n) i = (n-1)-(i-n);
+    return std::min(std::max(i, 0), n-1);
+}
+
+// Forward transform of n <= CONVOLUTION_FFT_ROWS real rows, samples 2k and
+// 2k+1 of row i in zr and zi at k*CONVOLUTION_FFT_ROWS + i, to the nw/2+1
+// bins of the rows of (Xr,Xi), C apart. z is overwritten.
+inline void RealFFTRows(
+    const ConvolutionSpectrum& spec, float* zr, float* zi, float* work_re, float* work_im,
+    float* Xr, float* Xi, int C, int n
+) {
+    const int M = spec.nw / 2;
+    const int RB = CONVOLUTION_FFT_ROWS;
+    FFT<false>(spec.rows, zr, zi, work_re, work_im, RB, 0, n);
+
+    for(int k=0; k <= M; ++k) {
+        const int ok = RB*(k < M ? k : 0);
+        const int oc = RB*(k > 0 ? M-k : 0);
+        const float2 wk = spec.W[k];
+        for(int i=0; i < n; ++i) {
+            const float2 a = make_float2(zr[ok+i], zi[ok+i]);
+            const float2 b = make_float2(zr[oc+i], -zi[oc+i]);
+            const float2 fe = 0.5f*(a + b);
+            const float2 fo = JMul<false>(0.5f*(a - b));
+            const float2 x = fe + CMul(wk, fo);
+            Xr[i*C + k] = x.x;
+            Xi[i*C + k] = x.y;
+        }
+    }
+}
+
+// Inverse of RealFFTRows, scaled by nw/2
+inline void RealInverseFFTRows(
+    const ConvolutionSpectrum& spec, const float* Xr, const float* Xi, int C,
+    float* zr, float* zi, float* work_re, float* work_im, int n
+) {
+    const int M = spec.nw / 2;
+    const int RB = CONVOLUTION_FFT_ROWS;
+
+    for(int k=0; k < M; ++k) {
+        const float2 wk = Conj(spec.W[k]);
+        for(int i=0; i < n; ++i) {
+            const float2 a = make_float2(Xr[i*C + k], Xi[i*C + k]);
+            const float2 b = make_float2(Xr[i*C + M-k], -Xi[i*C + M-k]);
+            const float2 fe = 0.5f*(a + b);
+            const float2 fo = 0.5f*CMul(a - b, wk);
+            const float2 z = fe + JMul<true>(fo);
+            zr[RB*k + i] = z.x;
+            zi[RB*k + i] = z.y;
+        }
+    }
+
+    FFT<true>(spec.rows, zr, zi, work_re, work_im, RB, 0, n);
+}
+
+// Spectrum S of the padded image, (nw/2+1) x nh real parts followed by as
+// many imaginary parts. fill(y, r) writes row y of the padded image to r,
+// returning false if it is zero.
+template<typename Fill>
+void RealFFT2D(const ConvolutionSpectrum& spec, std::vector<float>& S, std::vector<float>& T, Fill fill)
+{
+    const int M = spec.nw / 2;
+    const int C = M + 1;
+    const int N = C * spec.nh;
+    const int RB = CONVOLUTION_FFT_ROWS;
+    S.resize(2*N);
+    T.resize(2*N);
+
+    ParallelFor(0, (spec.nh + RB - 1) / RB, [&](size_t block) {
+        const int y0 = block * RB;
+        const int n = std::min(RB, spec.nh - y0);
+        std::vector<float> z(4*M*RB);
+        std::vector<float> r(spec.nw);
+        float* zr = &z[0];
+        float* zi = &z[M*RB];
+        for(int i=0; i < n; ++i) {
+            if(!fill(y0+i, &r[0])) {
+                std::fill(r.begin(), r.end(), 0.0f);
+            }
+            for(int k=0; k < M; ++k) {
+                zr[k*RB + i] = r[2*k];
+                zi[k*RB + i] = r[2*k+1];
+            }
+        }
+        RealFFTRows(spec, zr, zi, &z[2*M*RB], &z[3*M*RB], &S[y0*C], &S[N + y0*C], C, n);
+    });
+
+    ParallelFor(0, (C + CONVOLUTION_FFT_COLS - 1) / CONVOLUTION_FFT_COLS, [&](size_t chunk) {
+        const int q0 = chunk * CONVOLUTION_FFT_COLS;
+        const int q1 = std::min(C, q0 + CONVOLUTION_FFT_COLS);
+        FFT<false>(spec.cols, &S[0], &S[N], &T[0], &T[N], C, q0, q1);
+    });
+}
+
+void ConvolutionSpectrumInit(ConvolutionSpectrum& spec, int w, int h, const Image<float,TargetHost> kern, int kx, int ky)
+{
+    spec.w = w;
+    spec.h = h;
+    spec.kx = kx;
+    spec.ky = ky;
+    spec.kw = kern.w;
+    spec.kh = kern.h;
+    spec.nw = 2 * FFTFastSize((w + kern.w) / 2);
+    spec.nh = FFTFastSize(h + kern.h - 1);
+    FFTPlanInit(spec.rows, spec.nw / 2);
+    FFTPlanInit(spec.cols, spec.nh);
+
+    const int M = spec.nw / 2;
+    spec.W.resize(M+1);
+    for(int k=0; k <= M; ++k) {
+        const double a = -2.0 * M_PI * k / spec.nw;
+        spec.W[k] = make_float2((float)std::cos(a), (float)std::sin(a));
+    }
+
+    double kernsum = 0;
+    for(int r=0; r < spec.kh; ++r) {
+        for(int c=0; c < spec.kw; ++c) {
+            kernsum += kern(c,r);
+        }
+    }
+
+    std::vector<float> T;
+    RealFFT2D(spec, spec.K, T, [&](int y, float* r) {
+        if(y >= spec.kh) return false;
+        std::fill(r, r + spec.nw, 0.0f);
+        std::copy(kern.RowPtr(y), kern.RowPtr(y) + spec.kw, r);
+        return true;
+    });
+
+    // out(x) = sum_c k(c) in(x+c) is a correlation, hence the conjugate
+    const size_t N = spec.K.size() / 2;
+    const float scale = (float)(1.0 / ((double)spec.nh * M * kernsum));
+    for(size_t i=0; i < N; ++i) {
+        spec.K[i] *= scale;
+        spec.K[N+i] *= -scale;
+    }
+}
+
+void Convolution(Image<float,TargetHost> out, const Image<float,TargetHost> in, const ConvolutionSpectrum& spec)
+{
+    const int M = spec.nw / 2;
+    const int C = M + 1;
+    const int N = C * spec.nh;
+    const int pw = spec.w + spec.kw - 1;
+    const int ph = spec.h + spec.kh - 1;
+
+    // Padded column i holds input column i - kx
+    std::vector<int> mx(pw);
+    for(int i=0; i < pw; ++i) {
+        mx[i] = ConvolutionMirror(i - spec.kx, spec.w);
+    }
+
+    std::vector<float> S;
+    std::vector<float> T;
+    RealFFT2D(spec, S, T, [&](int y, float* r) {
+        if(y >= ph) return false;
+        const float* ri = in.RowPtr(ConvolutionMirror(y - spec.ky, spec.h));
+        for(int i=0; i < pw; ++i) {
+            r[i] = ri[mx[i]];
+        }
+        std::fill(r + pw, r + spec.nw, 0.0f);
+        return true;
+    });
+
+    ParallelFor(0, (C + CONVOLUTION_FFT_COLS - 1) / CONVOLUTION_FFT_COLS, [&](size_t chunk) {
+        const int q0 = chunk * CONVOLUTION_FFT_COLS;
+        const int q1 = std::min(C, q0 + CONVOLUTION_FFT_COLS);
+        for(int y=0; y < spec.nh; ++y) {
+            float* sr = &S[y*C];
+            float* si = &S[N + y*C];
+            const float* kr = &spec.K[y*C];
+            const float* ki = &spec.K[N + y*C];
+            for(int q=q0; q < q1; ++q) {
+                const float2 v = CMul(make_float2(sr[q], si[q]), make_float2(kr[q], ki[q]));
+                sr[q] = v.x;
+                si[q] = v.y;
+            }
+        }
+        FFT<true>(spec.cols, &S[0], &S[N], &T[0], &T[N], C, q0, q1);
+    });
+
+    const int w = std::min((int)out.w, spec.w);
+    const int h = std::min((int)out.h, spec.h);
+    const int RB = CONVOLUTION_FFT_ROWS;
+    ParallelFor(0, (h + RB - 1) / RB, [&](size_t block) {
+        const int y0 = block * RB;
+        const int n = std::min(RB, h - y0);
+        std::vector<float> z(4*M*RB);
+        const float* zr = &z[0];
+        const float* zi = &z[M*RB];
+        RealInverseFFTRows(spec, &S[y0*C], &S[N + y0*C], C, &z[0], &z[M*RB], &z[2*M*RB], &z[3*M*RB], n);
+        for(int i=0; i < n; ++i) {
+            float* ro = out.RowPtr(y0+i);
+            for(int x=0; x < w; ++x) {
+                ro[x] = (x & 1) ? zi[(x/2)*RB + i] : zr[(x/2)*RB + i];
+            }
+        }
+    });
+}
+
+//////////////////////////////////////////////////////
+// Convolution on the host
+// Small kernels directly, one kernel row at a time over a Neumann extended
+// copy of the source row so the inner loop runs along x without branches.
+//////////////////////////////////////////////////////
+
+template<typename OT, typename IT, typename KT, typename ACC>
+void Convolution(
+    Image<OT,TargetHost> out, const Image<IT,TargetHost> in, const Image<KT,TargetHost> kern, int kx, int ky
+) {
+    const int w = out.w;
+    const int h = out.h;
+    const int kw = kern.w;
+    const int kh = kern.h;
+
+    if(kw*kh >= CONVOLUTION_FFT_MIN_TAPS) {
+        Image<float,TargetHostAligned,Manage> fin(in.w, in.h);
+        Image<float,TargetHostAligned,Manage> fout(w, h);
+        ParallelForRows(in.h, [&](size_t y0, size_t y1) {
+            for(size_t y=y0; y < y1; ++y) {
+                std::copy(in.RowPtr(y), in.RowPtr(y) + in.w, fin.RowPtr(y));
+            }
+        });
+
+        // Iterative callers convolve with the same kernel over and over, so
+        // the spectrum of the last kernel is kept per calling thread
+        std::vector<float> fkern(kw*kh);
+        for(int r=0; r < kh; ++r) {
+            std::copy(kern.RowPtr(r), kern.RowPtr(r) + kw, &fkern[r*kw]);
+        }
+        static thread_local ConvolutionSpectrum spec;
+        static thread_local std::vector<float> speckern;
+        if(spec.w != (int)in.w || spec.h != (int)in.h || spec.kx != kx || spec.ky != ky ||
+           spec.kw != kw || spec.kh != kh || speckern != fkern) {
+            ConvolutionSpectrumInit(spec, in.w, in.h, Image<float,TargetHost>(&fkern[0], kw, kh, kw*sizeof(float)), kx, ky);
+            speckern.swap(fkern);
+        }
+        Convolution(fout, fin, spec);
+
+        ParallelForRows(h, [&](size_t y0, size_t y1) {
+            for(size_t y=y0; y < y1; ++y) {
+                std::copy(fout.RowPtr(y), fout.RowPtr(y) + w, out.RowPtr(y));
+            }
+        });
+        return;
+    }
+
+    ACC kernsum = 0;
+    for(int r=0; r < kh; ++r) {
+        for(int c=0; c < kw; ++c) {
+            kernsum += kern(c,r);
+        }
+    }
+
+    const int pw = w + kw - 1;
+    std::vector<int> mx(pw);
+    for(int i=0; i < pw; ++i) {
+        mx[i] = ConvolutionMirror(i - kx, in.w);
+    }
+
+    ParallelForRows(h, [&](size_t y0, size_t y1) {
+        std::vector<ACC> ext(pw);
+        std::vector<ACC> acc(w);
+        for(int y=(int)y0; y < (int)y1; ++y) {
+            std::fill(acc.begin(), acc.end(), (ACC)0);
+            for(int r=0; r < kh; ++r) {
+                const IT* ri = in.RowPtr(ConvolutionMirror(y - ky + r, in.h));
+                for(int i=0; i < pw; ++i) {
+                    ext[i] = ri[mx[i]];
+                }
+                for(int c=0; c < kw; ++c) {
+                    const ACC kv = kern(c,r);
+                    const ACC* e = &ext[c];
+                    for(int x=0; x < w; ++x) {
+                        acc[x] += kv * e[x];
+                    }
+                }
+            }
+            OT* ro = out.RowPtr(y);
+            for(int x=0; x < w; ++x) {
+                ro[x] = acc[x] / kernsum;
+            }
+        }
+    });
+}
+
+template KANGAROO_EXPORT void Convolution<float,float,float,float>(Image<float,TargetHost>, const Image<float,TargetHost>, const Image<float,TargetHost>, int, int);
+template KANGAROO_EXPORT void Convolution<float,unsigned char,unsigned char,float>(Image<float,TargetHost>, const Image<unsigned char,TargetHost>, const Image<unsigned char,TargetHost>, int, int);
+
+}
@@ -0,0 +1,87 @@
+#include "cu_deconvolution.h"
+
+#include "host_launch_utils.h"
+#include "Divergence.h"
+#include "cu_rof_denoising.h"
+
+namespace roo {
+
+//////////////////////////////////////////////////////
+// Convolution p ascent on the host
+//////////////////////////////////////////////////////
+
+void DeconvolutionDual_qAscent(
+        Image<float,TargetHost> imgq, const Image<float,TargetHost> imgAu, const Image<float,TargetHost> imgg,
+        float sigma_q, float lambda
+) {
+    ParallelForRows(imgq.h, [&](size_t y0, size_t y1) {
+        for(size_t y=y0; y < y1; ++y) {
+            float* q = imgq.RowPtr(y);
+            const float* Au = imgAu.RowPtr(y);
+            const float* g = imgg.RowPtr(y);
+            for(size_t x=0; x < imgq.w; ++x) {
+                q[x] = ( q[x] + sigma_q * (Au[x] - g[x])) / (1.0f + sigma_q / lambda);
+            }
+        }
+    });
+}
+
+//////////////////////////////////////////////////////
+// Convolution u descent on the host
+//////////////////////////////////////////////////////
+
+void Deconvolution_uDescent(
+        Image<float,TargetHost> imgu, const Image<float2,TargetHost> imgp, const Image<float,TargetHost> imgATq,
+        float tau, float lambda
+) {
+    // DivA is written for Image<float2>, read imgp through one
+    const Image<float2> p(imgp.ptr, imgp.w, imgp.h, imgp.pitch);
+
+    ParallelForRows(imgu.h, [&](size_t y0, size_t y1) {
+        for(size_t y=y0; y < y1; ++y) {
+            float* u = imgu.RowPtr(y);
+            const float* ATq = imgATq.RowPtr(y);
+            for(size_t x=0; x < imgu.w; ++x) {
+                const float divp_np1 = DivA(p,x,y);
+                u[x] = (u[x] + tau * (divp_np1 - lambda * ATq[x]));
+            }
+        }
+    });
+}
+
+//////////////////////////////////////////////////////
+// Deconvolution on the host
+// Convolution correlates, out(x) = sum_c k(c) in(x - kx + c), so its
+// adjoint correlates with k(kw-1-c) about kw-1-kx. Both spectra are built
+// once here instead of on every Convolution.
+//////////////////////////////////////////////////////
+
+void DeconvolutionSpectraInit(DeconvolutionSpectra& spec, int w, int h, const Image<float,TargetHost> kern, int kx, int ky)
+{
+    Image<float,TargetHostAligned,Manage> kernT(kern.w, kern.h);
+    for(size_t r=0; r < kern.h; ++r) {
+        for(size_t c=0; c < kern.w; ++c) {
+            kernT(c,r) = kern(kern.w-1-c, kern.h-1-r);
+        }
+    }
+
+    ConvolutionSpectrumInit(spec.k, w, h, kern, kx, ky);
+    ConvolutionSpectrumInit(spec.kT, w, h, kernT, kern.w-1-kx, kern.h-1-ky);
+}
+
+void Deconvolution(
+        Image<float,TargetHost> u, Image<float2,TargetHost> p, Image<float,TargetHost> q,
+        const Image<float,TargetHost> g, const DeconvolutionSpectra& spec,
+        Image<float,TargetHost> Au, Image<float,TargetHost> ATq,
+        float sigma_p, float sigma_q, float tau, float lambda, float alpha, int iterations
+) {
+    for(int i=0; i < iterations; ++i) {
+        HuberGradU_DualAscentP(p, u, sigma_p, alpha);
+        Convolution(Au, u, spec.k);
+        DeconvolutionDual_qAscent(q, Au, g, sigma_q, lambda);
+        Convolution(ATq, q, spec.kT);
+        Deconvolution_uDescent(u, p, ATq, tau, lambda);
+    }
+}
+
+}
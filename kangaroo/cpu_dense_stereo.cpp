@@ -0,0 +1,494 @@
+#include "cu_dense_stereo.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "host_launch_utils.h"
+#include "InvalidValue.h"
+#include "patch_score.h"
+
+namespace roo
+{
+
+//////////////////////////////////////////////////////
+// Disparity windows of a compact cost volume
+//////////////////////////////////////////////////////
+
+template<typename T>
+void CostVolRangeFromDisparity(CostVolRange<T,TargetHost> vol, const Image<float,TargetHost> seed, int radius, int maxDisp, float sd)
+{
+    const int w = vol.vol.w;
+    const int h = vol.vol.h;
+    const int window = vol.Window();
+
+    // seed may come from a coarser level, disparities scale with width
+    const float scale = (float)w / seed.w;
+    const float yscale = (float)h / seed.h;
+
+    ParallelForRows(h, [&](size_t y0, size_t y1) {
+        for(int y=(int)y0; y < (int)y1; ++y) {
+            const int sy = std::min(std::max((int)((y + 0.5f) / yscale), 0), (int)seed.h-1);
+            for(int x=0; x < w; ++x) {
+                const int sx = std::min(std::max((int)((x + 0.5f) / scale), 0), (int)seed.w-1);
+
+                // 3x3 neighbourhood of the seed so that depth edges are covered
+                float lo = 1E30f;
+                float hi = -1E30f;
+                for(int r=-1; r <= 1; ++r) {
+                    for(int c=-1; c <= 1; ++c) {
+                        const float s = seed.GetWithClampedRange(sx+c, sy+r);
+                        if(std::isfinite(s) && s >= 0) {
+                            lo = std::min(lo, s * scale);
+                            hi = std::max(hi, s * scale);
+                        }
+                    }
+                }
+
+                // disparities that stay within the other view
+                int dmax = maxDisp - 1;
+                if(sd < 0) dmax = std::min(dmax, (int)(x / -sd));
+                if(sd > 0) dmax = std::min(dmax, (int)((w-1-x) / sd));
+
+                int dlo, dhi;
+                if(lo <= hi) {
+                    dlo = std::max(0, (int)std::floor(lo) - radius);
+                    dhi = std::min(dmax, (int)std::ceil(hi) + radius);
+                    // seeds beyond the border still get the last disparities
+                    dlo = std::max(0, std::min(dlo, dhi - 2*radius));
+                }else{
+                    // no valid seed, search from zero
+                    dlo = 0;
+                    dhi = dmax;
+                }
+
+                if(dhi - dlo + 1 > window) {
+                    // keep the window centred on the seed of this pixel
+                    const float s = seed(sx,sy) * scale;
+                    const int centre = std::isfinite(s) && s >= 0 ? (int)(s + 0.5f) : (dlo + dhi) / 2;
+                    dlo = std::max(dlo, std::min(centre - window/2, dhi - window + 1));
+                    dhi = dlo + window - 1;
+                }
+
+                vol.range(x,y) = make_short2(dlo, std::max(0, dhi - dlo + 1));
+            }
+        }
+    });
+}
+
+template KANGAROO_EXPORT void CostVolRangeFromDisparity(CostVolRange<float,TargetHost> vol, const Image<float,TargetHost> seed, int radius, int maxDisp, float sd);
+template KANGAROO_EXPORT void CostVolRangeFromDisparity(CostVolRange<unsigned short,TargetHost> vol, const Image<float,TargetHost> seed, int radius, int maxDisp, float sd);
+
+void CostVolRangeFull(Image<short2,TargetHost> range, int maxDisp, float sd)
+{
+    const int w = range.w;
+    ParallelForRows(range.h, [&](size_t y0, size_t y1) {
+        for(size_t y=y0; y < y1; ++y) {
+            for(int x=0; x < w; ++x) {
+                int dmax = maxDisp - 1;
+                if(sd < 0) dmax = std::min(dmax, (int)(x / -sd));
+                if(sd > 0) dmax = std::min(dmax, (int)((w-1-x) / sd));
+                range(x,y) = make_short2(0, std::max(0, dmax + 1));
+            }
+        }
+    });
+}
+
+//////////////////////////////////////////////////////
+// Cost Volume minimum
+//////////////////////////////////////////////////////
+
+inline int CostVolRangeArgMin(const CostVolRange<float,TargetHost>& vol, int x, int y, int n)
+{
+    int besti = 0;
+    float bestc = vol.vol(x,y,0);
+    for(int i=1; i < n; ++i) {
+        const float c = vol.vol(x,y,i);
+        if(c < bestc) {
+            bestc = c;
+            besti = i;
+        }
+    }
+    return besti;
+}
+
+void CostVolMinimum(Image<float,TargetHost> disp, const CostVolRange<float,TargetHost> vol)
+{
+    ParallelForRows(disp.h, [&](size_t y0, size_t y1) {
+        for(int y=(int)y0; y < (int)y1; ++y) {
+            for(int x=0; x < (int)disp.w; ++x) {
+                const short2 r = vol.range(x,y);
+                disp(x,y) = r.y > 0 ? r.x + CostVolRangeArgMin(vol,x,y,r.y) : InvalidValue<float>::Value();
+            }
+        }
+    });
+}
+
+void CostVolMinimumSubpix(Image<float,TargetHost> disp, const CostVolRange<float,TargetHost> vol)
+{
+    ParallelForRows(disp.h, [&](size_t y0, size_t y1) {
+        for(int y=(int)y0; y < (int)y1; ++y) {
+            for(int x=0; x < (int)disp.w; ++x) {
+                const short2 r = vol.range(x,y);
+                if(r.y <= 0) {
+                    disp(x,y) = InvalidValue<float>::Value();
+                    continue;
+                }
+
+                const int besti = CostVolRangeArgMin(vol,x,y,r.y);
+                float out = r.x + besti;
+
+                // Fit parabola to neighbours, if they are in the window
+                if( 0 < besti && besti < r.y-1 ) {
+                    const float sl = vol.vol(x,y,besti-1);
+                    const float sc = vol.vol(x,y,besti);
+                    const float sr = vol.vol(x,y,besti+1);
+                    const float subpix = - (sr-sl) / (2*(sr-2*sc+sl));
+
+                    // Check that minima is sensible. Otherwise assume bad data.
+                    if( -1 < subpix && subpix < 1 ) {
+                        out += subpix;
+                    }
+                }
+
+                disp(x,y) = out;
+            }
+        }
+    });
+}
+
+//////////////////////////////////////////////////////
+// Fused disparity extraction
+//
+// Disparities of a row are visited once in increasing order. Each cost
+// updates the minimum of its left pixel x and of the right pixel x + sd*d
+// it is matched with, so the right disparity comes from the same read of
+// the volume as the left one, and the left right check needs no extra pass.
+//////////////////////////////////////////////////////
+
+// Minimum of the costs of one pixel, fed with increasing disparities
+struct DisparityTrack
+{
+    inline void Init()
+    {
+        const float inf = std::numeric_limits<float>::infinity();
+        best = second = lag = prev = costl = costr = inf;
+        bestd = last = -2;
+    }
+
+    inline void Add(int d, float c)
+    {
+        const float inf = std::numeric_limits<float>::infinity();
+
+        // prev must hold the cost of d-1, lag the minimum up to d-2
+        if(d != last+1) {
+            lag = std::min(lag, prev);
+            prev = inf;
+        }
+
+        if(c < best) {
+            best = c;
+            bestd = d;
+            costl = prev;
+            costr = inf;
+            second = lag;
+        }else if(d == bestd+1) {
+            costr = c;
+        }else{
+            second = std::min(second, c);
+        }
+
+        lag = std::min(lag, prev);
+        prev = c;
+        last = d;
+    }
+
+    // Parabola through the neighbours of the minimum, as KernCostVolMinimumSubpix
+    inline float Disparity() const
+    {
+        if(bestd < 0) return InvalidValue<float>::Value();
+        const float inf = std::numeric_limits<float>::infinity();
+        if(costl < inf && costr < inf) {
+            const float subpixdisp = bestd - (costr-costl) / (2*(costr-2*best+costl));
+            if( bestd-1 < subpixdisp && subpixdisp < bestd+1 ) {
+                return subpixdisp;
+            }
+        }
+        return bestd;
+    }
+
+    // 1 - best / second best, ignoring the neighbours of the minimum
+    inline float Confidence() const
+    {
+        return (0 < second && second < std::numeric_limits<float>::infinity()) ? 1 - best / second : 0;
+    }
+
+    float best;
+    float second;
+    float lag;
+    float prev;
+    float costl;
+    float costr;
+    int bestd;
+    int last;
+};
+
+struct DenseVolCost
+{
+    DenseVolCost(const Volume<float,TargetHost>& vol, int maxDisp)
+        : vol(vol), maxDisp(std::min<int>(maxDisp, vol.d))
+    {
+    }
+
+    inline void Disparities(int /*y*/, int& dmin, int& dmax) const
+    {
+        dmin = 0;
+        dmax = maxDisp;
+    }
+
+    inline bool Get(int x, int y, int d, float& c) const
+    {
+        c = vol(x,y,d);
+        return true;
+    }
+
+    const Volume<float,TargetHost>& vol;
+    int maxDisp;
+};
+
+struct RangeVolCost
+{
+    RangeVolCost(const CostVolRange<float,TargetHost>& vol)
+        : vol(vol)
+    {
+    }
+
+    inline void Disparities(int y, int& dmin, int& dmax) const
+    {
+        dmin = std::numeric_limits<int>::max();
+        dmax = 0;
+        for(int x=0; x < (int)vol.range.w; ++x) {
+            const short2 r = vol.range(x,y);
+            if(r.y > 0) {
+                dmin = std::min<int>(dmin, r.x);
+                dmax = std::max<int>(dmax, r.x + r.y);
+            }
+        }
+        dmin = std::min(dmin, dmax);
+    }
+
+    inline bool Get(int x, int y, int d, float& c) const
+    {
+        const short2 r = vol.range(x,y);
+        if(d < r.x || d >= r.x + r.y) return false;
+        c = vol.vol(x,y,d - r.x);
+        return true;
+    }
+
+    const CostVolRange<float,TargetHost>& vol;
+};
+
+template<typename Cost>
+void CostVolDisparitiesHost(Image<float,TargetHost> dispL, Image<float,TargetHost> dispR, Image<float,TargetHost> conf, Image<unsigned char,TargetHost> lrcheck, const Cost& cost, float sd, float maxDiff)
+{
+    const int w = dispL.w;
+
+    ParallelForRows(dispL.h, [&](size_t y0, size_t y1) {
+        std::vector<DisparityTrack> tl(w);
+        std::vector<DisparityTrack> tr(w);
+
+        for(int y=(int)y0; y < (int)y1; ++y) {
+            for(int x=0; x < w; ++x) {
+                tl[x].Init();
+                tr[x].Init();
+            }
+
+            int dmin, dmax;
+            cost.Disparities(y, dmin, dmax);
+            for(int d=dmin; d < dmax; ++d) {
+                for(int x=0; x < w; ++x) {
+                    const int xr = x + sd*d;
+                    float c;
+                    if(0 <= xr && xr < w && cost.Get(x,y,d,c)) {
+                        tl[x].Add(d,c);
+                        tr[xr].Add(d,c);
+                    }
+                }
+            }
+
+            for(int x=0; x < w; ++x) {
+                dispL(x,y) = tl[x].Disparity();
+                if(dispR.w) dispR(x,y) = tr[x].Disparity();
+                if(conf.w) conf(x,y) = tl[x].Confidence();
+            }
+
+            if(lrcheck.w) {
+                for(int x=0; x < w; ++x) {
+                    const float dl = dispL(x,y);
+                    const int xr = (int)std::floor(x + sd*dl + 0.5f);
+                    bool ok = false;
+                    if(dl == dl && 0 <= xr && xr < w) {
+                        const float dr = tr[xr].Disparity();
+                        ok = InvalidValue<float>::IsValid(dr) && std::fabs(dl - dr) <= maxDiff;
+                    }
+                    lrcheck(x,y) = ok ? 255 : 0;
+                }
+            }
+        }
+    });
+}
+
+void CostVolDisparities(Image<float,TargetHost> dispL, Image<float,TargetHost> dispR, Image<float,TargetHost> conf, Image<unsigned char,TargetHost> lrcheck, const Volume<float,TargetHost> vol, int maxDisp, float sd, float maxDiff)
+{
+    CostVolDisparitiesHost(dispL, dispR, conf, lrcheck, DenseVolCost(vol, maxDisp), sd, maxDiff);
+}
+
+void CostVolDisparities(Image<float,TargetHost> dispL, Image<float,TargetHost> dispR, Image<float,TargetHost> conf, Image<unsigned char,TargetHost> lrcheck, const CostVolRange<float,TargetHost> vol, float sd, float maxDiff)
+{
+    CostVolDisparitiesHost(dispL, dispR, conf, lrcheck, RangeVolCost(vol), sd, maxDiff);
+}
+
+//////////////////////////////////////////////////////
+// Scanline rectified dense stereo sub-pixel refinement
+//////////////////////////////////////////////////////
+
+// As DefaultSafeScoreType on the device, with reads clamped to the image
+typedef SANDPatchScore<float,2,ImgAccessClamped> HostSafeScoreType;
+
+template<typename TD, typename TI, typename Score>
+void DenseStereoSubpixelRefineHost(
+    Image<float,TargetHost> dDispOut, const Image<TD,TargetHost> dDisp, const Image<TI,TargetHost> dCamLeft, const Image<TI,TargetHost> dCamRight
+) {
+    ParallelForRows(dDisp.h, [&](size_t y0, size_t y1) {
+        for(int y=(int)y0; y < (int)y1; ++y) {
+            for(int x=0; x < (int)dDisp.w; ++x) {
+                const float disp = dDisp(x,y);
+
+                // Ignore invalid and things at infinity
+                if(!(disp >= 0)) {
+                    dDispOut(x,y) = InvalidValue<float>::Value();
+                    continue;
+                }
+
+                // Fit parabola to neighbours
+                const int bestDisp = (int)disp;
+                const float d1 = bestDisp+1;
+                const float d2 = bestDisp;
+                const float d3 = bestDisp-1;
+                const float s1 = Score::Score(dCamLeft, x,y, dCamRight, x-d1,y);
+                const float s2 = Score::Score(dCamLeft, x,y, dCamRight, x-d2,y);
+                const float s3 = Score::Score(dCamLeft, x,y, dCamRight, x-d3,y);
+
+                // Cooefficients of parabola through (d1,s1),(d2,s2),(d3,s3)
+                const float denom = (d1 - d2)*(d1 - d3)*(d2 - d3);
+                const float A = (d3 * (s2 - s1) + d2 * (s1 - s3) + d1 * (s3 - s2)) / denom;
+                const float B = (d3*d3 * (s1 - s2) + d2*d2 * (s3 - s1) + d1*d1 * (s2 - s3)) / denom;
+
+                // Minima of parabola
+                const float newDisp = -B / (2*A);
+
+                // Check that minima is sensible. Otherwise assume bad data.
+                dDispOut(x,y) = (d3 < newDisp && newDisp < d1) ? newDisp : InvalidValue<float>::Value();
+            }
+        }
+    });
+}
+
+void DenseStereoSubpixelRefine(Image<float,TargetHost> dDispOut, const Image<unsigned char,TargetHost> dDisp, const Image<unsigned char,TargetHost> dCamLeft, const Image<unsigned char,TargetHost> dCamRight)
+{
+    DenseStereoSubpixelRefineHost<unsigned char,unsigned char,HostSafeScoreType>(dDispOut, dDisp, dCamLeft, dCamRight);
+}
+
+//////////////////////////////////////////////////////
+// Coarse to fine dense stereo
+//
+// The top level searches every disparity, each finer level only searches
+// a band of searchRad around twice the disparities of the 3x3 coarser
+// neighbours, so work per pixel no longer grows with maxDisp.
+//////////////////////////////////////////////////////
+
+// Integer disparity in [dlo,dhi] with the lowest score, right view at x-d
+template<typename Score, typename TI>
+inline int DenseStereoBest(const Image<TI,TargetHost>& left, const Image<TI,TargetHost>& right, int x, int y, int dlo, int dhi)
+{
+    int bestd = InvalidValue<int>::Value();
+    float best = 1E30f;
+    for(int d=dlo; d <= dhi; ++d) {
+        const float score = Score::Score(left, x,y, right, x-d,y);
+        if(score < best) {
+            best = score;
+            bestd = d;
+        }
+    }
+    return bestd;
+}
+
+template<typename TI, unsigned Levels>
+void DenseStereoPyramid(Image<float,TargetHost> disp, const Pyramid<TI,Levels,TargetHost> left, const Pyramid<TI,Levels,TargetHost> right, int maxDisp, int levels, int searchRad, bool subpix)
+{
+    typedef HostSafeScoreType Score;
+
+    levels = std::max(1, std::min((int)Levels, levels));
+    while(levels > 1 && left.imgs[levels-1].w == 0) --levels;
+
+    // Integer disparities of every level, in pixels of that level
+    Pyramid<float,Levels,TargetHostAligned,Manage> hyp(left.imgs[0].w, left.imgs[0].h);
+
+    for(int l = levels-1; l >= 0; --l) {
+        const Image<TI,TargetHost> L = left.imgs[l];
+        const Image<TI,TargetHost> R = right.imgs[l];
+        const Image<float,TargetHost> coarse = hyp.imgs[std::min(l+1, levels-1)];
+        Image<float,TargetHost> H = hyp.imgs[l];
+        const int maxd = (maxDisp + (1<<l) - 1) >> l;
+        const bool top = (l == levels-1);
+
+        ParallelForRows(L.h, [&](size_t y0, size_t y1) {
+            for(int y=(int)y0; y < (int)y1; ++y) {
+                for(int x=0; x < (int)L.w; ++x) {
+                    const int dmax = std::min(maxd-1, x);
+                    int dlo = 0;
+                    int dhi = dmax;
+
+                    if(!top) {
+                        // band around the hypotheses of the coarser level
+                        float lo = 1E30f;
+                        float hi = -1E30f;
+                        for(int r=-1; r <= 1; ++r) {
+                            for(int c=-1; c <= 1; ++c) {
+                                const float s = coarse.GetWithClampedRange(x/2+c, y/2+r);
+                                if(s >= 0) {
+                                    lo = std::min(lo, 2*s);
+                                    hi = std::max(hi, 2*s);
+                                }
+                            }
+                        }
+                        // no valid hypothesis, fall back to the full search
+                        if(lo <= hi) {
+                            dlo = std::max(0, (int)lo - searchRad);
+                            dhi = std::min(dmax, (int)hi + searchRad);
+                        }
+                    }
+
+                    const int d = DenseStereoBest<Score>(L, R, x, y, dlo, dhi);
+                    H(x,y) = d >= 0 ? (float)d : InvalidValue<float>::Value();
+                }
+            }
+        });
+    }
+
+    if(subpix) {
+        DenseStereoSubpixelRefineHost<float,TI,Score>(disp, hyp.imgs[0], left.imgs[0], right.imgs[0]);
+    }else{
+        disp.CopyFrom(hyp.imgs[0]);
+    }
+}
+
+template KANGAROO_EXPORT void DenseStereoPyramid(Image<float,TargetHost>, const Pyramid<unsigned char,3,TargetHost>, const Pyramid<unsigned char,3,TargetHost>, int, int, int, bool);
+template KANGAROO_EXPORT void DenseStereoPyramid(Image<float,TargetHost>, const Pyramid<unsigned char,4,TargetHost>, const Pyramid<unsigned char,4,TargetHost>, int, int, int, bool);
+template KANGAROO_EXPORT void DenseStereoPyramid(Image<float,TargetHost>, const Pyramid<unsigned char,5,TargetHost>, const Pyramid<unsigned char,5,TargetHost>, int, int, int, bool);
+template KANGAROO_EXPORT void DenseStereoPyramid(Image<float,TargetHost>, const Pyramid<float,3,TargetHost>, const Pyramid<float,3,TargetHost>, int, int, int, bool);
+template KANGAROO_EXPORT void DenseStereoPyramid(Image<float,TargetHost>, const Pyramid<float,4,TargetHost>, const Pyramid<float,4,TargetHost>, int, int, int, bool);
+template KANGAROO_EXPORT void DenseStereoPyramid(Image<float,TargetHost>, const Pyramid<float,5,TargetHost>, const Pyramid<float,5,TargetHost>, int, int, int, bool);
+
+}
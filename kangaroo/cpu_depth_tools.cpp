@@ -0,0 +1,76 @@
+#include "cu_depth_tools.h"
+
+#include "host_launch_utils.h"
+#include "MatUtils.h"
+#include "InvalidValue.h"
+
+namespace roo
+{
+
+//////////////////////////////////////////////////////
+// Disparity to Depth Conversion
+//////////////////////////////////////////////////////
+
+void Disp2Depth(Image<float,TargetHost> dIn, const Image<float,TargetHost> dOut, float fu, float fBaseline, float fMinDisp)
+{
+    Image<float,TargetHost> out = dOut;
+    ParallelForRows(out.h, [&](size_t y0, size_t y1) {
+        for(size_t y=y0; y < y1; ++y) {
+            const float* in = dIn.RowPtr(y);
+            float* o = out.RowPtr(y);
+            for(size_t x=0; x < out.w; ++x) {
+                o[x] = in[x] >= fMinDisp ? fu * fBaseline / in[x] : InvalidValue<float>::Value();
+            }
+        }
+    });
+}
+
+template<typename Tin>
+inline void HostFilterBadKinectData(Image<float,TargetHost> dFiltered, Image<Tin,TargetHost> dKinectDepth)
+{
+    ParallelForRows(dFiltered.h, [&](size_t y0, size_t y1) {
+        for(size_t y=y0; y < y1; ++y) {
+            const Tin* in = dKinectDepth.RowPtr(y);
+            float* out = dFiltered.RowPtr(y);
+            for(size_t x=0; x < dFiltered.w; ++x) {
+                const float z_mm = in[x];
+                out[x] = z_mm >= 200 ? z_mm : InvalidValue<float>::Value();
+            }
+        }
+    });
+}
+
+void FilterBadKinectData(Image<float,TargetHost> dFiltered, Image<unsigned short,TargetHost> dKinectDepth)
+{
+    HostFilterBadKinectData(dFiltered, dKinectDepth);
+}
+
+void FilterBadKinectData(Image<float,TargetHost> dFiltered, Image<float,TargetHost> dKinectDepth)
+{
+    HostFilterBadKinectData(dFiltered, dKinectDepth);
+}
+
+//////////////////////////////////////////////////////
+// Kinect depthmap to vertex array
+//////////////////////////////////////////////////////
+
+template<typename T>
+void DepthToVbo(Image<float4,TargetHost> dVbo, const Image<T,TargetHost> dDepth, ImageIntrinsics K, float depthscale)
+{
+    ParallelForRows(dVbo.h, [&](size_t y0, size_t y1) {
+        for(size_t v=y0; v < y1; ++v) {
+            const T* depth = dDepth.RowPtr(v);
+            float4* vbo = dVbo.RowPtr(v);
+            for(size_t u=0; u < dVbo.w; ++u) {
+                const float kz = depthscale * depth[u];
+                const float3 P = K.Unproject(u,v,kz);
+                vbo[u] = make_float4(P.x,P.y,P.z,1);
+            }
+        }
+    });
+}
+
+template KANGAROO_EXPORT void DepthToVbo<float>( Image<float4,TargetHost> dVbo, const Image<float,TargetHost> dKinectDepth, ImageIntrinsics K, float scale);
+template KANGAROO_EXPORT void DepthToVbo<unsigned short>( Image<float4,TargetHost> dVbo, const Image<unsigned short,TargetHost> dKinectDepth, ImageIntrinsics K, float scale);
+
+}
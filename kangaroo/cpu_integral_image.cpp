@@ -0,0 +1,256 @@
+#include "cu_integral_image.h"
+
+#include <algorithm>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "host_launch_utils.h"
+
+namespace roo
+{
+
+//////////////////////////////////////////////////////
+// Image Transpose on the host
+// Square blocks whose source and destination rows both stay in L1
+//////////////////////////////////////////////////////
+
+const int TRANSPOSE_BLOCK = 32;
+
+template<typename Tout, typename Tin>
+void Transpose(Image<Tout,TargetHost> out, const Image<Tin,TargetHost> in)
+{
+    ParallelForTiles(in.w, in.h, [&](size_t x0, size_t x1, size_t y0, size_t y1) {
+        for(size_t x=x0; x < x1; ++x) {
+            Tout* ro = out.RowPtr(x);
+            for(size_t y=y0; y < y1; ++y) {
+                ro[y] = (Tout)in(x,y);
+            }
+        }
+    }, TRANSPOSE_BLOCK, TRANSPOSE_BLOCK);
+}
+
+template KANGAROO_EXPORT void Transpose(Image<unsigned char,TargetHost>, const Image<unsigned char,TargetHost>);
+template KANGAROO_EXPORT void Transpose(Image<int,TargetHost>, const Image<int,TargetHost>);
+template KANGAROO_EXPORT void Transpose(Image<float,TargetHost>, const Image<float,TargetHost>);
+
+//////////////////////////////////////////////////////
+// PrefixSum on the host
+// Exclusive, as the device scan: out[x] = in[0] + ... + in[x-1]. Four
+// elements are scanned in register with two shifted adds, then offset by
+// the running total.
+//////////////////////////////////////////////////////
+
+template<typename Tout, typename Tin>
+inline void PrefixSumRow(Tout* out, const Tin* in, size_t w)
+{
+    Tout sum = 0;
+    for(size_t x=0; x < w; ++x) {
+        out[x] = sum;
+        sum += (Tout)in[x];
+    }
+}
+
+#if defined(__SSE2__)
+template<>
+inline void PrefixSumRow<float,float>(float* out, const float* in, size_t w)
+{
+    __m128 carry = _mm_setzero_ps();
+    size_t x = 0;
+    for(; x+4 <= w; x += 4) {
+        const __m128 v = _mm_loadu_ps(in+x);
+        __m128 s = _mm_add_ps(v, _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(v), 4)));
+        s = _mm_add_ps(s, _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(s), 8)));
+        const __m128 ex = _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(s), 4));
+        _mm_storeu_ps(out+x, _mm_add_ps(ex, carry));
+        carry = _mm_add_ps(carry, _mm_shuffle_ps(s, s, _MM_SHUFFLE(3,3,3,3)));
+    }
+    float sum = _mm_cvtss_f32(carry);
+    for(; x < w; ++x) {
+        out[x] = sum;
+        sum += in[x];
+    }
+}
+
+template<>
+inline void PrefixSumRow<int,int>(int* out, const int* in, size_t w)
+{
+    __m128i carry = _mm_setzero_si128();
+    size_t x = 0;
+    for(; x+4 <= w; x += 4) {
+        const __m128i v = _mm_loadu_si128((const __m128i*)(in+x));
+        __m128i s = _mm_add_epi32(v, _mm_slli_si128(v, 4));
+        s = _mm_add_epi32(s, _mm_slli_si128(s, 8));
+        _mm_storeu_si128((__m128i*)(out+x), _mm_add_epi32(_mm_slli_si128(s, 4), carry));
+        carry = _mm_add_epi32(carry, _mm_shuffle_epi32(s, _MM_SHUFFLE(3,3,3,3)));
+    }
+    int sum = _mm_cvtsi128_si32(carry);
+    for(; x < w; ++x) {
+        out[x] = sum;
+        sum += in[x];
+    }
+}
+#endif
+
+template<typename Tout, typename Tin>
+void PrefixSumRows(Image<Tout,TargetHost> out, const Image<Tin,TargetHost> in)
+{
+    ParallelForRows(in.h, [&](size_t y0, size_t y1) {
+        for(size_t y=y0; y < y1; ++y) {
+            PrefixSumRow<Tout,Tin>(out.RowPtr(y), in.RowPtr(y), in.w);
+        }
+    });
+}
+
+template KANGAROO_EXPORT void PrefixSumRows(Image<int,TargetHost>, const Image<unsigned char,TargetHost>);
+template KANGAROO_EXPORT void PrefixSumRows(Image<int,TargetHost>, const Image<int,TargetHost>);
+template KANGAROO_EXPORT void PrefixSumRows(Image<float,TargetHost>, const Image<float,TargetHost>);
+
+//////////////////////////////////////////////////////
+// Large Radius Box Filter using Integral Image on the host
+// Windows [x-rad,x+rad) x [y-rad,y+rad) clipped to [0,w-1) x [0,h-1), as
+// KernBoxFilterIntegralImage. Tiles go down the columns of the output so
+// the transposed integral image is read along its rows.
+//////////////////////////////////////////////////////
+
+template<typename Tout, typename Tin>
+void BoxFilterIntegralImage(Image<Tout,TargetHost> out, const Image<Tin,TargetHost> IntegralImageT, int rad)
+{
+    ParallelForTiles(out.w, out.h, [&](size_t x0, size_t x1, size_t y0, size_t y1) {
+        for(int x=(int)x0; x < (int)x1; ++x) {
+            const int minx = std::max(0,x-rad);
+            const int maxx = std::min((int)out.w-1,x+rad);
+            const Tin* IminX = IntegralImageT.RowPtr(minx);
+            const Tin* ImaxX = IntegralImageT.RowPtr(maxx);
+
+            for(int y=(int)y0; y < (int)y1; ++y) {
+                const int miny = std::max(0,y-rad);
+                const int maxy = std::min((int)out.h-1,y+rad);
+                const int area = (maxx - minx) * (maxy - miny);
+                const Tin sum = ImaxX[maxy] + IminX[miny] - ImaxX[miny] - IminX[maxy];
+                out(x,y) = (float)sum / area;
+            }
+        }
+    }, TRANSPOSE_BLOCK, 128);
+}
+
+template KANGAROO_EXPORT void BoxFilterIntegralImage(Image<float,TargetHost>, const Image<int,TargetHost>, int);
+template KANGAROO_EXPORT void BoxFilterIntegralImage(Image<float,TargetHost>, const Image<float,TargetHost>, int);
+
+//////////////////////////////////////////////////////
+// Fused guided filter on the host
+//
+// Box means of several per pixel terms are produced one output row at a
+// time: column sums over the window rows slide down the image, and each row
+// of them becomes an exclusive prefix sum, i.e. one row of the integral
+// image, so every mean is two lookups whatever the radius. The first sweep
+// takes the means of I, p, I*I and I*p together and keeps only a and b, the
+// second takes the means of a and b and writes q. Windows are those of
+// BoxFilter.
+//////////////////////////////////////////////////////
+
+// terms(y, t) writes the NC term rows of image row y to t[0..NC-1],
+// out(y, m) gets their window means m[0..NC-1] for output row y.
+template<int NC, typename Terms, typename Out>
+void BoxMeanRows(int w, int h, int rad, Terms terms, Out out)
+{
+    ParallelForRows(h, [&](size_t y0, size_t y1) {
+        std::vector<float> buf(3*NC*w + w);
+        float* t[NC];
+        float* col[NC];
+        float* mean[NC];
+        for(int c=0; c < NC; ++c) {
+            t[c] = &buf[c*w];
+            col[c] = &buf[(NC+c)*w];
+            mean[c] = &buf[(2*NC+c)*w];
+        }
+        float* pre = &buf[3*NC*w];
+        std::fill(col[0], col[0] + NC*w, 0.0f);
+
+        // Window rows [lo,hi) currently in col
+        int lo = std::max(0, (int)y0-rad);
+        int hi = lo;
+
+        for(int y=(int)y0; y < (int)y1; ++y) {
+            const int miny = std::max(0,y-rad);
+            const int maxy = std::min(h-1,y+rad);
+
+            for(; hi < maxy; ++hi) {
+                terms(hi, t);
+                for(int c=0; c < NC; ++c) {
+                    for(int x=0; x < w; ++x) col[c][x] += t[c][x];
+                }
+            }
+            for(; lo < miny; ++lo) {
+                terms(lo, t);
+                for(int c=0; c < NC; ++c) {
+                    for(int x=0; x < w; ++x) col[c][x] -= t[c][x];
+                }
+            }
+
+            const float winh = (float)(maxy - miny);
+            for(int c=0; c < NC; ++c) {
+                PrefixSumRow<float,float>(pre, col[c], w);
+                float* m = mean[c];
+                for(int x=0; x < w; ++x) {
+                    const int minx = std::max(0,x-rad);
+                    const int maxx = std::min(w-1,x+rad);
+                    m[x] = (pre[maxx] - pre[minx]) / ((maxx - minx) * winh);
+                }
+            }
+
+            out(y, mean);
+        }
+    }, std::max(8, 2*rad));
+}
+
+void GuidedFilter(Image<float,TargetHost> q, const Image<float,TargetHost> I, const Image<float,TargetHost> p, int rad, float eps)
+{
+    const int w = I.w;
+    const int h = I.h;
+    Image<float,TargetHostAligned,Manage> a(w,h);
+    Image<float,TargetHostAligned,Manage> b(w,h);
+
+    BoxMeanRows<4>(w, h, rad,
+        [&](int y, float* const* t) {
+            const float* rI = I.RowPtr(y);
+            const float* rp = p.RowPtr(y);
+            for(int x=0; x < w; ++x) {
+                t[0][x] = rI[x];
+                t[1][x] = rp[x];
+                t[2][x] = rI[x]*rI[x];
+                t[3][x] = rI[x]*rp[x];
+            }
+        },
+        [&](int y, float* const* m) {
+            float* ra = a.RowPtr(y);
+            float* rb = b.RowPtr(y);
+            for(int x=0; x < w; ++x) {
+                const float meanI = m[0][x];
+                const float meanP = m[1][x];
+                const float varI = m[2][x] - meanI*meanI;
+                const float covIP = m[3][x] - meanI*meanP;
+                ra[x] = covIP / (varI + eps);
+                rb[x] = meanP - ra[x]*meanI;
+            }
+        }
+    );
+
+    BoxMeanRows<2>(w, h, rad,
+        [&](int y, float* const* t) {
+            std::copy(a.RowPtr(y), a.RowPtr(y) + w, t[0]);
+            std::copy(b.RowPtr(y), b.RowPtr(y) + w, t[1]);
+        },
+        [&](int y, float* const* m) {
+            const float* rI = I.RowPtr(y);
+            float* rq = q.RowPtr(y);
+            for(int x=0; x < w; ++x) {
+                rq[x] = m[0][x]*rI[x] + m[1][x];
+            }
+        }
+    );
+}
+
+}
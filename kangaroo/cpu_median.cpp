@@ -0,0 +1,205 @@
+#include "cu_median.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <set>
+#include <vector>
+
+#include "extra/BitonicSortingNetwork.h"
+#include "host_launch_utils.h"
+#include "host_simd.h"
+#include "InvalidValue.h"
+
+namespace roo
+{
+
+using namespace simd;
+
+//////////////////////////////////////////////////////
+// Median Filter on the host
+//
+// Sorting networks as in cu_median.cu, but each network element holds
+// MEDIAN_LANES neighbouring pixels instead of one, so a compare / swap is a
+// min and a max over a whole block of pixels, with no branches. Networks
+// are lists of (a,b) with the smaller value going to a: known exchange
+// networks for the plain medians, and BitonicNetwork pruned to the upper
+// half of the sorted order for the reject negative ones.
+//////////////////////////////////////////////////////
+
+// Replaces NaN and +-inf by -inf, which sorts below every valid value, and
+// counts them in bad
+#if defined(__AVX__)
+static inline mvec MvRejectInvalid(mvec a, mvec& bad) {
+    const __m256 ok = _mm256_cmp_ps(MvAbs(a), _mm256_set1_ps(std::numeric_limits<float>::max()), _CMP_LE_OQ);
+    bad = _mm256_add_ps(bad, _mm256_andnot_ps(ok, _mm256_set1_ps(1.0f)));
+    return _mm256_blendv_ps(_mm256_set1_ps(-std::numeric_limits<float>::infinity()), a, ok);
+}
+#elif defined(__SSE2__)
+static inline mvec MvRejectInvalid(mvec a, mvec& bad) {
+    const __m128 ok = _mm_cmple_ps(MvAbs(a), _mm_set1_ps(std::numeric_limits<float>::max()));
+    bad = _mm_add_ps(bad, _mm_andnot_ps(ok, _mm_set1_ps(1.0f)));
+    return _mm_or_ps(_mm_and_ps(ok, a), _mm_andnot_ps(ok, _mm_set1_ps(-std::numeric_limits<float>::infinity())));
+}
+#else
+static inline mvec MvRejectInvalid(mvec a, mvec& bad) {
+    const bool ok = std::fabs(a) <= std::numeric_limits<float>::max();
+    bad += ok ? 0 : 1;
+    return ok ? a : -std::numeric_limits<float>::infinity();
+}
+#endif
+
+// Pixels of a row filtered together, a multiple of MV
+const int MEDIAN_LANES = 16;
+
+// Exchange network for the median of 9 in v[4] (Paeth)
+const int MEDIAN_NETWORK_9[][2] = {
+    {1,2}, {4,5}, {7,8}, {0,1}, {3,4}, {6,7}, {1,2}, {4,5}, {7,8}, {0,3},
+    {5,8}, {4,7}, {3,6}, {1,4}, {2,5}, {4,7}, {4,2}, {6,4}, {4,2}
+};
+
+// Exchange network for the median of 25 in v[12] (Devillard). The table of
+// KernMedianFilter5x5 does not select the median for every input.
+const int MEDIAN_NETWORK_25[][2] = {
+    {0,1},    {3,4},    {2,4},    {2,3},    {6,7},    {5,7},    {5,6},    {9,10},   {8,10},   {8,9},
+    {12,13},  {11,13},  {11,12},  {15,16},  {14,16},  {14,15},  {18,19},  {17,19},  {17,18},  {21,22},
+    {20,22},  {20,21},  {23,24},  {2,5},    {3,6},    {0,6},    {0,3},    {4,7},    {1,7},    {1,4},
+    {11,14},  {8,14},   {8,11},   {12,15},  {9,15},   {9,12},   {13,16},  {10,16},  {10,13},  {20,23},
+    {17,23},  {17,20},  {21,24},  {18,24},  {18,21},  {19,22},  {8,17},   {9,18},   {0,18},   {0,9},
+    {10,19},  {1,19},   {1,10},   {11,20},  {2,20},   {2,11},   {12,21},  {3,21},   {3,12},   {13,22},
+    {4,22},   {4,13},   {14,23},  {5,23},   {5,14},   {15,24},  {6,24},   {6,15},   {7,16},   {7,19},
+    {13,21},  {15,23},  {7,13},   {7,15},   {1,9},    {3,11},   {5,17},   {11,17},  {9,17},   {4,10},
+    {6,12},   {7,14},   {4,6},    {4,7},    {12,14},  {10,14},  {6,7},    {10,12},  {6,10},   {6,17},
+    {12,17},  {7,17},   {7,10},   {12,18},  {7,12},   {10,18},  {12,20},  {10,20},  {10,12}
+};
+
+template<size_t N>
+inline std::vector<biswap> MedianNetworkFromTable(const int (&table)[N][2])
+{
+    std::vector<biswap> swaps(N);
+    for(size_t i=0; i < N; ++i) {
+        swaps[i] = biswap(table[i][0], table[i][1]);
+    }
+    return swaps;
+}
+
+// Bitonic sort of n numbers reduced to the swaps that decide the upper half
+// of the sorted order, which holds the median of the valid values once the
+// invalid ones have been made to sort first.
+inline std::vector<biswap> MedianNetworkUpperHalf(int n)
+{
+    BitonicNetwork network(n);
+    network.Compute();
+    std::set<int> desired;
+    for(int i=n/2; i < n; ++i) {
+        desired.insert(i);
+    }
+    network.Prune(desired);
+    return network.Swaps();
+}
+
+// Median of the (2*RAD+1)^2 window of every pixel, borders clamped. With
+// reject, invalid values are left out of the median and pixels with at
+// least maxbad of them come out invalid.
+template<int RAD>
+void MedianFilterNetwork(
+    Image<float,TargetHost> dOut, const Image<float,TargetHost> dIn,
+    const std::vector<biswap>& swaps, bool reject, int maxbad
+) {
+    const int kw = 2*RAD+1;
+    const int kpix = kw*kw;
+    const int w = dOut.w;
+
+    ParallelForRows(dOut.h, [&](size_t y0, size_t y1) {
+        float v[kpix][MEDIAN_LANES];
+        float bad[MEDIAN_LANES];
+
+        for(int y=(int)y0; y < (int)y1; ++y) {
+            for(int x0=0; x0 < w; x0 += MEDIAN_LANES) {
+                const bool inside = x0 >= RAD && x0 + MEDIAN_LANES + RAD <= (int)dIn.w;
+
+                for(int dX = -RAD; dX <= RAD; ++dX) {
+                    for(int dY = -RAD; dY <= RAD; ++dY) {
+                        float* vk = v[(dX + RAD) * kw + (dY + RAD)];
+                        if(inside) {
+                            const int yy = std::min(std::max(y+dY, 0), (int)dIn.h-1);
+                            std::copy(dIn.RowPtr(yy) + x0 + dX, dIn.RowPtr(yy) + x0 + dX + MEDIAN_LANES, vk);
+                        }else{
+                            for(int l=0; l < MEDIAN_LANES; ++l) {
+                                vk[l] = dIn.GetWithClampedRange(x0+l+dX, y+dY);
+                            }
+                        }
+                    }
+                }
+
+                // Invalid values to -inf so they sort first, and counted
+                std::fill(bad, bad + MEDIAN_LANES, 0.0f);
+                if(reject) {
+                    for(int l=0; l < MEDIAN_LANES; l += MV) {
+                        mvec nbad = MvLoad(bad + l);
+                        for(int k=0; k < kpix; ++k) {
+                            MvStore(v[k] + l, MvRejectInvalid(MvLoad(v[k] + l), nbad));
+                        }
+                        MvStore(bad + l, nbad);
+                    }
+                }
+
+                for(size_t s=0; s < swaps.size(); ++s) {
+                    float* va = v[swaps[s].first];
+                    float* vb = v[swaps[s].second];
+                    for(int l=0; l < MEDIAN_LANES; l += MV) {
+                        const mvec a = MvLoad(va + l);
+                        const mvec b = MvLoad(vb + l);
+                        MvStore(va + l, MvMin(a,b));
+                        MvStore(vb + l, MvMax(a,b));
+                    }
+                }
+
+                // Select median, ignoring bad values.
+                const int n = std::min(MEDIAN_LANES, w - x0);
+                for(int l=0; l < n; ++l) {
+                    const int nbad = (int)bad[l];
+                    const bool ok = !reject || (nbad < maxbad && nbad < kpix);
+                    dOut(x0+l, y) = ok ? v[(kpix+nbad)/2][l] : InvalidValue<float>::Value();
+                }
+            }
+        }
+    });
+}
+
+void MedianFilter3x3(
+    Image<float,TargetHost> dOut, const Image<float,TargetHost> dIn
+) {
+    static const std::vector<biswap> swaps = MedianNetworkFromTable(MEDIAN_NETWORK_9);
+    MedianFilterNetwork<1>(dOut, dIn, swaps, false, 0);
+}
+
+void MedianFilter5x5(
+    Image<float,TargetHost> dOut, const Image<float,TargetHost> dIn
+) {
+    static const std::vector<biswap> swaps = MedianNetworkFromTable(MEDIAN_NETWORK_25);
+    MedianFilterNetwork<2>(dOut, dIn, swaps, false, 0);
+}
+
+void MedianFilterRejectNegative5x5(
+    Image<float,TargetHost> dOut, const Image<float,TargetHost> dIn, int maxbad
+) {
+    static const std::vector<biswap> swaps = MedianNetworkUpperHalf(25);
+    MedianFilterNetwork<2>(dOut, dIn, swaps, true, maxbad);
+}
+
+void MedianFilterRejectNegative7x7(
+    Image<float,TargetHost> dOut, const Image<float,TargetHost> dIn, int maxbad
+) {
+    static const std::vector<biswap> swaps = MedianNetworkUpperHalf(49);
+    MedianFilterNetwork<3>(dOut, dIn, swaps, true, maxbad);
+}
+
+void MedianFilterRejectNegative9x9(
+    Image<float,TargetHost> dOut, const Image<float,TargetHost> dIn, int maxbad
+) {
+    static const std::vector<biswap> swaps = MedianNetworkUpperHalf(81);
+    MedianFilterNetwork<4>(dOut, dIn, swaps, true, maxbad);
+}
+
+}
@@ -0,0 +1,48 @@
+#include "cu_normals.h"
+
+#include "host_launch_utils.h"
+
+namespace roo
+{
+
+//////////////////////////////////////////////////////
+// Normals from VBO
+//////////////////////////////////////////////////////
+
+void NormalsFromVbo(Image<float4,TargetHost> dN, const Image<float4,TargetHost> dV)
+{
+    ParallelForRows(dN.h, [&](size_t y0, size_t y1) {
+        for(size_t v=y0; v < y1; ++v) {
+            float4* N = dN.RowPtr(v);
+
+            if(v+1 >= dN.h) {
+                std::fill(N, N + dN.w, make_float4(0,0,0,0));
+                continue;
+            }
+
+            const float4* Vrow = dV.RowPtr(v);
+            const float4* Vup = dV.RowPtr(v+1);
+
+            for(size_t u=0; u+1 < dN.w; ++u) {
+                const float4 Vc = Vrow[u];
+                const float4 a = Vrow[u+1] - Vc;
+                const float4 b = Vup[u] - Vc;
+
+                const float3 axb = make_float3(
+                    a.y*b.z - a.z*b.y,
+                    a.z*b.x - a.x*b.z,
+                    a.x*b.y - a.y*b.x
+                );
+
+                const float magaxb = length(axb);
+                N[u] = make_float4(-axb.x/magaxb, -axb.y/magaxb, -axb.z/magaxb,1);
+            }
+
+            if(dN.w > 0) {
+                N[dN.w-1] = make_float4(0,0,0,0);
+            }
+        }
+    });
+}
+
+}
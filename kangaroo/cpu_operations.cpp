@@ -0,0 +1,210 @@
+#include <kangaroo/cu_operations.h>
+
+#include <vector>
+
+#include "MatUtils.h"
+#include "host_launch_utils.h"
+
+namespace roo
+{
+
+//////////////////////////////////////////////////////
+// Image Fill
+//////////////////////////////////////////////////////
+
+template<typename T>
+void Fill(Image<T,TargetHost> img, T val)
+{
+    ParallelForRows(img.h, [&](size_t y0, size_t y1) {
+        for(size_t y=y0; y < y1; ++y) {
+            T* row = img.RowPtr(y);
+            std::fill(row, row + img.w, val);
+        }
+    });
+}
+
+//////////////////////////////////////////////////////
+// Image Scale / Bias
+// b = s*a+offset
+//////////////////////////////////////////////////////
+
+template<typename Tout, typename Tin, typename Tup>
+void ElementwiseScaleBias(Image<Tout,TargetHost> b, const Image<Tin,TargetHost> a, float s, Tup offset)
+{
+    ParallelForRows(b.h, [&](size_t y0, size_t y1) {
+        for(size_t y=y0; y < y1; ++y) {
+            const Tin* ra = a.RowPtr(y);
+            Tout* rb = b.RowPtr(y);
+            for(size_t x=0; x < b.w; ++x) {
+                const Tup v1 = ConvertPixel<Tup,Tin>(ra[x]);
+                rb[x] = ConvertPixel<Tout,Tup>(s*v1+offset);
+            }
+        }
+    });
+}
+
+//////////////////////////////////////////////////////
+// Image Addition
+// c = sa*a + sb*b + offset
+//////////////////////////////////////////////////////
+
+template<typename Tout, typename Tin1, typename Tin2, typename Tup>
+void ElementwiseAdd(Image<Tout,TargetHost> c, const Image<Tin1,TargetHost> a, const Image<Tin2,TargetHost> b, Tup sa, Tup sb, Tup offset )
+{
+    ParallelForRows(c.h, [&](size_t y0, size_t y1) {
+        for(size_t y=y0; y < y1; ++y) {
+            const Tin1* ra = a.RowPtr(y);
+            const Tin2* rb = b.RowPtr(y);
+            Tout* rc = c.RowPtr(y);
+            for(size_t x=0; x < c.w; ++x) {
+                const Tup v1 = sa * ConvertPixel<Tup,Tin1>(ra[x]);
+                const Tup v2 = sb * ConvertPixel<Tup,Tin2>(rb[x]);
+                rc[x] = ConvertPixel<Tout,Tup>(v1+v2+offset);
+            }
+        }
+    });
+}
+
+//////////////////////////////////////////////////////
+// Image Multiplication
+// c = scalar * a*b + offset
+//////////////////////////////////////////////////////
+
+template<typename Tout, typename Tin1, typename Tin2, typename Tup>
+void ElementwiseMultiply(Image<Tout,TargetHost> c, const Image<Tin1,TargetHost> a, const Image<Tin2,TargetHost> b, Tup scalar, Tup offset )
+{
+    ParallelForRows(c.h, [&](size_t y0, size_t y1) {
+        for(size_t y=y0; y < y1; ++y) {
+            const Tin1* ra = a.RowPtr(y);
+            const Tin2* rb = b.RowPtr(y);
+            Tout* rc = c.RowPtr(y);
+            for(size_t x=0; x < c.w; ++x) {
+                const Tup v1 = ConvertPixel<Tup,Tin1>(ra[x]);
+                const Tup v2 = ConvertPixel<Tup,Tin2>(rb[x]);
+                rc[x] = ConvertPixel<Tout,Tup>( scalar * (v1 * v2) + offset );
+            }
+        }
+    });
+}
+
+//////////////////////////////////////////////////////
+// Image Division
+// c = scalar * (a+sa) / (b+sb) + offset
+//////////////////////////////////////////////////////
+
+template<typename Tout, typename Tin1, typename Tin2, typename Tup>
+void ElementwiseDivision(Image<Tout,TargetHost> c, const Image<Tin1,TargetHost> a, const Image<Tin2,TargetHost> b, Tup sa, Tup sb, Tup scalar, Tup offset)
+{
+    ParallelForRows(c.h, [&](size_t y0, size_t y1) {
+        for(size_t y=y0; y < y1; ++y) {
+            const Tin1* ra = a.RowPtr(y);
+            const Tin2* rb = b.RowPtr(y);
+            Tout* rc = c.RowPtr(y);
+            for(size_t x=0; x < c.w; ++x) {
+                const Tup v1 = ConvertPixel<Tup,Tin1>(ra[x]);
+                const Tup v2 = ConvertPixel<Tup,Tin2>(rb[x]);
+                rc[x] = ConvertPixel<Tout,Tup>( scalar * (v1+sa)/(v2+sb) + offset );
+            }
+        }
+    });
+}
+
+//////////////////////////////////////////////////////
+// Image Square
+// b = scalar * a^2 + offset
+//////////////////////////////////////////////////////
+
+template<typename Tout, typename Tin, typename Tup>
+void ElementwiseSquare(Image<Tout,TargetHost> b, const Image<Tin,TargetHost> a, Tup scalar, Tup offset )
+{
+    ParallelForRows(b.h, [&](size_t y0, size_t y1) {
+        for(size_t y=y0; y < y1; ++y) {
+            const Tin* ra = a.RowPtr(y);
+            Tout* rb = b.RowPtr(y);
+            for(size_t x=0; x < b.w; ++x) {
+                const Tup v1 = ConvertPixel<Tup,Tin>(ra[x]);
+                rb[x] = ConvertPixel<Tout,Tup>( (scalar * v1*v1) + offset );
+            }
+        }
+    });
+}
+
+//////////////////////////////////////////////////////
+// Image Multiplication / Addition
+// d = sab*a*b+ sc*c + offset
+//////////////////////////////////////////////////////
+
+template<typename Tout, typename Tin1, typename Tin2, typename Tin3, typename Tup>
+void ElementwiseMultiplyAdd(Image<Tout,TargetHost> d, const Image<Tin1,TargetHost> a, const Image<Tin2,TargetHost> b, const Image<Tin3,TargetHost> c, Tup sab, Tup sc, Tup offset)
+{
+    ParallelForRows(d.h, [&](size_t y0, size_t y1) {
+        for(size_t y=y0; y < y1; ++y) {
+            const Tin1* ra = a.RowPtr(y);
+            const Tin2* rb = b.RowPtr(y);
+            const Tin3* rc = c.RowPtr(y);
+            Tout* rd = d.RowPtr(y);
+            for(size_t x=0; x < d.w; ++x) {
+                const Tup v1 = ConvertPixel<Tup,Tin1>(ra[x]);
+                const Tup v2 = ConvertPixel<Tup,Tin2>(rb[x]);
+                const Tup v3 = ConvertPixel<Tup,Tin3>(rc[x]);
+                rd[x] = ConvertPixel<Tout,Tup>( sab*v1*v2 + sc*v3 + offset );
+            }
+        }
+    });
+}
+
+//////////////////////////////////////////////////////
+// Image Abs elements
+//////////////////////////////////////////////////////
+
+template<typename Tout, typename T>
+Tout ImageL1(Image<T,TargetHost> img, Image<unsigned char,TargetHost> /*scratch*/)
+{
+    // One partial sum per row keeps the result independent of thread count
+    std::vector<Tout> rowsum(img.h, 0);
+
+    ParallelForRows(img.h, [&](size_t y0, size_t y1) {
+        for(size_t y=y0; y < y1; ++y) {
+            const T* row = img.RowPtr(y);
+            Tout sum = 0;
+            for(size_t x=0; x < img.w; ++x) {
+                sum += L1(row[x]);
+            }
+            rowsum[y] = sum;
+        }
+    });
+
+    Tout sum = 0;
+    for(size_t y=0; y < img.h; ++y) {
+        sum += rowsum[y];
+    }
+    return sum;
+}
+
+//////////////////////////////////////////////////////
+// Instantiate Templates
+//////////////////////////////////////////////////////
+
+template KANGAROO_EXPORT void Fill(Image<float,TargetHost> img, float val);
+template KANGAROO_EXPORT void Fill(Image<float3,TargetHost> img, float3 val);
+template KANGAROO_EXPORT void Fill(Image<float4,TargetHost> img, float4 val);
+template KANGAROO_EXPORT void Fill(Image<unsigned char,TargetHost> img, unsigned char val);
+template KANGAROO_EXPORT void Fill(Image<uchar3,TargetHost> img, uchar3 val);
+template KANGAROO_EXPORT void Fill(Image<uchar4,TargetHost> img, uchar4 val);
+template KANGAROO_EXPORT void ElementwiseScaleBias(Image<float,TargetHost> b, const Image<unsigned char,TargetHost> a, float s, float offset);
+template KANGAROO_EXPORT void ElementwiseScaleBias(Image<float,TargetHost> b, const Image<unsigned short,TargetHost> a, float s, float offset);
+template KANGAROO_EXPORT void ElementwiseScaleBias(Image<float,TargetHost> b, const Image<float,TargetHost> a, float s, float offset);
+template KANGAROO_EXPORT void ElementwiseScaleBias(Image<float2,TargetHost> b, const Image<float2,TargetHost> a, float s, float2 offset);
+template KANGAROO_EXPORT void ElementwiseAdd(Image<unsigned char,TargetHost>, Image<unsigned char,TargetHost>, Image<unsigned char,TargetHost>, int, int, int);
+template KANGAROO_EXPORT void ElementwiseAdd(Image<float,TargetHost>, Image<float,TargetHost>, Image<float,TargetHost>, float, float, float);
+template KANGAROO_EXPORT void ElementwiseMultiply(Image<float,TargetHost>, Image<float,TargetHost>, Image<float,TargetHost>, float,float);
+template KANGAROO_EXPORT void ElementwiseMultiply(Image<float,TargetHost>, Image<unsigned char,TargetHost>, Image<unsigned char,TargetHost>, float,float);
+template KANGAROO_EXPORT void ElementwiseSquare<float,float,float>(Image<float,TargetHost>, Image<float,TargetHost>, float, float);
+template KANGAROO_EXPORT void ElementwiseSquare<float,unsigned char,float>(Image<float,TargetHost>, Image<unsigned char,TargetHost>, float, float);
+template KANGAROO_EXPORT void ElementwiseMultiplyAdd(Image<float,TargetHost> d, const Image<float,TargetHost> a, const Image<float,TargetHost> b, const Image<float,TargetHost> c, float sab, float sc, float offset);
+template KANGAROO_EXPORT void ElementwiseMultiplyAdd(Image<float,TargetHost> d, const Image<float,TargetHost> a, const Image<unsigned char,TargetHost> b, const Image<float,TargetHost> c, float sab, float sc, float offset);
+template KANGAROO_EXPORT void ElementwiseDivision(Image<float,TargetHost> c, const Image<float,TargetHost> a, const Image<float,TargetHost> b, float sa, float sb, float scalar, float offset);
+
+template KANGAROO_EXPORT float ImageL1(Image<float2,TargetHost> img, Image<unsigned char,TargetHost> scratch);
+
+}
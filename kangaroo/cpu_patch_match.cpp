@@ -0,0 +1,253 @@
+#include "cu_dense_stereo.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+#include "host_launch_utils.h"
+#include "InvalidValue.h"
+#include "patch_score.h"
+
+namespace roo
+{
+
+//////////////////////////////////////////////////////
+// PatchMatch stereo on the host
+//
+// Every pixel holds a disparity plane d = a*x + b*y + c. Planes start out
+// random, then each iteration lets the pixels of one colour of a
+// checkerboard try the planes of pixels of the other colour up to
+// PATCH_MATCH_REACH away along rows and columns (so pixels of a colour are
+// independent) and random perturbations of their own plane within a
+// shrinking range. Work and memory are independent of maxDisp.
+//////////////////////////////////////////////////////
+
+// Furthest neighbour tried during propagation, odd
+const int PATCH_MATCH_REACH = 5;
+
+// Reproducible random numbers, independent of the thread layout
+inline unsigned int PatchMatchHash(unsigned int a, unsigned int b, unsigned int c, unsigned int d)
+{
+    unsigned int h = a * 0x9E3779B1u;
+    h ^= b + 0x7F4A7C15u + (h << 6) + (h >> 2);
+    h ^= c + 0x7F4A7C15u + (h << 6) + (h >> 2);
+    h ^= d + 0x7F4A7C15u + (h << 6) + (h >> 2);
+    h ^= h >> 16;
+    h *= 0x85EBCA6Bu;
+    h ^= h >> 13;
+    h *= 0xC2B2AE35u;
+    h ^= h >> 16;
+    return h;
+}
+
+// uniform in [-1,1)
+inline float PatchMatchRandom(unsigned int& state)
+{
+    state = state * 1664525u + 1013904223u;
+    return (state >> 8) * (2.0f / 16777216.0f) - 1.0f;
+}
+
+// Plane through disparity d at (x,y) with normal n, n.z > 0
+inline float3 PatchMatchPlane(float x, float y, float d, float3 n)
+{
+    const float a = -n.x / n.z;
+    const float b = -n.y / n.z;
+    return make_float3(a, b, d - a*x - b*y);
+}
+
+inline float3 PatchMatchNormal(const float3 p)
+{
+    const float s = 1.0f / std::sqrt(p.x*p.x + p.y*p.y + 1.0f);
+    return make_float3(-p.x*s, -p.y*s, s);
+}
+
+// Patch scores along a disparity plane: tap (x+c,y+r) of the left view is
+// compared with the right view at its own disparity d + a*c + b*r, so the
+// slant (a,b) of a plane changes the score as well as its disparity d at
+// the centre. Same sums as SADPatchScore / SSNDPatchScore otherwise.
+template<int RAD>
+struct PatchMatchSADScore
+{
+    inline static float Score(const Image<float,TargetHost>& left, const Image<float,TargetHost>& right, int x, int y, float d, float a, float b)
+    {
+        typedef ImgAccessBilinearClamped<float> Access;
+        float sum_abs_diff = 0;
+        for(int r=-RAD; r <= RAD; ++r) {
+            for(int c=-RAD; c <= RAD; ++c) {
+                const float i1 = Access::Get(left, (float)(x+c), (float)(y+r));
+                const float i2 = Access::Get(right, x+c - (d + a*c + b*r), (float)(y+r));
+                sum_abs_diff += std::abs(i1 - i2);
+            }
+        }
+        return sum_abs_diff;
+    }
+};
+
+template<int RAD>
+struct PatchMatchSSNDScore
+{
+    inline static float Score(const Image<float,TargetHost>& left, const Image<float,TargetHost>& right, int x, int y, float d, float a, float b)
+    {
+        typedef ImgAccessBilinearClamped<float> Access;
+        float sxi = 0, sxi2 = 0, syi = 0, syi2 = 0, sxiyi = 0;
+        for(int r=-RAD; r <= RAD; ++r) {
+            for(int c=-RAD; c <= RAD; ++c) {
+                const float xi = Access::Get(left, (float)(x+c), (float)(y+r));
+                const float yi = Access::Get(right, x+c - (d + a*c + b*r), (float)(y+r));
+                sxi += xi;
+                syi += yi;
+                sxi2 += xi*xi;
+                syi2 += yi*yi;
+                sxiyi += xi*yi;
+            }
+        }
+
+        const float n = (float)((2*RAD+1)*(2*RAD+1));
+        const float mx = sxi / n;
+        const float my = syi / n;
+        return sxi2 - 2*mx*sxi + n*mx*mx
+             + 2*(-sxiyi + my*sxi + mx*syi - n*mx*my)
+             + syi2 - 2*my*syi + n*my*my;
+    }
+};
+
+template<typename Score>
+struct PatchMatchEngine
+{
+    PatchMatchEngine(const Image<float,TargetHost>& left, const Image<float,TargetHost>& right, Image<float3,TargetHost> planes, Image<float,TargetHost> costs, const PatchMatchParams& params)
+        : left(left), right(right), planes(planes), costs(costs), params(params)
+    {
+    }
+
+    // Patch score along plane p around (x,y), which must put the centre
+    // within [0,maxDisp]
+    inline float Cost(int x, int y, const float3 p) const
+    {
+        const float d = p.x*x + p.y*y + p.z;
+        if(!(0 <= d && d <= params.maxDisp)) {
+            return std::numeric_limits<float>::infinity();
+        }
+        return Score::Score(left, right, x, y, d, p.x, p.y);
+    }
+
+    inline void Try(int x, int y, const float3 p, float3& best, float& bestc) const
+    {
+        const float c = Cost(x,y,p);
+        if(c < bestc) {
+            bestc = c;
+            best = p;
+        }
+    }
+
+    void Init()
+    {
+        ParallelForRows(planes.h, [&](size_t y0, size_t y1) {
+            for(int y=(int)y0; y < (int)y1; ++y) {
+                for(int x=0; x < (int)planes.w; ++x) {
+                    unsigned int state = PatchMatchHash(params.seed, x, y, 0xFFFFFFFFu);
+                    const float d = (PatchMatchRandom(state) + 1) * 0.5f * params.maxDisp;
+                    float3 n = make_float3(PatchMatchRandom(state), PatchMatchRandom(state), 1);
+                    n.z = std::max(0.1f, std::abs(n.z));
+                    const float3 p = PatchMatchPlane(x, y, d, n);
+                    planes(x,y) = p;
+                    costs(x,y) = Cost(x,y,p);
+                }
+            }
+        });
+    }
+
+    // Spatial propagation and refinement of the pixels with (x+y)%2 == colour
+    void Iterate(int iteration, int colour)
+    {
+        const int w = planes.w;
+        const int h = planes.h;
+
+        ParallelForRows(h, [&](size_t y0, size_t y1) {
+            for(int y=(int)y0; y < (int)y1; ++y) {
+                for(int x=(y+colour)&1; x < w; x += 2) {
+                    float3 best = planes(x,y);
+                    float bestc = costs(x,y);
+
+                    // odd distances reach the other colour only
+                    for(int r=1; r <= PATCH_MATCH_REACH; r += 2) {
+                        if(x >= r)   Try(x,y, planes(x-r,y), best, bestc);
+                        if(x < w-r)  Try(x,y, planes(x+r,y), best, bestc);
+                        if(y >= r)   Try(x,y, planes(x,y-r), best, bestc);
+                        if(y < h-r)  Try(x,y, planes(x,y+r), best, bestc);
+                    }
+
+                    unsigned int state = PatchMatchHash(params.seed, x, y, iteration);
+                    float dd = 0.5f * params.maxDisp;
+                    float dn = 1.0f;
+                    for(int k=0; k < params.refineSteps; ++k) {
+                        const float d = best.x*x + best.y*y + best.z;
+                        float3 n = PatchMatchNormal(best);
+                        n.x += dn * PatchMatchRandom(state);
+                        n.y += dn * PatchMatchRandom(state);
+                        n.z = std::max(0.1f, n.z + dn * PatchMatchRandom(state));
+                        const float nd = std::min(std::max(d + dd * PatchMatchRandom(state), 0.0f), (float)params.maxDisp);
+                        Try(x,y, PatchMatchPlane(x, y, nd, n), best, bestc);
+                        dd *= 0.5f;
+                        dn *= 0.5f;
+                    }
+
+                    planes(x,y) = best;
+                    costs(x,y) = bestc;
+                }
+            }
+        });
+    }
+
+    const Image<float,TargetHost>& left;
+    const Image<float,TargetHost>& right;
+    Image<float3,TargetHost> planes;
+    Image<float,TargetHost> costs;
+    const PatchMatchParams& params;
+};
+
+template<typename Score>
+void PatchMatchStereoScore(Image<float,TargetHost> disp, const Image<float,TargetHost> left, const Image<float,TargetHost> right, const PatchMatchParams& params)
+{
+    Image<float3,TargetHostAligned,Manage> planes(left.w, left.h);
+    Image<float,TargetHostAligned,Manage> costs(left.w, left.h);
+
+    PatchMatchEngine<Score> engine(left, right, planes, costs, params);
+    engine.Init();
+    for(int i=0; i < params.iterations; ++i) {
+        engine.Iterate(i, 0);
+        engine.Iterate(i, 1);
+    }
+
+    ParallelForRows(disp.h, [&](size_t y0, size_t y1) {
+        for(int y=(int)y0; y < (int)y1; ++y) {
+            for(int x=0; x < (int)disp.w; ++x) {
+                const float3 p = planes(x,y);
+                disp(x,y) = costs(x,y) < std::numeric_limits<float>::infinity() ? p.x*x + p.y*y + p.z : InvalidValue<float>::Value();
+            }
+        }
+    });
+}
+
+template<template<int> class Score>
+void PatchMatchStereoRad(Image<float,TargetHost> disp, const Image<float,TargetHost> left, const Image<float,TargetHost> right, const PatchMatchParams& params)
+{
+    switch(params.rad) {
+    case 1:  PatchMatchStereoScore<Score<1> >(disp, left, right, params); break;
+    case 2:  PatchMatchStereoScore<Score<2> >(disp, left, right, params); break;
+    case 3:  PatchMatchStereoScore<Score<3> >(disp, left, right, params); break;
+    case 4:  PatchMatchStereoScore<Score<4> >(disp, left, right, params); break;
+    default: throw std::invalid_argument("PatchMatchStereo: rad must be in [1,4]");
+    }
+}
+
+void PatchMatchStereo(Image<float,TargetHost> disp, const Image<float,TargetHost> left, const Image<float,TargetHost> right, const PatchMatchParams& params)
+{
+    if(params.ssnd) {
+        PatchMatchStereoRad<PatchMatchSSNDScore>(disp, left, right, params);
+    }else{
+        PatchMatchStereoRad<PatchMatchSADScore>(disp, left, right, params);
+    }
+}
+
+}
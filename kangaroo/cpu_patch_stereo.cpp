@@ -0,0 +1,313 @@
+#include "cu_dense_stereo.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+
+#include "host_launch_utils.h"
+#include "host_simd.h"
+#include "patch_score.h"
+
+namespace roo
+{
+
+using namespace simd;
+
+//////////////////////////////////////////////////////
+// Patch costs with running box sums on the host
+//
+// The cost of a (2*RAD+1)^2 patch is the box sum of a per pixel term
+// (|l-r|, (l-r)^2, or l*r for SSND, whose other sums do not depend on the
+// disparity). Column sums of 2*RAD+1 rows are kept for every column and
+// disparity and moved down one row at a time by adding the entering row and
+// subtracting the leaving one, and patches slide along the row the same
+// way, so the work per pixel and disparity does not depend on RAD.
+// Disparities are innermost in every buffer and processed MV at a time.
+//////////////////////////////////////////////////////
+
+inline int PatchPadded(int K)
+{
+    return (K + MV - 1) / MV * MV;
+}
+
+// dst = a + b - c for n values
+inline void PatchAddSub(float* dst, const float* a, const float* b, const float* c, int n)
+{
+    int i=0;
+    for(; i + MV <= n; i += MV) {
+        MvStore(dst+i, MvSub(MvAdd(MvLoad(a+i), MvLoad(b+i)), MvLoad(c+i)));
+    }
+    for(; i < n; ++i) {
+        dst[i] = a[i] + b[i] - c[i];
+    }
+}
+
+// Per pixel terms of the supported scores
+template<typename Score>
+struct PatchTerms;
+
+template<int RAD>
+struct PatchTerms<SADPatchScore<float,RAD,ImgAccessClamped> >
+{
+    static const bool normalised = false;
+    static inline mvec Term(mvec l, mvec r) { return MvAbs(MvSub(l,r)); }
+};
+
+template<int RAD>
+struct PatchTerms<SSDPatchScore<float,RAD,ImgAccessClamped> >
+{
+    static const bool normalised = false;
+    static inline mvec Term(mvec l, mvec r) { const mvec d = MvSub(l,r); return MvMul(d,d); }
+};
+
+template<int RAD>
+struct PatchTerms<SSNDPatchScore<float,RAD,ImgAccessClamped> >
+{
+    static const bool normalised = true;
+    static inline mvec Term(mvec l, mvec r) { return MvMul(l,r); }
+};
+
+// (2*R+1)^2 box sums of K values at n positions, moving down a row at a time
+template<int R>
+struct PatchRows
+{
+    PatchRows(int n, int K)
+        : n(n), K(K), col((n+2*R)*K), ta((n+2*R)*K), tb((n+2*R)*K)
+    {
+    }
+
+    // terms(y, t) writes the K terms of the n+2R columns of row y (clamped)
+    template<typename F>
+    void Start(int y, F& terms)
+    {
+        std::fill(col.begin(), col.end(), 0.0f);
+        for(int r=-R; r <= R; ++r) {
+            terms(y+r, &ta[0]);
+            for(size_t i=0; i < col.size(); ++i) col[i] += ta[i];
+        }
+    }
+
+    // From row y-1 to row y
+    template<typename F>
+    void Advance(int y, F& terms)
+    {
+        terms(y+R, &ta[0]);
+        terms(y-R-1, &tb[0]);
+        PatchAddSub(&col[0], &col[0], &ta[0], &tb[0], (int)col.size());
+    }
+
+    // out[x*K + k], x in [0,n)
+    void Boxes(float* out) const
+    {
+        std::fill(out, out+K, 0.0f);
+        for(int c=0; c <= 2*R; ++c) {
+            for(int k=0; k < K; ++k) out[k] += col[c*K + k];
+        }
+        for(int x=1; x < n; ++x) {
+            PatchAddSub(out + x*K, out + (x-1)*K, &col[(x+2*R)*K], &col[(x-1)*K], K);
+        }
+    }
+
+    int n;
+    int K;
+    std::vector<float> col;
+    std::vector<float> ta;
+    std::vector<float> tb;
+};
+
+inline int PatchClamp(int v, int lo, int hi)
+{
+    return std::min(std::max(v, lo), hi);
+}
+
+template<typename Score, typename TImg>
+void CostVolumeFromStereoPatch(Volume<float,TargetHost> vol, const Image<TImg,TargetHost> left, const Image<TImg,TargetHost> right, float sd)
+{
+    typedef PatchTerms<Score> Terms;
+    const int R = Score::rad;
+    const int w = vol.w;
+    const int h = vol.h;
+    const int D = vol.d;
+    const int Kp = PatchPadded(D);
+
+    // Box sums need one column offset per disparity for the whole row, which
+    // only matches the (int)(x + sd*d) of the direct scores for whole sd
+    if(sd != std::floor(sd)) {
+        throw std::invalid_argument("CostVolumeFromStereoPatch: sd must be a whole number");
+    }
+
+    // column offset of the right view for each disparity
+    std::vector<int> off(Kp);
+    int omin = 0;
+    int omax = 0;
+    for(int d=0; d < Kp; ++d) {
+        off[d] = (int)sd * d;
+        omin = std::min(omin, off[d]);
+        omax = std::max(omax, off[d]);
+    }
+    const bool backward = (sd == -1);
+    const bool forward = (sd == 1);
+
+    ParallelForRows(h, [&](size_t y0, size_t y1) {
+        PatchRows<Score::rad> rows(w, Kp);
+        std::vector<float> lrow(w + 2*R);
+        std::vector<float> rrow(w + 2*R + Kp);
+        std::vector<float> gather(Kp);
+        std::vector<float> box(w * Kp);
+
+        // terms of columns x' = i - R of row y
+        struct CrossTerms {
+            void operator()(int y, float* t) {
+                y = PatchClamp(y, 0, h-1);
+                for(int i=0; i < w + 2*R; ++i) {
+                    lrow[i] = left(PatchClamp(i-R, 0, w-1), y);
+                }
+                if(backward) {
+                    // right(x'-d) at rrow[w+2R-1-i+d]
+                    for(int m=0; m < w + 2*R + Kp; ++m) {
+                        rrow[m] = right(PatchClamp(w+R-1-m, 0, w-1), y);
+                    }
+                }else if(forward) {
+                    // right(x'+d) at rrow[i+d]
+                    for(int m=0; m < w + 2*R + Kp; ++m) {
+                        rrow[m] = right(PatchClamp(m-R, 0, w-1), y);
+                    }
+                }
+
+                for(int i=0; i < w + 2*R; ++i) {
+                    const float* r;
+                    if(backward) {
+                        r = &rrow[w + 2*R - 1 - i];
+                    }else if(forward) {
+                        r = &rrow[i];
+                    }else{
+                        for(int d=0; d < Kp; ++d) {
+                            gather[d] = right(PatchClamp(i-R+off[d], 0, w-1), y);
+                        }
+                        r = &gather[0];
+                    }
+
+                    const mvec l = MvSet(lrow[i]);
+                    float* ti = t + i*Kp;
+                    for(int d=0; d < Kp; d += MV) {
+                        MvStore(ti+d, Terms::Term(l, MvLoad(r+d)));
+                    }
+                }
+            }
+
+            const Image<TImg,TargetHost>& left;
+            const Image<TImg,TargetHost>& right;
+            const std::vector<int>& off;
+            std::vector<float>& lrow;
+            std::vector<float>& rrow;
+            std::vector<float>& gather;
+            int w, h, R, Kp;
+            bool backward, forward;
+        } terms = { left, right, off, lrow, rrow, gather, w, h, R, Kp, backward, forward };
+
+        // SSND also needs the sum and sum of squares of both patches, right
+        // patches centred at x + off[d], so columns [omin, w + omax)
+        const int nr = Terms::normalised ? w + omax - omin : 0;
+        PatchRows<Score::rad> lsums(Terms::normalised ? w : 0, 2);
+        PatchRows<Score::rad> rsums(nr, 2);
+        std::vector<float> lbox(Terms::normalised ? 2*w : 0);
+        std::vector<float> rbox(2*nr);
+
+        struct SumTerms {
+            void operator()(int y, float* t) {
+                y = PatchClamp(y, 0, img.h-1);
+                for(int i=0; i < n + 2*R; ++i) {
+                    const float v = img(PatchClamp(x0+i-R, 0, img.w-1), y);
+                    t[2*i] = v;
+                    t[2*i+1] = v*v;
+                }
+            }
+
+            const Image<TImg,TargetHost>& img;
+            int x0, n, R;
+        } lterms = { left, 0, w, R }, rterms = { right, omin, nr, R };
+
+        for(int y=(int)y0; y < (int)y1; ++y) {
+            if(y == (int)y0) {
+                rows.Start(y, terms);
+                if(Terms::normalised) {
+                    lsums.Start(y, lterms);
+                    rsums.Start(y, rterms);
+                }
+            }else{
+                rows.Advance(y, terms);
+                if(Terms::normalised) {
+                    lsums.Advance(y, lterms);
+                    rsums.Advance(y, rterms);
+                }
+            }
+
+            rows.Boxes(&box[0]);
+
+            if(Terms::normalised) {
+                // score as SSNDPatchScore from the box sums
+                const float n = Score::area;
+                lsums.Boxes(&lbox[0]);
+                rsums.Boxes(&rbox[0]);
+                for(int x=0; x < w; ++x) {
+                    const float sxi = lbox[2*x];
+                    const float sxi2 = lbox[2*x+1];
+                    for(int d=0; d < D; ++d) {
+                        const int xr = x + off[d] - omin;
+                        const float syi = rbox[2*xr];
+                        const float syi2 = rbox[2*xr+1];
+                        const float sxiyi = box[x*Kp + d];
+                        box[x*Kp + d] = sxi2 - sxi*sxi/n + syi2 - syi*syi/n - 2*(sxiyi - sxi*syi/n);
+                    }
+                }
+            }
+
+            for(int d=0; d < D; ++d) {
+                float* out = &vol(0,y,d);
+                for(int x=0; x < w; ++x) {
+                    out[x] = box[x*Kp + d];
+                }
+            }
+        }
+    });
+}
+
+template KANGAROO_EXPORT void CostVolumeFromStereoPatch<SADPatchScore<float,1,ImgAccessClamped> >(Volume<float,TargetHost>, const Image<unsigned char,TargetHost>, const Image<unsigned char,TargetHost>, float);
+template KANGAROO_EXPORT void CostVolumeFromStereoPatch<SADPatchScore<float,2,ImgAccessClamped> >(Volume<float,TargetHost>, const Image<unsigned char,TargetHost>, const Image<unsigned char,TargetHost>, float);
+template KANGAROO_EXPORT void CostVolumeFromStereoPatch<SADPatchScore<float,3,ImgAccessClamped> >(Volume<float,TargetHost>, const Image<unsigned char,TargetHost>, const Image<unsigned char,TargetHost>, float);
+template KANGAROO_EXPORT void CostVolumeFromStereoPatch<SADPatchScore<float,4,ImgAccessClamped> >(Volume<float,TargetHost>, const Image<unsigned char,TargetHost>, const Image<unsigned char,TargetHost>, float);
+template KANGAROO_EXPORT void CostVolumeFromStereoPatch<SADPatchScore<float,5,ImgAccessClamped> >(Volume<float,TargetHost>, const Image<unsigned char,TargetHost>, const Image<unsigned char,TargetHost>, float);
+template KANGAROO_EXPORT void CostVolumeFromStereoPatch<SADPatchScore<float,7,ImgAccessClamped> >(Volume<float,TargetHost>, const Image<unsigned char,TargetHost>, const Image<unsigned char,TargetHost>, float);
+template KANGAROO_EXPORT void CostVolumeFromStereoPatch<SSDPatchScore<float,1,ImgAccessClamped> >(Volume<float,TargetHost>, const Image<unsigned char,TargetHost>, const Image<unsigned char,TargetHost>, float);
+template KANGAROO_EXPORT void CostVolumeFromStereoPatch<SSDPatchScore<float,2,ImgAccessClamped> >(Volume<float,TargetHost>, const Image<unsigned char,TargetHost>, const Image<unsigned char,TargetHost>, float);
+template KANGAROO_EXPORT void CostVolumeFromStereoPatch<SSDPatchScore<float,3,ImgAccessClamped> >(Volume<float,TargetHost>, const Image<unsigned char,TargetHost>, const Image<unsigned char,TargetHost>, float);
+template KANGAROO_EXPORT void CostVolumeFromStereoPatch<SSDPatchScore<float,4,ImgAccessClamped> >(Volume<float,TargetHost>, const Image<unsigned char,TargetHost>, const Image<unsigned char,TargetHost>, float);
+template KANGAROO_EXPORT void CostVolumeFromStereoPatch<SSDPatchScore<float,5,ImgAccessClamped> >(Volume<float,TargetHost>, const Image<unsigned char,TargetHost>, const Image<unsigned char,TargetHost>, float);
+template KANGAROO_EXPORT void CostVolumeFromStereoPatch<SSDPatchScore<float,7,ImgAccessClamped> >(Volume<float,TargetHost>, const Image<unsigned char,TargetHost>, const Image<unsigned char,TargetHost>, float);
+template KANGAROO_EXPORT void CostVolumeFromStereoPatch<SSNDPatchScore<float,1,ImgAccessClamped> >(Volume<float,TargetHost>, const Image<unsigned char,TargetHost>, const Image<unsigned char,TargetHost>, float);
+template KANGAROO_EXPORT void CostVolumeFromStereoPatch<SSNDPatchScore<float,2,ImgAccessClamped> >(Volume<float,TargetHost>, const Image<unsigned char,TargetHost>, const Image<unsigned char,TargetHost>, float);
+template KANGAROO_EXPORT void CostVolumeFromStereoPatch<SSNDPatchScore<float,3,ImgAccessClamped> >(Volume<float,TargetHost>, const Image<unsigned char,TargetHost>, const Image<unsigned char,TargetHost>, float);
+template KANGAROO_EXPORT void CostVolumeFromStereoPatch<SSNDPatchScore<float,4,ImgAccessClamped> >(Volume<float,TargetHost>, const Image<unsigned char,TargetHost>, const Image<unsigned char,TargetHost>, float);
+template KANGAROO_EXPORT void CostVolumeFromStereoPatch<SSNDPatchScore<float,5,ImgAccessClamped> >(Volume<float,TargetHost>, const Image<unsigned char,TargetHost>, const Image<unsigned char,TargetHost>, float);
+template KANGAROO_EXPORT void CostVolumeFromStereoPatch<SSNDPatchScore<float,7,ImgAccessClamped> >(Volume<float,TargetHost>, const Image<unsigned char,TargetHost>, const Image<unsigned char,TargetHost>, float);
+template KANGAROO_EXPORT void CostVolumeFromStereoPatch<SADPatchScore<float,1,ImgAccessClamped> >(Volume<float,TargetHost>, const Image<float,TargetHost>, const Image<float,TargetHost>, float);
+template KANGAROO_EXPORT void CostVolumeFromStereoPatch<SADPatchScore<float,2,ImgAccessClamped> >(Volume<float,TargetHost>, const Image<float,TargetHost>, const Image<float,TargetHost>, float);
+template KANGAROO_EXPORT void CostVolumeFromStereoPatch<SADPatchScore<float,3,ImgAccessClamped> >(Volume<float,TargetHost>, const Image<float,TargetHost>, const Image<float,TargetHost>, float);
+template KANGAROO_EXPORT void CostVolumeFromStereoPatch<SADPatchScore<float,4,ImgAccessClamped> >(Volume<float,TargetHost>, const Image<float,TargetHost>, const Image<float,TargetHost>, float);
+template KANGAROO_EXPORT void CostVolumeFromStereoPatch<SADPatchScore<float,5,ImgAccessClamped> >(Volume<float,TargetHost>, const Image<float,TargetHost>, const Image<float,TargetHost>, float);
+template KANGAROO_EXPORT void CostVolumeFromStereoPatch<SADPatchScore<float,7,ImgAccessClamped> >(Volume<float,TargetHost>, const Image<float,TargetHost>, const Image<float,TargetHost>, float);
+template KANGAROO_EXPORT void CostVolumeFromStereoPatch<SSDPatchScore<float,1,ImgAccessClamped> >(Volume<float,TargetHost>, const Image<float,TargetHost>, const Image<float,TargetHost>, float);
+template KANGAROO_EXPORT void CostVolumeFromStereoPatch<SSDPatchScore<float,2,ImgAccessClamped> >(Volume<float,TargetHost>, const Image<float,TargetHost>, const Image<float,TargetHost>, float);
+template KANGAROO_EXPORT void CostVolumeFromStereoPatch<SSDPatchScore<float,3,ImgAccessClamped> >(Volume<float,TargetHost>, const Image<float,TargetHost>, const Image<float,TargetHost>, float);
+template KANGAROO_EXPORT void CostVolumeFromStereoPatch<SSDPatchScore<float,4,ImgAccessClamped> >(Volume<float,TargetHost>, const Image<float,TargetHost>, const Image<float,TargetHost>, float);
+template KANGAROO_EXPORT void CostVolumeFromStereoPatch<SSDPatchScore<float,5,ImgAccessClamped> >(Volume<float,TargetHost>, const Image<float,TargetHost>, const Image<float,TargetHost>, float);
+template KANGAROO_EXPORT void CostVolumeFromStereoPatch<SSDPatchScore<float,7,ImgAccessClamped> >(Volume<float,TargetHost>, const Image<float,TargetHost>, const Image<float,TargetHost>, float);
+template KANGAROO_EXPORT void CostVolumeFromStereoPatch<SSNDPatchScore<float,1,ImgAccessClamped> >(Volume<float,TargetHost>, const Image<float,TargetHost>, const Image<float,TargetHost>, float);
+template KANGAROO_EXPORT void CostVolumeFromStereoPatch<SSNDPatchScore<float,2,ImgAccessClamped> >(Volume<float,TargetHost>, const Image<float,TargetHost>, const Image<float,TargetHost>, float);
+template KANGAROO_EXPORT void CostVolumeFromStereoPatch<SSNDPatchScore<float,3,ImgAccessClamped> >(Volume<float,TargetHost>, const Image<float,TargetHost>, const Image<float,TargetHost>, float);
+template KANGAROO_EXPORT void CostVolumeFromStereoPatch<SSNDPatchScore<float,4,ImgAccessClamped> >(Volume<float,TargetHost>, const Image<float,TargetHost>, const Image<float,TargetHost>, float);
+template KANGAROO_EXPORT void CostVolumeFromStereoPatch<SSNDPatchScore<float,5,ImgAccessClamped> >(Volume<float,TargetHost>, const Image<float,TargetHost>, const Image<float,TargetHost>, float);
+template KANGAROO_EXPORT void CostVolumeFromStereoPatch<SSNDPatchScore<float,7,ImgAccessClamped> >(Volume<float,TargetHost>, const Image<float,TargetHost>, const Image<float,TargetHost>, float);
+
+}
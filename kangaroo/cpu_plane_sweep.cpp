@@ -0,0 +1,131 @@
+#include "cu_dense_stereo.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "host_launch_utils.h"
+#include "MatUtils.h"
+#include "patch_score.h"
+
+namespace roo
+{
+
+//////////////////////////////////////////////////////
+// Multi-view plane sweep on the host
+//
+// Plane d of the sweep is fronto-parallel to the reference camera at depth
+// fu*baseline/d, as in CostVolumeAdd. A reference pixel p maps into view c
+// through H_d = Kc (R Kr^-1 + t e3' d/(fu*baseline)), (R,t) = T_cr, so only
+// the last column of H_d changes between planes. Tiles of the reference
+// image go through every plane and every view before moving on, so the
+// reference patches and the tile's footprint in the views stay in cache and
+// every CostVolElem is written once.
+//////////////////////////////////////////////////////
+
+typedef SANDPatchScore<float,2,ImgAccessBilinearClamped<float> > PlaneSweepScore;
+
+// Border kept from the view edges, as KernAddToCostVolume
+const float PLANE_SWEEP_BORDER = 5;
+
+// H_d = [c0 c1 c2 + d * ct]
+struct PlaneSweepHomography
+{
+    float3 c0;
+    float3 c1;
+    float3 c2;
+    float3 ct;
+};
+
+inline float3 PlaneSweepK(const ImageIntrinsics& K, const float3 P)
+{
+    return make_float3(K.fu*P.x + K.u0*P.z, K.fv*P.y + K.v0*P.z, P.z);
+}
+
+template<typename T>
+inline PlaneSweepHomography PlaneSweepHomographyFor(const ImageKeyframe<T,TargetHost>& ref, const ImageKeyframe<T,TargetHost>& view, float baseline)
+{
+    const Mat<float,3,4> T_cr = view.T_iw * SE3inv(ref.T_iw);
+    const ImageIntrinsics& Kr = ref.K;
+
+    // R Kr^-1
+    const float3 r0 = make_float3(T_cr(0,0), T_cr(1,0), T_cr(2,0));
+    const float3 r1 = make_float3(T_cr(0,1), T_cr(1,1), T_cr(2,1));
+    const float3 r2 = make_float3(T_cr(0,2), T_cr(1,2), T_cr(2,2));
+    const float3 a0 = r0 / Kr.fu;
+    const float3 a1 = r1 / Kr.fv;
+    const float3 a2 = r2 - a0*Kr.u0 - a1*Kr.v0;
+
+    PlaneSweepHomography H;
+    H.c0 = PlaneSweepK(view.K, a0);
+    H.c1 = PlaneSweepK(view.K, a1);
+    H.c2 = PlaneSweepK(view.K, a2);
+    H.ct = PlaneSweepK(view.K, SE3Translation(T_cr) / (Kr.fu * baseline));
+    return H;
+}
+
+template<typename T>
+void PlaneSweep(Volume<CostVolElem,TargetHost> vol, const ImageKeyframe<T,TargetHost> ref, const ImageKeyframe<T,TargetHost>* views, int numViews, float baseline, bool accumulate)
+{
+    typedef PlaneSweepScore Score;
+
+    std::vector<PlaneSweepHomography> H(numViews);
+    for(int c=0; c < numViews; ++c) {
+        H[c] = PlaneSweepHomographyFor(ref, views[c], baseline);
+    }
+
+    ParallelForTiles(vol.w, vol.h, [&](size_t x0, size_t x1, size_t y0, size_t y1) {
+        for(int d=0; d < (int)vol.d; ++d) {
+            for(size_t v=y0; v < y1; ++v) {
+                for(size_t u=x0; u < x1; ++u) {
+                    CostVolElem elem;
+                    if(accumulate) {
+                        elem = vol(u,v,d);
+                    }else{
+                        elem.n = 0;
+                        elem.sum = 0;
+                    }
+
+                    for(int c=0; c < numViews; ++c) {
+                        const PlaneSweepHomography& h = H[c];
+                        const float3 KPc = h.c0*(float)u + h.c1*(float)v + h.c2 + h.ct*(float)d;
+                        if(KPc.z > 0) {
+                            const float2 pc = make_float2(KPc.x / KPc.z, KPc.y / KPc.z);
+                            if(views[c].img.InBounds(pc, PLANE_SWEEP_BORDER)) {
+                                elem.sum += Score::Score(ref.img, (float)u, (float)v, views[c].img, pc.x, pc.y) / (float)Score::area;
+                                elem.n += 1;
+                            }
+                        }
+                    }
+
+                    vol(u,v,d) = elem;
+                }
+            }
+        }
+    }, 32, 16);
+}
+
+template KANGAROO_EXPORT void PlaneSweep(Volume<CostVolElem,TargetHost> vol, const ImageKeyframe<unsigned char,TargetHost> ref, const ImageKeyframe<unsigned char,TargetHost>* views, int numViews, float baseline, bool accumulate);
+template KANGAROO_EXPORT void PlaneSweep(Volume<CostVolElem,TargetHost> vol, const ImageKeyframe<float,TargetHost> ref, const ImageKeyframe<float,TargetHost>* views, int numViews, float baseline, bool accumulate);
+
+void CostVolMinimum(Image<float,TargetHost> disp, const Volume<CostVolElem,TargetHost> vol)
+{
+    ParallelForRows(disp.h, [&](size_t y0, size_t y1) {
+        for(size_t y=y0; y < y1; ++y) {
+            for(size_t x=0; x < disp.w; ++x) {
+                float bestd = 0;
+                float bestc = 1E30;
+                for(int d=0; d < (int)vol.d; ++d) {
+                    CostVolElem elem = vol(x,y,d);
+                    const float c = elem;
+                    if(c < bestc) {
+                        bestc = c;
+                        bestd = d;
+                    }
+                }
+                disp(x,y) = bestd;
+            }
+        }
+    });
+}
+
+}
@@ -0,0 +1,75 @@
+#include "cu_resample.h"
+
+#include "Pyramid.h"
+#include "reduce.h"
+#include "host_launch_utils.h"
+#include "InvalidValue.h"
+#include "pixel_convert.h"
+
+#include "CUDA_SDK/cutil_math.h"
+
+namespace roo
+{
+
+//////////////////////////////////////////////////////
+// Downsampling
+//////////////////////////////////////////////////////
+
+template<typename To, typename UpType, typename Ti>
+void BoxHalf( Image<To,TargetHost> out, const Image<Ti,TargetHost> in)
+{
+    ParallelForRows(out.h, [&](size_t y0, size_t y1) {
+        for(size_t y=y0; y < y1; ++y) {
+            const Ti* tl = in.RowPtr(2*y);
+            const Ti* bl = in.RowPtr(2*y+1);
+            To* o = out.RowPtr(y);
+            for(size_t x=0; x < out.w; ++x) {
+                o[x] = ConvertPixel<To>( (
+                    ConvertPixel<UpType>(tl[2*x]) +
+                    ConvertPixel<UpType>(tl[2*x+1]) +
+                    ConvertPixel<UpType>(bl[2*x]) +
+                    ConvertPixel<UpType>(bl[2*x+1])
+                ) / 4.0f);
+            }
+        }
+    });
+}
+
+// Instantiate
+template void BoxHalf<unsigned char,unsigned int,unsigned char>(Image<unsigned char,TargetHost>, const Image<unsigned char,TargetHost>);
+template void BoxHalf<float,float,float>(Image<float,TargetHost>, const Image<float,TargetHost>);
+template void BoxHalf<uchar3,uint3,uchar3>(Image<uchar3,TargetHost>, const Image<uchar3,TargetHost>);
+template void BoxHalf<uchar4,uint4,uchar4>(Image<uchar4,TargetHost>, const Image<uchar4,TargetHost>);
+
+//////////////////////////////////////////////////////
+// Downsampling (Ignore invalid)
+//////////////////////////////////////////////////////
+
+template<typename To, typename UpType, typename Ti>
+void BoxHalfIgnoreInvalid( Image<To,TargetHost> out, const Image<Ti,TargetHost> in)
+{
+    ParallelForRows(out.h, [&](size_t y0, size_t y1) {
+        for(size_t y=y0; y < y1; ++y) {
+            const Ti* tl = in.RowPtr(2*y);
+            const Ti* bl = in.RowPtr(2*y+1);
+            To* o = out.RowPtr(y);
+            for(size_t x=0; x < out.w; ++x) {
+                const Ti v[4] = { tl[2*x], tl[2*x+1], bl[2*x], bl[2*x+1] };
+
+                int n = 0;
+                UpType sum = 0;
+                for(int i=0; i < 4; ++i) {
+                    if(InvalidValue<Ti>::IsValid(v[i])) { sum += v[i]; n++; }
+                }
+
+                o[x] = n > 0 ? (To)(sum / n) : InvalidValue<To>::Value();
+            }
+        }
+    });
+}
+
+// Instantiate
+template KANGAROO_EXPORT void BoxHalfIgnoreInvalid<unsigned char,unsigned int,unsigned char>(Image<unsigned char,TargetHost>, const Image<unsigned char,TargetHost>);
+template KANGAROO_EXPORT void BoxHalfIgnoreInvalid<float,float,float>(Image<float,TargetHost>, const Image<float,TargetHost>);
+
+}
@@ -0,0 +1,51 @@
+#include "cu_rof_denoising.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "host_launch_utils.h"
+
+namespace roo
+{
+
+//////////////////////////////////////////////////////
+// ROF p ascent on the host
+// p = project((p + sigma*grad u) / (1 + sigma*alpha)) with forward
+// differences, zero on the last row and column, as the device kernels.
+// TV-L1 is the Huber step with alpha 0.
+//////////////////////////////////////////////////////
+
+void HuberGradU_DualAscentP(
+        Image<float2,TargetHost> imgp, const Image<float,TargetHost> imgu,
+        float sigma, float alpha
+) {
+    const size_t w = imgu.w;
+    const size_t h = imgu.h;
+    const float s = 1.0f / (1 + sigma*alpha);
+
+    ParallelForRows(h, [&](size_t y0, size_t y1) {
+        for(size_t y=y0; y < y1; ++y) {
+            float2* p = imgp.RowPtr(y);
+            const float* u = imgu.RowPtr(y);
+            const float* un = y < h-1 ? imgu.RowPtr(y+1) : u;
+            for(size_t x=0; x < w; ++x) {
+                const float dx = x < w-1 ? u[x+1] - u[x] : 0.0f;
+                const float dy = un[x] - u[x];
+                const float npx = (p[x].x + sigma * dx) * s;
+                const float npy = (p[x].y + sigma * dy) * s;
+                const float reprojection = std::max(1.0f, std::sqrt(npx*npx + npy*npy));
+                p[x].x = npx / reprojection;
+                p[x].y = npy / reprojection;
+            }
+        }
+    });
+}
+
+void TVL1GradU_DualAscentP(
+        Image<float2,TargetHost> imgp, const Image<float,TargetHost> imgu,
+        float sigma
+) {
+    HuberGradU_DualAscentP(imgp, imgu, sigma, 0.0f);
+}
+
+}
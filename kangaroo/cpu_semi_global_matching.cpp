@@ -0,0 +1,381 @@
+#include "cu_semi_global_matching.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdint.h>
+#include <vector>
+
+#if defined(__AVX2__) || defined(__SSE4_1__)
+#include <immintrin.h>
+#endif
+
+#include "host_launch_utils.h"
+#include "CostVolElem.h"
+
+namespace roo
+{
+
+//////////////////////////////////////////////////////
+// Semi Global Matching on the host
+//
+// Costs are quantised to 16 bit once, with a scale chosen so that the sum
+// of all enabled paths cannot overflow, and every path is aggregated with
+// saturating arithmetic in its own buffers (textbook SGM, whereas the device
+// kernel recurses on the accumulated volH).
+//
+// Rows of L for all x of a scanline are kept in slots of SgmSlot(Dp) values
+// with SGM_GUARD saturated values either side, so the d-1 / d+1 neighbours
+// can be loaded unaligned without bound checks.
+//////////////////////////////////////////////////////
+
+typedef uint16_t sgm_t;
+
+const sgm_t SGM_MAX = 0xFFFF;
+const int SGM_GUARD = 16;
+
+// disparities are padded to a multiple of the widest vector
+inline int SgmPaddedDisparities(int D)
+{
+    return (D + 15) & ~15;
+}
+
+inline int SgmSlot(int Dp)
+{
+    return Dp + 2*SGM_GUARD;
+}
+
+// One step along a path: L = C + min(Lp(d), Lp(d+-1)+P1, minLp+P2) - minLp
+// accumulated into S. Lp and L point at d=0 inside a guarded slot.
+// Returns min_d L.
+inline sgm_t SgmStep(const sgm_t* C, const sgm_t* Lp, sgm_t minLp, sgm_t P1, sgm_t P2, sgm_t* L, sgm_t* S, int Dp)
+{
+#if defined(__AVX2__)
+    const __m256i vP1 = _mm256_set1_epi16((short)P1);
+    const __m256i vMinP2 = _mm256_set1_epi16((short)(sgm_t)std::min<int>(SGM_MAX, minLp + P2));
+    const __m256i vMinLp = _mm256_set1_epi16((short)minLp);
+    __m256i vMin = _mm256_set1_epi16((short)SGM_MAX);
+
+    for(int d=0; d < Dp; d += 16) {
+        const __m256i lp  = _mm256_loadu_si256((const __m256i*)(Lp+d));
+        const __m256i lpm = _mm256_loadu_si256((const __m256i*)(Lp+d-1));
+        const __m256i lpp = _mm256_loadu_si256((const __m256i*)(Lp+d+1));
+        __m256i m = _mm256_min_epu16(lp, vMinP2);
+        m = _mm256_min_epu16(m, _mm256_adds_epu16(lpm, vP1));
+        m = _mm256_min_epu16(m, _mm256_adds_epu16(lpp, vP1));
+        const __m256i c = _mm256_loadu_si256((const __m256i*)(C+d));
+        const __m256i l = _mm256_adds_epu16(c, _mm256_subs_epu16(m, vMinLp));
+        _mm256_storeu_si256((__m256i*)(L+d), l);
+        const __m256i s = _mm256_loadu_si256((const __m256i*)(S+d));
+        _mm256_storeu_si256((__m256i*)(S+d), _mm256_adds_epu16(s, l));
+        vMin = _mm256_min_epu16(vMin, l);
+    }
+
+    const __m128i vMin8 = _mm_min_epu16(_mm256_castsi256_si128(vMin), _mm256_extracti128_si256(vMin,1));
+    return (sgm_t)_mm_cvtsi128_si32(_mm_minpos_epu16(vMin8));
+#elif defined(__SSE4_1__)
+    const __m128i vP1 = _mm_set1_epi16((short)P1);
+    const __m128i vMinP2 = _mm_set1_epi16((short)(sgm_t)std::min<int>(SGM_MAX, minLp + P2));
+    const __m128i vMinLp = _mm_set1_epi16((short)minLp);
+    __m128i vMin = _mm_set1_epi16((short)SGM_MAX);
+
+    for(int d=0; d < Dp; d += 8) {
+        const __m128i lp  = _mm_loadu_si128((const __m128i*)(Lp+d));
+        const __m128i lpm = _mm_loadu_si128((const __m128i*)(Lp+d-1));
+        const __m128i lpp = _mm_loadu_si128((const __m128i*)(Lp+d+1));
+        __m128i m = _mm_min_epu16(lp, vMinP2);
+        m = _mm_min_epu16(m, _mm_adds_epu16(lpm, vP1));
+        m = _mm_min_epu16(m, _mm_adds_epu16(lpp, vP1));
+        const __m128i c = _mm_loadu_si128((const __m128i*)(C+d));
+        const __m128i l = _mm_adds_epu16(c, _mm_subs_epu16(m, vMinLp));
+        _mm_storeu_si128((__m128i*)(L+d), l);
+        const __m128i s = _mm_loadu_si128((const __m128i*)(S+d));
+        _mm_storeu_si128((__m128i*)(S+d), _mm_adds_epu16(s, l));
+        vMin = _mm_min_epu16(vMin, l);
+    }
+
+    return (sgm_t)_mm_cvtsi128_si32(_mm_minpos_epu16(vMin));
+#else
+    const int minP2 = std::min<int>(SGM_MAX, minLp + P2);
+    sgm_t minL = SGM_MAX;
+
+    for(int d=0; d < Dp; ++d) {
+        int m = std::min<int>(Lp[d], minP2);
+        m = std::min<int>(m, Lp[d-1] + P1);
+        m = std::min<int>(m, Lp[d+1] + P1);
+        const sgm_t l = (sgm_t)std::min<int>(SGM_MAX, C[d] + (m - minLp));
+        L[d] = l;
+        S[d] = (sgm_t)std::min<int>(SGM_MAX, S[d] + l);
+        minL = std::min(minL, l);
+    }
+
+    return minL;
+#endif
+}
+
+// First pixel of a path: L = C
+inline sgm_t SgmStart(const sgm_t* C, sgm_t* L, sgm_t* S, int Dp)
+{
+    sgm_t minL = SGM_MAX;
+    for(int d=0; d < Dp; ++d) {
+        L[d] = C[d];
+        S[d] = (sgm_t)std::min<int>(SGM_MAX, S[d] + C[d]);
+        minL = std::min(minL, C[d]);
+    }
+    return minL;
+}
+
+template<typename Timg>
+inline sgm_t SgmP2(const Image<Timg,TargetHost>& left, int x, int y, int px, int py, float P2, float scale)
+{
+    // Penalise jumps less across intensity edges, as the device kernel does
+    const float diff = (float)left(px,py) - (float)left(x,y);
+    return (sgm_t)std::min(65535.0f, P2 / (1.0f + std::fabs(diff)) * scale + 0.5f);
+}
+
+// Lp of the previous pixel on a path, realigned to the disparity window of
+// the current pixel when both windows start shift disparities apart (see
+// CostVolRange). tmp must be a guarded slot.
+inline const sgm_t* SgmAlign(const sgm_t* Lp, int shift, sgm_t* tmp, int Dp)
+{
+    if(shift == 0) return Lp;
+    for(int d=0; d < Dp; ++d) {
+        const int j = d + shift;
+        tmp[d] = (0 <= j && j < Dp) ? Lp[j] : SGM_MAX;
+    }
+    return tmp;
+}
+
+// Aggregate one path direction (dx,dy) into S. dmin holds the first
+// disparity of every pixel for compact volumes and is NULL otherwise.
+template<typename Timg>
+void SgmPath(
+    const std::vector<sgm_t>& C, std::vector<sgm_t>& S, const short* dmin, const Image<Timg,TargetHost>& left,
+    int w, int h, int Dp, int dx, int dy, sgm_t P1, float P2, float scale
+) {
+    const int slot = SgmSlot(Dp);
+
+    if(dy == 0) {
+        // Scanlines are independent
+        ParallelForRows(h, [&](size_t y0, size_t y1) {
+            std::vector<sgm_t> buf(3*slot, SGM_MAX);
+            sgm_t* tmp = &buf[2*slot + SGM_GUARD];
+            for(int y = (int)y0; y < (int)y1; ++y) {
+                sgm_t* Lp = &buf[SGM_GUARD];
+                sgm_t* L = &buf[slot + SGM_GUARD];
+                const int xs = dx > 0 ? 0 : w-1;
+                const size_t i0 = ((size_t)y*w + xs)*Dp;
+                sgm_t minLp = SgmStart(&C[i0], Lp, &S[i0], Dp);
+
+                for(int x = xs + dx; x >= 0 && x < w; x += dx) {
+                    const size_t p = (size_t)y*w + x;
+                    const size_t i = p*Dp;
+                    const sgm_t p2 = SgmP2(left, x, y, x-dx, y, P2, scale);
+                    const sgm_t* Lpa = dmin ? SgmAlign(Lp, dmin[p] - dmin[p-dx], tmp, Dp) : Lp;
+                    minLp = SgmStep(&C[i], Lpa, minLp, P1, p2, L, &S[i], Dp);
+                    std::swap(Lp, L);
+                }
+            }
+        });
+    }else{
+        // Sweep rows, all pixels of a row only depend on the previous row
+        std::vector<sgm_t> buf((dmin ? 3 : 2)*(size_t)w*slot, SGM_MAX);
+        std::vector<sgm_t> minbuf(2*w);
+        sgm_t* Lp = &buf[SGM_GUARD];
+        sgm_t* L = &buf[(size_t)w*slot + SGM_GUARD];
+        sgm_t* tmp = dmin ? &buf[2*(size_t)w*slot + SGM_GUARD] : NULL;
+        sgm_t* minLp = &minbuf[0];
+        sgm_t* minL = &minbuf[w];
+
+        const int ys = dy > 0 ? 0 : h-1;
+        for(int y = ys; y >= 0 && y < h; y += dy) {
+            const bool first = (y == ys);
+            ParallelFor(0, w, [&](size_t ux) {
+                const int x = (int)ux;
+                const int px = x - dx;
+                const size_t p = (size_t)y*w + x;
+                const size_t i = p*Dp;
+                if(first || px < 0 || px >= w) {
+                    minL[x] = SgmStart(&C[i], L + (size_t)x*slot, &S[i], Dp);
+                }else{
+                    const sgm_t p2 = SgmP2(left, x, y, px, y-dy, P2, scale);
+                    const sgm_t* Lpx = Lp + (size_t)px*slot;
+                    const sgm_t* Lpa = dmin ? SgmAlign(Lpx, dmin[p] - dmin[(size_t)(y-dy)*w + px], tmp + (size_t)x*slot, Dp) : Lpx;
+                    minL[x] = SgmStep(&C[i], Lpa, minLp[px], P1, p2, L + (size_t)x*slot, &S[i], Dp);
+                }
+            }, 64);
+            std::swap(Lp, L);
+            std::swap(minLp, minL);
+        }
+    }
+}
+
+inline std::vector<int2> SgmDirections(bool dohoriz, bool dovert, bool doreverse, bool dodiag)
+{
+    std::vector<int2> dirs;
+    if(dovert) {
+        dirs.push_back(make_int2(0,1));
+        if(doreverse) dirs.push_back(make_int2(0,-1));
+    }
+    if(dohoriz) {
+        dirs.push_back(make_int2(1,0));
+        if(doreverse) dirs.push_back(make_int2(-1,0));
+    }
+    if(dodiag) {
+        dirs.push_back(make_int2(1,1));
+        dirs.push_back(make_int2(-1,1));
+        if(doreverse) {
+            dirs.push_back(make_int2(1,-1));
+            dirs.push_back(make_int2(-1,-1));
+        }
+    }
+    return dirs;
+}
+
+// Quantise costs and aggregate all paths. cost(x,y,i) is the cost of slot i
+// of pixel (x,y), valid(x,y,i) whether that slot holds a disparity. Returns
+// the summed path costs, Dp per pixel, in units of 1/scale.
+template<typename Timg, typename Cost, typename Valid>
+std::vector<sgm_t> SgmAggregate(
+    int w, int h, int D, const short* dmin, Cost cost, Valid valid, const Image<Timg,TargetHost>& left,
+    float P1, float P2, const std::vector<int2>& dirs, float& scale
+) {
+    const int Dp = SgmPaddedDisparities(D);
+
+    // Largest valid cost, invalid entries (CostVolElem without samples,
+    // non finite) are treated as this cost.
+    std::vector<float> rowmax(h, 0.0f);
+    ParallelForRows(h, [&](size_t y0, size_t y1) {
+        for(size_t y=y0; y < y1; ++y) {
+            float m = 0;
+            for(int x=0; x < w; ++x) {
+                for(int d=0; d < D && valid(x,(int)y,d); ++d) {
+                    const float f = cost(x,(int)y,d);
+                    if(f < 1E30f) m = std::max(m, f);
+                }
+            }
+            rowmax[y] = m;
+        }
+    });
+    const float cmax = *std::max_element(rowmax.begin(), rowmax.end());
+
+    // Scale so that the sum over all paths fits in 16 bits: every path value
+    // is at most cmax + max(P1,P2) above zero.
+    const float bound = dirs.size() * (cmax + std::max(P1,P2));
+    scale = bound > 0 ? (SGM_MAX - 1) / bound : 1.0f;
+    const sgm_t qP1 = (sgm_t)std::min(65535.0f, P1 * scale + 0.5f);
+
+    // Quantised costs, invalid disparities and the padding are saturated so
+    // they never win a minimum.
+    std::vector<sgm_t> C((size_t)w*h*Dp);
+    std::vector<sgm_t> S((size_t)w*h*Dp, 0);
+    ParallelForRows(h, [&](size_t y0, size_t y1) {
+        for(size_t y=y0; y < y1; ++y) {
+            for(int x=0; x < w; ++x) {
+                sgm_t* c = &C[(y*w + x)*Dp];
+                for(int d=0; d < Dp; ++d) {
+                    if(d < D && valid(x,(int)y,d)) {
+                        float f = cost(x,(int)y,d);
+                        if(!(f < 1E30f)) f = cmax;
+                        c[d] = (sgm_t)std::min(65534.0f, f * scale + 0.5f);
+                    }else{
+                        c[d] = SGM_MAX;
+                    }
+                }
+            }
+        }
+    });
+
+    for(size_t i=0; i < dirs.size(); ++i) {
+        SgmPath(C, S, dmin, left, w, h, Dp, dirs[i].x, dirs[i].y, qP1, P2, scale);
+    }
+
+    return S;
+}
+
+template<typename TH, typename TC, typename Timg>
+void SemiGlobalMatching(Volume<TH,TargetHost> volH, Volume<TC,TargetHost> volC, Image<Timg,TargetHost> left, int maxDisp, float P1, float P2, bool dohoriz, bool dovert, bool doreverse, bool dodiag)
+{
+    const int w = volC.w;
+    const int h = volC.h;
+    const int D = std::max(0, std::min<int>(maxDisp, volC.d));
+    const int Dp = SgmPaddedDisparities(D);
+
+    if(w == 0 || h == 0) return;
+
+    const std::vector<int2> dirs = SgmDirections(dohoriz, dovert, doreverse, dodiag);
+
+    // disparities beyond the image border (d > x) are invalid
+    float scale;
+    const std::vector<sgm_t> S = SgmAggregate(w, h, D, (const short*)NULL,
+        [&](int x, int y, int d) { TC e = volC(x,y,d); return (float)e; },
+        [&](int x, int, int d) { return d <= x; },
+        left, P1, P2, dirs, scale
+    );
+
+    // Back to cost units, untouched disparities stay zero as on the device
+    const float inv = 1.0f / scale;
+    ParallelForRows(h, [&](size_t y0, size_t y1) {
+        for(size_t y=y0; y < y1; ++y) {
+            for(int x=0; x < w; ++x) {
+                const sgm_t* s = &S[(y*w + x)*Dp];
+                const int maxd = dirs.empty() ? 0 : std::min(D,x+1);
+                for(int d=0; d < (int)volH.d; ++d) {
+                    volH(x,y,d) = d < maxd ? (TH)(s[d] * inv) : (TH)0;
+                }
+            }
+        }
+    });
+}
+
+template KANGAROO_EXPORT void SemiGlobalMatching(Volume<float,TargetHost> volH, Volume<CostVolElem,TargetHost> volC, Image<unsigned char,TargetHost> left, int maxDisp, float P1, float P2, bool dohoriz, bool dovert, bool doreverse, bool dodiag);
+template KANGAROO_EXPORT void SemiGlobalMatching(Volume<float,TargetHost> volH, Volume<float,TargetHost> volC, Image<float,TargetHost> left, int maxDisp, float P1, float P2, bool dohoriz, bool dovert, bool doreverse, bool dodiag);
+
+template<typename TH, typename TC, typename Timg>
+void SemiGlobalMatching(CostVolRange<TH,TargetHost> volH, CostVolRange<TC,TargetHost> volC, Image<Timg,TargetHost> left, float P1, float P2, bool dohoriz, bool dovert, bool doreverse, bool dodiag)
+{
+    const int w = volC.vol.w;
+    const int h = volC.vol.h;
+    const int D = volC.Window();
+    const int Dp = SgmPaddedDisparities(D);
+
+    if(w == 0 || h == 0) return;
+
+    // Paths realign windows of neighbouring pixels through dmin
+    std::vector<short> dmin((size_t)w*h);
+    for(int y=0; y < h; ++y) {
+        for(int x=0; x < w; ++x) {
+            dmin[(size_t)y*w + x] = volC.range(x,y).x;
+        }
+    }
+
+    const std::vector<int2> dirs = SgmDirections(dohoriz, dovert, doreverse, dodiag);
+
+    float scale;
+    const std::vector<sgm_t> S = SgmAggregate(w, h, D, &dmin[0],
+        [&](int x, int y, int i) { TC e = volC.vol(x,y,i); return (float)e; },
+        [&](int x, int y, int i) { return i < volC.range(x,y).y; },
+        left, P1, P2, dirs, scale
+    );
+
+    // Same windows as the input, slots beyond a window are zero
+    const float inv = 1.0f / scale;
+    ParallelForRows(h, [&](size_t y0, size_t y1) {
+        for(size_t y=y0; y < y1; ++y) {
+            for(int x=0; x < w; ++x) {
+                const short2 r = volC.range(x,y);
+                const sgm_t* s = &S[(y*w + x)*Dp];
+                const int n = dirs.empty() ? 0 : r.y;
+                volH.range(x,y) = r;
+                for(int i=0; i < (int)volH.Window(); ++i) {
+                    volH.vol(x,y,i) = i < n ? (TH)(s[i] * inv) : (TH)0;
+                }
+            }
+        }
+    });
+}
+
+template KANGAROO_EXPORT void SemiGlobalMatching(CostVolRange<float,TargetHost> volH, CostVolRange<float,TargetHost> volC, Image<float,TargetHost> left, float P1, float P2, bool dohoriz, bool dovert, bool doreverse, bool dodiag);
+template KANGAROO_EXPORT void SemiGlobalMatching(CostVolRange<float,TargetHost> volH, CostVolRange<float,TargetHost> volC, Image<unsigned char,TargetHost> left, float P1, float P2, bool dohoriz, bool dovert, bool doreverse, bool dodiag);
+template KANGAROO_EXPORT void SemiGlobalMatching(CostVolRange<float,TargetHost> volH, CostVolRange<unsigned short,TargetHost> volC, Image<unsigned char,TargetHost> left, float P1, float P2, bool dohoriz, bool dovert, bool doreverse, bool dodiag);
+
+}
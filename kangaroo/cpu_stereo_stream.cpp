@@ -0,0 +1,123 @@
+#include "cu_dense_stereo.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "cu_census.h"
+#include "cu_semi_global_matching.h"
+
+namespace roo
+{
+
+//////////////////////////////////////////////////////
+// Band streaming stereo on the host
+//
+// Every band of bandRows output rows is matched with overlapRows of context
+// above and below, which the vertical and diagonal SGM paths run through
+// before reaching the band. Census descriptors need STREAM_CENSUS_ROWS more
+// image rows around that. All buffers are sized for one band and reused.
+//////////////////////////////////////////////////////
+
+typedef ulong4 StreamCensus;
+
+// 16x16 census reaches 8 rows up and 7 down
+const int STREAM_CENSUS_ROWS = 8;
+
+// rows [y0,y0+rows) of img
+template<typename T>
+inline Image<T,TargetHost> StreamRows(const Image<T,TargetHost>& img, int y0, int rows)
+{
+    return Image<T,TargetHost>((T*)img.RowPtr(y0), img.w, rows, img.pitch);
+}
+
+inline int StreamBandRows(const StereoStreamParams& params)
+{
+    return std::max(1, params.bandRows) + 2*std::max(0, params.overlapRows);
+}
+
+size_t DenseStereoStreamedBytes(int w, const StereoStreamParams& params)
+{
+    const size_t eh = StreamBandRows(params);
+    const size_t D = std::max(1, params.maxDisp);
+    const size_t Dp = (D + 15) & ~15;
+
+    const size_t census = 2 * w * (eh + 2*STREAM_CENSUS_ROWS) * sizeof(StreamCensus);
+    const size_t volumes = 2 * w * eh * (D * sizeof(float) + sizeof(short2));
+    const size_t sgm = 2 * w * eh * Dp * sizeof(unsigned short);
+    const size_t disp = w * eh * sizeof(float);
+    return census + volumes + sgm + disp;
+}
+
+template<typename Timg>
+void DenseStereoStreamed(Image<float,TargetHost> disp, const Image<Timg,TargetHost> left, const Image<Timg,TargetHost> right, const StereoStreamParams& params, StereoRowsCallback callback, void* user)
+{
+    const int w = left.w;
+    const int h = left.h;
+    const int band = std::max(1, params.bandRows);
+    const int overlap = std::max(0, params.overlapRows);
+    const int ehmax = std::min(h, StreamBandRows(params));
+    const int chmax = std::min(h, ehmax + 2*STREAM_CENSUS_ROWS);
+    const int D = std::max(1, params.maxDisp);
+    const bool dosgm = params.dohoriz || params.dovert || params.dodiag;
+
+    if(w == 0 || h == 0) return;
+
+    Image<StreamCensus,TargetHostAligned,Manage> cl(w, chmax);
+    Image<StreamCensus,TargetHostAligned,Manage> cr(w, chmax);
+    CostVolRange<float,TargetHostAligned,Manage> volC(w, ehmax, D);
+    CostVolRange<float,TargetHostAligned,Manage> volH(dosgm ? w : 0, dosgm ? ehmax : 0, dosgm ? D : 0);
+    Image<float,TargetHostAligned,Manage> bandDisp(w, ehmax);
+
+    // Windows only depend on x, the full range for every band
+    CostVolRangeFull(volC.range, D, params.sd);
+
+    for(int b0=0; b0 < h; b0 += band) {
+        const int b1 = std::min(h, b0 + band);
+
+        // band with SGM context, and the image rows its census needs
+        const int e0 = std::max(0, b0 - overlap);
+        const int e1 = std::min(h, b1 + overlap);
+        const int c0 = std::max(0, e0 - STREAM_CENSUS_ROWS);
+        const int c1 = std::min(h, e1 + STREAM_CENSUS_ROWS);
+        const int eh = e1 - e0;
+
+        Image<StreamCensus,TargetHost> cbl = cl.SubImage(w, c1-c0);
+        Image<StreamCensus,TargetHost> cbr = cr.SubImage(w, c1-c0);
+        Census(cbl, StreamRows(left, c0, c1-c0));
+        Census(cbr, StreamRows(right, c0, c1-c0));
+
+        // views of the first eh rows, slices keep their allocated pitch
+        CostVolRange<float,TargetHost> C(volC);
+        C.vol.h = eh;
+        C.range.h = eh;
+        CensusStereoVolume<float,StreamCensus>(C, StreamRows(cbl, e0-c0, eh), StreamRows(cbr, e0-c0, eh), params.sd);
+
+        CostVolRange<float,TargetHost> H(volH);
+        if(dosgm) {
+            H.vol.h = eh;
+            H.range.h = eh;
+            SemiGlobalMatching<float,float,Timg>(H, C, StreamRows(left, e0, eh), params.P1, params.P2, params.dohoriz, params.dovert, params.doreverse, params.dodiag);
+        }
+
+        Image<float,TargetHost> bd = bandDisp.SubImage(w, eh);
+        if(params.subpix) {
+            CostVolMinimumSubpix(bd, dosgm ? H : C);
+        }else{
+            CostVolMinimum(bd, dosgm ? H : C);
+        }
+
+        // only rows of the band itself are final
+        for(int y=b0; y < b1; ++y) {
+            memcpy(disp.RowPtr(y), bd.RowPtr(y-e0), w*sizeof(float));
+        }
+
+        if(callback) {
+            callback(disp, b0, b1, user);
+        }
+    }
+}
+
+template KANGAROO_EXPORT void DenseStereoStreamed(Image<float,TargetHost> disp, const Image<unsigned char,TargetHost> left, const Image<unsigned char,TargetHost> right, const StereoStreamParams& params, StereoRowsCallback callback, void* user);
+template KANGAROO_EXPORT void DenseStereoStreamed(Image<float,TargetHost> disp, const Image<float,TargetHost> left, const Image<float,TargetHost> right, const StereoStreamParams& params, StereoRowsCallback callback, void* user);
+
+}
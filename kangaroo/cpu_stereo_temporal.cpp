@@ -0,0 +1,138 @@
+#include "StereoTemporal.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "cu_census.h"
+#include "cu_dense_stereo.h"
+#include "cu_semi_global_matching.h"
+#include "host_launch_utils.h"
+#include "InvalidValue.h"
+
+namespace roo
+{
+
+////////////////////////////////////////
+// Implementation
+////////////////////////////////////////
+
+inline bool StereoTemporalSgm(const StereoTemporalParams& params)
+{
+    return params.dohoriz || params.dovert || params.dodiag;
+}
+
+StereoTemporal::StereoTemporal(int w, int h, const StereoTemporalParams& params)
+    : params(params), have_prev(false), searched(1),
+      census_left(w,h), census_right(w,h),
+      volC(w, h, params.maxDisp),
+      volH(StereoTemporalSgm(params) ? w : 0, StereoTemporalSgm(params) ? h : 0, StereoTemporalSgm(params) ? params.maxDisp : 0),
+      prev_left(w,h), prev_disp(w,h), conf(w,h), dispR(w,h), lrcheck(w,h)
+{
+}
+
+void StereoTemporal::Reset()
+{
+    have_prev = false;
+}
+
+float StereoTemporal::SearchedFraction() const
+{
+    return searched;
+}
+
+StereoTemporalParams& StereoTemporal::Params()
+{
+    return params;
+}
+
+template<typename Timg>
+void StereoTemporal::Process(Image<float,TargetHost> disp, const Image<Timg,TargetHost> left, const Image<Timg,TargetHost> right)
+{
+    const int w = left.w;
+    const int h = left.h;
+    const int D = std::min<int>(params.maxDisp, volC.Window());
+    const float sd = params.sd;
+    const bool dosgm = StereoTemporalSgm(params) && volH.Window() > 0;
+
+    Census(census_left, left);
+    Census(census_right, right);
+
+    // Windows: narrow where the previous frame can be trusted, full elsewhere
+    std::vector<size_t> rowsearched(h, 0);
+    CostVolRange<float,TargetHost> C(volC);
+    ParallelForRows(h, [&](size_t y0, size_t y1) {
+        const int cr = params.changeRad;
+        const float area = (2*cr+1)*(2*cr+1);
+
+        for(int y=(int)y0; y < (int)y1; ++y) {
+            for(int x=0; x < w; ++x) {
+                int dmax = D - 1;
+                if(sd < 0) dmax = std::min(dmax, (int)(x / -sd));
+                if(sd > 0) dmax = std::min(dmax, (int)((w-1-x) / sd));
+
+                bool reliable = have_prev && lrcheck(x,y) && conf(x,y) >= params.minConfidence;
+                if(reliable) {
+                    float change = 0;
+                    for(int r=-cr; r <= cr; ++r) {
+                        for(int c=-cr; c <= cr; ++c) {
+                            change += std::fabs((float)left.GetWithClampedRange(x+c,y+r) - prev_left.GetWithClampedRange(x+c,y+r));
+                        }
+                    }
+                    reliable = change <= params.maxChange * area;
+                }
+
+                int dlo = 0;
+                int dhi = dmax;
+                if(reliable) {
+                    float lo = 1E30f;
+                    float hi = -1E30f;
+                    for(int r=-1; r <= 1; ++r) {
+                        for(int c=-1; c <= 1; ++c) {
+                            const float s = prev_disp.GetWithClampedRange(x+c, y+r);
+                            if(s >= 0) {
+                                lo = std::min(lo, s);
+                                hi = std::max(hi, s);
+                            }
+                        }
+                    }
+                    dlo = std::max(0, (int)std::floor(lo) - params.radius);
+                    dhi = std::min(dmax, (int)std::ceil(hi) + params.radius);
+                }
+
+                const int n = std::max(0, dhi - dlo + 1);
+                C.range(x,y) = make_short2(dlo, n);
+                rowsearched[y] += n;
+            }
+        }
+    });
+
+    size_t total = 0;
+    for(int y=0; y < h; ++y) total += rowsearched[y];
+    searched = (w && h && D) ? (float)total / ((size_t)w * h * D) : 0;
+
+    CensusStereoVolume<float,ulong4>(C, census_left, census_right, sd);
+
+    CostVolRange<float,TargetHost> H(volH);
+    if(dosgm) {
+        SemiGlobalMatching<float,float,Timg>(H, C, left, params.P1, params.P2, params.dohoriz, params.dovert, params.doreverse, params.dodiag);
+    }
+
+    CostVolDisparities(disp, dispR, conf, lrcheck, dosgm ? H : C, sd);
+
+    ParallelForRows(h, [&](size_t y0, size_t y1) {
+        for(int y=(int)y0; y < (int)y1; ++y) {
+            for(int x=0; x < w; ++x) {
+                if(!lrcheck(x,y)) disp(x,y) = InvalidValue<float>::Value();
+                prev_disp(x,y) = disp(x,y);
+                prev_left(x,y) = left(x,y);
+            }
+        }
+    });
+    have_prev = true;
+}
+
+template KANGAROO_EXPORT void StereoTemporal::Process(Image<float,TargetHost> disp, const Image<unsigned char,TargetHost> left, const Image<unsigned char,TargetHost> right);
+template KANGAROO_EXPORT void StereoTemporal::Process(Image<float,TargetHost> disp, const Image<float,TargetHost> left, const Image<float,TargetHost> right);
+
+}
@@ -24,4 +24,43 @@ void BilateralFilter(
     Image<To> dOut, const Image<Ti> dIn, const Image<Ti2> dImg, float gs, float gr, float gc, uint size
 );
 
+//////////////////////////////////////////////////////
+// Host (CPU) execution, see cpu_bilateral.cpp
+//////////////////////////////////////////////////////
+
+template<typename To, typename Ti>
+KANGAROO_EXPORT
+void BilateralFilter(
+    Image<To,TargetHost> dOut, const Image<Ti,TargetHost> dIn, float gs, float gr, uint size
+);
+
+template<typename To, typename Ti>
+KANGAROO_EXPORT
+void BilateralFilter(
+    Image<To,TargetHost> dOut, const Image<Ti,TargetHost> dIn, float gs, float gr, uint size, Ti minval
+);
+
+template<typename To, typename Ti, typename Ti2>
+KANGAROO_EXPORT
+void BilateralFilter(
+    Image<To,TargetHost> dOut, const Image<Ti,TargetHost> dIn, const Image<Ti2,TargetHost> dImg, float gs, float gr, float gc, uint size
+);
+
+// Bilateral grid approximation of the filters above with the same gs and gr,
+// whose cost does not depend on gs. Pixels below minval are ignored and
+// come out invalid. gs, in pixels, should be at least 1. gr is coarsened to
+// keep the grid within 256 intensity cells, and grids much larger than the
+// image (small gs) fall back to BilateralFilter with size ceil(2*gs).
+template<typename To, typename Ti>
+KANGAROO_EXPORT
+void BilateralGridFilter(
+    Image<To,TargetHost> dOut, const Image<Ti,TargetHost> dIn, float gs, float gr
+);
+
+template<typename To, typename Ti>
+KANGAROO_EXPORT
+void BilateralGridFilter(
+    Image<To,TargetHost> dOut, const Image<Ti,TargetHost> dIn, float gs, float gr, Ti minval
+);
+
 }
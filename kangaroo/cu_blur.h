@@ -18,4 +18,15 @@ template<typename Tout, typename Tin, unsigned MAXRAD, unsigned MAXIMGDIM>
 KANGAROO_EXPORT
 void GaussianBlur(Image<Tout> out, Image<Tin> in, Image<Tout> temp, float sigma);
 
+//////////////////////////////////////////////////////
+// Host (CPU) execution, see cpu_blur.cpp
+//////////////////////////////////////////////////////
+
+// Recursive (IIR) Gaussian with edge values extended, whose cost does not
+// depend on sigma. Sigma below 0.5 is treated as 0.5, except 0 which copies.
+// temp is not used, intermediate results are kept in float.
+template<typename Tout, typename Tin>
+KANGAROO_EXPORT
+void GaussianBlur(Image<Tout,TargetHost> out, const Image<Tin,TargetHost> in, Image<Tout,TargetHost> temp, float sigma);
+
 }
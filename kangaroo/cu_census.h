@@ -3,6 +3,7 @@
 #include <kangaroo/platform.h>
 #include <kangaroo/Image.h>
 #include <kangaroo/Volume.h>
+#include <kangaroo/CostVolRange.h>
 
 namespace roo
 {
@@ -37,4 +38,40 @@ template<typename Tvol, typename T>
 KANGAROO_EXPORT
 void CensusStereoVolume(Volume<Tvol> vol, Image<T> left, Image<T> right, int maxDisp, float sd);
 
+//////////////////////////////////////////////////////
+// Host (CPU) execution, see cpu_census.cpp
+// Same descriptor bit layout as the device; Hamming distances count all 64
+// bits of every word.
+//////////////////////////////////////////////////////
+
+KANGAROO_EXPORT
+void Census(Image<unsigned long,TargetHost> census, const Image<unsigned char,TargetHost> img);
+
+KANGAROO_EXPORT
+void Census(Image<ulong2,TargetHost> census, const Image<unsigned char,TargetHost> img);
+
+KANGAROO_EXPORT
+void Census(Image<ulong4,TargetHost> census, const Image<unsigned char,TargetHost> img);
+
+KANGAROO_EXPORT
+void Census(Image<unsigned long,TargetHost> census, const Image<float,TargetHost> img);
+
+KANGAROO_EXPORT
+void Census(Image<ulong2,TargetHost> census, const Image<float,TargetHost> img);
+
+KANGAROO_EXPORT
+void Census(Image<ulong4,TargetHost> census, const Image<float,TargetHost> img);
+
+KANGAROO_EXPORT
+void CensusStereo(Image<char,TargetHost> disp, const Image<unsigned long,TargetHost> left, const Image<unsigned long,TargetHost> right, int maxDisp);
+
+template<typename Tvol, typename T>
+KANGAROO_EXPORT
+void CensusStereoVolume(Volume<Tvol,TargetHost> vol, const Image<T,TargetHost> left, const Image<T,TargetHost> right, int maxDisp, float sd);
+
+// Costs of the disparity window of every pixel only, see CostVolRange
+template<typename Tvol, typename T>
+KANGAROO_EXPORT
+void CensusStereoVolume(CostVolRange<Tvol,TargetHost> vol, const Image<T,TargetHost> left, const Image<T,TargetHost> right, float sd);
+
 }
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <vector>
+
 #include <kangaroo/platform.h>
 #include <kangaroo/Image.h>
 
@@ -12,4 +14,60 @@ void Convolution(
     Image<OT> out,  Image<IT> in,  Image<KT> kern, int kx, int ky
 );
 
+//////////////////////////////////////////////////////
+// Host (CPU) execution, see cpu_convolution.cpp
+//////////////////////////////////////////////////////
+
+// As KernConvolution: kernel origin (kx,ky), Neumann borders, normalised by
+// the kernel sum. Kernels of CONVOLUTION_FFT_MIN_TAPS taps or more go
+// through a ConvolutionSpectrum, which is kept for the last kernel and image
+// size of the calling thread.
+template<typename OT, typename IT, typename KT, typename ACC>
+KANGAROO_EXPORT
+void Convolution(
+    Image<OT,TargetHost> out, const Image<IT,TargetHost> in, const Image<KT,TargetHost> kern, int kx, int ky
+);
+
+const int CONVOLUTION_FFT_MIN_TAPS = 144;
+
+// Mixed radix (4,2,3,5) complex FFT of length n
+struct FFTPlan
+{
+    FFTPlan() : n(0) {}
+
+    int n;
+    std::vector<int> radix;
+    std::vector<float2> twiddle;
+};
+
+// Spectrum of a kernel for repeated Convolution of w x h images, so each
+// call costs two real 2D FFTs, O(w*h*log(w*h)) whatever the kernel size.
+// The image is extended by the Neumann border before the transform, so
+// results match the direct convolution up to float rounding.
+struct ConvolutionSpectrum
+{
+    ConvolutionSpectrum() : w(0), h(0), kx(0), ky(0), kw(0), kh(0), nw(0), nh(0) {}
+
+    int w, h;
+    int kx, ky, kw, kh;
+
+    // Transform size, nw even
+    int nw, nh;
+    FFTPlan rows;
+    FFTPlan cols;
+
+    // exp(-2 pi i k / nw) for k in [0,nw/2], splits the real row transforms
+    std::vector<float2> W;
+
+    // Conjugate kernel spectrum scaled for normalisation, (nw/2+1) x nh
+    // real parts followed by as many imaginary parts
+    std::vector<float> K;
+};
+
+KANGAROO_EXPORT
+void ConvolutionSpectrumInit(ConvolutionSpectrum& spec, int w, int h, const Image<float,TargetHost> kern, int kx, int ky);
+
+KANGAROO_EXPORT
+void Convolution(Image<float,TargetHost> out, const Image<float,TargetHost> in, const ConvolutionSpectrum& spec);
+
 }
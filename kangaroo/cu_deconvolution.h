@@ -2,6 +2,7 @@
 
 #include <kangaroo/platform.h>
 #include <kangaroo/Image.h>
+#include <kangaroo/cu_convolution.h>
 
 namespace roo
 {
@@ -18,4 +19,43 @@ void Deconvolution_uDescent(
         float tau, float lambda
 );
 
+//////////////////////////////////////////////////////
+// Host (CPU) execution, see cpu_deconvolution.cpp
+//////////////////////////////////////////////////////
+
+KANGAROO_EXPORT
+void DeconvolutionDual_qAscent(
+        Image<float,TargetHost> q, const Image<float,TargetHost> Au, const Image<float,TargetHost> g,
+        float sigma_q, float lambda
+);
+
+KANGAROO_EXPORT
+void Deconvolution_uDescent(
+        Image<float,TargetHost> imgu, const Image<float2,TargetHost> imgp, const Image<float,TargetHost> imgATq,
+        float tau, float lambda
+);
+
+// Spectra of the blur kernel k, origin (kx,ky), and of its adjoint, k
+// rotated by 180 degrees about the origin, for w x h images
+struct DeconvolutionSpectra
+{
+    ConvolutionSpectrum k;
+    ConvolutionSpectrum kT;
+};
+
+KANGAROO_EXPORT
+void DeconvolutionSpectraInit(DeconvolutionSpectra& spec, int w, int h, const Image<float,TargetHost> kern, int kx, int ky);
+
+// Primal dual iterations deblurring g: HuberGradU_DualAscentP on p,
+// DeconvolutionDual_qAscent on Au = k*u and Deconvolution_uDescent on
+// ATq = kT*q. u, p and q carry the state between calls, Au and ATq are
+// scratch. Every iteration costs four real 2D FFTs whatever the kernel size.
+KANGAROO_EXPORT
+void Deconvolution(
+        Image<float,TargetHost> u, Image<float2,TargetHost> p, Image<float,TargetHost> q,
+        const Image<float,TargetHost> g, const DeconvolutionSpectra& spec,
+        Image<float,TargetHost> Au, Image<float,TargetHost> ATq,
+        float sigma_p, float sigma_q, float tau, float lambda, float alpha, int iterations
+);
+
 }
@@ -3,7 +3,11 @@
 #include <kangaroo/platform.h>
 #include <kangaroo/Image.h>
 #include <kangaroo/Volume.h>
+#include <kangaroo/Pyramid.h>
 #include <kangaroo/CostVolElem.h>
+#include <kangaroo/CostVolRange.h>
+#include <kangaroo/ImageKeyframe.h>
+#include <kangaroo/patch_score.h>
 
 namespace roo
 {
@@ -95,6 +99,157 @@ void CostVolumeCrossSection(
     Image<float> dScore, Volume<CostVolElem> dCostVol, int y
 );
 
+//////////////////////////////////////////////////////
+// Compact cost volumes, host (CPU) execution, see cpu_dense_stereo.cpp
+//////////////////////////////////////////////////////
+
+// Window of every pixel from seed disparities, e.g. of a coarser pyramid
+// level (scaled to the width of vol) or of the previous frame: the 3x3
+// seed neighbourhood widened by radius, within [0,maxDisp) and the other
+// view (sd as in CensusStereoVolume). Pixels without a valid seed search
+// from 0, windows wider than vol.Window() are centred on the seed.
+template<typename T>
+KANGAROO_EXPORT
+void CostVolRangeFromDisparity(CostVolRange<T,TargetHost> vol, const Image<float,TargetHost> seed, int radius, int maxDisp, float sd);
+
+// Full [0,maxDisp) search, clipped to the other view
+KANGAROO_EXPORT
+void CostVolRangeFull(Image<short2,TargetHost> range, int maxDisp, float sd);
+
+// Absolute disparities, NaN for pixels with an empty window
+KANGAROO_EXPORT
+void CostVolMinimum(Image<float,TargetHost> disp, const CostVolRange<float,TargetHost> vol);
+
+KANGAROO_EXPORT
+void CostVolMinimumSubpix(Image<float,TargetHost> disp, const CostVolRange<float,TargetHost> vol);
+
+// Left and right subpixel disparities, confidence and left right check
+// from a single pass over vol, left pixel x matched with right x + sd*d.
+// conf is 1 - best / second best cost ignoring the neighbours of the best
+// (costs must be non-negative), lrcheck is 255 where the disparities agree
+// within maxDiff, 0 elsewhere. Empty dispR, conf and lrcheck are skipped.
+KANGAROO_EXPORT
+void CostVolDisparities(Image<float,TargetHost> dispL, Image<float,TargetHost> dispR, Image<float,TargetHost> conf, Image<unsigned char,TargetHost> lrcheck, const Volume<float,TargetHost> vol, int maxDisp, float sd = -1, float maxDiff = 1);
+
+KANGAROO_EXPORT
+void CostVolDisparities(Image<float,TargetHost> dispL, Image<float,TargetHost> dispR, Image<float,TargetHost> conf, Image<unsigned char,TargetHost> lrcheck, const CostVolRange<float,TargetHost> vol, float sd = -1, float maxDiff = 1);
+
+//////////////////////////////////////////////////////
+// Band streaming stereo, host (CPU) execution, see cpu_stereo_stream.cpp
+//
+// Census costs, SGM and minimum for bands of bandRows rows at a time, so
+// memory is bounded by the band height rather than the image height (see
+// DenseStereoStreamedBytes). Vertical and diagonal SGM paths start
+// overlapRows above / below a band, so they match whole image SGM only
+// approximately; horizontal paths are exact.
+//////////////////////////////////////////////////////
+
+struct StereoStreamParams
+{
+    StereoStreamParams()
+        : maxDisp(64), bandRows(32), overlapRows(32), sd(-1),
+          P1(0.01f), P2(0.02f), dohoriz(true), dovert(true), doreverse(true), dodiag(false),
+          subpix(true)
+    {
+    }
+
+    int maxDisp;
+    int bandRows;
+    int overlapRows;
+    float sd;
+    float P1;
+    float P2;
+    bool dohoriz;
+    bool dovert;
+    bool doreverse;
+    bool dodiag;
+    bool subpix;
+};
+
+// Called once rows [y0,y1) of disp are final
+typedef void (*StereoRowsCallback)(const Image<float,TargetHost> disp, int y0, int y1, void* user);
+
+template<typename Timg>
+KANGAROO_EXPORT
+void DenseStereoStreamed(Image<float,TargetHost> disp, const Image<Timg,TargetHost> left, const Image<Timg,TargetHost> right, const StereoStreamParams& params, StereoRowsCallback callback = 0, void* user = 0);
+
+// Working memory of DenseStereoStreamed for images w pixels wide
+KANGAROO_EXPORT
+size_t DenseStereoStreamedBytes(int w, const StereoStreamParams& params);
+
+//////////////////////////////////////////////////////
+// Coarse to fine stereo, host (CPU) execution, see cpu_dense_stereo.cpp
+//
+// Full search over maxDisp/2^(levels-1) at the top of the pyramids, then a
+// band of searchRad around the upsampled disparities on every finer level.
+// Right view at x-d; NaN where no match or refinement failed.
+//////////////////////////////////////////////////////
+
+template<typename TImg, unsigned Levels>
+KANGAROO_EXPORT
+void DenseStereoPyramid(Image<float,TargetHost> disp, const Pyramid<TImg,Levels,TargetHost> left, const Pyramid<TImg,Levels,TargetHost> right, int maxDisp, int levels = Levels, int searchRad = 2, bool subpix = true);
+
+KANGAROO_EXPORT
+void DenseStereoSubpixelRefine(Image<float,TargetHost> dDispOut, const Image<unsigned char,TargetHost> dDisp, const Image<unsigned char,TargetHost> dCamLeft, const Image<unsigned char,TargetHost> dCamRight);
+
+//////////////////////////////////////////////////////
+// PatchMatch stereo, host (CPU) execution, see cpu_patch_match.cpp
+//
+// Slanted disparity planes per pixel from random initialisation, checkerboard
+// propagation and random refinement. Time O(w*h*iterations) and memory
+// O(w*h) regardless of maxDisp. Right view at x-d.
+//////////////////////////////////////////////////////
+
+struct PatchMatchParams
+{
+    PatchMatchParams()
+        : maxDisp(256), iterations(4), rad(3), ssnd(false), refineSteps(6), seed(0)
+    {
+    }
+
+    int maxDisp;
+    int iterations;
+    // SAD or SSND (as SADPatchScore, SSNDPatchScore) of (2*rad+1)^2 pixels,
+    // each matched at its own disparity on the plane, rad in [1,4]
+    // (std::invalid_argument otherwise)
+    int rad;
+    bool ssnd;
+    int refineSteps;
+    unsigned int seed;
+};
+
+KANGAROO_EXPORT
+void PatchMatchStereo(Image<float,TargetHost> disp, const Image<float,TargetHost> left, const Image<float,TargetHost> right, const PatchMatchParams& params);
+
+//////////////////////////////////////////////////////
+// Multi-view plane sweep, host (CPU) execution, see cpu_plane_sweep.cpp
+//
+// Costs of all views for every plane of vol in one tiled pass, plane d at
+// depth ref.K.fu*baseline/d as CostVolumeAdd. Views are posed with T_iw in
+// the same world frame as ref; without accumulate vol is overwritten.
+//////////////////////////////////////////////////////
+
+template<typename T>
+KANGAROO_EXPORT
+void PlaneSweep(Volume<CostVolElem,TargetHost> vol, const ImageKeyframe<T,TargetHost> ref, const ImageKeyframe<T,TargetHost>* views, int numViews, float baseline, bool accumulate = false);
+
+KANGAROO_EXPORT
+void CostVolMinimum(Image<float,TargetHost> disp, const Volume<CostVolElem,TargetHost> vol);
+
+//////////////////////////////////////////////////////
+// Patch costs, host (CPU) execution, see cpu_patch_stereo.cpp
+//
+// vol(x,y,d) = Score::Score(left,x,y, right,x+sd*d,y) for d < vol.d
+// from running box sums, so the cost per pixel and disparity does not grow
+// with the patch size. sd must be a whole number (std::invalid_argument
+// otherwise). Score is SADPatchScore, SSDPatchScore or
+// SSNDPatchScore<float,rad,ImgAccessClamped>, rad 1-5 or 7.
+//////////////////////////////////////////////////////
+
+template<typename Score, typename TImg>
+KANGAROO_EXPORT
+void CostVolumeFromStereoPatch(Volume<float,TargetHost> vol, const Image<TImg,TargetHost> left, const Image<TImg,TargetHost> right, float sd = -1);
+
 //////////////////////////////////////////////////////
 
 KANGAROO_EXPORT
@@ -37,4 +37,27 @@ template<typename Tout, typename Tin, size_t N>
 KANGAROO_EXPORT
 void TextureDepth(Image<Tout> img, const Mat<ImageKeyframe<Tin>,N> kfs, const Image<float> depth, const Image<float4> norm, const Image<float> phong, const Mat<float,3,4> T_wd, ImageIntrinsics Kdepth);
 
+//////////////////////////////////////////////////////
+// Host (CPU) execution, see cpu_depth_tools.cpp
+//////////////////////////////////////////////////////
+
+KANGAROO_EXPORT
+void Disp2Depth(Image<float,TargetHost> dIn, const Image<float,TargetHost> dOut, float fu, float fBaseline, float fMinDisp = 0.0);
+
+KANGAROO_EXPORT
+void FilterBadKinectData(Image<float,TargetHost> dFiltered, Image<unsigned short,TargetHost> dKinectDepth);
+
+KANGAROO_EXPORT
+void FilterBadKinectData(Image<float,TargetHost> dFiltered, Image<float,TargetHost> dKinectDepth);
+
+template<typename T>
+KANGAROO_EXPORT
+void DepthToVbo( Image<float4,TargetHost> dVbo, const Image<T,TargetHost> dKinectDepth, ImageIntrinsics K, float scale = 1.0f);
+
+template<typename T>
+inline void DepthToVbo( Image<float4,TargetHost> dVbo, const Image<T,TargetHost> dKinectDepth, float fu, float fv, float u0, float v0, float scale = 1.0f)
+{
+    DepthToVbo(dVbo, dKinectDepth, ImageIntrinsics(fu,fv,u0,v0), scale);
+}
+
 }
@@ -92,4 +92,41 @@ inline void GuidedFilter(Image<float> q, const Image<float> covIP, const Image<f
     ElementwiseMultiplyAdd<float,float,float,float,float>(q,meana,I,meanb);
 }
 
+//////////////////////////////////////////////////////
+// Host (CPU) execution, see cpu_integral_image.cpp
+//////////////////////////////////////////////////////
+
+template<typename Tout, typename Tin>
+KANGAROO_EXPORT
+void Transpose(Image<Tout,TargetHost> out, const Image<Tin,TargetHost> in);
+
+template<typename Tout, typename Tin>
+KANGAROO_EXPORT
+void PrefixSumRows(Image<Tout,TargetHost> out, const Image<Tin,TargetHost> in);
+
+template<typename Tout, typename Tin>
+KANGAROO_EXPORT
+void BoxFilterIntegralImage(Image<Tout,TargetHost> out, const Image<Tin,TargetHost> IntegralImageT, int rad);
+
+template<typename Tout, typename Tin, typename TSum>
+void BoxFilter(Image<Tout,TargetHost> out, const Image<Tin,TargetHost> in, Image<unsigned char,TargetHost> scratch, int rad)
+{
+    Image<TSum,TargetHost> RowPrefixSum = scratch.template AlignedImage<TSum>(in.w, in.h);
+    PrefixSumRows<TSum,Tin>(RowPrefixSum, in);
+
+    Image<TSum,TargetHost> RowPrefixSumT = out.template AlignedImage<TSum>(in.h, in.w);
+    Transpose<TSum,TSum>(RowPrefixSumT,RowPrefixSum);
+
+    Image<TSum,TargetHost> IntegralImageT = scratch.template AlignedImage<TSum>(in.h, in.w);
+    PrefixSumRows<TSum,TSum>(IntegralImageT, RowPrefixSumT);
+
+    BoxFilterIntegralImage<Tout,TSum>(out,IntegralImageT,rad);
+}
+
+// Guided filter of p with guide I over the windows of BoxFilter, the same
+// as ComputeMeanVarience, ComputeCovariance and GuidedFilter above but in
+// two sweeps over the images. q may be p or I.
+KANGAROO_EXPORT
+void GuidedFilter(Image<float,TargetHost> q, const Image<float,TargetHost> I, const Image<float,TargetHost> p, int rad, float eps);
+
 }
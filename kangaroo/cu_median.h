@@ -31,4 +31,33 @@ void MedianFilterRejectNegative9x9(
     Image<float> dOut, Image<float> dIn, int maxbad
 );
 
+//////////////////////////////////////////////////////
+// Host (CPU) execution, see cpu_median.cpp
+//////////////////////////////////////////////////////
+
+KANGAROO_EXPORT
+void MedianFilter3x3(
+    Image<float,TargetHost> dOut, const Image<float,TargetHost> dIn
+);
+
+KANGAROO_EXPORT
+void MedianFilter5x5(
+    Image<float,TargetHost> dOut, const Image<float,TargetHost> dIn
+);
+
+KANGAROO_EXPORT
+void MedianFilterRejectNegative5x5(
+    Image<float,TargetHost> dOut, const Image<float,TargetHost> dIn, int maxbad = 100
+);
+
+KANGAROO_EXPORT
+void MedianFilterRejectNegative7x7(
+    Image<float,TargetHost> dOut, const Image<float,TargetHost> dIn, int maxbad
+);
+
+KANGAROO_EXPORT
+void MedianFilterRejectNegative9x9(
+    Image<float,TargetHost> dOut, const Image<float,TargetHost> dIn, int maxbad
+);
+
 }
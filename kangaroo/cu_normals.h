@@ -9,4 +9,8 @@ namespace roo
 KANGAROO_EXPORT
 void NormalsFromVbo(Image<float4> dN, const Image<float4> dV);
 
+// Host (CPU) execution, see cpu_normals.cpp
+KANGAROO_EXPORT
+void NormalsFromVbo(Image<float4,TargetHost> dN, const Image<float4,TargetHost> dV);
+
 }
@@ -38,4 +38,40 @@ template<typename Tout, typename T>
 KANGAROO_EXPORT
 Tout ImageL1(Image<T> img, Image<unsigned char> scratch);
 
+//////////////////////////////////////////////////////
+// Host (CPU) execution, see cpu_operations.cpp
+//////////////////////////////////////////////////////
+
+template<typename T>
+KANGAROO_EXPORT
+void Fill(Image<T,TargetHost> img, T val);
+
+template<typename Tout, typename Tin, typename Tup>
+KANGAROO_EXPORT
+void ElementwiseScaleBias(Image<Tout,TargetHost> b, const Image<Tin,TargetHost> a, float s, Tup offset=0);
+
+template<typename Tout, typename Tin1, typename Tin2, typename Tup>
+KANGAROO_EXPORT
+void ElementwiseAdd(Image<Tout,TargetHost> c, Image<Tin1,TargetHost> a, Image<Tin2,TargetHost> b, Tup sa=1, Tup sb=1, Tup offset=0 );
+
+template<typename Tout, typename Tin1, typename Tin2, typename Tup>
+KANGAROO_EXPORT
+void ElementwiseMultiply(Image<Tout,TargetHost> c, Image<Tin1,TargetHost> a, Image<Tin2,TargetHost> b, Tup scalar=1, Tup offset=0 );
+
+template<typename Tout, typename Tin1, typename Tin2, typename Tup>
+KANGAROO_EXPORT
+void ElementwiseDivision(Image<Tout,TargetHost> c, const Image<Tin1,TargetHost> a, const Image<Tin2,TargetHost> b, Tup sa=0, Tup sb=0, Tup scalar=1, Tup offset=0);
+
+template<typename Tout, typename Tin, typename Tup>
+KANGAROO_EXPORT
+void ElementwiseSquare(Image<Tout,TargetHost> b, const Image<Tin,TargetHost> a, Tup scalar=1, Tup offset=0 );
+
+template<typename Tout, typename Tin1, typename Tin2, typename Tin3, typename Tup>
+KANGAROO_EXPORT
+void ElementwiseMultiplyAdd(Image<Tout,TargetHost> d, const Image<Tin1,TargetHost> a, const Image<Tin2,TargetHost> b, const Image<Tin3,TargetHost> c, Tup sab=1, Tup sc=1, Tup offset=0);
+
+template<typename Tout, typename T>
+KANGAROO_EXPORT
+Tout ImageL1(Image<T,TargetHost> img, Image<unsigned char,TargetHost> scratch);
+
 }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <kangaroo/platform.h>
+#include <kangaroo/Image.h>
 
 namespace roo
 {
@@ -47,4 +48,20 @@ void WeightedL2_u_minus_g_PrimalDescent(
         float tau, float lambda
 );
 
+//////////////////////////////////////////////////////
+// Host (CPU) execution, see cpu_rof_denoising.cpp
+//////////////////////////////////////////////////////
+
+KANGAROO_EXPORT
+void TVL1GradU_DualAscentP(
+        Image<float2,TargetHost> p, const Image<float,TargetHost> u,
+        float sigma
+);
+
+KANGAROO_EXPORT
+void HuberGradU_DualAscentP(
+        Image<float2,TargetHost> p, const Image<float,TargetHost> u,
+        float sigma, float alpha
+);
+
 }
@@ -3,6 +3,7 @@
 #include <kangaroo/platform.h>
 #include <kangaroo/Image.h>
 #include <kangaroo/Volume.h>
+#include <kangaroo/CostVolRange.h>
 
 namespace roo
 {
@@ -11,4 +12,17 @@ template<typename TH, typename TC, typename Timg>
 KANGAROO_EXPORT
 void SemiGlobalMatching(Volume<TH> volH, Volume<TC> volC, Image<Timg> left, int maxDisp, float P1, float P2, bool dohoriz, bool dovert, bool doreverse);
 
+// Host (CPU) execution, see cpu_semi_global_matching.cpp
+// Paths are aggregated independently with 16 bit saturating costs, SIMD over
+// disparities where the compiler targets SSE4.1 / AVX2.
+template<typename TH, typename TC, typename Timg>
+KANGAROO_EXPORT
+void SemiGlobalMatching(Volume<TH,TargetHost> volH, Volume<TC,TargetHost> volC, Image<Timg,TargetHost> left, int maxDisp, float P1, float P2, bool dohoriz, bool dovert, bool doreverse, bool dodiag = false);
+
+// Compact cost volume, windows of neighbouring pixels are realigned along
+// each path. volH is given the windows of volC.
+template<typename TH, typename TC, typename Timg>
+KANGAROO_EXPORT
+void SemiGlobalMatching(CostVolRange<TH,TargetHost> volH, CostVolRange<TC,TargetHost> volC, Image<Timg,TargetHost> left, float P1, float P2, bool dohoriz, bool dovert, bool doreverse, bool dodiag = false);
+
 }
@@ -25,7 +25,7 @@ struct BitonicSwaps
 
     void Print()
     {
-        for(int i=0; i < swaps.size(); ++i )
+        for(size_t i=0; i < swaps.size(); ++i )
         {
             biswap swap = swaps[i];
             std::cout << "t2(" << swap.first << "," << swap.second << "); ";
@@ -54,9 +54,6 @@ struct BitonicNetwork
     {
         stages = ceil(log(size) / log(2));
         N = 1 << stages;
-        std::cout << "Numbers: " << size << std::endl;
-        std::cout << "Stages:" << stages << std::endl;
-        std::cout << "Network size: " << N << std::endl;
     }
 
     void Compute()
@@ -65,7 +62,6 @@ struct BitonicNetwork
         for(int s=0; s<stages; ++s) {
             ComputeStage(s);
         }
-        std::cout << "Swap rounds: " << rounds.size() << std::endl;
     }
 
     void Prune(std::set<int>& workingset)
@@ -78,16 +74,32 @@ struct BitonicNetwork
 
     void Print()
     {
-        for(int r=0; r < rounds.size(); ++r)
+        std::cout << "Numbers: " << size << std::endl;
+        std::cout << "Stages:" << stages << std::endl;
+        std::cout << "Network size: " << N << std::endl;
+        std::cout << "Swap rounds: " << rounds.size() << std::endl;
+        for(size_t r=0; r < rounds.size(); ++r)
         {
             rounds[r].Print();
         }
     }
 
+    // All compare / swaps in order, the smaller value goes to swap.first.
+    // Swaps within a round touch distinct elements.
+    std::vector<biswap> Swaps()
+    {
+        std::vector<biswap> all;
+        for(size_t r=0; r < rounds.size(); ++r)
+        {
+            all.insert(all.end(), rounds[r].swaps.begin(), rounds[r].swaps.end());
+        }
+        return all;
+    }
+
     int Size()
     {
         int size = 0;
-        for(int r=0; r < rounds.size(); ++r)
+        for(size_t r=0; r < rounds.size(); ++r)
         {
             size += rounds[r].Size();
         }
@@ -122,7 +122,7 @@ bool LoadPXM(std::ifstream& bFile, roo::Volume<T,roo::TargetHost,roo::Manage>& v
         roo::Manage::Cleanup<T,roo::TargetHost>(vol.ptr);
 
         // Allocate memory
-        roo::TargetHost::AllocatePitchedMem<T>(&vol.ptr,&vol.pitch,&vol.img_pitch,w,h,d);
+        roo::Manage::AllocatePitchedMem<T,roo::TargetHost>(&vol.ptr,&vol.pitch,&vol.img_pitch,w,h,d);
         vol.w = w; vol.h = h; vol.d = d;
 
         // Read in data
@@ -170,7 +170,7 @@ bool LoadPXM(const std::string filename, roo::Volume<T,roo::TargetDevice,roo::Ma
     if(success) {
         roo::Manage::Cleanup<T,roo::TargetDevice>(vol.ptr);
 
-        roo::TargetDevice::AllocatePitchedMem<T>(&vol.ptr,&vol.pitch,&vol.img_pitch,hvol.w,hvol.h,hvol.d);
+        roo::Manage::AllocatePitchedMem<T,roo::TargetDevice>(&vol.ptr,&vol.pitch,&vol.img_pitch,hvol.w,hvol.h,hvol.d);
         vol.w = hvol.w; vol.h = hvol.h; vol.d = hvol.d;
 
         vol.CopyFrom(hvol);
@@ -187,7 +187,7 @@ bool LoadPXM(const std::string filename, roo::BoundedVolume<T,roo::TargetDevice,
     if(success) {
         roo::Manage::Cleanup<T,roo::TargetDevice>(vol.ptr);
 
-        roo::TargetDevice::AllocatePitchedMem<T>(&vol.ptr,&vol.pitch,&vol.img_pitch,hvol.w,hvol.h,hvol.d);
+        roo::Manage::AllocatePitchedMem<T,roo::TargetDevice>(&vol.ptr,&vol.pitch,&vol.img_pitch,hvol.w,hvol.h,hvol.d);
         vol.w = hvol.w; vol.h = hvol.h; vol.d = hvol.d;
 
         vol.CopyFrom(hvol);
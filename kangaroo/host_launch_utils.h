@@ -0,0 +1,282 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <kangaroo/platform.h>
+
+namespace roo
+{
+
+////////////////////////////////////////
+// Definition
+////////////////////////////////////////
+
+//! Fixed size pool of worker threads shared by every host (TargetHost) kernel.
+//! The calling thread takes part in the work, so a pool of N threads
+//! keeps N-1 workers alive. Tasks are handed out one at a time from an
+//! atomic counter so uneven rows or tiles balance themselves.
+class HostThreadPool
+{
+public:
+    static HostThreadPool& Instance();
+
+    ~HostThreadPool();
+
+    //! Number of threads (including the caller) used by Run
+    unsigned NumThreads() const;
+
+    //! Resize the pool. 0 selects std::thread::hardware_concurrency()
+    void SetNumThreads(unsigned num_threads);
+
+    //! Call fn(task) for every task in [0,num_tasks) and wait for completion.
+    //! Nested calls made from inside a task run serially on that thread.
+    //! The first exception thrown by a task is rethrown here.
+    void Run(size_t num_tasks, const std::function<void(size_t)>& fn);
+
+protected:
+    HostThreadPool();
+    HostThreadPool(const HostThreadPool&);
+    HostThreadPool& operator=(const HostThreadPool&);
+
+    void StartWorkers(unsigned num_workers);
+    void StopWorkers();
+    void WorkerLoop();
+    void ExecuteTasks(const std::function<void(size_t)>& fn, size_t num_tasks);
+
+    static bool& InsideTask();
+
+    std::vector<std::thread> workers;
+    std::mutex run_mutex;
+    std::mutex mutex;
+    std::condition_variable cv_work;
+    std::condition_variable cv_done;
+
+    const std::function<void(size_t)>* job_fn;
+    size_t job_tasks;
+    size_t tasks_done;
+    size_t generation;
+    unsigned active;
+    bool stop;
+    std::atomic<size_t> next_task;
+    std::exception_ptr job_error;
+};
+
+////////////////////////////////////////
+// Launch helpers
+////////////////////////////////////////
+
+//! Calls kern(i) for i in [begin,end), 'grain' consecutive indices per task
+template<typename F>
+inline void ParallelFor(size_t begin, size_t end, F kern, size_t grain = 1)
+{
+    if(end <= begin) return;
+    grain = std::max<size_t>(grain, 1);
+    const size_t num_tasks = (end - begin + grain - 1) / grain;
+    HostThreadPool::Instance().Run(num_tasks, [&](size_t t) {
+        const size_t i0 = begin + t*grain;
+        const size_t i1 = std::min(end, i0 + grain);
+        for(size_t i=i0; i < i1; ++i) kern(i);
+    });
+}
+
+//! Host equivalent of InitDimFromOutputImage for row-wise kernels.
+//! Calls kern(y_begin, y_end) on bands of rows covering [0,h). Bands are
+//! sized so each thread gets a few of them to balance load.
+template<typename F>
+inline void ParallelForRows(size_t h, F kern, size_t min_rows = 4)
+{
+    if(h == 0) return;
+    const size_t threads = HostThreadPool::Instance().NumThreads();
+    const size_t rows = std::max<size_t>(min_rows, (h + 4*threads - 1) / (4*threads));
+    const size_t num_tasks = (h + rows - 1) / rows;
+    HostThreadPool::Instance().Run(num_tasks, [&](size_t t) {
+        kern(t*rows, std::min(h, (t+1)*rows));
+    });
+}
+
+//! Cache-tiled launch for kernels reading a neighbourhood around each pixel.
+//! Calls kern(x_begin, x_end, y_begin, y_end) for each tile covering (w,h).
+template<typename F>
+inline void ParallelForTiles(size_t w, size_t h, F kern, size_t tile_w = 128, size_t tile_h = 32)
+{
+    if(w == 0 || h == 0) return;
+    const size_t tiles_x = (w + tile_w - 1) / tile_w;
+    const size_t tiles_y = (h + tile_h - 1) / tile_h;
+    HostThreadPool::Instance().Run(tiles_x * tiles_y, [&](size_t t) {
+        const size_t x0 = (t % tiles_x) * tile_w;
+        const size_t y0 = (t / tiles_x) * tile_h;
+        kern(x0, std::min(w, x0+tile_w), y0, std::min(h, y0+tile_h));
+    });
+}
+
+//! Calls kern(x,y) for every pixel of a w x h output, tile by tile
+template<typename F>
+inline void ParallelForPixels(size_t w, size_t h, F kern, size_t tile_w = 128, size_t tile_h = 32)
+{
+    ParallelForTiles(w, h, [&](size_t x0, size_t x1, size_t y0, size_t y1) {
+        for(size_t y=y0; y < y1; ++y) {
+            for(size_t x=x0; x < x1; ++x) {
+                kern(x,y);
+            }
+        }
+    }, tile_w, tile_h);
+}
+
+////////////////////////////////////////
+// Implementation
+////////////////////////////////////////
+
+inline HostThreadPool& HostThreadPool::Instance()
+{
+    static HostThreadPool pool;
+    return pool;
+}
+
+inline HostThreadPool::HostThreadPool()
+    : job_fn(0), job_tasks(0), tasks_done(0), generation(0), active(0), stop(false), next_task(0)
+{
+    const unsigned hw = std::thread::hardware_concurrency();
+    StartWorkers(hw > 1 ? hw-1 : 0);
+}
+
+inline HostThreadPool::~HostThreadPool()
+{
+    StopWorkers();
+}
+
+inline unsigned HostThreadPool::NumThreads() const
+{
+    return (unsigned)workers.size() + 1;
+}
+
+inline void HostThreadPool::SetNumThreads(unsigned num_threads)
+{
+    if(num_threads == 0) {
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    std::lock_guard<std::mutex> run_lock(run_mutex);
+    StopWorkers();
+    StartWorkers(num_threads-1);
+}
+
+inline bool& HostThreadPool::InsideTask()
+{
+    static thread_local bool inside = false;
+    return inside;
+}
+
+inline void HostThreadPool::StartWorkers(unsigned num_workers)
+{
+    stop = false;
+    for(unsigned i=0; i < num_workers; ++i) {
+        workers.push_back( std::thread(&HostThreadPool::WorkerLoop, this) );
+    }
+}
+
+inline void HostThreadPool::StopWorkers()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+    }
+    cv_work.notify_all();
+    for(size_t i=0; i < workers.size(); ++i) {
+        workers[i].join();
+    }
+    workers.clear();
+}
+
+inline void HostThreadPool::ExecuteTasks(const std::function<void(size_t)>& fn, size_t num_tasks)
+{
+    size_t completed = 0;
+    InsideTask() = true;
+    for(size_t t = next_task++; t < num_tasks; t = next_task++) {
+        try {
+            fn(t);
+        }catch(...) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if(!job_error) job_error = std::current_exception();
+        }
+        ++completed;
+    }
+    InsideTask() = false;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    tasks_done += completed;
+    if(tasks_done == job_tasks) {
+        cv_done.notify_all();
+    }
+}
+
+inline void HostThreadPool::WorkerLoop()
+{
+    size_t seen = 0;
+    for(;;) {
+        const std::function<void(size_t)>* fn;
+        size_t num_tasks;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv_work.wait(lock, [&]{ return stop || generation != seen; });
+            if(stop) return;
+            seen = generation;
+            // Woke up after the job we were signalled for has been retired
+            if(!job_fn) continue;
+            fn = job_fn;
+            num_tasks = job_tasks;
+            ++active;
+        }
+
+        ExecuteTasks(*fn, num_tasks);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if(--active == 0) {
+            cv_done.notify_all();
+        }
+    }
+}
+
+inline void HostThreadPool::Run(size_t num_tasks, const std::function<void(size_t)>& fn)
+{
+    if(num_tasks == 0) return;
+
+    if(num_tasks == 1 || workers.empty() || InsideTask()) {
+        for(size_t t=0; t < num_tasks; ++t) fn(t);
+        return;
+    }
+
+    std::lock_guard<std::mutex> run_lock(run_mutex);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        job_fn = &fn;
+        job_tasks = num_tasks;
+        tasks_done = 0;
+        job_error = std::exception_ptr();
+        next_task = 0;
+        ++generation;
+    }
+    cv_work.notify_all();
+
+    ExecuteTasks(fn, num_tasks);
+
+    std::exception_ptr error;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv_done.wait(lock, [&]{ return tasks_done == job_tasks && active == 0; });
+        job_fn = 0;
+        error = job_error;
+        job_error = std::exception_ptr();
+    }
+
+    if(error) {
+        std::rethrow_exception(error);
+    }
+}
+
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+// Host only, include from cpu_*.cpp and never from headers nvcc sees.
+
+#if defined(__AVX__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace roo
+{
+namespace simd
+{
+
+////////////////////////////////////////
+// Float vectors for the host kernels
+//
+// mvec holds MV floats, the widest of AVX, SSE2 or a plain float that the
+// translation unit is compiled for. The width depends on the compile flags
+// of each cpu_*.cpp (see HOST_NATIVE_SIMD), so everything here has internal
+// linkage rather than one inline definition shared between objects.
+////////////////////////////////////////
+
+#if defined(__AVX__)
+typedef __m256 mvec;
+static const int MV = 8;
+static inline mvec MvLoad(const float* p) { return _mm256_loadu_ps(p); }
+static inline void MvStore(float* p, mvec v) { _mm256_storeu_ps(p, v); }
+static inline mvec MvSet(float a) { return _mm256_set1_ps(a); }
+static inline mvec MvAdd(mvec a, mvec b) { return _mm256_add_ps(a, b); }
+static inline mvec MvSub(mvec a, mvec b) { return _mm256_sub_ps(a, b); }
+static inline mvec MvMul(mvec a, mvec b) { return _mm256_mul_ps(a, b); }
+static inline mvec MvMin(mvec a, mvec b) { return _mm256_min_ps(a, b); }
+static inline mvec MvMax(mvec a, mvec b) { return _mm256_max_ps(a, b); }
+static inline mvec MvAbs(mvec a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+#elif defined(__SSE2__)
+typedef __m128 mvec;
+static const int MV = 4;
+static inline mvec MvLoad(const float* p) { return _mm_loadu_ps(p); }
+static inline void MvStore(float* p, mvec v) { _mm_storeu_ps(p, v); }
+static inline mvec MvSet(float a) { return _mm_set1_ps(a); }
+static inline mvec MvAdd(mvec a, mvec b) { return _mm_add_ps(a, b); }
+static inline mvec MvSub(mvec a, mvec b) { return _mm_sub_ps(a, b); }
+static inline mvec MvMul(mvec a, mvec b) { return _mm_mul_ps(a, b); }
+static inline mvec MvMin(mvec a, mvec b) { return _mm_min_ps(a, b); }
+static inline mvec MvMax(mvec a, mvec b) { return _mm_max_ps(a, b); }
+static inline mvec MvAbs(mvec a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+#else
+typedef float mvec;
+static const int MV = 1;
+static inline mvec MvLoad(const float* p) { return *p; }
+static inline void MvStore(float* p, mvec v) { *p = v; }
+static inline mvec MvSet(float a) { return a; }
+static inline mvec MvAdd(mvec a, mvec b) { return a + b; }
+static inline mvec MvSub(mvec a, mvec b) { return a - b; }
+static inline mvec MvMul(mvec a, mvec b) { return a * b; }
+static inline mvec MvMin(mvec a, mvec b) { return a < b ? a : b; }
+static inline mvec MvMax(mvec a, mvec b) { return a < b ? b : a; }
+static inline mvec MvAbs(mvec a) { return a < 0 ? -a : a; }
+#endif
+
+}
+}
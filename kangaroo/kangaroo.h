@@ -14,6 +14,7 @@
 #include "BoundingBox.h"
 #include <kangaroo/BoundedVolume.h>
 #include "ImageKeyframe.h"
+#include "StereoTemporal.h"
 
 #include "cu_convert.h"
 #include "cu_depth_tools.h"
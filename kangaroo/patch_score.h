@@ -13,9 +13,9 @@ struct ImgAccessRaw
 {
     typedef int TXY;
 
-    template<typename T>
+    template<typename T, typename Target>
     __host__ __device__ inline static
-    T Get(const Image<T>& img, int x, int y) {
+    T Get(const Image<T,Target>& img, int x, int y) {
         return img(x,y);
     }
 };
@@ -24,9 +24,9 @@ struct ImgAccessClamped
 {
     typedef int TXY;
 
-    template<typename T>
+    template<typename T, typename Target>
     __host__ __device__ inline static
-    T Get(const Image<T>& img, int x, int y) {
+    T Get(const Image<T,Target>& img, int x, int y) {
         return img.GetWithClampedRange(x,y);
     }
 };
@@ -36,9 +36,9 @@ struct ImgAccessBilinear
 {
     typedef float TXY;
 
-    template<typename T>
+    template<typename T, typename Target>
     __host__ __device__ inline static
-    T Get(const Image<T>& img, float x, float y) {
+    T Get(const Image<T,Target>& img, float x, float y) {
         return img.template GetBilinear<Tinterp>(x,y);
     }
 };
@@ -48,9 +48,9 @@ struct ImgAccessBilinearClamped
 {
     typedef float TXY;
 
-    template<typename T>
+    template<typename T, typename Target>
     __host__ __device__ inline static
-    T Get(const Image<T>& img, float x, float y) {
+    T Get(const Image<T,Target>& img, float x, float y) {
         if(x<0) x=0;
         if(x > img.w-1) x = img.w-1;
         if(y<0) y=0;
@@ -61,12 +61,13 @@ struct ImgAccessBilinearClamped
 
 //////////////////////////////////////////////////////
 // Patch Scores
+// Scores take images of any Target, so they serve host code as well.
 //////////////////////////////////////////////////////
 
-template<typename To, typename T, int rad, typename ImgAccess>
+template<typename To, typename T, int rad, typename ImgAccess, typename Target>
 __host__ __device__ inline
 To Sum(
-    Image<T> img, int x, int y
+    Image<T,Target> img, int x, int y
 ) {
     To sum = 0;
     for(int r=-rad; r <=rad; ++r ) {
@@ -86,11 +87,11 @@ struct SinglePixelSqPatchScore {
     static const int height = 1;
     static const int area = width*height;
 
-    template<typename T>
+    template<typename T, typename Target>
     __host__ __device__ inline static
     To Score(
-        Image<T> img1, TXY x1, TXY y1,
-        Image<T> img2, TXY x2, TXY y2
+        Image<T,Target> img1, TXY x1, TXY y1,
+        Image<T,Target> img2, TXY x2, TXY y2
     ) {
         const T i1 = ImgAccess::Get(img1,x1,y1);
         const T i2 = ImgAccess::Get(img2,x2,y2);
@@ -108,11 +109,11 @@ struct SADPatchScore {
     static const int height = 2*rad+1;
     static const int area = width*height;
 
-    template<typename T>
+    template<typename T, typename Target>
     __host__ __device__ inline static
     To Score(
-        Image<T> img1, TXY x1, TXY y1,
-        Image<T> img2, TXY x2, TXY y2
+        Image<T,Target> img1, TXY x1, TXY y1,
+        Image<T,Target> img2, TXY x2, TXY y2
     ) {
         To sum_abs_diff = 0;
 
@@ -137,11 +138,11 @@ struct SSDPatchScore {
     static const int height = 2*rad+1;
     static const int area = width*height;
 
-    template<typename T>
+    template<typename T, typename Target>
     __host__ __device__ inline static
     To Score(
-        Image<T> img1, TXY x1, TXY y1,
-        Image<T> img2, TXY x2, TXY y2
+        Image<T,Target> img1, TXY x1, TXY y1,
+        Image<T,Target> img2, TXY x2, TXY y2
     ) {
         To sum_sq_diff = 0;
 
@@ -167,11 +168,11 @@ struct SSNDPatchScore {
     static const int height = 2*rad+1;
     static const int area = width*height;
 
-    template<typename T>
+    template<typename T, typename Target>
     __host__ __device__ inline static
     To Score(
-        Image<T> img1, TXY x1, TXY y1,
-        Image<T> img2, TXY x2, TXY y2
+        Image<T,Target> img1, TXY x1, TXY y1,
+        Image<T,Target> img2, TXY x2, TXY y2
     ) {
         To sxi = 0;
         To sxi2 = 0;
@@ -216,11 +217,11 @@ struct SSNDLineScore
     static const int height = 1;
     static const int area = width*height;
 
-    template<typename T>
+    template<typename T, typename Target>
     __host__ __device__ inline static
     To Score(
-        Image<T> img1, TXY x1, TXY y1,
-        Image<T> img2, TXY x2, TXY y2
+        Image<T,Target> img1, TXY x1, TXY y1,
+        Image<T,Target> img2, TXY x2, TXY y2
     ) {
         To sxi = 0;
         To sxi2 = 0;
@@ -262,11 +263,11 @@ struct SANDPatchScore {
     static const int height = 2*rad+1;
     static const int area = width*height;
 
-    template<typename T>
+    template<typename T, typename Target>
     __host__ __device__ inline static
     To Score(
-        Image<T> img1, TXY x1, TXY y1,
-        Image<T> img2, TXY x2, TXY y2
+        Image<T,Target> img1, TXY x1, TXY y1,
+        Image<T,Target> img2, TXY x2, TXY y2
     ) {
         To sum_abs_diff = 0;
 
@@ -10,6 +10,13 @@ void BoxHalf( Image<To> out, const Image<Ti> in);
 template<typename To, typename UpType, typename Ti>
 void BoxHalfIgnoreInvalid( Image<To> out, const Image<Ti> in);
 
+// Host (CPU) execution, see cpu_resample.cpp
+template<typename To, typename UpType, typename Ti>
+void BoxHalf( Image<To,TargetHost> out, const Image<Ti,TargetHost> in);
+
+template<typename To, typename UpType, typename Ti>
+void BoxHalfIgnoreInvalid( Image<To,TargetHost> out, const Image<Ti,TargetHost> in);
+
 template<typename To, typename UpType, typename Ti>
 inline void BoxReduce( Image<To> out, Image<Ti> in_temp, Image<To> temp, int level)
 {
@@ -58,6 +65,28 @@ inline void BoxReduceIgnoreInvalid(Pyramid<T,Levels> pyramid)
     }
 }
 
+template<typename T, unsigned Levels, typename UpType>
+inline void BoxReduce(Pyramid<T,Levels,TargetHost> pyramid)
+{
+    const int w = pyramid.imgs[0].w;
+    const int h = pyramid.imgs[0].h;
+
+    for(unsigned int l=1; l<Levels && (w>>l > 0) && (h>>l > 0); ++l) {
+        BoxHalf<T,UpType,T>(pyramid.imgs[l], pyramid.imgs[l-1]);
+    }
+}
+
+template<typename T, unsigned Levels, typename UpType>
+inline void BoxReduceIgnoreInvalid(Pyramid<T,Levels,TargetHost> pyramid)
+{
+    const int w = pyramid.imgs[0].w;
+    const int h = pyramid.imgs[0].h;
+
+    for(unsigned int l=1; l<Levels && (w>>l > 0) && (h>>l > 0); ++l) {
+        BoxHalfIgnoreInvalid<T,UpType,T>(pyramid.imgs[l], pyramid.imgs[l-1]);
+    }
+}
+
 template<typename T, unsigned Levels, typename UpType>
 inline void BlurReduce(Pyramid<T,Levels> pyramid, Image<T> temp1, Image<T> temp2)
 {
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cmath>
+#include <cstdio>
+
+// Minimal check macros for the host unit tests. Failed checks are reported
+// and counted, main() returns TEST_RESULT() so ctest sees the failure.
+
+static int test_failures = 0;
+
+#define CHECK(cond) \
+    do { \
+        if(!(cond)) { \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            ++test_failures; \
+        } \
+    } while(0)
+
+#define CHECK_NEAR(a, b, eps) \
+    do { \
+        const double test_a = (a), test_b = (b); \
+        if(!(std::fabs(test_a - test_b) <= (eps))) { \
+            std::fprintf(stderr, "%s:%d: CHECK_NEAR(%s, %s) failed, %g vs %g\n", __FILE__, __LINE__, #a, #b, test_a, test_b); \
+            ++test_failures; \
+        } \
+    } while(0)
+
+#define TEST_RESULT() \
+    (test_failures ? (std::fprintf(stderr, "%d check(s) failed\n", test_failures), 1) : 0)
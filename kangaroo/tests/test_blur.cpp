@@ -0,0 +1,111 @@
+#include <kangaroo/cu_blur.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "test.h"
+
+using namespace roo;
+
+static const int W = 120;
+static const int H = 90;
+
+// Separable Gaussian over +-6 sigma with edge values extended, in double
+static std::vector<double> GaussianReference(const Image<float,TargetHost>& in, float sigma)
+{
+    const int R = (int)std::ceil(6*sigma);
+    std::vector<double> k(2*R+1);
+    double ksum = 0;
+    for(int i = -R; i <= R; ++i) {
+        k[i+R] = std::exp(-0.5*i*i / (sigma*sigma));
+        ksum += k[i+R];
+    }
+
+    std::vector<double> t(W*H), r(W*H);
+    for(int y = 0; y < H; ++y)
+    for(int x = 0; x < W; ++x) {
+        double s = 0;
+        for(int i = -R; i <= R; ++i) s += k[i+R] * in(std::min(std::max(x+i, 0), W-1), y);
+        t[y*W + x] = s / ksum;
+    }
+    for(int y = 0; y < H; ++y)
+    for(int x = 0; x < W; ++x) {
+        double s = 0;
+        for(int i = -R; i <= R; ++i) s += k[i+R] * t[std::min(std::max(y+i, 0), H-1)*W + x];
+        r[y*W + x] = s / ksum;
+    }
+    return r;
+}
+
+// The recursive filter approximates the Gaussian, closest for larger sigma.
+// Checkerboard edges of 60 on a smooth wave, so values span 0 to 210.
+static void TestAgainstReference()
+{
+    Image<float,TargetHostAligned,Manage> in(W,H), out(W,H), temp(1,1);
+    for(int y = 0; y < H; ++y)
+    for(int x = 0; x < W; ++x) {
+        in(x,y) = 100 + 50*std::sin(x*0.11f)*std::cos(y*0.07f) + ((x/30 + y/30) % 2)*60;
+    }
+
+    const float sigmas[] = {0.5f, 0.8f, 2.0f, 5.0f, 20.0f};
+    for(int i = 0; i < 5; ++i) {
+        GaussianBlur<float,float>(out, in, temp, sigmas[i]);
+        const std::vector<double> ref = GaussianReference(in, sigmas[i]);
+        double err = 0;
+        for(int y = 0; y < H; ++y)
+        for(int x = 0; x < W; ++x) {
+            err = std::max(err, std::fabs(out(x,y) - ref[y*W + x]));
+        }
+        CHECK(err <= (sigmas[i] < 2 ? 0.03 : 0.015) * 210);
+    }
+}
+
+// Constant images stay constant, sigma 0 copies
+static void TestConstantAndCopy()
+{
+    Image<float,TargetHostAligned,Manage> in(W,H), out(W,H), temp(1,1);
+    for(int y = 0; y < H; ++y)
+    for(int x = 0; x < W; ++x) {
+        in(x,y) = 77;
+    }
+    GaussianBlur<float,float>(out, in, temp, 25.0f);
+    double err = 0;
+    for(int y = 0; y < H; ++y)
+    for(int x = 0; x < W; ++x) {
+        err = std::max(err, (double)std::fabs(out(x,y) - 77));
+    }
+    CHECK(err <= 77 * 1e-3);
+
+    for(int y = 0; y < H; ++y)
+    for(int x = 0; x < W; ++x) {
+        in(x,y) = (float)(x*y % 23);
+    }
+    GaussianBlur<float,float>(out, in, temp, 0.0f);
+    int differ = 0;
+    for(int y = 0; y < H; ++y)
+    for(int x = 0; x < W; ++x) {
+        differ += out(x,y) != in(x,y);
+    }
+    CHECK(differ == 0);
+
+    // 8 bit images are blurred in float and rounded back
+    Image<unsigned char,TargetHostAligned,Manage> u8(W,H), u8out(W,H);
+    for(int y = 0; y < H; ++y)
+    for(int x = 0; x < W; ++x) {
+        u8(x,y) = 200;
+    }
+    GaussianBlur<unsigned char,unsigned char>(u8out, u8, u8out, 3.0f);
+    int wrong = 0;
+    for(int y = 0; y < H; ++y)
+    for(int x = 0; x < W; ++x) {
+        wrong += std::abs(u8out(x,y) - 200) > 1;
+    }
+    CHECK(wrong == 0);
+}
+
+int main()
+{
+    TestAgainstReference();
+    TestConstantAndCopy();
+    return TEST_RESULT();
+}
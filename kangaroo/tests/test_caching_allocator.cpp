@@ -0,0 +1,148 @@
+#include <kangaroo/CachingAllocator.h>
+#include <kangaroo/RollingGridSDF/VolumeGrid.h>
+
+#include "test.h"
+
+using namespace roo;
+
+// Freed blocks are handed out again for any request of the same bucket
+static void TestBucketReuse()
+{
+    CachingAllocator pool(MallocRawAlloc, MallocRawFree, 1 << 20);
+
+    CHECK(CachingAllocator::BucketSize(1000) >= 1000);
+    CHECK(CachingAllocator::BucketSize(1000) <= 1250);
+    CHECK(CachingAllocator::BucketSize(1000) == CachingAllocator::BucketSize(CachingAllocator::BucketSize(1000)));
+
+    void* a = pool.Allocate(1000);
+    CHECK(a != 0);
+    CHECK(pool.Deallocate(a));
+
+    // Same bucket, same block
+    void* b = pool.Allocate(CachingAllocator::BucketSize(1000));
+    CHECK(b == a);
+
+    // Different bucket, fresh block
+    void* c = pool.Allocate(64 * 1024);
+    CHECK(c != 0 && c != a);
+
+    const CachingAllocatorStats s = pool.Stats();
+    CHECK(s.requests == 3);
+    CHECK(s.hits == 1);
+    CHECK(s.misses == 2);
+    CHECK(s.returned == 1);
+    CHECK(s.retained_blocks == 0);
+    CHECK(s.retained_bytes == 0);
+    CHECK(s.in_use_bytes == CachingAllocator::BucketSize(1000) + CachingAllocator::BucketSize(64 * 1024));
+    CHECK_NEAR(s.HitRate(), 1.0 / 3.0, 1e-12);
+
+    // Blocks not owned by the pool are left alone
+    int foreign = 0;
+    CHECK(!pool.Deallocate(&foreign));
+
+    CHECK(pool.Deallocate(b));
+    CHECK(pool.Deallocate(c));
+}
+
+// Retained bytes follow Deallocate / ReleaseCached and stay within the limit
+static void TestRetainedBytes()
+{
+    const size_t bucket = CachingAllocator::BucketSize(256 * 1024);
+    CachingAllocator pool(MallocRawAlloc, MallocRawFree, 2 * bucket);
+
+    void* blocks[4];
+    for(int i = 0; i < 4; ++i) {
+        blocks[i] = pool.Allocate(bucket);
+        CHECK(blocks[i] != 0);
+    }
+    CHECK(pool.Stats().in_use_bytes == 4 * bucket);
+
+    for(int i = 0; i < 4; ++i) {
+        CHECK(pool.Deallocate(blocks[i]));
+    }
+
+    CachingAllocatorStats s = pool.Stats();
+    CHECK(s.in_use_bytes == 0);
+    CHECK(s.retained_bytes == 2 * bucket);
+    CHECK(s.retained_blocks == 2);
+    CHECK(s.released == 2);
+    CHECK(s.peak_bytes == 4 * bucket);
+
+    pool.ReleaseCached();
+    s = pool.Stats();
+    CHECK(s.retained_bytes == 0);
+    CHECK(s.retained_blocks == 0);
+    CHECK(s.released == 4);
+
+    // Lowering the limit trims what is already cached
+    void* a = pool.Allocate(bucket);
+    void* b = pool.Allocate(bucket);
+    CHECK(pool.Deallocate(a));
+    CHECK(pool.Deallocate(b));
+    CHECK(pool.Stats().retained_blocks == 2);
+    pool.SetMaxRetainedBytes(bucket);
+    CHECK(pool.MaxRetainedBytes() == bucket);
+    CHECK(pool.Stats().retained_bytes <= bucket);
+
+    pool.ResetStats();
+    s = pool.Stats();
+    CHECK(s.requests == 0);
+    CHECK(s.hits == 0);
+    CHECK(s.retained_bytes <= bucket);
+}
+
+// DontManage grids allocate straight from the Target, Manage grids from the pool
+static void TestVolumeGridAllocation()
+{
+    CachingAllocator& pool = AlignedHostCachingAllocator();
+    pool.ReleaseCached();
+    pool.ResetStats();
+
+    VolumeGrid<float,TargetHostAligned,DontManage> view;
+    view.InitVolume(8,8,8);
+    CHECK(view.ptr != 0);
+    CHECK(pool.Stats().requests == 0);
+    TargetHostAligned::DeallocatePitchedMem(view.ptr);
+
+    VolumeGrid<float,TargetHostAligned,Manage> block;
+    block.InitVolume(8,8,8);
+    CHECK(block.ptr != 0);
+    float* first = block.ptr;
+    block.CleanUp();
+    CHECK(block.ptr == 0);
+    CHECK(pool.Stats().retained_blocks == 1);
+
+    block.InitVolume(8,8,8);
+    CHECK(block.ptr == first);
+    CHECK(pool.Stats().hits == 1);
+    block.CleanUp();
+}
+
+// TargetHost memory is usable with or without a CUDA device
+static void TestHostTarget()
+{
+    VolumeGrid<float,TargetHost,DontManage> view;
+    view.InitVolume(8,8,8);
+    CHECK(view.ptr != 0);
+    view.ptr[8*8*8-1] = 1.0f;
+    TargetHost::DeallocatePitchedMem(view.ptr);
+
+    VolumeGrid<float,TargetHost,Manage> block;
+    block.InitVolume(8,8,8);
+    CHECK(block.ptr != 0);
+    block.ptr[8*8*8-1] = 1.0f;
+    block.CleanUp();
+
+    void* p = HostRawAlloc(100);
+    CHECK(p != 0);
+    HostRawFree(p);
+}
+
+int main()
+{
+    TestBucketReuse();
+    TestRetainedBytes();
+    TestVolumeGridAllocation();
+    TestHostTarget();
+    return TEST_RESULT();
+}
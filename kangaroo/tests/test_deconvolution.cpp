@@ -0,0 +1,183 @@
+#include <kangaroo/cu_deconvolution.h>
+#include <kangaroo/cu_rof_denoising.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+#include "test.h"
+
+using namespace roo;
+
+typedef Image<float,TargetHostAligned,Manage> HostImage;
+
+static const int W = 61;
+static const int H = 47;
+
+inline float Random()
+{
+    return std::rand() / (float)RAND_MAX;
+}
+
+// Convolution straight from its definition: correlation about (kx,ky),
+// Neumann borders, normalised by the kernel sum
+static double MaxErrorToDirect(const Image<float,TargetHost>& out, const Image<float,TargetHost>& in, const Image<float,TargetHost>& k, int kx, int ky)
+{
+    double ksum = 0;
+    for(size_t r = 0; r < k.h; ++r)
+    for(size_t c = 0; c < k.w; ++c) {
+        ksum += k(c,r);
+    }
+
+    double err = 0;
+    for(int y = 0; y < H; ++y)
+    for(int x = 0; x < W; ++x) {
+        double s = 0;
+        for(int r = 0; r < (int)k.h; ++r)
+        for(int c = 0; c < (int)k.w; ++c) {
+            s += k(c,r) * in.GetConditionNeumann(x - kx + c, y - ky + r);
+        }
+        err = std::max(err, std::fabs(out(x,y) - s / ksum));
+    }
+    return err;
+}
+
+// Spectrum and templated Convolution against the direct sum, with a kernel
+// large enough for the FFT path, then a second kernel of the same size
+static void TestConvolution()
+{
+    HostImage in(W,H), k(13,11), out(W,H), out2(W,H);
+    for(int y = 0; y < H; ++y)
+    for(int x = 0; x < W; ++x) {
+        in(x,y) = Random();
+    }
+
+    for(int trial = 0; trial < 2; ++trial) {
+        for(size_t r = 0; r < k.h; ++r)
+        for(size_t c = 0; c < k.w; ++c) {
+            k(c,r) = Random();
+        }
+
+        ConvolutionSpectrum spec;
+        ConvolutionSpectrumInit(spec, W, H, k, 4, 7);
+        Convolution(out, in, spec);
+        CHECK(MaxErrorToDirect(out, in, k, 4, 7) <= 1e-4);
+
+        Convolution<float,float,float,float>(out2, in, k, 4, 7);
+        CHECK(MaxErrorToDirect(out2, in, k, 4, 7) <= 1e-4);
+    }
+}
+
+// <k*u, q> = <u, kT*q> for u and q that vanish near the borders, for an
+// asymmetric kernel with its origin off centre
+static void TestAdjoint()
+{
+    const int kx = 2, ky = 5;
+    HostImage k(9,7), u(W,H), q(W,H), Au(W,H), ATq(W,H);
+    for(size_t r = 0; r < k.h; ++r)
+    for(size_t c = 0; c < k.w; ++c) {
+        k(c,r) = Random() + (c < 3 ? 1.0f : 0.0f);
+    }
+    for(int y = 0; y < H; ++y)
+    for(int x = 0; x < W; ++x) {
+        const bool inside = x >= 10 && x < W-10 && y >= 10 && y < H-10;
+        u(x,y) = inside ? Random() - 0.5f : 0.0f;
+        q(x,y) = inside ? Random() - 0.5f : 0.0f;
+    }
+
+    DeconvolutionSpectra spec;
+    DeconvolutionSpectraInit(spec, W, H, k, kx, ky);
+    Convolution(Au, u, spec.k);
+    Convolution(ATq, q, spec.kT);
+
+    double a = 0, b = 0, n = 0;
+    for(int y = 0; y < H; ++y)
+    for(int x = 0; x < W; ++x) {
+        a += Au(x,y) * q(x,y);
+        b += u(x,y) * ATq(x,y);
+        n += std::fabs(Au(x,y) * q(x,y));
+    }
+    CHECK_NEAR(a, b, 1e-5 * n);
+}
+
+// The dual step against the device formula, and TV-L1 stays in the unit ball
+static void TestDualAscent()
+{
+    const float sigma = 0.7f, alpha = 0.1f;
+    HostImage u(W,H);
+    Image<float2,TargetHostAligned,Manage> p(W,H), p0(W,H);
+    for(int y = 0; y < H; ++y)
+    for(int x = 0; x < W; ++x) {
+        u(x,y) = Random() * 4;
+        p(x,y) = make_float2(Random() - 0.5f, Random() - 0.5f);
+        p0(x,y) = p(x,y);
+    }
+
+    HuberGradU_DualAscentP(p, u, sigma, alpha);
+    double err = 0;
+    for(int y = 0; y < H; ++y)
+    for(int x = 0; x < W; ++x) {
+        const float dx = x < W-1 ? u(x+1,y) - u(x,y) : 0.0f;
+        const float dy = y < H-1 ? u(x,y+1) - u(x,y) : 0.0f;
+        const float nx = (p0(x,y).x + sigma*dx) / (1 + sigma*alpha);
+        const float ny = (p0(x,y).y + sigma*dy) / (1 + sigma*alpha);
+        const float r = std::max(1.0f, std::sqrt(nx*nx + ny*ny));
+        err = std::max(err, (double)std::fabs(p(x,y).x - nx/r));
+        err = std::max(err, (double)std::fabs(p(x,y).y - ny/r));
+    }
+    CHECK(err <= 1e-6);
+
+    TVL1GradU_DualAscentP(p, u, 10.0f);
+    int outside = 0;
+    for(int y = 0; y < H; ++y)
+    for(int x = 0; x < W; ++x) {
+        outside += p(x,y).x*p(x,y).x + p(x,y).y*p(x,y).y > 1 + 1e-5f;
+    }
+    CHECK(outside == 0);
+}
+
+// Deblurring a Gaussian blurred checkerboard gets much closer to it
+static void TestDeconvolution()
+{
+    HostImage gt(W,H), g(W,H), k(13,13), u(W,H), q(W,H), Au(W,H), ATq(W,H);
+    Image<float2,TargetHostAligned,Manage> p(W,H);
+    for(int y = 0; y < H; ++y)
+    for(int x = 0; x < W; ++x) {
+        gt(x,y) = (x/16 + y/12) % 2 ? 0.8f : 0.2f;
+    }
+    for(int r = 0; r < 13; ++r)
+    for(int c = 0; c < 13; ++c) {
+        k(c,r) = std::exp(-((c-6)*(c-6) + (r-6)*(r-6)) / 8.0f);
+    }
+
+    DeconvolutionSpectra spec;
+    DeconvolutionSpectraInit(spec, W, H, k, 6, 6);
+    Convolution(g, gt, spec.k);
+
+    // Host images are set by hand, Memset and CopyFrom go through CUDA
+    for(int y = 0; y < H; ++y)
+    for(int x = 0; x < W; ++x) {
+        u(x,y) = g(x,y);
+        p(x,y) = make_float2(0,0);
+        q(x,y) = 0;
+    }
+    Deconvolution(u, p, q, g, spec, Au, ATq, 0.5f, 0.5f, 0.05f, 50.0f, 0.0f, 200);
+
+    double eg = 0, eu = 0;
+    for(int y = 0; y < H; ++y)
+    for(int x = 0; x < W; ++x) {
+        eg += (g(x,y) - gt(x,y)) * (g(x,y) - gt(x,y));
+        eu += (u(x,y) - gt(x,y)) * (u(x,y) - gt(x,y));
+    }
+    CHECK(eu < 0.25 * eg);
+}
+
+int main()
+{
+    std::srand(7);
+    TestConvolution();
+    TestAdjoint();
+    TestDualAscent();
+    TestDeconvolution();
+    return TEST_RESULT();
+}
@@ -0,0 +1,128 @@
+#include <kangaroo/RollingGridSDF/GridBlockTable.h>
+
+#include <cstdlib>
+
+#include "test.h"
+
+using namespace roo;
+
+static const unsigned int Res = 32;
+static const unsigned int BlockRes = 8;
+
+// Large, keep them off the stack
+static BoundedVolumeGrid<float,TargetHostAligned,Manage> vol;
+static BoundedVolumeGrid<float,TargetHostAligned,DontManage> unmanaged;
+
+inline float Random(float lo, float hi)
+{
+    return lo + (hi - lo) * (std::rand() / (float)RAND_MAX);
+}
+
+// Every accessor of the table agrees with the grid it was built from
+static int CountMismatches(const GridBlockTable<float,TargetHostAligned>& table)
+{
+    int mismatches = 0;
+    for(unsigned int z = 0; z < Res; ++z)
+    for(unsigned int y = 0; y < Res; ++y)
+    for(unsigned int x = 0; x < Res; ++x) {
+        const int nIndex = vol.ConvertLocalIndexToRealIndex(x/BlockRes, y/BlockRes, z/BlockRes);
+        if(table.ConvertLocalIndexToRealIndex(x/BlockRes, y/BlockRes, z/BlockRes) != (unsigned int)nIndex ||
+           table.CheckIfBasicSDFActive(nIndex) != vol.CheckIfBasicSDFActive(nIndex)) {
+            ++mismatches;
+        }else if(vol.CheckIfBasicSDFActive(nIndex) && &table.Get(x,y,z) != &vol.Get(x,y,z)) {
+            ++mismatches;
+        }
+    }
+
+    std::srand(1);
+    for(int i = 0; i < 5000; ++i) {
+        const float3 p = make_float3(Random(-0.1f,1.1f), Random(-0.1f,1.1f), Random(-0.1f,1.1f));
+        const float t = table.GetUnitsTrilinearClamped(p);
+        const float v = vol.GetUnitsTrilinearClamped(p);
+        if( (t != t) != (v != v) || (t == t && t != v) ) {
+            ++mismatches;
+        }
+    }
+    return mismatches;
+}
+
+static void TestUpdate()
+{
+    const BoundingBox bbox(make_float3(0,0,0), make_float3(1,1,1));
+    vol.Init(Res, Res, Res, BlockRes, bbox);
+
+    GridBlockTableCache<float,TargetHostAligned> cache;
+
+    // Nothing active yet
+    cache.Update(vol);
+    CHECK(cache.Table().GetTotalGridNum() == vol.GetTotalGridNum());
+    CHECK(!cache.Table().CheckIfBasicSDFActive(0));
+    const size_t uploads = cache.NumTableUploads();
+
+    for(unsigned int z = 0; z < Res; z += BlockRes)
+    for(unsigned int y = 0; y < Res; y += BlockRes)
+    for(unsigned int x = 0; x < Res; x += 2*BlockRes) {
+        vol.InitSingleBasicSDFWithGridIndex(x,y,z);
+    }
+    for(unsigned int z = 0; z < Res; ++z)
+    for(unsigned int y = 0; y < Res; ++y)
+    for(unsigned int x = 0; x < Res; ++x) {
+        if(vol.CheckIfVoxelExist(x,y,z)) vol.Get(x,y,z) = 0.5f*x - 0.25f*y + 0.125f*z;
+    }
+
+    CHECK(cache.Update(vol));
+    CHECK(cache.NumTableUploads() == uploads + 1);
+    CHECK(cache.Table().m_nBlockPitch == vol.m_GridVolumes[0].pitch);
+    CHECK(CountMismatches(cache.Table()) == 0);
+
+    // Unchanged grid: descriptor and table stay as they are
+    CHECK(!cache.Update(vol));
+    CHECK(cache.NumTableUploads() == uploads + 1);
+
+    // Rolling only changes the descriptor
+    vol.UpdateLocalAndGlobalShift(make_int3(1,0,-1));
+    CHECK(cache.Update(vol));
+    CHECK(cache.NumTableUploads() == uploads + 1);
+    CHECK(CountMismatches(cache.Table()) == 0);
+
+    // Init and free of grid volumes upload the table again
+    vol.InitSingleBasicSDFWithGridIndex(0,0,0);
+    cache.Update(vol);
+    CHECK(cache.NumTableUploads() == uploads + 2);
+    CHECK(CountMismatches(cache.Table()) == 0);
+
+    const int nIndex = vol.ConvertLocalIndexToRealIndex(0,0,0);
+    CHECK(cache.Table().CheckIfBasicSDFActive(nIndex));
+    vol.FreeMemoryByIndex(nIndex);
+    vol.m_GridVolumes[nIndex].w = 0;
+    cache.Update(vol);
+    CHECK(cache.NumTableUploads() == uploads + 3);
+    CHECK(!cache.Table().CheckIfBasicSDFActive(nIndex));
+
+    // Release drops the table, the next Update builds it again
+    cache.Release();
+    CHECK(cache.Table().m_ppBlocks == 0);
+    CHECK(cache.Update(vol));
+    CHECK(cache.NumTableUploads() == uploads + 4);
+    CHECK(CountMismatches(cache.Table()) == 0);
+
+    cache.Release();
+    vol.FreeMemory();
+}
+
+// Stamps come from one counter whatever the grid type
+static void TestStamps()
+{
+    vol.MarkGridVolumesChanged();
+    unmanaged.MarkGridVolumesChanged();
+    CHECK(unmanaged.m_nGridStamp > vol.m_nGridStamp);
+    vol.MarkGridVolumesChanged();
+    CHECK(vol.m_nGridStamp > unmanaged.m_nGridStamp);
+}
+
+int main()
+{
+    TestUpdate();
+    TestStamps();
+    return TEST_RESULT();
+}
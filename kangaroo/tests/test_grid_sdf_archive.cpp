@@ -0,0 +1,291 @@
+#include <kangaroo/RollingGridSDF/GridSDFArchive.h>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+#include "test.h"
+
+using namespace roo;
+
+static const unsigned int GridRes = 8;
+static const int VolRes = 32;
+static const char* FileName = "test_grid_sdf_archive.kgrid";
+
+inline float Value(int3 l, unsigned int x, unsigned int y, unsigned int z, float seed)
+{
+    return seed + 0.5f * l.x + 0.25f * l.y + 0.125f * l.z + 0.01f * (x + GridRes * (y + GridRes * z));
+}
+
+// Dense grid of known values, or one with padded rows (pitch) to go through
+// the writer's staging copy
+struct TestGrid
+{
+    TestGrid(int3 l, float seed, unsigned int pad = 0)
+        : data((GridRes + pad) * GridRes * GridRes)
+    {
+        memset(&vol, 0, sizeof(vol));
+        vol.ptr       = &data[0];
+        vol.w         = GridRes;
+        vol.h         = GridRes;
+        vol.d         = GridRes;
+        vol.pitch     = (GridRes + pad) * sizeof(float);
+        vol.img_pitch = vol.pitch * GridRes;
+        for(unsigned int z = 0; z < GridRes; ++z)
+        for(unsigned int y = 0; y < GridRes; ++y)
+        for(unsigned int x = 0; x < GridRes; ++x) {
+            vol(x,y,z) = Value(l,x,y,z,seed);
+        }
+    }
+
+    std::vector<float> data;
+    VolumeGrid<float,TargetHost,DontManage> vol;
+};
+
+static bool ReadMatches(GridSDFArchiveReader& reader, const GridArchiveEntry& entry, float seed)
+{
+    VolumeGrid<float,TargetHost,Manage> vol;
+    memset(&vol, 0, sizeof(vol));
+    if(!reader.ReadGrid(entry, vol)) return false;
+
+    bool match = vol.w == GridRes && vol.h == GridRes && vol.d == GridRes;
+    for(unsigned int z = 0; match && z < GridRes; ++z)
+    for(unsigned int y = 0; y < GridRes; ++y)
+    for(unsigned int x = 0; x < GridRes; ++x) {
+        match = match && vol(x,y,z) == Value(entry.LocalIndex,x,y,z,seed);
+    }
+    vol.CleanUp();
+    return match;
+}
+
+static std::vector<char> ReadFile()
+{
+    std::ifstream f(FileName, std::ios::in | std::ios::binary);
+    return std::vector<char>((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+}
+
+static void WriteFile(const std::vector<char>& bytes, size_t n)
+{
+    std::ofstream f(FileName, std::ios::out | std::ios::trunc | std::ios::binary);
+    f.write(&bytes[0], n);
+}
+
+// Two volumes, the first with a color channel and a padded grid
+static void WriteArchive()
+{
+    const int3 g0 = make_int3(0,0,0), g1 = make_int3(1,-1,2);
+
+    GridSDFArchiveWriter writer;
+    CHECK(writer.Open(FileName, GridRes, make_int3(VolRes,VolRes,VolRes), false));
+    CHECK(writer.AppendGrid(g0, make_int3(0,0,0), TestGrid(make_int3(0,0,0), 0.0f).vol));
+    CHECK(writer.AppendGrid(g0, make_int3(1,2,3), TestGrid(make_int3(1,2,3), 0.0f, 3).vol));
+    CHECK(writer.AppendGrid(g0, make_int3(1,2,3), TestGrid(make_int3(1,2,3), 7.0f).vol, GRID_ARCHIVE_COLOR));
+    CHECK(writer.AppendBoundingBox(g0, BoundingBox(make_float3(-1,-2,-3), make_float3(1,2,3))));
+    CHECK(writer.AppendGrid(g1, make_int3(3,3,3), TestGrid(make_int3(3,3,3), 0.0f).vol));
+    CHECK(writer.HasBoundingBox(g0));
+    CHECK(!writer.HasBoundingBox(g1));
+    CHECK(writer.NumEntries() == 5);
+    CHECK(writer.Close());
+
+    // a closed writer reports failed appends
+    CHECK(!writer.AppendGrid(g1, make_int3(0,0,0), TestGrid(make_int3(0,0,0), 0.0f).vol));
+    CHECK(!writer.AppendBoundingBox(g1, BoundingBox(make_float3(0,0,0), make_float3(1,1,1))));
+}
+
+static void TestRoundTrip()
+{
+    WriteArchive();
+
+    GridSDFArchiveReader reader;
+    CHECK(reader.Open(FileName));
+    CHECK(reader.Header().nGridRes == GridRes);
+    CHECK(reader.Header().nVolRes[2] == VolRes);
+    CHECK(reader.Grids().size() == 4);
+
+    const std::vector<int3> globals = reader.GetGlobalIndices();
+    CHECK(globals.size() == 2);
+
+    const std::vector<GridArchiveEntry> sdf = reader.GetGrids(make_int3(0,0,0));
+    CHECK(sdf.size() == 2);
+    for(size_t i = 0; i < sdf.size(); ++i) {
+        CHECK(ReadMatches(reader, sdf[i], 0.0f));
+    }
+
+    const std::vector<GridArchiveEntry> color = reader.GetGrids(make_int3(0,0,0), GRID_ARCHIVE_COLOR);
+    CHECK(color.size() == 1);
+    CHECK(color.size() == 1 && ReadMatches(reader, color[0], 7.0f));
+
+    const std::vector<GridArchiveEntry> other = reader.GetGrids(make_int3(1,-1,2));
+    CHECK(other.size() == 1 && ReadMatches(reader, other[0], 0.0f));
+
+    BoundingBox bbox;
+    CHECK(reader.GetBoundingBox(make_int3(0,0,0), bbox));
+    CHECK(bbox.boxmin.y == -2 && bbox.boxmax.z == 3);
+    CHECK(!reader.GetBoundingBox(make_int3(1,-1,2), bbox));
+
+    // elem size must match
+    VolumeGrid<double,TargetHost,Manage> wrong;
+    memset(&wrong, 0, sizeof(wrong));
+    CHECK(!reader.ReadGrid(sdf[0], wrong));
+}
+
+// Reopening appends after the old chunks, later copies of a grid win
+static void TestAppend()
+{
+    WriteArchive();
+
+    GridSDFArchiveWriter writer;
+    CHECK(!writer.Open(FileName, GridRes, make_int3(VolRes,VolRes,2*VolRes)));
+    CHECK(writer.Open(FileName, GridRes, make_int3(VolRes,VolRes,VolRes)));
+    CHECK(writer.NumEntries() == 5);
+    CHECK(writer.HasBoundingBox(make_int3(0,0,0)));
+    CHECK(writer.AppendGrid(make_int3(0,0,0), make_int3(0,0,0), TestGrid(make_int3(0,0,0), 3.0f).vol));
+    CHECK(writer.AppendGrid(make_int3(0,0,0), make_int3(2,2,2), TestGrid(make_int3(2,2,2), 0.0f).vol));
+    CHECK(writer.Close());
+
+    GridSDFArchiveReader reader;
+    CHECK(reader.Open(FileName));
+    CHECK(reader.Grids().size() == 5);
+
+    const std::vector<GridArchiveEntry> sdf = reader.GetGrids(make_int3(0,0,0));
+    CHECK(sdf.size() == 3);
+    for(size_t i = 0; i < sdf.size(); ++i) {
+        const int3 l = sdf[i].LocalIndex;
+        CHECK(ReadMatches(reader, sdf[i], l.x == 0 && l.y == 0 && l.z == 0 ? 3.0f : 0.0f));
+    }
+
+    BoundingBox bbox;
+    CHECK(reader.GetBoundingBox(make_int3(0,0,0), bbox));
+}
+
+// Without a trailer or index the reader scans the chunks, and drops a chunk
+// cut short by the end of the file
+static void TestRecovery()
+{
+    WriteArchive();
+    const std::vector<char> bytes = ReadFile();
+    GridArchiveTrailer trailer;
+    memcpy(&trailer, &bytes[bytes.size() - sizeof(trailer)], sizeof(trailer));
+    CHECK(trailer.nNumEntries == 5);
+
+    // trailer lost
+    WriteFile(bytes, bytes.size() - sizeof(trailer));
+    {
+        GridSDFArchiveReader reader;
+        CHECK(reader.Open(FileName));
+        CHECK(reader.Grids().size() == 4);
+        BoundingBox bbox;
+        CHECK(reader.GetBoundingBox(make_int3(0,0,0), bbox));
+        CHECK(bbox.boxmin.x == -1);
+        const std::vector<GridArchiveEntry> sdf = reader.GetGrids(make_int3(0,0,0));
+        CHECK(sdf.size() == 2 && ReadMatches(reader, sdf[1], 0.0f));
+    }
+
+    // index chunk overwritten, trailer still there
+    std::vector<char> damaged = bytes;
+    memset(&damaged[trailer.nIndexOffset], 0, sizeof(GridArchiveChunk));
+    WriteFile(damaged, damaged.size());
+    {
+        GridSDFArchiveReader reader;
+        CHECK(reader.Open(FileName));
+        CHECK(reader.Grids().size() == 4);
+    }
+
+    // last grid cut short
+    WriteFile(bytes, trailer.nIndexOffset - 100);
+    {
+        GridSDFArchiveReader reader;
+        CHECK(reader.Open(FileName));
+        CHECK(reader.Grids().size() == 3);
+        CHECK(reader.GetGrids(make_int3(1,-1,2)).empty());
+    }
+
+    // and such a file can be appended to, which writes a valid index again
+    {
+        GridSDFArchiveWriter writer;
+        CHECK(writer.Open(FileName, GridRes, make_int3(VolRes,VolRes,VolRes)));
+        CHECK(writer.NumEntries() == 4);
+        CHECK(writer.AppendGrid(make_int3(1,-1,2), make_int3(3,3,3), TestGrid(make_int3(3,3,3), 0.0f).vol));
+        CHECK(writer.Close());
+    }
+    const std::vector<char> repaired = ReadFile();
+    memcpy(&trailer, &repaired[repaired.size() - sizeof(trailer)], sizeof(trailer));
+    CHECK(memcmp(trailer.sMagic, "KGRIDEND", 8) == 0);
+    CHECK(trailer.nNumEntries == 5);
+    {
+        GridSDFArchiveReader reader;
+        CHECK(reader.Open(FileName));
+        const std::vector<GridArchiveEntry> other = reader.GetGrids(make_int3(1,-1,2));
+        CHECK(other.size() == 1 && ReadMatches(reader, other[0], 0.0f));
+    }
+
+    // not an archive
+    WriteFile(bytes, 16);
+    GridSDFArchiveReader reader;
+    CHECK(!reader.Open(FileName));
+}
+
+// Large, keep it off the stack
+static BoundedVolumeGrid<float,TargetHost,Manage> loaded;
+
+// Views into the mapping hold the archived values and can be written to
+// without touching the file, global volumes are copied out
+static void TestMap()
+{
+    WriteArchive();
+    const std::vector<char> bytes = ReadFile();
+
+    GridSDFArchiveMap map;
+    CHECK(map.Open(FileName));
+    CHECK(map.IsOpen());
+
+    const std::vector<GridArchiveEntry> sdf = map.Index().GetGrids(make_int3(0,0,0));
+    CHECK(sdf.size() == 2);
+    map.WillNeed(sdf);
+
+    for(size_t i = 0; i < sdf.size(); ++i) {
+        VolumeGrid<float,TargetHost,DontManage> view;
+        CHECK(map.GetGrid(sdf[i], view));
+        CHECK(view.w == GridRes && view.pitch == GridRes * sizeof(float));
+        bool match = true;
+        for(unsigned int z = 0; z < GridRes; ++z)
+        for(unsigned int y = 0; y < GridRes; ++y)
+        for(unsigned int x = 0; x < GridRes; ++x) {
+            match = match && view(x,y,z) == Value(sdf[i].LocalIndex,x,y,z,0.0f);
+        }
+        CHECK(match);
+        view(1,2,3) = -100.0f;
+        CHECK(view(1,2,3) == -100.0f);
+    }
+
+    VolumeGrid<double,TargetHost,DontManage> wrong;
+    CHECK(!map.GetGrid(sdf[0], wrong));
+
+    loaded.Init(VolRes, VolRes, VolRes, GridRes, BoundingBox(make_float3(0,0,0), make_float3(1,1,1)));
+    CHECK(map.GetGlobalVolume(make_int3(0,0,0), loaded) == 2);
+    CHECK(map.GetGlobalVolume(make_int3(1,1,1), loaded) == 0);
+    CHECK(loaded.GetActiveGridVolNum() == 2);
+    map.Close();
+    CHECK(!map.IsOpen());
+
+    // copies outlive the map, and hold the values written through the views
+    const int3 l = make_int3(1,2,3);
+    CHECK(loaded.Get(l.x*GridRes + 1, l.y*GridRes + 2, l.z*GridRes + 3) == -100.0f);
+    CHECK(loaded.Get(l.x*GridRes + 4, l.y*GridRes + 5, l.z*GridRes + 6) == Value(l,4,5,6,0.0f));
+    loaded.FreeMemory();
+
+    // the file itself is unchanged
+    CHECK(ReadFile() == bytes);
+}
+
+int main()
+{
+    TestRoundTrip();
+    TestAppend();
+    TestRecovery();
+    TestMap();
+    std::remove(FileName);
+    return TEST_RESULT();
+}
@@ -0,0 +1,97 @@
+#include <kangaroo/cu_integral_image.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+#include "test.h"
+
+using namespace roo;
+
+static const int W = 160;
+static const int H = 120;
+
+// Mean over the window of BoxFilter, [x-rad, x+rad) clipped to the image
+static double BoxMean(const std::vector<double>& f, int x, int y, int rad)
+{
+    const int x0 = std::max(0, x-rad), x1 = std::min(W-1, x+rad);
+    const int y0 = std::max(0, y-rad), y1 = std::min(H-1, y+rad);
+    double s = 0;
+    for(int j = y0; j < y1; ++j)
+    for(int i = x0; i < x1; ++i) {
+        s += f[j*W + i];
+    }
+    return s / ((x1-x0)*(y1-y0));
+}
+
+// Guided filter in double precision straight from its definition
+static std::vector<double> GuidedReference(const std::vector<double>& I, const std::vector<double>& p, int rad, double eps)
+{
+    std::vector<double> II(W*H), Ip(W*H), a(W*H), b(W*H), q(W*H);
+    for(int i = 0; i < W*H; ++i) {
+        II[i] = I[i]*I[i];
+        Ip[i] = I[i]*p[i];
+    }
+    for(int y = 0; y < H; ++y)
+    for(int x = 0; x < W; ++x) {
+        const double mI = BoxMean(I, x, y, rad);
+        const double mp = BoxMean(p, x, y, rad);
+        const double var = BoxMean(II, x, y, rad) - mI*mI;
+        const double cov = BoxMean(Ip, x, y, rad) - mI*mp;
+        a[y*W + x] = cov / (var + eps);
+        b[y*W + x] = mp - a[y*W + x]*mI;
+    }
+    for(int y = 0; y < H; ++y)
+    for(int x = 0; x < W; ++x) {
+        q[y*W + x] = BoxMean(a, x, y, rad)*I[y*W + x] + BoxMean(b, x, y, rad);
+    }
+    return q;
+}
+
+int main()
+{
+    const int rad = 6;
+    const float eps = 0.01f;
+
+    // Noisy step edge in the guide, p follows it with more noise
+    Image<float,TargetHostAligned,Manage> I(W,H), p(W,H), q(W,H), box(W,H);
+    std::vector<double> dI(W*H), dp(W*H);
+    std::srand(3);
+    for(int y = 0; y < H; ++y)
+    for(int x = 0; x < W; ++x) {
+        I(x,y) = (x < W/2 ? 0.2f : 0.8f) + (std::rand() % 100) / 1000.0f;
+        p(x,y) = I(x,y) + (std::rand() % 100) / 500.0f;
+        dI[y*W + x] = I(x,y);
+        dp[y*W + x] = p(x,y);
+    }
+
+    Image<unsigned char,TargetHostAligned,Manage> scratch(W*sizeof(float)*2, H);
+    BoxFilter<float,float,float>(box, I, scratch, rad);
+    double err = 0;
+    for(int y = 0; y < H; ++y)
+    for(int x = 0; x < W; ++x) {
+        err = std::max(err, std::fabs(box(x,y) - BoxMean(dI, x, y, rad)));
+    }
+    // Differences of float integral image sums of up to W*H values
+    CHECK(err <= 1e-4);
+
+    GuidedFilter(q, I, p, rad, eps);
+    const std::vector<double> ref = GuidedReference(dI, dp, rad, eps);
+    err = 0;
+    for(int y = 0; y < H; ++y)
+    for(int x = 0; x < W; ++x) {
+        err = std::max(err, std::fabs(q(x,y) - ref[y*W + x]));
+    }
+    CHECK(err <= 1e-5);
+
+    // p may be filtered in place
+    GuidedFilter(p, I, p, rad, eps);
+    int differ = 0;
+    for(int y = 0; y < H; ++y)
+    for(int x = 0; x < W; ++x) {
+        differ += p(x,y) != q(x,y);
+    }
+    CHECK(differ == 0);
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,117 @@
+#include <kangaroo/cu_median.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
+#include <vector>
+
+#include "test.h"
+
+using namespace roo;
+
+static const int W = 67;
+static const int H = 43;
+
+// Median of the clamped (2r+1)^2 window by sorting. With reject, non finite
+// values are left out and pixels with maxbad or more of them are invalid.
+static float SortedMedian(const Image<float,TargetHost>& in, int x, int y, int r, bool reject, int maxbad)
+{
+    std::vector<float> v;
+    int bad = 0;
+    for(int dy = -r; dy <= r; ++dy)
+    for(int dx = -r; dx <= r; ++dx) {
+        const float f = in.GetWithClampedRange(x+dx, y+dy);
+        if(reject && !std::isfinite(f)) {
+            ++bad;
+        }else{
+            v.push_back(f);
+        }
+    }
+    const int n = (2*r+1)*(2*r+1);
+    if(reject && !(bad < maxbad && bad < n)) {
+        return std::numeric_limits<float>::quiet_NaN();
+    }
+    std::sort(v.begin(), v.end());
+    return v[(n + bad)/2 - bad];
+}
+
+static int CountMismatches(const Image<float,TargetHost>& out, const Image<float,TargetHost>& in, int r, bool reject, int maxbad)
+{
+    int wrong = 0;
+    for(int y = 0; y < H; ++y)
+    for(int x = 0; x < W; ++x) {
+        const float m = SortedMedian(in, x, y, r, reject, maxbad);
+        const float o = out(x,y);
+        wrong += !(m == o || (std::isnan(m) && std::isnan(o)));
+    }
+    return wrong;
+}
+
+// Quantised values so windows have ties, negative values are valid too
+inline float RandomValue()
+{
+    return (std::rand() % 200 - 50) / 4.0f;
+}
+
+// Plain medians of images without invalid values
+static void TestMedian()
+{
+    Image<float,TargetHostAligned,Manage> in(W,H), out(W,H);
+    for(int trial = 0; trial < 10; ++trial) {
+        for(int y = 0; y < H; ++y)
+        for(int x = 0; x < W; ++x) {
+            in(x,y) = RandomValue();
+        }
+
+        MedianFilter3x3(out, in);
+        CHECK(CountMismatches(out, in, 1, false, 0) == 0);
+
+        MedianFilter5x5(out, in);
+        CHECK(CountMismatches(out, in, 2, false, 0) == 0);
+    }
+}
+
+// Medians ignoring NaN and infinities, with densities of invalid values on
+// both sides of maxbad
+static void TestRejectNegative()
+{
+    const float invalid[3] = {
+        std::numeric_limits<float>::quiet_NaN(),
+        std::numeric_limits<float>::infinity(),
+        -std::numeric_limits<float>::infinity()
+    };
+
+    Image<float,TargetHostAligned,Manage> in(W,H), out(W,H);
+    for(int trial = 0; trial < 10; ++trial) {
+        const int density = 2 + trial % 5;
+        for(int y = 0; y < H; ++y)
+        for(int x = 0; x < W; ++x) {
+            in(x,y) = std::rand() % density ? RandomValue() : invalid[std::rand() % 3];
+        }
+
+        MedianFilterRejectNegative5x5(out, in, 8);
+        CHECK(CountMismatches(out, in, 2, true, 8) == 0);
+
+        MedianFilterRejectNegative7x7(out, in, 20);
+        CHECK(CountMismatches(out, in, 3, true, 20) == 0);
+
+        MedianFilterRejectNegative9x9(out, in, 81);
+        CHECK(CountMismatches(out, in, 4, true, 81) == 0);
+    }
+
+    // A fully invalid image has no median anywhere
+    for(int y = 0; y < H; ++y)
+    for(int x = 0; x < W; ++x) {
+        in(x,y) = invalid[0];
+    }
+    MedianFilterRejectNegative5x5(out, in, 100);
+    CHECK(CountMismatches(out, in, 2, true, 100) == 0);
+}
+
+int main()
+{
+    std::srand(1);
+    TestMedian();
+    TestRejectNegative();
+    return TEST_RESULT();
+}
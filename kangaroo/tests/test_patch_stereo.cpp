@@ -0,0 +1,91 @@
+#include <kangaroo/cu_dense_stereo.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <stdexcept>
+
+#include "test.h"
+
+using namespace roo;
+
+static const int W = 73;
+static const int H = 41;
+static const int D = 19;
+
+// Largest difference between the box sum costs and the direct patch scores,
+// relative to the largest score
+template<typename Score, typename TImg>
+static double MaxError(const Image<TImg,TargetHost> left, const Image<TImg,TargetHost> right, float sd)
+{
+    Volume<float,TargetHostAligned,Manage> vol(W,H,D);
+    CostVolumeFromStereoPatch<Score,TImg>(vol, left, right, sd);
+
+    double err = 0;
+    double maxScore = 1;
+    for(int y = 0; y < H; ++y)
+    for(int x = 0; x < W; ++x)
+    for(int d = 0; d < D; ++d) {
+        const float s = Score::Score(left, x, y, right, x + (int)(sd*d), y);
+        err = std::max(err, (double)std::fabs(s - vol(x,y,d)));
+        maxScore = std::max(maxScore, (double)std::fabs(s));
+    }
+    return err / maxScore;
+}
+
+// SAD and SSD of integer intensities are sums of integers, bit exact against
+// the direct scores. SSND subtracts large sums and is only close.
+template<typename TImg>
+static void TestScores(const Image<TImg,TargetHost> left, const Image<TImg,TargetHost> right, float sd)
+{
+    double e = MaxError<SADPatchScore<float,1,ImgAccessClamped>,TImg>(left, right, sd);
+    CHECK(e == 0);
+    e = MaxError<SADPatchScore<float,3,ImgAccessClamped>,TImg>(left, right, sd);
+    CHECK(e == 0);
+    e = MaxError<SADPatchScore<float,7,ImgAccessClamped>,TImg>(left, right, sd);
+    CHECK(e == 0);
+    e = MaxError<SSDPatchScore<float,2,ImgAccessClamped>,TImg>(left, right, sd);
+    CHECK(e == 0);
+    e = MaxError<SSDPatchScore<float,5,ImgAccessClamped>,TImg>(left, right, sd);
+    CHECK(e == 0);
+    e = MaxError<SSNDPatchScore<float,3,ImgAccessClamped>,TImg>(left, right, sd);
+    CHECK(e <= 1e-5);
+}
+
+int main()
+{
+    Image<unsigned char,TargetHostAligned,Manage> left(W,H), right(W,H);
+    std::srand(5);
+    for(int y = 0; y < H; ++y)
+    for(int x = 0; x < W; ++x) {
+        left(x,y) = std::rand() % 256;
+        right(x,y) = std::rand() % 256;
+    }
+
+    TestScores<unsigned char>(left, right, -1);
+    TestScores<unsigned char>(left, right, 1);
+    TestScores<unsigned char>(left, right, -2);
+
+    // Float images need the same sums in a different order, so only close
+    Image<float,TargetHostAligned,Manage> leftf(W,H), rightf(W,H);
+    for(int y = 0; y < H; ++y)
+    for(int x = 0; x < W; ++x) {
+        leftf(x,y) = left(x,y) / 255.0f;
+        rightf(x,y) = right(x,y) / 255.0f;
+    }
+    double e = MaxError<SADPatchScore<float,2,ImgAccessClamped>,float>(leftf, rightf, -1);
+    CHECK(e <= 1e-5);
+    e = MaxError<SSNDPatchScore<float,5,ImgAccessClamped>,float>(leftf, rightf, -1);
+    CHECK(e <= 1e-5);
+
+    // Fractional disparity steps have no single column offset per disparity
+    bool thrown = false;
+    try {
+        Volume<float,TargetHostAligned,Manage> vol(W,H,D);
+        CostVolumeFromStereoPatch<SADPatchScore<float,1,ImgAccessClamped>,unsigned char>(vol, left, right, -0.5f);
+    }catch(const std::invalid_argument&) {
+        thrown = true;
+    }
+    CHECK(thrown);
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,87 @@
+#include <kangaroo/cu_dense_stereo.h>
+
+#include <cmath>
+
+#include "test.h"
+
+using namespace roo;
+
+static const int W = 96;
+static const int H = 72;
+static const int D = 24;
+static const int Views = 4;
+
+// Texture of the fronto-parallel world plane
+inline float Texture(float x, float y)
+{
+    return 100 + 40*std::sin(37*x + 11*y) + 30*std::sin(13*x - 41*y) + 20*std::sin(71*x + 53*y);
+}
+
+inline Mat<float,3,4> Translation(float tx, float ty)
+{
+    Mat<float,3,4> T;
+    for(int i = 0; i < 3; ++i)
+    for(int j = 0; j < 4; ++j) {
+        T(i,j) = (i == j) ? 1.0f : 0.0f;
+    }
+    T(0,3) = tx;
+    T(1,3) = ty;
+    return T;
+}
+
+// Views around the reference all see the plane at depth z, every interior
+// pixel has to pick the plane of disparity fu*baseline/z
+static void TestSinglePlane()
+{
+    const float fu = 150;
+    const float baseline = 0.1f;
+    const float z = 1.5f;
+    const int expected = (int)(fu*baseline/z + 0.5f);
+    const ImageIntrinsics K(fu, fu, W/2.0f, H/2.0f);
+    const float offset[Views+1][2] = {{0,0}, {-baseline,0}, {baseline,0}, {0,-baseline}, {0,baseline}};
+
+    Image<float,TargetHostAligned,Manage> imgs[Views+1] = {{W,H},{W,H},{W,H},{W,H},{W,H}};
+    ImageKeyframe<float,TargetHost> kf[Views+1];
+    for(int i = 0; i <= Views; ++i) {
+        kf[i].K = K;
+        kf[i].T_iw = Translation(offset[i][0], offset[i][1]);
+        kf[i].img = imgs[i];
+        for(int v = 0; v < H; ++v)
+        for(int u = 0; u < W; ++u) {
+            const float x = (u - K.u0) / fu * z;
+            const float y = (v - K.v0) / fu * z;
+            imgs[i](u,v) = Texture(x - offset[i][0], y - offset[i][1]);
+        }
+    }
+
+    Volume<CostVolElem,TargetHostAligned,Manage> vol(W,H,D);
+    PlaneSweep<float>(vol, kf[0], kf+1, Views, baseline);
+
+    Image<float,TargetHostAligned,Manage> disp(W,H);
+    CostVolMinimum(disp, vol);
+
+    // Pixels within the largest disparity of the border see outside a view
+    int wrong = 0;
+    for(int v = D; v < H-D; ++v)
+    for(int u = D; u < W-D; ++u) {
+        wrong += disp(u,v) != expected;
+    }
+    CHECK(wrong == 0);
+
+    // Accumulating the same views again keeps the minimum
+    PlaneSweep<float>(vol, kf[0], kf+1, Views, baseline, true);
+    Image<float,TargetHostAligned,Manage> disp2(W,H);
+    CostVolMinimum(disp2, vol);
+    wrong = 0;
+    for(int v = D; v < H-D; ++v)
+    for(int u = D; u < W-D; ++u) {
+        wrong += disp2(u,v) != disp(u,v);
+    }
+    CHECK(wrong == 0);
+}
+
+int main()
+{
+    TestSinglePlane();
+    return TEST_RESULT();
+}
@@ -0,0 +1,131 @@
+#include <kangaroo/RollingGridSDF/BoundedVolumeGrid.h>
+#include <kangaroo/RollingGridSDF/SparseVolumeGrid.h>
+
+#include <cstdlib>
+
+#include "test.h"
+
+using namespace roo;
+
+static const unsigned int Res = 32;
+static const unsigned int BlockRes = 8;
+static const unsigned int Blocks = Res / BlockRes;
+
+// Large, keep it off the stack
+static BoundedVolumeGrid<float,TargetHostAligned,Manage> bounded;
+
+inline float Value(unsigned int x, unsigned int y, unsigned int z)
+{
+    return 0.25f * x - 0.5f * y + 0.125f * z * z / Res;
+}
+
+inline bool BlockActive(unsigned int bx, unsigned int by, unsigned int bz)
+{
+    return (bx * 7 + by * 3 + bz * 5) % 3 != 0;
+}
+
+inline float Random(float lo, float hi)
+{
+    return lo + (hi - lo) * (std::rand() / (float)RAND_MAX);
+}
+
+// Get and GetUnitsTrilinearClamped agree with BoundedVolumeGrid on the same
+// set of active blocks, including NaN for missing blocks.
+static void TestMatchesBoundedVolumeGrid()
+{
+    const BoundingBox bbox(make_float3(-1,-1,0), make_float3(1,1,2));
+
+    SparseVolumeGrid<float,TargetHostAligned> sparse;
+    sparse.Init(Res, Res, Res, BlockRes, bbox, Blocks * Blocks * Blocks);
+    bounded.Init(Res, Res, Res, BlockRes, bbox);
+
+    int active = 0;
+    for(unsigned int bz = 0; bz < Blocks; ++bz)
+    for(unsigned int by = 0; by < Blocks; ++by)
+    for(unsigned int bx = 0; bx < Blocks; ++bx) {
+        if(!BlockActive(bx,by,bz)) continue;
+        sparse.InitSingleBasicSDFWithGridIndex(bx*BlockRes, by*BlockRes, bz*BlockRes);
+        bounded.InitSingleBasicSDFWithGridIndex(bx*BlockRes, by*BlockRes, bz*BlockRes);
+        ++active;
+    }
+    sparse.SyncTable();
+    CHECK(sparse.GetActiveGridVolNum() == active);
+    CHECK(bounded.GetActiveGridVolNum() == active);
+
+    for(unsigned int z = 0; z < Res; ++z)
+    for(unsigned int y = 0; y < Res; ++y)
+    for(unsigned int x = 0; x < Res; ++x) {
+        if(!BlockActive(x/BlockRes, y/BlockRes, z/BlockRes)) continue;
+        sparse.Get(x,y,z) = Value(x,y,z);
+        bounded.Get(x,y,z) = Value(x,y,z);
+    }
+
+    int mismatches = 0;
+    for(unsigned int z = 0; z < Res; ++z)
+    for(unsigned int y = 0; y < Res; ++y)
+    for(unsigned int x = 0; x < Res; ++x) {
+        CHECK(sparse.CheckIfVoxelExist(x,y,z) == BlockActive(x/BlockRes, y/BlockRes, z/BlockRes));
+        if(sparse.CheckIfVoxelExist(x,y,z) && sparse.Get(x,y,z) != bounded.Get(x,y,z)) {
+            ++mismatches;
+        }
+    }
+    CHECK(mismatches == 0);
+
+    int nans = 0;
+    mismatches = 0;
+    std::srand(1);
+    for(int i = 0; i < 20000; ++i) {
+        // Slightly outside the box too, to exercise clamping
+        const float3 p = make_float3(Random(-1.1f,1.1f), Random(-1.1f,1.1f), Random(-0.1f,2.1f));
+        const float s = sparse.GetUnitsTrilinearClamped(p);
+        const float b = bounded.GetUnitsTrilinearClamped(p);
+        if(s != s || b != b) {
+            nans++;
+            mismatches += (s != s) != (b != b);
+        }else if(std::fabs(s - b) > 1e-5f) {
+            mismatches++;
+        }
+    }
+    CHECK(mismatches == 0);
+    CHECK(nans > 0);
+
+    sparse.FreeMemory();
+    bounded.FreeMemory();
+}
+
+// Blocks can be freed and added again, the slot goes back to the pool
+static void TestFreeBlock()
+{
+    const BoundingBox bbox(make_float3(0,0,0), make_float3(1,1,1));
+
+    SparseVolumeGrid<float,TargetHostAligned> sparse;
+    sparse.Init(Res, Res, Res, BlockRes, bbox, 4);
+    CHECK(sparse.m_nCapacity == 4);
+
+    const int3 a = make_int3(0,0,0);
+    const int3 b = make_int3(1,2,3);
+    const int sa = sparse.InitBlock(a);
+    const int sb = sparse.InitBlock(b);
+    CHECK(sa != sb);
+    CHECK(sparse.InitBlock(a) == sa);
+    CHECK(sparse.GetActiveGridVolNum() == 2);
+
+    CHECK(sparse.FreeBlock(a));
+    CHECK(!sparse.FreeBlock(a));
+    CHECK(!sparse.CheckIfBlockActive(a));
+    CHECK(sparse.FindSlot(b) == sb);
+    CHECK(sparse.GetActiveGridVolNum() == 1);
+
+    CHECK(sparse.InitBlock(make_int3(3,3,3)) == sa);
+
+    sparse.FreeMemory();
+    CHECK(sparse.m_pBlocks == 0);
+    CHECK(sparse.m_pHostTable == 0);
+}
+
+int main()
+{
+    TestMatchesBoundedVolumeGrid();
+    TestFreeBlock();
+    return TEST_RESULT();
+}